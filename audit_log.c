@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "log_rpc.h"
+#include "audit_log.h"
+
+#define BATCH_SIZE       256     // Registros por llamada LOG_BATCH
+#define IDLE_SLEEP_NS    2000000 // Espera del shipper con la cola vacía (2 ms)
+#define BLOCK_SLEEP_NS   100000  // Espera de un productor con la cola llena (0.1 ms)
+
+// Cola acotada de Vyukov: cada celda lleva un número de secuencia que dice
+// si está libre para el productor de la vuelta "pos" o lista para el consumidor.
+typedef struct {
+    _Atomic size_t seq;
+    AuditRecord record;
+} Cell;
+
+static Cell* cells = NULL;
+static size_t mask = 0;
+static _Atomic size_t enqueue_pos = 0;
+static _Atomic size_t dequeue_pos = 0;   // Sólo lo escribe el shipper
+
+static CLIENT* log_clnt = NULL;
+static AuditOverflow overflow_policy = AUDIT_OVERFLOW_DROP;
+
+// Volcado a disco (sólo con AUDIT_OVERFLOW_SPILL)
+static pthread_mutex_t spill_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char spill_path[256];
+static int spill_fd = -1;
+static _Atomic uint64_t spill_pending = 0;
+
+static _Atomic uint64_t stat_enqueued = 0;
+static _Atomic uint64_t stat_shipped = 0;
+static _Atomic uint64_t stat_dropped = 0;
+static _Atomic uint64_t stat_spilled = 0;
+static _Atomic uint64_t stat_batches = 0;
+static _Atomic uint64_t stat_failed_batches = 0;
+
+static void sleep_ns(long ns) {
+    struct timespec ts = { 0, ns };
+    nanosleep(&ts, NULL);
+}
+
+static void copy_field(char* dst, const char* src, size_t size) {
+    strncpy(dst, src ? src : "", size - 1);
+    dst[size - 1] = '\0';
+}
+
+// ----------------------------
+// Cola MPSC
+// ----------------------------
+
+static int try_enqueue(const AuditRecord* rec) {
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    Cell* cell;
+
+    while (1) {
+        cell = &cells[pos & mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return 0; // Llena
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    cell->record = *rec;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 1;
+}
+
+static int try_dequeue(AuditRecord* out) {
+    size_t pos = atomic_load_explicit(&dequeue_pos, memory_order_relaxed);
+    Cell* cell = &cells[pos & mask];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    if (seq != pos + 1) return 0; // Vacía (o el productor aún escribe)
+
+    *out = cell->record;
+    atomic_store_explicit(&cell->seq, pos + mask + 1, memory_order_release);
+    atomic_store_explicit(&dequeue_pos, pos + 1, memory_order_relaxed);
+    return 1;
+}
+
+// ----------------------------
+// Volcado a disco
+// ----------------------------
+
+static void spill_records(const AuditRecord* recs, int n) {
+    pthread_mutex_lock(&spill_mutex);
+    if (spill_fd < 0) spill_fd = open(spill_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+    ssize_t bytes = (ssize_t)(n * sizeof(AuditRecord));
+    if (spill_fd >= 0 && write(spill_fd, recs, bytes) == bytes) {
+        atomic_fetch_add(&spill_pending, n);
+        atomic_fetch_add(&stat_spilled, n);
+    } else {
+        atomic_fetch_add(&stat_dropped, n);
+    }
+    pthread_mutex_unlock(&spill_mutex);
+}
+
+// ----------------------------
+// Shipper
+// ----------------------------
+
+// Envía un lote con LOG_BATCH. Si falla, se vuelca o se descarta según la política.
+static void ship_batch(const AuditRecord* recs, int n) {
+    log_action_args args[BATCH_SIZE];
+    for (int i = 0; i < n; i++) {
+        args[i].user = (char*)recs[i].user;
+        args[i].operation = (char*)recs[i].operation;
+        args[i].timestamp = recs[i].time_us;
+    }
+
+    log_batch_args batch;
+    batch.records.records_len = n;
+    batch.records.records_val = args;
+
+    struct timeval timeout = { 5, 0 };
+    enum clnt_stat st = clnt_call(log_clnt, LOG_BATCH,
+                                  (xdrproc_t)xdr_log_batch_args, (caddr_t)&batch,
+                                  (xdrproc_t)xdr_void, NULL, timeout);
+
+    if (st == RPC_SUCCESS) {
+        atomic_fetch_add(&stat_batches, 1);
+        atomic_fetch_add(&stat_shipped, n);
+        return;
+    }
+
+    atomic_fetch_add(&stat_failed_batches, 1);
+    if (overflow_policy == AUDIT_OVERFLOW_SPILL) {
+        spill_records(recs, n);
+    } else {
+        atomic_fetch_add(&stat_dropped, n);
+    }
+}
+
+// Reenvía lo volcado a disco. Se renombra el fichero para que los productores
+// puedan seguir volcando mientras se envía.
+static void ship_spilled(void) {
+    char sending_path[300];
+    snprintf(sending_path, sizeof(sending_path), "%s.sending", spill_path);
+
+    pthread_mutex_lock(&spill_mutex);
+    if (spill_fd >= 0) {
+        close(spill_fd);
+        spill_fd = -1;
+    }
+    int renamed = rename(spill_path, sending_path) == 0;
+    atomic_store(&spill_pending, 0);
+    pthread_mutex_unlock(&spill_mutex);
+    if (!renamed) return;
+
+    int fd = open(sending_path, O_RDONLY);
+    if (fd < 0) return;
+
+    AuditRecord* recs = malloc(BATCH_SIZE * sizeof(AuditRecord));
+    ssize_t bytes;
+    while (recs && (bytes = read(fd, recs, BATCH_SIZE * sizeof(AuditRecord))) > 0) {
+        ship_batch(recs, (int)(bytes / sizeof(AuditRecord)));
+    }
+    free(recs);
+    close(fd);
+    unlink(sending_path);
+}
+
+// Avisa (como mucho una vez por segundo) si se han perdido registros
+static void report_drops(void) {
+    static uint64_t reported = 0;
+    static time_t last = 0;
+
+    time_t now = time(NULL);
+    uint64_t dropped = atomic_load(&stat_dropped);
+    if (dropped == reported || now == last) return;
+
+    AuditStats st;
+    audit_log_stats(&st);
+    fprintf(stderr, "s> AUDIT LOG: %llu records dropped (queue depth %llu)\n",
+            (unsigned long long)dropped, (unsigned long long)st.depth);
+    reported = dropped;
+    last = now;
+}
+
+static void* shipper_main(void* arg) {
+    AuditRecord* batch = malloc(BATCH_SIZE * sizeof(AuditRecord));
+
+    while (1) {
+        report_drops();
+
+        int n = 0;
+        while (n < BATCH_SIZE && try_dequeue(&batch[n])) n++;
+
+        if (n > 0) {
+            ship_batch(batch, n);
+        } else if (atomic_load(&spill_pending) > 0) {
+            ship_spilled();
+        } else {
+            sleep_ns(IDLE_SLEEP_NS);
+        }
+    }
+    return NULL;
+}
+
+// ----------------------------
+// API
+// ----------------------------
+
+int audit_log_init(CLIENT* clnt, size_t capacity, AuditOverflow policy, const char* spill) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    cells = malloc(cap * sizeof(Cell));
+    if (!cells) return -1;
+    for (size_t i = 0; i < cap; i++) atomic_init(&cells[i].seq, i);
+    mask = cap - 1;
+
+    log_clnt = clnt;
+    overflow_policy = policy;
+    copy_field(spill_path, spill ? spill : "audit_spill.bin", sizeof(spill_path));
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, shipper_main, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+void audit_log_record(const char* user, const char* operation, uint64_t time_us) {
+    AuditRecord rec;
+    copy_field(rec.user, user, sizeof(rec.user));
+    copy_field(rec.operation, operation, sizeof(rec.operation));
+    rec.time_us = time_us;
+
+    while (!try_enqueue(&rec)) {
+        if (overflow_policy == AUDIT_OVERFLOW_DROP) {
+            atomic_fetch_add(&stat_dropped, 1);
+            return;
+        }
+        if (overflow_policy == AUDIT_OVERFLOW_SPILL) {
+            spill_records(&rec, 1);
+            return;
+        }
+        sleep_ns(BLOCK_SLEEP_NS); // AUDIT_OVERFLOW_BLOCK
+    }
+    atomic_fetch_add(&stat_enqueued, 1);
+}
+
+void audit_log_stats(AuditStats* out) {
+    size_t enq = atomic_load(&enqueue_pos);
+    size_t deq = atomic_load(&dequeue_pos);
+    out->depth = enq >= deq ? enq - deq : 0;
+    out->enqueued = atomic_load(&stat_enqueued);
+    out->shipped = atomic_load(&stat_shipped);
+    out->dropped = atomic_load(&stat_dropped);
+    out->spilled = atomic_load(&stat_spilled);
+    out->batches = atomic_load(&stat_batches);
+    out->failed_batches = atomic_load(&stat_failed_batches);
+}
+
+int audit_parse_overflow(const char* name, AuditOverflow* out) {
+    if (strcmp(name, "drop") == 0) *out = AUDIT_OVERFLOW_DROP;
+    else if (strcmp(name, "block") == 0) *out = AUDIT_OVERFLOW_BLOCK;
+    else if (strcmp(name, "spill") == 0) *out = AUDIT_OVERFLOW_SPILL;
+    else return -1;
+    return 0;
+}
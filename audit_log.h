@@ -0,0 +1,46 @@
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include <stdint.h>
+#include <tirpc/rpc/rpc.h>
+
+// ----------------------------
+// Registro de auditoría asíncrono
+// ----------------------------
+//
+// Los hilos que atienden peticiones dejan cada registro en una cola acotada
+// sin locks (MPSC) y siguen con su trabajo. Un hilo "shipper" la vacía y
+// manda los registros al servidor RPC en lotes con LOG_BATCH.
+
+#define AUDIT_USER_LEN       256
+#define AUDIT_OPERATION_LEN  512
+
+// Qué hacer cuando la cola está llena
+typedef enum {
+    AUDIT_OVERFLOW_DROP,     // Descartar el registro (y contarlo)
+    AUDIT_OVERFLOW_BLOCK,    // Esperar a que haya hueco
+    AUDIT_OVERFLOW_SPILL     // Volcarlo a disco; se reenvía cuando se vacíe la cola
+} AuditOverflow;
+
+typedef struct {
+    char user[AUDIT_USER_LEN];
+    char operation[AUDIT_OPERATION_LEN];
+    uint64_t time_us;        // Hora del servidor (coarse_clock.h)
+} AuditRecord;
+
+typedef struct {
+    uint64_t depth;          // Registros en cola ahora mismo
+    uint64_t enqueued;       // Registros aceptados en la cola
+    uint64_t shipped;        // Registros entregados al servidor RPC
+    uint64_t dropped;        // Registros perdidos (cola llena o fallo RPC)
+    uint64_t spilled;        // Registros volcados a disco
+    uint64_t batches;        // Llamadas LOG_BATCH correctas
+    uint64_t failed_batches; // Llamadas LOG_BATCH fallidas
+} AuditStats;
+
+int audit_log_init(CLIENT* clnt, size_t capacity, AuditOverflow policy, const char* spill_path);
+void audit_log_record(const char* user, const char* operation, uint64_t time_us);
+void audit_log_stats(AuditStats* out);
+int audit_parse_overflow(const char* name, AuditOverflow* out);
+
+#endif
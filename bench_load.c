@@ -0,0 +1,509 @@
+// bench_load.c: Generador de carga contra el servidor de sockets.
+//
+// Antes de medir se crea una población de -u usuarios registrados y
+// conectados, cada uno con -f archivos publicados. Después cada hilo lanza
+// -n peticiones eligiendo la operación al azar según la mezcla -m, con el
+// mismo formato OP\0usuario\0...\0timestamp\0 que envía client.py:
+//
+//   REGISTER      usuario nuevo cada vez
+//   CONNECT       alterna CONNECT y DISCONNECT sobre un usuario propio del hilo
+//                 (cada mitad sale en su fila del CSV)
+//   PUBLISH       archivo nuevo de un usuario de la población
+//   LIST_USERS    desde un usuario de la población
+//   LIST_CONTENT  de un usuario de la población a otro
+//   GET_FILE      un archivo precargado de otro usuario de la población
+//
+// Sin -2 cada petición abre una conexión nueva (como client.py) y la
+// latencia va desde connect() hasta recibir la respuesta completa.
+//
+// Con -2 cada hilo usa una única conexión v2 persistente y mantiene hasta
+// -d peticiones en vuelo (pipelining); la latencia es desde que se envía
+// la tanda hasta que llega cada respuesta.
+//
+// Con varios puertos en -p (p. ej. los de los shards, ver shard.h) cada
+// hilo va siempre al suyo, repartidos por turno: como varios clientes que
+// entran por servidores distintos a un mismo directorio.
+//
+// Al final se imprime en CSV, por operación y en total: peticiones, errores
+// de red, respuestas con código distinto de 0, throughput y p50/p99/p999.
+//
+// Uso: ./bench_load -s <host> -p <port>[,<port>...] [-c hilos] [-n peticiones por hilo]
+//                   [-u usuarios] [-f archivos por usuario] [-m OP=peso,...]
+//                   [-2 [-d profundidad]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define DEFAULT_MIX "LIST_USERS=30,LIST_CONTENT=25,GET_FILE=25,PUBLISH=10,CONNECT=8,REGISTER=2"
+#define TIMESTAMP   "01/01/2025 00:00:00"
+#define MAX_MSG     512
+#define MAX_REPLY   (1 << 20)       // LIST_USERS con muchos usuarios ocupa bastante
+#define MAX_SERVERS 64
+
+enum { OP_REGISTER, OP_CONNECT, OP_DISCONNECT, OP_PUBLISH, OP_LIST_USERS,
+       OP_LIST_CONTENT, OP_GET_FILE, NUM_OPS };
+
+static const char* op_names[NUM_OPS] = {
+    "REGISTER", "CONNECT", "DISCONNECT", "PUBLISH", "LIST_USERS", "LIST_CONTENT", "GET_FILE"
+};
+
+static struct sockaddr_in server_addrs[MAX_SERVERS];
+static int num_servers = 0;
+static int requests_per_thread = 1000;
+static int num_threads = 8;
+static int num_users = 1000;
+static int files_per_user = 5;
+static int use_v2 = 0;
+static int pipeline_depth = 16;
+static int run_tag;                  // Distingue los nombres de cada ejecución
+static int mix[NUM_OPS];             // Peso de cada operación (DISCONNECT va con CONNECT)
+static int mix_total = 0;
+
+static pthread_barrier_t setup_done;
+
+// Latencias de una operación en un hilo
+typedef struct {
+    double* latencies;    // Segundos
+    int done;             // Peticiones completadas
+    int errors;           // connect/send/recv fallidos
+    int fails;            // Respuesta con código distinto de 0
+} OpStats;
+
+typedef struct {
+    int id;
+    const struct sockaddr_in* server;   // Servidor al que va este hilo
+    uint64_t rng;
+    int session_connected;   // Estado del usuario propio para CONNECT/DISCONNECT
+    int registered;          // Usuarios creados con REGISTER
+    int published;           // Archivos creados con PUBLISH
+    OpStats ops[NUM_OPS];
+} Worker;
+
+// Petición ya serializada y la operación a la que se apunta
+typedef struct {
+    int op;
+    int len;
+    char msg[MAX_MSG];
+} Request;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t next_rand(Worker* w) {
+    // xorshift64: barato y sin estado compartido entre hilos
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 7;
+    w->rng ^= w->rng << 17;
+    return (uint32_t)(w->rng >> 32);
+}
+
+// ----------------------------
+// Construcción de peticiones
+// ----------------------------
+
+// Concatena los campos con su \0 y añade el timestamp al final
+static int build_fields(char* buf, const char* const* fields, int count) {
+    int len = 0;
+    for (int i = 0; i < count; i++) {
+        int n = strlen(fields[i]) + 1;
+        if (len + n + (int)sizeof(TIMESTAMP) > MAX_MSG) break;
+        memcpy(buf + len, fields[i], n);
+        len += n;
+    }
+    memcpy(buf + len, TIMESTAMP, sizeof(TIMESTAMP));
+    return len + sizeof(TIMESTAMP);
+}
+
+static void population_user(char* out, size_t size, int i) {
+    snprintf(out, size, "bench%d_u%d", run_tag, i);
+}
+
+static void preload_file(char* out, size_t size, int i) {
+    snprintf(out, size, "f%d.dat", i);
+}
+
+static int pick_op(Worker* w) {
+    int r = next_rand(w) % mix_total;
+    for (int op = 0; op < NUM_OPS; op++) {
+        if (r < mix[op]) return op;
+        r -= mix[op];
+    }
+    return OP_LIST_USERS;
+}
+
+static void next_request(Worker* w, Request* req) {
+    char user[64], other[64], file[64], port[16], session[64];
+    population_user(user, sizeof(user), next_rand(w) % num_users);
+    population_user(other, sizeof(other), next_rand(w) % num_users);
+
+    req->op = pick_op(w);
+    switch (req->op) {
+        case OP_REGISTER: {
+            snprintf(session, sizeof(session), "bench%d_r%d_%d", run_tag, w->id, w->registered++);
+            const char* f[] = { "REGISTER", session };
+            req->len = build_fields(req->msg, f, 2);
+            break;
+        }
+        case OP_CONNECT: {
+            snprintf(session, sizeof(session), "bench%d_s%d", run_tag, w->id);
+            if (w->session_connected) {
+                req->op = OP_DISCONNECT;
+                const char* f[] = { "DISCONNECT", session };
+                req->len = build_fields(req->msg, f, 2);
+            } else {
+                snprintf(port, sizeof(port), "%d", 20000 + w->id);
+                const char* f[] = { "CONNECT", session, port };
+                req->len = build_fields(req->msg, f, 3);
+            }
+            w->session_connected = !w->session_connected;
+            break;
+        }
+        case OP_PUBLISH: {
+            snprintf(file, sizeof(file), "p%d_%d.dat", w->id, w->published++);
+            const char* f[] = { "PUBLISH", user, file, "bench" };
+            req->len = build_fields(req->msg, f, 4);
+            break;
+        }
+        case OP_LIST_CONTENT: {
+            const char* f[] = { "LIST_CONTENT", user, other };
+            req->len = build_fields(req->msg, f, 3);
+            break;
+        }
+        case OP_GET_FILE: {
+            preload_file(file, sizeof(file), files_per_user ? next_rand(w) % files_per_user : 0);
+            const char* f[] = { "GET_FILE", user, other, file };
+            req->len = build_fields(req->msg, f, 4);
+            break;
+        }
+        default: {
+            req->op = OP_LIST_USERS;
+            const char* f[] = { "LIST_USERS", user };
+            req->len = build_fields(req->msg, f, 2);
+            break;
+        }
+    }
+}
+
+// Lee "OP=peso,OP=peso". CONNECT cubre también los DISCONNECT.
+static int parse_mix(const char* spec) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", spec);
+    memset(mix, 0, sizeof(mix));
+    mix_total = 0;
+
+    char* save = NULL;
+    for (char* tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char* eq = strchr(tok, '=');
+        int weight = eq ? atoi(eq + 1) : 1;
+        if (eq) *eq = '\0';
+
+        int op;
+        for (op = 0; op < NUM_OPS; op++) {
+            if (op != OP_DISCONNECT && strcmp(tok, op_names[op]) == 0) break;
+        }
+        if (op == NUM_OPS || weight < 0) {
+            fprintf(stderr, "Operación no válida en la mezcla: %s\n", tok);
+            return -1;
+        }
+        mix[op] = weight;
+        mix_total += weight;
+    }
+    return mix_total > 0 ? 0 : -1;
+}
+
+// ----------------------------
+// Envío
+// ----------------------------
+
+// Envía una petición por una conexión nueva y lee la respuesta hasta el
+// cierre. Devuelve el código de resultado (primer byte) o -1.
+static int do_request(const struct sockaddr_in* server, const char* msg, int msg_len) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+
+    if (connect(sock, (const struct sockaddr*)server, sizeof(*server)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    if (send(sock, msg, msg_len, 0) != msg_len) {
+        close(sock);
+        return -1;
+    }
+
+    char buffer[4096];
+    int total = 0, code = -1;
+    ssize_t n;
+    while ((n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        if (total == 0) code = (unsigned char)buffer[0];
+        total += n;
+    }
+    close(sock);
+    return code;
+}
+
+static int recv_exact(int sock, void* buf, int n) {
+    int got = 0;
+    while (got < n) {
+        ssize_t r = recv(sock, (char*)buf + got, n - got, 0);
+        if (r <= 0) return -1;
+        got += r;
+    }
+    return 0;
+}
+
+static void record(OpStats* s, double latency, int code) {
+    s->latencies[s->done++] = latency;
+    if (code != 0) s->fails++;
+}
+
+// Registra, conecta y publica los archivos de los usuarios que tocan a este
+// hilo. El usuario propio para CONNECT/DISCONNECT sólo se registra.
+static void setup_population(Worker* w) {
+    char msg[MAX_MSG], user[64], file[64], port[16];
+    snprintf(user, sizeof(user), "bench%d_s%d", run_tag, w->id);
+    const char* session[] = { "REGISTER", user };
+    do_request(w->server, msg, build_fields(msg, session, 2));
+
+    for (int i = w->id; i < num_users; i += num_threads) {
+        population_user(user, sizeof(user), i);
+        snprintf(port, sizeof(port), "%d", 30000 + i % 30000);
+
+        const char* reg[] = { "REGISTER", user };
+        do_request(w->server, msg, build_fields(msg, reg, 2));
+        const char* conn[] = { "CONNECT", user, port };
+        do_request(w->server, msg, build_fields(msg, conn, 3));
+        for (int j = 0; j < files_per_user; j++) {
+            preload_file(file, sizeof(file), j);
+            const char* pub[] = { "PUBLISH", user, file, "precarga" };
+            do_request(w->server, msg, build_fields(msg, pub, 4));
+        }
+    }
+}
+
+// Modo v2: una conexión, tandas de pipeline_depth tramas
+static void run_v2(Worker* w) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0 || connect(sock, (const struct sockaddr*)w->server, sizeof(*w->server)) < 0) {
+        w->ops[OP_LIST_USERS].errors += requests_per_thread;
+        if (sock >= 0) close(sock);
+        return;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    send(sock, "\0V2\0", 4, 0);
+
+    char* batch = malloc(pipeline_depth * (MAX_MSG + 5));
+    int* batch_ops = malloc(pipeline_depth * sizeof(int));
+    char* response = malloc(MAX_REPLY);
+    Request req;
+
+    for (int i = 0; i < requests_per_thread; i += pipeline_depth) {
+        int n = requests_per_thread - i < pipeline_depth ? requests_per_thread - i : pipeline_depth;
+        int batch_len = 0;
+        for (int j = 0; j < n; j++) {
+            next_request(w, &req);
+            uint32_t frame_len = htonl(req.len);
+            memcpy(batch + batch_len, &frame_len, 4);
+            batch[batch_len + 4] = 0; // flags
+            memcpy(batch + batch_len + 5, req.msg, req.len);
+            batch_len += 5 + req.len;
+            batch_ops[j] = req.op;
+        }
+
+        double t0 = now_sec();
+        if (send(sock, batch, batch_len, 0) != batch_len) {
+            for (int j = 0; j < n; j++) w->ops[batch_ops[j]].errors++;
+            break;
+        }
+        int broken = 0;
+        for (int j = 0; j < n; j++) {
+            uint32_t resp_len;
+            if (broken || recv_exact(sock, &resp_len, 4) < 0) {
+                w->ops[batch_ops[j]].errors++;
+                broken = 1;
+                continue;
+            }
+            resp_len = ntohl(resp_len);
+            if (resp_len == 0 || resp_len > MAX_REPLY || recv_exact(sock, response, resp_len) < 0) {
+                w->ops[batch_ops[j]].errors++;
+                broken = 1;
+                continue;
+            }
+            record(&w->ops[batch_ops[j]], now_sec() - t0, (unsigned char)response[0]);
+        }
+        if (broken) break;
+    }
+
+    free(response);
+    free(batch_ops);
+    free(batch);
+    close(sock);
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    setup_population(w);
+    pthread_barrier_wait(&setup_done);
+    pthread_barrier_wait(&setup_done); // main toma el tiempo de inicio entre las dos
+
+    if (use_v2) {
+        run_v2(w);
+        return NULL;
+    }
+
+    Request req;
+    for (int i = 0; i < requests_per_thread; i++) {
+        next_request(w, &req);
+
+        double t0 = now_sec();
+        int code = do_request(w->server, req.msg, req.len);
+        if (code < 0) {
+            w->ops[req.op].errors++;
+            continue;
+        }
+        record(&w->ops[req.op], now_sec() - t0, code);
+    }
+    return NULL;
+}
+
+// ----------------------------
+// Resultados
+// ----------------------------
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int n, double p) {
+    if (n == 0) return 0;
+    int idx = (int)(p * (n - 1));
+    return sorted[idx];
+}
+
+static void print_row(const char* name, double* lat, int n, int errors, int fails, double elapsed) {
+    qsort(lat, n, sizeof(double), cmp_double);
+    printf("%s,%d,%d,%d,%d,%.0f,%.1f,%.1f,%.1f,%.1f\n",
+           name, num_threads, n, errors, fails, n / elapsed,
+           percentile(lat, n, 0.50) * 1e6,
+           percentile(lat, n, 0.99) * 1e6,
+           percentile(lat, n, 0.999) * 1e6,
+           n ? lat[n - 1] * 1e6 : 0.0);
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    const char* mix_spec = DEFAULT_MIX;
+    const char* ports = "5000";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:c:n:u:f:m:2d:")) != -1) {
+        switch (opt) {
+            case 's': host = optarg; break;
+            case 'p': ports = optarg; break;
+            case 'c': num_threads = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+            case 'n': requests_per_thread = atoi(optarg); break;
+            case 'u': num_users = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+            case 'f': files_per_user = atoi(optarg) >= 0 ? atoi(optarg) : 0; break;
+            case 'm': mix_spec = optarg; break;
+            case '2': use_v2 = 1; break;
+            case 'd': pipeline_depth = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+            default:
+                fprintf(stderr, "Uso: %s -s <host> -p <port>[,<port>...] [-c hilos] [-n peticiones] [-u usuarios] "
+                                "[-f archivos] [-m OP=peso,...] [-2 [-d profundidad]]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (parse_mix(mix_spec) < 0) {
+        fprintf(stderr, "Mezcla no válida: %s\n", mix_spec);
+        return 1;
+    }
+
+    char port_list[256];
+    snprintf(port_list, sizeof(port_list), "%s", ports);
+    char* save = NULL;
+    for (char* p = strtok_r(port_list, ",", &save); p && num_servers < MAX_SERVERS; p = strtok_r(NULL, ",", &save)) {
+        struct sockaddr_in* addr = &server_addrs[num_servers++];
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(atoi(p));
+        if (inet_pton(AF_INET, host, &addr->sin_addr) != 1) {
+            fprintf(stderr, "IP no válida: %s\n", host);
+            return 1;
+        }
+    }
+    if (num_servers == 0) {
+        fprintf(stderr, "Puertos no válidos: %s\n", ports);
+        return 1;
+    }
+    run_tag = getpid();
+
+    Worker* workers = calloc(num_threads, sizeof(Worker));
+    pthread_t* tids = calloc(num_threads, sizeof(pthread_t));
+    pthread_barrier_init(&setup_done, NULL, num_threads + 1);
+
+    double t_setup = now_sec();
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].id = i;
+        workers[i].server = &server_addrs[i % num_servers];
+        workers[i].rng = 0x9E3779B97F4A7C15ULL * (i + 1) ^ run_tag;
+        for (int op = 0; op < NUM_OPS; op++) {
+            workers[i].ops[op].latencies = calloc(requests_per_thread, sizeof(double));
+        }
+        pthread_create(&tids[i], NULL, worker_main, &workers[i]);
+    }
+    pthread_barrier_wait(&setup_done);
+    fprintf(stderr, "bench_load: %d usuarios x %d archivos precargados en %.1f s\n",
+            num_users, files_per_user, now_sec() - t_setup);
+
+    double t0 = now_sec();
+    pthread_barrier_wait(&setup_done);
+    for (int i = 0; i < num_threads; i++) pthread_join(tids[i], NULL);
+    double elapsed = now_sec() - t0;
+
+    // Juntar las latencias de todos los hilos, por operación y en total
+    int total_requests = num_threads * requests_per_thread;
+    double* all = malloc(sizeof(double) * (total_requests ? total_requests : 1));
+    double* per_op = malloc(sizeof(double) * (total_requests ? total_requests : 1));
+    int all_n = 0, all_errors = 0, all_fails = 0;
+
+    printf("op,threads,requests,errors,fails,ops_per_sec,p50_us,p99_us,p999_us,max_us\n");
+    for (int op = 0; op < NUM_OPS; op++) {
+        int n = 0, errors = 0, fails = 0;
+        for (int i = 0; i < num_threads; i++) {
+            OpStats* s = &workers[i].ops[op];
+            memcpy(per_op + n, s->latencies, s->done * sizeof(double));
+            memcpy(all + all_n + n, s->latencies, s->done * sizeof(double));
+            n += s->done;
+            errors += s->errors;
+            fails += s->fails;
+        }
+        if (n + errors == 0) continue;
+        print_row(op_names[op], per_op, n, errors, fails, elapsed);
+        all_n += n;
+        all_errors += errors;
+        all_fails += fails;
+    }
+    print_row("ALL", all, all_n, all_errors, all_fails, elapsed);
+
+    for (int i = 0; i < num_threads; i++) {
+        for (int op = 0; op < NUM_OPS; op++) free(workers[i].ops[op].latencies);
+    }
+    free(per_op);
+    free(all);
+    free(tids);
+    free(workers);
+    pthread_barrier_destroy(&setup_done);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// bench_memory.c: Memoria del registro por usuario y por archivo publicado.
+//
+// Registra (y conecta) N usuarios con nombres de ~20 bytes y publica F
+// archivos por usuario; un tercio de los nombres de archivo son comunes a
+// todos (README.md, notes.txt...). Mide el heap en uso con mallinfo2 antes
+// y después de cada fase y saca los bytes por usuario y por archivo.
+//
+// Uso: ./bench_memory [-u usuarios] [-f archivos por usuario]
+//      (por defecto 100000 usuarios y 10 archivos)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <malloc.h>
+#include "registry.h"
+#include "epoch.h"
+
+static const char* common_files[] = {
+    "README.md", "notes.txt", "LICENSE", "photo.jpg", "song.mp3", "index.html",
+};
+#define NUM_COMMON (sizeof(common_files) / sizeof(common_files[0]))
+
+// Sin lectores, dos avances de época liberan todo lo retirado (tablas viejas)
+static size_t heap_in_use(void) {
+    epoch_reclaim();
+    epoch_reclaim();
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+}
+
+int main(int argc, char* argv[]) {
+    int num_users = 100000;
+    int files_per_user = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "u:f:")) != -1) {
+        switch (opt) {
+            case 'u': num_users = atoi(optarg); break;
+            case 'f': files_per_user = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Uso: %s [-u usuarios] [-f archivos por usuario]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (registry_init() < 0) {
+        perror("registry_init");
+        return 1;
+    }
+
+    char name[64], filename[64], description[64];
+
+    size_t base = heap_in_use();
+    for (int i = 0; i < num_users; i++) {
+        snprintf(name, sizeof(name), "usuario_prueba_%06d", i);
+        register_user(name);
+        connect_user(name, "192.168.1.100", 40000 + i % 20000);
+    }
+    size_t after_users = heap_in_use();
+
+    long files = 0;
+    for (int i = 0; i < num_users; i++) {
+        snprintf(name, sizeof(name), "usuario_prueba_%06d", i);
+        for (int j = 0; j < files_per_user; j++) {
+            if (j % 3 == 0) {
+                snprintf(filename, sizeof(filename), "%s", common_files[(i + j) % NUM_COMMON]);
+            } else {
+                snprintf(filename, sizeof(filename), "doc_%d_%d.pdf", i, j);
+            }
+            snprintf(description, sizeof(description), "Apuntes tema %d", j);
+            if (publish_file(name, filename, description) == 0) files++;
+        }
+    }
+    size_t after_files = heap_in_use();
+
+    printf("users,files,bytes_per_user,bytes_per_file,total_mb\n");
+    printf("%d,%ld,%.1f,%.1f,%.1f\n", num_users, files,
+           (double)(after_users - base) / num_users,
+           files ? (double)(after_files - after_users) / files : 0.0,
+           (after_files - base) / (1024.0 * 1024.0));
+    return 0;
+}
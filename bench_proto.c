@@ -0,0 +1,148 @@
+// bench_proto.c: Velocidad del códec del protocolo por tipo de mensaje.
+//
+// Codifica con proto_encode una petición típica de cada operación (los
+// lotes con -b elementos) y la parsea -n veces con proto_parse_request,
+// como hace el servidor con cada petición que le llega. Para las respuestas
+// mide proto_split sobre una de LIST_USERS con -b usuarios, que es lo que
+// trocea client.py. Saca mensajes/s y MB/s de cada caso.
+//
+// Uso: ./bench_proto [-n repeticiones] [-b elementos por lote]
+//      (por defecto 2000000 repeticiones y lotes de 64)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "proto.h"
+
+#define MSG_MAX   (64 * 1024)
+#define FIELDS_MAX 2048
+
+typedef struct {
+    const char* name;
+    char buf[MSG_MAX];
+    int len;
+} Message;
+
+static long reps = 2000000;
+static int batch = 64;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Petición de op con sus campos propios; si es un lote, añade batch
+// elementos de ejemplo. Siempre con timestamp al final.
+static void build(Message* m, int op) {
+    static char item_buf[FIELDS_MAX][32];
+    const char* fields[FIELDS_MAX];
+    int n = 0;
+    int items = proto_item_fields(op);
+    char count[16];
+
+    fields[n++] = proto_op_name(op);
+    fields[n++] = "usuario_42";
+    switch (op) {
+    case PROTO_CONNECT:           fields[n++] = "40123"; break;
+    case PROTO_PUBLISH:           fields[n++] = "/home/usuario_42/fichero.txt"; fields[n++] = "un fichero de prueba"; break;
+    case PROTO_GET_FILE:          fields[n++] = "usuario_7"; fields[n++] = "/home/usuario_7/fichero.txt"; break;
+    case PROTO_LIST_CONTENT_PAGE: fields[n++] = "usuario_7"; fields[n++] = "0"; fields[n++] = "1000"; fields[n++] = "d"; break;
+    case PROTO_PUBLISH_CONTENT:
+        fields[n++] = "/home/usuario_42/fichero.txt"; fields[n++] = "un fichero de prueba";
+        fields[n++] = "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08"; fields[n++] = "268435456";
+        break;
+    case PROTO_GET_SOURCES:       fields[n++] = "usuario_7"; fields[n++] = "/home/usuario_7/fichero.txt"; fields[n++] = "8"; break;
+    default:
+        if (items) {
+            snprintf(count, sizeof(count), "%d", batch);
+            fields[n++] = count;
+            for (int i = 0; i < batch * items && n < FIELDS_MAX - 1; i++) {
+                snprintf(item_buf[i], sizeof(item_buf[i]), i % 2 ? "fichero_%d.txt" : "usuario_%d", i);
+                fields[n++] = item_buf[i];
+            }
+        } else {
+            for (int i = 0; i < proto_op_args(op); i++) fields[n++] = "argumento";
+        }
+    }
+    fields[n++] = "18/10/2026 10:00:00";
+
+    m->name = proto_op_name(op);
+    m->len = proto_encode(m->buf, sizeof(m->buf), fields, n);
+    if (m->len < 0) {
+        fprintf(stderr, "%s no cabe en %d bytes\n", m->name, MSG_MAX);
+        exit(1);
+    }
+}
+
+static void report(const char* name, int len, double secs) {
+    printf("%-20s %8d %14.0f %10.0f\n", name, len, reps / secs, (double)reps * len / secs / 1e6);
+}
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:")) != -1) {
+        switch (opt) {
+            case 'n': reps = atol(optarg); break;
+            case 'b': batch = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Uso: %s [-n repeticiones] [-b elementos por lote]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (batch < 1 || batch * 2 > FIELDS_MAX - 8) {
+        fprintf(stderr, "-b tiene que estar entre 1 y %d\n", (FIELDS_MAX - 8) / 2);
+        return 1;
+    }
+
+    static Message msgs[PROTO_OTHER];
+    int ok = 1;
+    volatile long sink = 0;
+
+    printf("%-20s %8s %14s %10s\n", "mensaje", "bytes", "mensajes/s", "MB/s");
+    for (int op = 0; op < PROTO_OTHER; op++) {
+        Message* m = &msgs[op];
+        build(m, op);
+
+        ProtoRequest req;
+        double t0 = now_sec();
+        for (long r = 0; r < reps; r++) {
+            if (proto_parse_request(m->buf, m->len, 1, batch, &req) != PROTO_OK) ok = 0;
+            sink += req.count;
+        }
+        report(m->name, m->len, now_sec() - t0);
+        if (req.op != op) {
+            printf("  ** %s se parsea como %s **\n", m->name, proto_op_name(req.op));
+            ok = 0;
+        }
+    }
+
+    // Respuesta de LIST_USERS: n y luego nombre, ip y puerto de cada uno
+    char reply[MSG_MAX];
+    const char* fields[FIELDS_MAX];
+    char names[FIELDS_MAX / 3][32];
+    char count[16];
+    int n = 0;
+    snprintf(count, sizeof(count), "%d", batch);
+    fields[n++] = count;
+    for (int i = 0; i < batch && n < FIELDS_MAX - 3; i++) {
+        snprintf(names[i], sizeof(names[i]), "usuario_%d", i);
+        fields[n++] = names[i];
+        fields[n++] = "127.0.0.1";
+        fields[n++] = "40123";
+    }
+    int len = proto_encode(reply, sizeof(reply), fields, n);
+    static int starts[FIELDS_MAX], lens[FIELDS_MAX];
+    int used = 0;
+    double t0 = now_sec();
+    for (long r = 0; r < reps; r++) {
+        if (proto_split(reply, len, FIELDS_MAX, starts, lens, &used) != n) ok = 0;
+        sink += used;
+    }
+    report("resp. LIST_USERS", len, now_sec() - t0);
+
+    if (!ok) printf("** Algún mensaje no se ha parseado bien **\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// bench_query.c: Consultas con los índices del log frente a recorrerlo entero.
+//
+// Llena un directorio con -n registros repartidos en -w semanas (horas
+// casi ordenadas, con algo de desorden como cuando llegan lotes de varios
+// servidores) entre -u usuarios, y luego mide consultas típicas de una
+// revisión de incidentes: "los PUBLISH de X entre las 10 y las 11", todo lo
+// de X, todo lo de un minuto... Cada resultado se compara con un recorrido
+// completo de los segmentos.
+//
+// Uso: ./bench_query [-d dir] [-n registros] [-u usuarios] [-w semanas] [-k (reusar dir)]
+//      (por defecto un directorio temporal, 10000000 registros, 10000 usuarios y 4 semanas)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log_sink.h"
+#include "log_index.h"
+
+#define HOUR_US   3600000000ULL
+#define BATCH     256
+
+static const char* ops[] = {
+    "CONNECT", "DISCONNECT", "LIST_USERS", "LIST_CONTENT", "LIST_CONTENT", "GET_FILE",
+    "GET_FILE", "PUBLISH fichero.txt", "DELETE fichero.txt", "REGISTER"
+};
+#define NUM_OPS (sizeof(ops) / sizeof(ops[0]))
+
+static long num_records = 10000000;
+static int num_users = 10000;
+static int weeks = 4;
+static uint64_t start_us = 1767225600ULL * 1000000ULL; // 1/1/2026
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t span_us(void) {
+    return (uint64_t)weeks * 7 * 24 * HOUR_US;
+}
+
+static void fill(const char* dir) {
+    LogSinkConfig cfg;
+    log_sink_config_env(&cfg);
+    cfg.dir = dir;
+    if (log_sink_open(&cfg) < 0) {
+        perror(dir);
+        exit(1);
+    }
+
+    char (*users)[32] = malloc(num_users * sizeof(*users));
+    for (int i = 0; i < num_users; i++) snprintf(users[i], sizeof(users[i]), "usuario_%d", i);
+
+    uint64_t step = span_us() / num_records;
+    unsigned seed = 12345;
+    LogSinkRecord recs[BATCH];
+    double t0 = now_sec();
+    for (long i = 0; i < num_records; i += BATCH) {
+        int m = num_records - i < BATCH ? (int)(num_records - i) : BATCH;
+        for (int j = 0; j < m; j++) {
+            long k = i + j;
+            recs[j].user = users[rand_r(&seed) % num_users];
+            recs[j].operation = ops[rand_r(&seed) % NUM_OPS];
+            // Hasta 2 s de desorden
+            recs[j].time_us = start_us + k * step + (rand_r(&seed) % 2000000);
+        }
+        log_sink_append_batch(recs, m);
+    }
+    log_sink_close();
+    printf("Escritos %ld registros en %.1f s\n", num_records, now_sec() - t0);
+    free(users);
+}
+
+// ----------------------------
+// Consultas
+// ----------------------------
+
+typedef struct {
+    const char* name;
+    LogQuery q;
+    long indexed;            // Resultados con índices
+    long scanned;            // Resultados del recorrido completo
+    double cold_ms, warm_ms;
+} Case;
+
+static int count_match(const LogEntry* e, void* ctx) {
+    (*(long*)ctx)++;
+    return 1;
+}
+
+// El mismo filtro que log_index, escrito aparte para comprobarlo
+static int matches(const LogEntry* e, const LogQuery* q) {
+    if (q->from_us && e->time_us < q->from_us) return 0;
+    if (q->to_us && e->time_us > q->to_us) return 0;
+    if (q->user && (e->user_len != strlen(q->user) || memcmp(e->user, q->user, e->user_len))) return 0;
+    if (q->operation) {
+        size_t n = strlen(q->operation);
+        if (e->op_len < n || memcmp(e->operation, q->operation, n)) return 0;
+        if (e->op_len > n && e->operation[n] != ' ') return 0;
+    }
+    return 1;
+}
+
+static int is_segment(const struct dirent* d) {
+    return strncmp(d->d_name, "log-", 4) == 0 && strstr(d->d_name, ".seg") != NULL;
+}
+
+static double full_scan(const char* dir, Case* cases, int n) {
+    struct dirent** names;
+    int segs = scandir(dir, &names, is_segment, alphasort);
+    double t0 = now_sec();
+    for (int i = 0; i < segs; i++) {
+        char path[800];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+        free(names[i]);
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        fstat(fd, &st);
+        char* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        size_t off = sizeof(LogSegmentHeader);
+        LogEntry e;
+        while (log_segment_next(data, st.st_size, &off, &e) == 1) {
+            for (int c = 0; c < n; c++) {
+                if (matches(&e, &cases[c].q)) cases[c].scanned++;
+            }
+        }
+        munmap(data, st.st_size);
+    }
+    free(names);
+    return now_sec() - t0;
+}
+
+int main(int argc, char* argv[]) {
+    char tmp[] = "/tmp/bench_query_XXXXXX";
+    const char* dir = NULL;
+    int keep = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:u:w:k")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 'n': num_records = atol(optarg); break;
+            case 'u': num_users = atoi(optarg); break;
+            case 'w': weeks = atoi(optarg); break;
+            case 'k': keep = 1; break;
+            default:
+                fprintf(stderr, "Uso: %s [-d dir] [-n registros] [-u usuarios] [-w semanas] [-k]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_records <= 0 || num_users <= 0 || weeks <= 0) return 1;
+    if (!dir) {
+        dir = mkdtemp(tmp);
+        if (!dir) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+    if (!keep) fill(dir);
+
+    // Una hora a media tarde en mitad del periodo
+    uint64_t mid = start_us + span_us() / 2;
+    mid -= mid % (24 * HOUR_US);
+    uint64_t ten = mid + 10 * HOUR_US;
+    Case cases[] = {
+        { "PUBLISH de un usuario en 1 h", { "usuario_42", "PUBLISH", ten, ten + HOUR_US - 1, 0 } },
+        { "todo de un usuario", { "usuario_42", NULL, 0, 0, 0 } },
+        { "un usuario en 1 día", { "usuario_7", NULL, mid, mid + 24 * HOUR_US - 1, 0 } },
+        { "todos en 1 minuto", { NULL, NULL, ten, ten + 60000000ULL - 1, 0 } },
+        { "DELETE de todos en 1 h", { NULL, "DELETE", ten, ten + HOUR_US - 1, 0 } },
+    };
+    int n = sizeof(cases) / sizeof(cases[0]);
+
+    for (int c = 0; c < n; c++) {
+        double t0 = now_sec();
+        log_index_query_dir(dir, NULL, &cases[c].q, count_match, &cases[c].indexed);
+        cases[c].cold_ms = (now_sec() - t0) * 1000;
+        long again = 0;
+        t0 = now_sec();
+        log_index_query_dir(dir, NULL, &cases[c].q, count_match, &again);
+        cases[c].warm_ms = (now_sec() - t0) * 1000;
+    }
+    double scan = full_scan(dir, cases, n);
+
+    int ok = 1;
+    printf("%-32s %10s %10s %10s\n", "consulta", "registros", "1ª (ms)", "2ª (ms)");
+    for (int c = 0; c < n; c++) {
+        printf("%-32s %10ld %10.1f %10.2f%s\n", cases[c].name, cases[c].indexed,
+               cases[c].cold_ms, cases[c].warm_ms,
+               cases[c].indexed == cases[c].scanned ? "" : "  ** NO COINCIDE con el recorrido **");
+        if (cases[c].indexed != cases[c].scanned) ok = 0;
+    }
+    printf("Recorrido completo (las %d consultas a la vez): %.0f ms\n", n, scan * 1000);
+
+    if (dir == tmp) {
+        char cmd[700];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+        if (system(cmd) != 0) fprintf(stderr, "No se pudo borrar %s\n", dir);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+// bench_reads.c: Escalado de las lecturas del registro (LIST_USERS,
+// LIST_CONTENT, GET_FILE) con N hilos lectores y un escritor que conecta y
+// desconecta usuarios sin parar.
+//
+// Modo "mutex": cada lectura se hace con user_mutex cogido, como antes.
+// Modo "epoch": las lecturas van sin lock (secciones de época).
+// Se imprime una línea CSV por modo y número de lectores.
+//
+// Uso: ./bench_reads [-u usuarios] [-f archivos por usuario] [-s segundos] [lectores ...]
+//      (por defecto 1000 usuarios, 4 archivos, 1 s y 1 2 4 8 lectores)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "registry.h"
+#include "epoch.h"
+
+#define LIST_LIMIT 1000    // Como LIST_CONTENT en el servidor
+
+static int num_users = 1000;
+static int files_per_user = 4;
+static double duration = 1.0;
+
+static atomic_int running;
+static int use_mutex;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// LIST_CONTENT sólo cuenta los archivos (el servidor los copiaría a la respuesta)
+static void count_file(const FileEntry* f, void* ctx) {
+    (*(int*)ctx)++;
+}
+
+static void user_name(char* out, int i) {
+    snprintf(out, MAX_NAME_LEN, "user%d", i);
+}
+
+// Mezcla de lecturas: 1 LIST_USERS por cada 8 LIST_CONTENT y 8 GET_FILE
+static void* reader(void* arg) {
+    unsigned int seed = (unsigned int)(size_t)arg;
+    unsigned long ops = 0;
+    char requester[MAX_NAME_LEN], target[MAX_NAME_LEN], filename[64];
+    user_name(requester, 0); // user0 no se desconecta nunca
+
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
+        int kind = rand_r(&seed) % 17;
+        user_name(target, rand_r(&seed) % num_users);
+
+        if (use_mutex) pthread_mutex_lock(&user_mutex);
+        if (kind == 0) {
+            const UsersImage* image;
+            epoch_enter();
+            list_connected_users(requester, &image);
+            epoch_exit();
+        } else if (kind <= 8) {
+            int listed = 0;
+            uint32_t next;
+            list_user_files(requester, target, 0, LIST_LIMIT, count_file, &listed, &next);
+        } else {
+            snprintf(filename, sizeof(filename), "file%d", rand_r(&seed) % files_per_user);
+            Endpoint ep;
+            resolve_file(requester, target, filename, &ep);
+        }
+        if (use_mutex) pthread_mutex_unlock(&user_mutex);
+        ops++;
+    }
+    return (void*)ops;
+}
+
+// Escritor: desconecta y vuelve a conectar usuarios (retira endpoints)
+static void* writer(void* arg) {
+    unsigned int seed = 12345;
+    unsigned long ops = 0;
+    char name[MAX_NAME_LEN];
+
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
+        user_name(name, 1 + rand_r(&seed) % (num_users - 1));
+        disconnect_user(name);
+        connect_user(name, "127.0.0.1", 6000);
+        ops += 2;
+    }
+    return (void*)ops;
+}
+
+static void run(int readers) {
+    pthread_t tids[readers], wtid;
+    atomic_store(&running, 1);
+
+    double t0 = now_sec();
+    for (int i = 0; i < readers; i++) {
+        pthread_create(&tids[i], NULL, reader, (void*)(size_t)(i + 1));
+    }
+    pthread_create(&wtid, NULL, writer, NULL);
+
+    usleep((useconds_t)(duration * 1e6));
+    atomic_store(&running, 0);
+
+    unsigned long reads = 0;
+    void* ops;
+    for (int i = 0; i < readers; i++) {
+        pthread_join(tids[i], &ops);
+        reads += (unsigned long)ops;
+    }
+    pthread_join(wtid, &ops);
+    double elapsed = now_sec() - t0;
+
+    printf("%s,%d,%.0f,%.0f\n", use_mutex ? "mutex" : "epoch", readers,
+           reads / elapsed, (unsigned long)ops / elapsed);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "u:f:s:")) != -1) {
+        switch (opt) {
+            case 'u': num_users = atoi(optarg); break;
+            case 'f': files_per_user = atoi(optarg); break;
+            case 's': duration = atof(optarg); break;
+            default:
+                fprintf(stderr, "Uso: %s [-u usuarios] [-f archivos] [-s segundos] [lectores ...]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_users < 2) num_users = 2;
+
+    if (registry_init() < 0) {
+        perror("registry_init");
+        return 1;
+    }
+
+    // Poblar el registro: todos conectados y con archivos publicados
+    char name[MAX_NAME_LEN], filename[64];
+    for (int i = 0; i < num_users; i++) {
+        user_name(name, i);
+        register_user(name);
+        connect_user(name, "127.0.0.1", 6000);
+        for (int j = 0; j < files_per_user; j++) {
+            snprintf(filename, sizeof(filename), "file%d", j);
+            publish_file(name, filename, "bench");
+        }
+    }
+
+    int default_readers[] = { 1, 2, 4, 8 };
+    int* readers = default_readers;
+    int n_readers = 4;
+    if (optind < argc) {
+        n_readers = argc - optind;
+        readers = malloc(n_readers * sizeof(int));
+        for (int i = 0; i < n_readers; i++) readers[i] = atoi(argv[optind + i]);
+    }
+
+    printf("mode,readers,reads_per_sec,writes_per_sec\n");
+    for (use_mutex = 1; use_mutex >= 0; use_mutex--) {
+        for (int i = 0; i < n_readers; i++) run(readers[i]);
+    }
+
+    if (readers != default_readers) free(readers);
+    return 0;
+}
@@ -0,0 +1,114 @@
+// bench_registry.c: Mide ops/s del índice de usuarios (StrMap) frente al
+// recorrido lineal de la lista enlazada que se usaba antes.
+//
+// Uso: ./bench_registry [n1 n2 ...]   (por defecto 1000 100000 1000000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "strmap.h"
+
+#define MAX_NAME_LEN 256
+
+typedef struct BenchUser {
+    char name[MAX_NAME_LEN];
+    struct BenchUser* next;
+} BenchUser;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Generador xorshift para no depender de rand()
+static unsigned long long rng_state = 88172645463325252ULL;
+static unsigned long long next_rand(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void run(size_t n) {
+    BenchUser* users = calloc(n, sizeof(BenchUser));
+    BenchUser* list = NULL;
+    StrMap map;
+    strmap_init(&map, 16);
+
+    // REGISTER: inserción en el índice (y en la lista, como hace el servidor)
+    double t0 = now_sec();
+    for (size_t i = 0; i < n; i++) {
+        snprintf(users[i].name, MAX_NAME_LEN, "user%zu", i);
+        strmap_put(&map, users[i].name, &users[i]);
+        users[i].next = list;
+        list = &users[i];
+    }
+    double t_insert = now_sec() - t0;
+
+    // Búsquedas con acierto (CONNECT, PUBLISH, GET_FILE...)
+    size_t lookups = n < 1000000 ? 1000000 : n;
+    char key[MAX_NAME_LEN];
+    size_t found = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < lookups; i++) {
+        snprintf(key, sizeof(key), "user%llu", next_rand() % n);
+        if (strmap_get(&map, key)) found++;
+    }
+    double t_hit = now_sec() - t0;
+
+    // Búsquedas sin acierto (REGISTER de un nombre nuevo)
+    t0 = now_sec();
+    for (size_t i = 0; i < lookups; i++) {
+        snprintf(key, sizeof(key), "nouser%llu", next_rand() % n);
+        if (strmap_get(&map, key)) found++;
+    }
+    double t_miss = now_sec() - t0;
+
+    // UNREGISTER + REGISTER: genera lápidas y fuerza rehash
+    size_t churn = n / 2;
+    t0 = now_sec();
+    for (size_t i = 0; i < churn; i++) {
+        BenchUser* u = &users[next_rand() % n];
+        strmap_remove(&map, u->name);
+        strmap_put(&map, u->name, u);
+    }
+    double t_churn = now_sec() - t0;
+
+    // Referencia: recorrido lineal de la lista con strcmp (muestra limitada)
+    size_t scans = n >= 1000000 ? 200 : (n >= 100000 ? 2000 : 100000);
+    t0 = now_sec();
+    for (size_t i = 0; i < scans; i++) {
+        snprintf(key, sizeof(key), "user%llu", next_rand() % n);
+        for (BenchUser* u = list; u; u = u->next) {
+            if (strcmp(u->name, key) == 0) { found++; break; }
+        }
+    }
+    double t_scan = now_sec() - t0;
+
+    printf("%zu,%.0f,%.0f,%.0f,%.0f,%.0f\n", n,
+           n / t_insert,
+           lookups / t_hit,
+           lookups / t_miss,
+           2 * churn / t_churn,
+           scans / t_scan);
+
+    if (found == 0) fprintf(stderr, "bench: ninguna búsqueda con éxito\n");
+
+    strmap_destroy(&map);
+    free(users);
+}
+
+int main(int argc, char* argv[]) {
+    printf("users,insert_ops,lookup_hit_ops,lookup_miss_ops,unreg_reg_ops,list_scan_ops\n");
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) run(strtoul(argv[i], NULL, 10));
+    } else {
+        run(1000);
+        run(100000);
+        run(1000000);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// bench_rpc.c: Ingesta de log contra servidor_rpc con varios emisores a la vez.
+//
+// Cada emisor es un hilo con su propia conexión TCP (como cada servidor de
+// directorio con su shipper de auditoría) que manda lotes LOG_BATCH, o
+// llamadas LOG_ACTION sueltas con -a, esperando cada respuesta. Se mide con
+// 1, 4 y 16 emisores; si el servidor atendiera las llamadas de una en una el
+// ritmo total no subiría con más emisores.
+//
+// Uso: ./bench_rpc -p <port> [-s host] [-c 1,4,16] [-n llamadas por emisor] [-b registros por lote] [-a]
+//      (servidor_rpc debe estar arrancado con -p <port>)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include "log_rpc.h"
+
+static struct sockaddr_in server_addr;
+static int calls_per_sender = 2000;
+static int batch_size = 64;
+static int single = 0;
+
+typedef struct {
+    int id;
+    long failed;
+    double max_ms;
+} Sender;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* sender_main(void* arg) {
+    Sender* s = arg;
+    struct sockaddr_in addr = server_addr;
+    int sock = RPC_ANYSOCK;
+    CLIENT* clnt = clnttcp_create(&addr, LOGPROG, LOGVERS, &sock, 0, 0);
+    if (!clnt) {
+        clnt_pcreateerror("bench_rpc");
+        s->failed = calls_per_sender;
+        return NULL;
+    }
+
+    char user[32];
+    snprintf(user, sizeof(user), "emisor_%d", s->id);
+    log_action_args* recs = malloc(batch_size * sizeof(log_action_args));
+    for (int i = 0; i < batch_size; i++) {
+        recs[i].user = user;
+        recs[i].operation = i % 2 ? "PUBLISH fichero_1.txt" : "LIST_USERS";
+    }
+    log_batch_args batch;
+    batch.records.records_len = batch_size;
+    batch.records.records_val = recs;
+
+    struct timeval timeout = { 5, 0 };
+    for (int i = 0; i < calls_per_sender; i++) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t t = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+        for (int j = 0; j < batch_size; j++) recs[j].timestamp = t;
+
+        double t0 = now_sec();
+        enum clnt_stat st = single
+            ? clnt_call(clnt, LOG_ACTION, (xdrproc_t)xdr_log_action_args, (caddr_t)&recs[0],
+                        (xdrproc_t)xdr_void, NULL, timeout)
+            : clnt_call(clnt, LOG_BATCH, (xdrproc_t)xdr_log_batch_args, (caddr_t)&batch,
+                        (xdrproc_t)xdr_void, NULL, timeout);
+        double ms = (now_sec() - t0) * 1000;
+        if (st != RPC_SUCCESS) s->failed++;
+        if (ms > s->max_ms) s->max_ms = ms;
+    }
+
+    free(recs);
+    clnt_destroy(clnt);
+    return NULL;
+}
+
+static void run(int senders) {
+    pthread_t tids[senders];
+    Sender args[senders];
+    memset(args, 0, sizeof(args));
+
+    double t0 = now_sec();
+    for (int i = 0; i < senders; i++) {
+        args[i].id = i;
+        pthread_create(&tids[i], NULL, sender_main, &args[i]);
+    }
+    long failed = 0;
+    double max_ms = 0;
+    for (int i = 0; i < senders; i++) {
+        pthread_join(tids[i], NULL);
+        failed += args[i].failed;
+        if (args[i].max_ms > max_ms) max_ms = args[i].max_ms;
+    }
+    double elapsed = now_sec() - t0;
+
+    long calls = (long)senders * calls_per_sender - failed;
+    long records = calls * (single ? 1 : batch_size);
+    printf("%d,%ld,%ld,%.0f,%.0f,%.3f,%.2f\n", senders, calls, failed,
+           calls / elapsed, records / elapsed, elapsed * 1000 * senders / (calls ? calls : 1), max_ms);
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = "127.0.0.1";
+    int port = -1;
+    char counts[64] = "1,4,16";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:c:n:b:a")) != -1) {
+        switch (opt) {
+            case 's': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'c': snprintf(counts, sizeof(counts), "%s", optarg); break;
+            case 'n': calls_per_sender = atoi(optarg); break;
+            case 'b': batch_size = atoi(optarg); break;
+            case 'a': single = 1; break;
+            default:
+                fprintf(stderr, "Uso: %s -p <port> [-s host] [-c 1,4,16] [-n llamadas] [-b lote] [-a]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (port <= 0 || calls_per_sender <= 0 || batch_size <= 0) {
+        fprintf(stderr, "Uso: %s -p <port> [-s host] [-c 1,4,16] [-n llamadas] [-b lote] [-a]\n", argv[0]);
+        return 1;
+    }
+    if (single) batch_size = 1;
+
+    struct hostent* he = gethostbyname(host);
+    if (!he) {
+        fprintf(stderr, "No se puede resolver %s\n", host);
+        return 1;
+    }
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    memcpy(&server_addr.sin_addr, he->h_addr_list[0], sizeof(server_addr.sin_addr));
+
+    printf("senders,calls,failed,calls_per_sec,records_per_sec,avg_ms,max_ms\n");
+    for (char* tok = strtok(counts, ","); tok; tok = strtok(NULL, ",")) {
+        int n = atoi(tok);
+        if (n > 0) run(n);
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#!/bin/bash
+# bench_shards.sh: throughput del directorio repartido en 1, 2, 4... shards en localhost.
+#
+# Para cada número de shards arranca esos servidores (puertos de cliente
+# desde BASE_PORT, canal interno 100 más arriba), lanza bench_load con los
+# hilos repartidos entre todos los puertos y saca la fila ALL. Con un solo
+# shard el servidor va sin -S: es la referencia. La mezcla por defecto
+# carga las escrituras, que son lo que serializa user_mutex; LIST_USERS,
+# que pregunta a todos los shards, se puede añadir con MIX.
+#
+# Necesita servidor_rpc arrancado y LOG_RPC_IP exportada, como el servidor.
+#
+# Uso: bash bench_shards.sh [1,2,4] [opciones de bench_load]
+#      (SERVIDOR=./servidor, BASE_PORT=5200, MIX=... para cambiarlos)
+
+SHARDS=${1:-1,2,4}
+shift
+SERVIDOR=${SERVIDOR:-./servidor}
+BASE_PORT=${BASE_PORT:-5200}
+MIX=${MIX:-PUBLISH=40,CONNECT=20,REGISTER=10,GET_FILE=15,LIST_CONTENT=15}
+BENCH_ARGS=${*:--c 64 -n 2000 -u 1000 -f 5 -2 -d 16}
+
+if [ -z "$LOG_RPC_IP" ]; then
+    echo "Exporta LOG_RPC_IP (servidor_rpc arrancado)" >&2
+    exit 1
+fi
+
+echo "shards,ops_per_sec,p50_us,p99_us,errors,fails"
+for n in ${SHARDS//,/ }; do
+    LIST=""
+    PORTS=""
+    for ((i = 0; i < n; i++)); do
+        LIST="$LIST${LIST:+,}127.0.0.1:$((BASE_PORT + 100 + i))"
+        PORTS="$PORTS${PORTS:+,}$((BASE_PORT + i))"
+    done
+
+    PIDS=""
+    for ((i = 0; i < n; i++)); do
+        if [ "$n" -eq 1 ]; then
+            $SERVIDOR -n -p $BASE_PORT > /dev/null 2>&1 &
+        else
+            $SERVIDOR -n -p $((BASE_PORT + i)) -S $LIST -i $i > /dev/null 2>&1 &
+        fi
+        PIDS="$PIDS $!"
+    done
+    sleep 1
+
+    ./bench_load -s 127.0.0.1 -p $PORTS -m $MIX $BENCH_ARGS 2> /dev/null |
+        awk -F, -v n=$n '$1 == "ALL" { print n "," $6 "," $7 "," $8 "," $4 "," $5 }'
+
+    kill $PIDS
+    wait $PIDS 2> /dev/null
+done
@@ -0,0 +1,157 @@
+// bench_sink.c: Ritmo de ingesta del sumidero de log de servidor_rpc.
+//
+// Un solo hilo mete registros con la forma de los de auditoría, primero de
+// uno en uno (LOG_ACTION) y luego en lotes (LOG_BATCH), con el volcado
+// periódico por defecto y con fdatasync en cada lote. Al final se releen
+// todos los segmentos y se comprueba que están todos los registros.
+//
+// Uso: ./bench_sink [-d dir] [-n registros] [-b tamaño de lote]
+//      (por defecto un directorio temporal, 1000000 registros y lotes de 256)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "log_sink.h"
+
+static const char* ops[] = { "CONNECT", "PUBLISH fichero_1.txt", "LIST_USERS", "LIST_CONTENT", "DISCONNECT" };
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static char users[1000][32];
+
+static void run(const char* label, const char* dir, long n, int batch, unsigned fsync_ms) {
+    LogSinkConfig cfg;
+    log_sink_config_env(&cfg);
+    cfg.dir = dir;
+    cfg.fsync_ms = fsync_ms;
+    LogSinkStats before, after;
+    log_sink_stats(&before);
+    if (log_sink_open(&cfg) < 0) {
+        perror(dir);
+        exit(1);
+    }
+
+    LogSinkRecord recs[batch];
+    double t0 = now_sec();
+    for (long i = 0; i < n; i += batch) {
+        int m = n - i < batch ? (int)(n - i) : batch;
+        uint64_t t = now_us();
+        for (int j = 0; j < m; j++) {
+            long k = i + j;
+            recs[j].user = users[k % 1000];
+            recs[j].operation = ops[k % 5];
+            recs[j].time_us = t;
+        }
+        if (batch == 1) log_sink_append(recs[0].user, recs[0].operation, recs[0].time_us);
+        else log_sink_append_batch(recs, m);
+    }
+    log_sink_sync();
+    double elapsed = now_sec() - t0;
+    log_sink_stats(&after);
+    log_sink_close();
+
+    double mb = (after.bytes - before.bytes) / (1024.0 * 1024.0);
+    printf("%-34s %10.0f registros/s  %7.1f MB/s  %6llu fsyncs  %3llu segmentos\n",
+           label, n / elapsed, mb / elapsed,
+           (unsigned long long)(after.fsyncs - before.fsyncs),
+           (unsigned long long)(after.segments - before.segments));
+}
+
+static int is_segment(const struct dirent* d) {
+    return strncmp(d->d_name, "log-", 4) == 0;
+}
+
+// Relee todos los segmentos; devuelve los registros válidos y comprueba que
+// los seq van seguidos
+static long verify(const char* dir, int* gaps) {
+    struct dirent** names;
+    int n = scandir(dir, &names, is_segment, alphasort);
+    long count = 0;
+    uint64_t expected = 1;
+    *gaps = 0;
+    double t0 = now_sec();
+    for (int i = 0; i < n; i++) {
+        char path[800];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+        free(names[i]);
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        fstat(fd, &st);
+        char* data = malloc(st.st_size);
+        if (read(fd, data, st.st_size) != st.st_size) st.st_size = 0;
+        close(fd);
+
+        size_t off = sizeof(LogSegmentHeader);
+        LogEntry e;
+        while ((size_t)st.st_size > off && log_segment_next(data, st.st_size, &off, &e) == 1) {
+            if (e.seq != expected) (*gaps)++;
+            expected = e.seq + 1;
+            count++;
+        }
+        free(data);
+    }
+    free(names);
+    double elapsed = now_sec() - t0;
+    printf("%-34s %10.0f registros/s\n", "lectura (log_segment_next)", count / elapsed);
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    char tmp[] = "/tmp/bench_sink_XXXXXX";
+    const char* dir = NULL;
+    long n = 1000000;
+    int batch = 256;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:b:")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 'n': n = atol(optarg); break;
+            case 'b': batch = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Uso: %s [-d dir] [-n registros] [-b lote]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (batch < 1) batch = 1;
+    if (!dir) {
+        dir = mkdtemp(tmp);
+        if (!dir) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+    for (int i = 0; i < 1000; i++) snprintf(users[i], sizeof(users[i]), "usuario_%d", i);
+
+    printf("Sumidero de log en %s, %ld registros por prueba\n", dir, n);
+    run("de uno en uno, fsync cada 100 ms", dir, n, 1, 100);
+    run("lotes, fsync cada 100 ms", dir, n, batch, 100);
+    run("lotes, fsync en cada lote", dir, n / 10, batch, 0);
+
+    int gaps;
+    long total = n + n + n / 10;
+    long found = verify(dir, &gaps);
+    printf("Releídos %ld de %ld registros, %d saltos de secuencia\n", found, total, gaps);
+
+    if (dir == tmp) {
+        char cmd[700];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+        if (system(cmd) != 0) fprintf(stderr, "No se pudo borrar %s\n", dir);
+    }
+    return found == total && gaps == 0 ? 0 : 1;
+}
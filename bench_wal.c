@@ -0,0 +1,177 @@
+// bench_wal.c: Rendimiento del WAL con group commit y tiempo de recuperación.
+//
+// 1) Escritura: 1, 4 y 16 hilos hacen REGISTER/CONNECT/PUBLISH esperando
+//    cada uno a que su cambio esté en disco (wal_sync), como el servidor.
+//    Se ve cuántos cambios entran en cada fdatasync.
+// 2) Recuperación: se llena el registro hasta -u x -f publicaciones, se
+//    escribe un snapshot, se añade una cola de cambios al WAL y el propio
+//    programa se vuelve a ejecutar con -r para medir cuánto tarda en
+//    cargarlo todo en un proceso limpio.
+//
+// Uso: ./bench_wal [-d dir] [-u usuarios] [-f archivos por usuario] [-n cambios por hilo]
+//      (por defecto un directorio temporal, 100000 usuarios x 10 archivos y 2000 cambios)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "registry.h"
+#include "persist.h"
+
+#define TAIL_CHANGES 10000
+
+static int ops_per_thread = 2000;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    int id;
+    int round;
+} Writer;
+
+// Cada "operación" es un cambio del registro confirmado en disco
+static void* writer(void* arg) {
+    Writer* w = arg;
+    char name[64], filename[64];
+    snprintf(name, sizeof(name), "wal_r%d_t%d", w->round, w->id);
+    register_user(name);
+    wal_sync();
+    connect_user(name, "127.0.0.1", 7000);
+
+    for (int i = 1; i < ops_per_thread; i++) {
+        snprintf(filename, sizeof(filename), "file_%d.dat", i);
+        publish_file(name, filename, "bench");
+        wal_sync();
+    }
+    return NULL;
+}
+
+static void run_writers(int threads, int round) {
+    pthread_t tids[threads];
+    Writer args[threads];
+    WalStats before, after;
+    wal_stats(&before);
+
+    double t0 = now_sec();
+    for (int i = 0; i < threads; i++) {
+        args[i].id = i;
+        args[i].round = round;
+        pthread_create(&tids[i], NULL, writer, &args[i]);
+    }
+    for (int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    double elapsed = now_sec() - t0;
+
+    wal_stats(&after);
+    uint64_t records = after.records - before.records;
+    uint64_t fsyncs = after.fsyncs - before.fsyncs;
+    printf("%d,%.0f,%llu,%llu,%.1f\n", threads, records / elapsed,
+           (unsigned long long)records, (unsigned long long)fsyncs,
+           fsyncs ? (double)records / fsyncs : 0.0);
+}
+
+static int recover(const char* dir, int cleanup) {
+    double t0 = now_sec();
+    if (registry_init() < 0 || persist_start(dir, WAL_SYNC_GROUP, 0) < 0) {
+        fprintf(stderr, "bench_wal: no se pudo recuperar %s\n", dir);
+        return 1;
+    }
+    double elapsed = now_sec() - t0;
+
+    char path[600];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/snapshot.bin", dir);
+    double snapshot_mb = stat(path, &st) == 0 ? st.st_size / (1024.0 * 1024.0) : 0;
+
+    printf("recover_ms,snapshot_mb\n%.1f,%.1f\n", elapsed * 1e3, snapshot_mb);
+
+    if (cleanup) {
+        wal_close();
+        wal_remove_before(dir, UINT64_MAX);
+        unlink(path);
+        rmdir(dir);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    const char* dir = NULL;
+    int num_users = 100000;
+    int files_per_user = 10;
+    int recover_mode = 0, cleanup = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:u:f:n:rx")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 'u': num_users = atoi(optarg); break;
+            case 'f': files_per_user = atoi(optarg); break;
+            case 'n': ops_per_thread = atoi(optarg); break;
+            case 'r': recover_mode = 1; break;
+            case 'x': cleanup = 1; break;
+            default:
+                fprintf(stderr, "Uso: %s [-d dir] [-u usuarios] [-f archivos] [-n cambios por hilo]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (recover_mode) return recover(dir, cleanup);
+
+    char tmp_dir[] = "/tmp/bench_wal.XXXXXX";
+    if (!dir) {
+        if (!mkdtemp(tmp_dir)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        dir = tmp_dir;
+        cleanup = 1;
+    }
+
+    if (registry_init() < 0 || persist_start(dir, WAL_SYNC_GROUP, 0) < 0) {
+        perror("persist_start");
+        return 1;
+    }
+
+    printf("threads,records_per_sec,records,fsyncs,records_per_fsync\n");
+    int rounds[] = { 1, 4, 16 };
+    for (int i = 0; i < 3; i++) run_writers(rounds[i], i);
+
+    // Llenar el registro y hacer snapshot
+    char name[64], filename[64], description[64];
+    for (int i = 0; i < num_users; i++) {
+        snprintf(name, sizeof(name), "usuario_prueba_%06d", i);
+        register_user(name);
+        connect_user(name, "192.168.1.100", 40000);
+        for (int j = 0; j < files_per_user; j++) {
+            snprintf(filename, sizeof(filename), "doc_%d_%d.pdf", i, j);
+            snprintf(description, sizeof(description), "Apuntes tema %d", j);
+            publish_file(name, filename, description);
+        }
+    }
+    double t0 = now_sec();
+    if (persist_snapshot() < 0) {
+        fprintf(stderr, "bench_wal: fallo al escribir el snapshot\n");
+        return 1;
+    }
+    printf("snapshot_ms\n%.1f\n", (now_sec() - t0) * 1e3);
+
+    // Cola del WAL que hay que aplicar sobre el snapshot
+    for (int i = 0; i < TAIL_CHANGES; i++) {
+        snprintf(name, sizeof(name), "usuario_prueba_%06d", i % num_users);
+        snprintf(filename, sizeof(filename), "tail_%d.txt", i);
+        publish_file(name, filename, "cola");
+    }
+    wal_close();
+    fflush(stdout);
+
+    // Recuperar en un proceso nuevo
+    if (cleanup) execl(argv[0], argv[0], "-r", "-x", "-d", dir, (char*)NULL);
+    else execl(argv[0], argv[0], "-r", "-d", dir, (char*)NULL);
+    perror("execl");
+    return 1;
+}
@@ -6,7 +6,12 @@ import argparse
 import socket
 import threading
 import os
+import subprocess
 import requests
+import struct
+import zlib
+import ctypes
+import hashlib
 
 def get_datetime_from_web():
     try:
@@ -20,6 +25,23 @@ def get_datetime_from_web():
 
 
 
+# Códec del protocolo en C (libproto.so, ver proto.h) para trocear las
+# respuestas de una pasada. Si no está compilado se hace lo mismo en Python.
+def _load_codec():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libproto.so")
+    try:
+        lib = ctypes.CDLL(path)
+    except OSError:
+        return None
+    c_int_p = ctypes.POINTER(ctypes.c_int)
+    lib.proto_split.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, c_int_p, c_int_p, c_int_p]
+    lib.proto_split.restype = ctypes.c_int
+    return lib
+
+_codec = _load_codec()
+
+
+
 class client :
 
     # ******************** TYPES *********************
@@ -37,20 +59,150 @@ class client :
     _listen_port = None
     _listen_socket = None
     _listen_thread = None
+    _peer_process = None     # peer_server atendiendo GET_FILE (si está compilado)
     _current_user = None
     _running = True
+    # Protocolo v2: una conexión persistente con tramas de longitud prefijada
+    V2_NO_TIMESTAMP = 0x01   # Flag de trama: no lleva timestamp, lo pone el servidor
+    _v2 = False
+    _v2_socket = None
+    LIST_PAGE = 500          # Archivos por página de LIST_CONTENT
+    GET_FILES_BATCH = 500    # Archivos por petición GET_FILES
+    PUBLISH_BATCH = 5000     # Entradas por petición PUBLISH_BATCH/DELETE_BATCH
+    # Descargas por trozos entre peers (GET_SUMS + GET_RANGE, ver peer_server.c)
+    PEER_FIELDS = {b"GET_FILE": 2, b"GET_SUMS": 3, b"GET_RANGE": 4}
+    SWARM_CHUNK = 4 << 20    # Trozo que se pide y se comprueba con CRC-32
+    SUM_MIN = 64 << 10       # Trozos que acepta un peer en GET_SUMS
+    SUM_MAX = 64 << 20
+    PEER_TIMEOUT = 30
+    SOURCES_MAX = 8          # Fuentes que se piden con GET_SOURCES
+    # HEARTBEAT: el servidor desconecta a quien pasa su plazo sin dar señales
+    HEARTBEAT_RETRY = 5      # Segundos hasta reintentar si el servidor no responde
+    _heartbeat_thread = None
+    _heartbeat_stop = None
+    # WATCH_USERS: conexión aparte por la que el servidor empuja los cambios
+    _watch_socket = None
+    _watch_seq = 0
+    _watch_users = {}
 
     # ******************** METHODS *******************
 
+    # *
+    # * @brief Respuesta v2 ya recibida entera; se lee con recv() como un socket
+    class _FrameReader :
+        def __init__(self, data):
+            self._data = data
+            self._pos = 0
+
+        def recv(self, n):
+            chunk = self._data[self._pos:self._pos + n]
+            self._pos += len(chunk)
+            return chunk
+
+        def __enter__(self):
+            return self
+
+        def __exit__(self, *args):
+            return False
+
 
     @staticmethod
-    def  register(user) :
+    def _recv_exact(s, n):
+        data = bytearray()
+        while len(data) < n:
+            chunk = s.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError("connection closed by server")
+            data += chunk
+        return bytes(data)
+
+
+    # *
+    # * @brief Campos terminados en \0 al principio de data (sin el resto a medias,
+    # *        p. ej. el contenido de un archivo) y cuántos bytes ocupan.
+    # *        max_fields limita cuántos se quieren; None = todos.
+    @staticmethod
+    def _split(data, max_fields=None):
+        if not isinstance(data, bytes):
+            data = bytes(data)
+        if max_fields is None:
+            max_fields = data.count(b'\0')
+        if _codec is None:
+            fields = data.split(b'\0', max_fields)[:-1]  # El último trozo es lo que sobra
+            return fields, sum(map(len, fields)) + len(fields)
+        starts = (ctypes.c_int * max(max_fields, 1))()
+        lens = (ctypes.c_int * max(max_fields, 1))()
+        used = ctypes.c_int()
+        n = _codec.proto_split(data, len(data), max_fields, starts, lens, ctypes.byref(used))
+        return [data[starts[i]:starts[i] + lens[i]] for i in range(n)], used.value
+
+    # *
+    # * @brief Resto de la respuesta: hasta que el servidor cierra (v1) o lo que
+    # *        quede de la trama (v2), en bloques grandes
+    @staticmethod
+    def _recv_all(s):
+        data = bytearray()
+        while True:
+            chunk = s.recv(65536)
+            if not chunk:
+                return bytes(data)
+            data += chunk
+
+    # *
+    # * @brief Código de respuesta y, si es 0, sus n primeros campos, leyendo en
+    # *        bloques (nunca byte a byte). Devuelve también lo que haya llegado
+    # *        detrás (el principio del contenido de un archivo). Código b'' si
+    # *        cierran sin responder.
+    @staticmethod
+    def _recv_head(s, n):
+        data = s.recv(65536)
+        while True:
+            if data[:1] != b'\x00':
+                return data[:1], [], b''
+            fields, used = client._split(data[1:], n)
+            if len(fields) == n:
+                return b'\x00', fields, data[1 + used:]
+            chunk = s.recv(65536)
+            if not chunk:
+                raise ConnectionError("connection closed by peer")
+            data += chunk
+
+    # *
+    # * @brief Envía una petición al servidor y devuelve de dónde leer la respuesta.
+    # *        En v1 es un socket nuevo; en v2 la trama de respuesta ya leída.
+    # *        message lleva los campos sin el timestamp: la hora la pone el
+    # *        servidor (en v1 va un campo vacío, en v2 el flag NO_TIMESTAMP).
+    @staticmethod
+    def _send_request(message):
+        if not client._v2:
+            s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            s.connect((client._server, client._port))
+            s.sendall(message + b"\0")
+            return s
+
         try:
-            timestamp = get_datetime_from_web()
+            if client._v2_socket is None:
+                s = socket.create_connection((client._server, client._port))
+                s.sendall(b"\0V2\0")
+                client._v2_socket = s
+
+            # Trama: longitud (u32 big-endian) + flags (u8) + campos
+            client._v2_socket.sendall(struct.pack(">IB", len(message), client.V2_NO_TIMESTAMP) + message)
+            length = struct.unpack(">I", client._recv_exact(client._v2_socket, 4))[0]
+            return client._FrameReader(client._recv_exact(client._v2_socket, length))
+        except OSError:
+            # Conexión rota: la siguiente petición abrirá otra
+            if client._v2_socket is not None:
+                client._v2_socket.close()
+                client._v2_socket = None
+            raise
 
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"REGISTER\0" + user.encode() + b"\0" + timestamp.encode() + b"\0")
+
+
+    @staticmethod
+    def  register(user) :
+        try:
+            with client._send_request(b"REGISTER\0" + user.encode() + b"\0") as s:
                 response = s.recv(1)
                 
                 if response == b'\x00':
@@ -70,11 +222,7 @@ class client :
     @staticmethod
     def  unregister(user) :
         try:
-            timestamp = get_datetime_from_web()
-
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"UNREGISTER\0" + user.encode() + b"\0" + timestamp.encode() + b"\0")
+            with client._send_request(b"UNREGISTER\0" + user.encode() + b"\0") as s:
                 response = s.recv(1)
                 
                 if response == b'\x00':
@@ -92,85 +240,184 @@ class client :
 
     @staticmethod
     def handle_client_request(conn):
-        # Leemos en bucle hasta encontrar el delimitador \0 dos veces (lo que indica que tenemos el comando y el nombre del archivo completo)
+        # Leemos hasta tener todos los campos de la operación (GET_FILE: nombre;
+        # GET_SUMS: nombre y trozo; GET_RANGE: nombre, offset y longitud)
         try:
-            # timestamp = get_datetime_from_web()
-
             data = bytearray()
-            while b'\0' not in data or data.count(b'\0') < 2:
+            while True:
+                parts, _ = client._split(data)
+                n = client.PEER_FIELDS.get(parts[0], 0) if parts else 0
+                if parts and (n == 0 or len(parts) >= n):
+                    break
                 chunk = conn.recv(1024)
                 if not chunk:
-                    break
+                    return
                 data += chunk
+            if n == 0:
+                return
+
+            op = parts[0]
+            filename = parts[1].decode()
+            try:
+                f = open(filename, 'rb')
+            except OSError:
+                f = None
+            if f is None or not os.path.isfile(filename):
+                conn.sendall(b'\x01')  # Archivo no existe
+                return
+
+            with f:
+                file_size = os.fstat(f.fileno()).st_size
+                if op == b"GET_FILE":
+                    timestamp = get_datetime_from_web()
+
+                    # OK + encabezado separado por '\0' (file_size\0timestamp\0) en un solo envío
+                    conn.sendall(b'\x00' + f"{file_size}\0{timestamp}\0".encode())
+
+                    # El contenido con sendfile() (sin copiarlo por Python) si el sistema lo tiene
+                    conn.sendfile(f, 0, file_size)
+
+                elif op == b"GET_SUMS":
+                    size = min(max(int(parts[2]), client.SUM_MIN), client.SUM_MAX)
+                    sums = []
+                    while True:
+                        block = f.read(size)
+                        if not block:
+                            break
+                        sums.append(f"{zlib.crc32(block):08x}\0")
+                    conn.sendall(b'\x00' + f"{file_size}\0{size}\0{''.join(sums)}".encode())
 
-            if data.startswith(b"GET_FILE"):
-                parts = data.split(b'\0')
-                if len(parts) >= 2:
-                    filename = parts[1].decode()
-                    if os.path.exists(filename):
-                        conn.sendall(b'\x00')  # OK
-                        file_size = os.path.getsize(filename)
-                        timestamp = get_datetime_from_web()
-
-                        # Enviar encabezado separado por '\0' (file_size\0timestamp\0)
-                        header = f"{file_size}\0{timestamp}\0".encode()
-                        conn.sendall(header)
-
-                        # Enviar archivo
-                        with open(filename, 'rb') as f:
-                            while True:
-                                chunk = f.read(4096)
-                                if not chunk:
-                                    break
-                                conn.sendall(chunk)
-                    else:
-                        conn.sendall(b'\x01')  # Archivo no existe
+                else:
+                    offset, length = int(parts[2]), int(parts[3])
+                    if offset > file_size:
+                        conn.sendall(b'\x02')  # Rango fuera del archivo
+                        return
+                    length = min(length, file_size - offset)
+                    conn.sendall(b'\x00' + f"{file_size}\0".encode())
+                    if length > 0:
+                        conn.sendfile(f, offset, length)
 
         except Exception as e:
-            print(f"c> Error al manejar GET_FILE: {e}")
+            print(f"c> Error al manejar {bytes(data[:9]).decode(errors='replace')}: {e}")
         finally:
             conn.close()
 
+    # *
+    # * @brief Lanza peer_server (junto a client.py) sobre el socket de escucha ya abierto.
+    # *        Devuelve False si no está compilado o no arranca: entonces sirven los hilos de Python.
+    @staticmethod
+    def _start_peer_server(listen_socket):
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "peer_server")
+        if not os.access(path, os.X_OK):
+            return False
+        fd = listen_socket.fileno()
+        try:
+            client._peer_process = subprocess.Popen([path, "-f", str(fd)], pass_fds=(fd,))
+        except OSError:
+            client._peer_process = None
+            return False
+        return True
 
-    
     @staticmethod
-    def connect(user):
+    def _stop_peer_server():
+        if client._peer_process is None:
+            return
+        client._peer_process.terminate()
         try:
-            timestamp = get_datetime_from_web()
+            client._peer_process.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            client._peer_process.kill()
+            client._peer_process.wait()
+        client._peer_process = None
+
+    # *
+    # * @brief Petición v1 por una conexión propia (los hilos de fondo no comparten
+    # *        el socket v2 del shell). Devuelve la respuesta entera.
+    @staticmethod
+    def _oneshot_request(message):
+        with socket.create_connection((client._server, client._port), timeout=client.PEER_TIMEOUT) as s:
+            s.sendall(message + b"\0")
+            return client._recv_all(s)
+
+    # *
+    # * @brief Manda HEARTBEAT mientras dure la sesión, a un tercio del plazo que
+    # *        devuelve el servidor. Si ya nos ha dado por caídos (código 2, p. ej.
+    # *        tras suspender el equipo) se vuelve a conectar con el mismo puerto.
+    @staticmethod
+    def _start_heartbeat(user, port):
+        client._stop_heartbeat()
+        stop = threading.Event()
 
+        def beat():
+            while not stop.is_set():
+                every = client.HEARTBEAT_RETRY
+                try:
+                    data = client._oneshot_request(b"HEARTBEAT\0" + user.encode() + b"\0")
+                    if data[:1] == b'\x00':
+                        fields, _ = client._split(data[1:])
+                        timeout = int(fields[0]) if fields else 0
+                        if timeout == 0:
+                            return  # El servidor no caduca a nadie
+                        every = max(timeout / 3, 0.5)
+                    elif data[:1] == b'\x02' and not stop.is_set():
+                        client._oneshot_request(b"CONNECT\0" + user.encode() + b"\0" + str(port).encode() + b"\0")
+                except (OSError, ValueError):
+                    pass
+                stop.wait(every)
+
+        client._heartbeat_stop = stop
+        client._heartbeat_thread = threading.Thread(target=beat, daemon=True)
+        client._heartbeat_thread.start()
+
+    @staticmethod
+    def _stop_heartbeat():
+        if client._heartbeat_stop is None:
+            return
+        client._heartbeat_stop.set()
+        client._heartbeat_thread.join(timeout=client.PEER_TIMEOUT)
+        client._heartbeat_stop = None
+        client._heartbeat_thread = None
+
+    @staticmethod
+    def connect(user):
+        try:
             # 1. Crear socket de escucha (servidor) en un puerto libre
             listen_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
             listen_socket.bind(('', 0))  # El sistema elige un puerto libre
-            listen_socket.listen(5)
+            listen_socket.listen(socket.SOMAXCONN)
             client._listen_socket = listen_socket
             client._listen_port = listen_socket.getsockname()[1]
             client._current_user = user
+            client._running = True
+
+            # 2. Atender las descargas de otros clientes: peer_server si está compilado
+            #    (epoll + sendfile, muchas a la vez); si no, un hilo por conexión
+            if not client._start_peer_server(listen_socket):
+                def listen():
+                    while client._running:
+                        try:
+                            conn, addr = listen_socket.accept()
+                        except Exception as e:
+                            if client._running:
+                                print(f"c> Error en el hilo de escucha: {e}")
+                            break
+                        threading.Thread(target=client.handle_client_request, args=(conn,), daemon=True).start()
 
-            # 2. Crear el hilo que escuchará peticiones
-            def listen():
-                while client._running:
-                    try:
-                        conn, addr = listen_socket.accept()
-                        client.handle_client_request(conn)
-                        # conn.close()
-                    except Exception as e:
-                        print(f"c> Error en el hilo de escucha: {e}")
-                        break
-
-            client._listen_thread = threading.Thread(target=listen, daemon=True)
-            client._listen_thread.start()
+                client._listen_thread = threading.Thread(target=listen, daemon=True)
+                client._listen_thread.start()
 
             # 3. Conectar con el servidor
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"CONNECT\0" + user.encode() + b"\0" + str(client._listen_port).encode() + b'\0' + timestamp.encode() + b"\0") # + b"\0")
+            with client._send_request(b"CONNECT\0" + user.encode() + b"\0" + str(client._listen_port).encode() + b'\0') as s:
                 response = s.recv(1) # Para recibir 1 byte (que es el resultado de la operación (0, 1, 2, 3))
 
             # 4. Interpretar respuesta
             if response == b'\x00':
+                client._start_heartbeat(user, client._listen_port)
                 print("c> CONNECT OK")
                 return client.RC.OK
-            elif response == b'\x01':
+
+            client._stop_peer_server()  # No hay sesión: nadie va a pedirnos archivos
+            if response == b'\x01':
                 print("c> CONNECT FAIL, USER DOES NOT EXIST")
                 return client.RC.USER_ERROR
             elif response == b'\x02':
@@ -188,12 +435,10 @@ class client :
     @staticmethod
     def disconnect(user):
         try:
-            timestamp = get_datetime_from_web()
-
-            # 1. Enviar mensaje al servidor
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"DISCONNECT\0" + user.encode() + b"\0" + timestamp.encode() + b"\0")
+            # 1. Enviar mensaje al servidor (antes, parar los HEARTBEAT: que no
+            #    vuelvan a conectarnos justo después)
+            client._stop_heartbeat()
+            with client._send_request(b"DISCONNECT\0" + user.encode() + b"\0") as s:
                 response = s.recv(1)
 
             # 2. Interpretar respuesta del servidor
@@ -209,8 +454,9 @@ class client :
                 print("c> DISCONNECT FAIL")
                 return client.RC.ERROR
 
-            # 3. Parar el hilo y cerrar el socket de escucha
+            # 3. Parar el hilo (o peer_server) y cerrar el socket de escucha
             client._running = False
+            client._stop_peer_server()
             if client._listen_socket:
                 try:
                     client._listen_socket.close()
@@ -221,6 +467,7 @@ class client :
             client._listen_thread = None
             client._listen_port = None
             client._current_user = None
+            client._stop_watch()
 
             return client.RC.OK
 
@@ -236,14 +483,17 @@ class client :
             return client.RC.USER_ERROR
 
         try:
-            timestamp = get_datetime_from_web()
-
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"PUBLISH\0" +
-                        client._current_user.encode() + b"\0" +
-                        fileName.encode() + b"\0" +
-                        description.encode() + b"\0" + timestamp.encode() + b"\0")
+            # Si el archivo está aquí se publica con su hash: así el servidor
+            # sabe quién más tiene los mismos bytes aunque sea con otro nombre
+            content = client._content_hash(fileName)
+            if content is None:
+                message = b"PUBLISH\0" + client._current_user.encode() + b"\0" + \
+                          fileName.encode() + b"\0" + description.encode() + b"\0"
+            else:
+                message = b"PUBLISH_CONTENT\0" + client._current_user.encode() + b"\0" + \
+                          fileName.encode() + b"\0" + description.encode() + b"\0" + \
+                          content[0].encode() + b"\0" + str(content[1]).encode() + b"\0"
+            with client._send_request(message) as s:
 
                 response = s.recv(1)
 
@@ -265,6 +515,25 @@ class client :
             return client.RC.ERROR
 
 
+    # (sha256 en hex, tamaño) de un archivo local, o None si no es un archivo
+    @staticmethod
+    def _content_hash(fileName):
+        try:
+            if not os.path.isfile(fileName):
+                return None
+            h = hashlib.sha256()
+            size = 0
+            with open(fileName, 'rb') as f:
+                while True:
+                    block = f.read(1 << 20)
+                    if not block:
+                        break
+                    h.update(block)
+                    size += len(block)
+            return h.hexdigest(), size
+        except OSError:
+            return None
+
     @staticmethod
     def delete(fileName):
         if client._current_user is None:
@@ -272,13 +541,9 @@ class client :
             return client.RC.USER_ERROR
 
         try:
-            timestamp = get_datetime_from_web()
-
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"DELETE\0" +
+            with client._send_request(b"DELETE\0" +
                         client._current_user.encode() + b"\0" +
-                        fileName.encode() + b"\0" + timestamp.encode() + b"\0")
+                        fileName.encode() + b"\0") as s:
 
                 response = s.recv(1)
 
@@ -300,6 +565,85 @@ class client :
             return client.RC.ERROR
 
 
+    # PUBLISH_BATCH / DELETE_BATCH: entries son listas de campos por entrada
+    # ([nombre, descripción] o [nombre]). Devuelve el código de la petición
+    # y la lista de códigos por entrada.
+    @staticmethod
+    def _batch(op, entries):
+        codes = []
+        for start in range(0, len(entries), client.PUBLISH_BATCH):
+            chunk = entries[start:start + client.PUBLISH_BATCH]
+            message = (op + b"\0" + client._current_user.encode() + b"\0" +
+                       str(len(chunk)).encode() + b"\0")
+            for fields in chunk:
+                message += b"".join(f.encode() + b"\0" for f in fields)
+
+            with client._send_request(message) as s:
+                response = s.recv(1)
+                if response != b'\x00':
+                    return response, codes
+                data = client._recv_all(s)
+
+            entries_data, _ = client._split(data)
+            codes += [int(c) for c in entries_data[1].decode()]
+        return b'\x00', codes
+
+
+    @staticmethod
+    def _batch_report(op, names, response, codes, messages):
+        if response == b'\x01':
+            print(f"c> {op} FAIL, USER DOES NOT EXIST")
+            return client.RC.USER_ERROR
+        elif response == b'\x02':
+            print(f"c> {op} FAIL, USER NOT CONNECTED")
+            return client.RC.USER_ERROR
+        elif response != b'\x00':
+            print(f"c> {op} FAIL")
+            return client.RC.ERROR
+
+        for name, code in zip(names, codes):
+            if code != 0:
+                print(f"c> {name} FAIL, {messages.get(code, 'ERROR')}")
+        ok = codes.count(0)
+        print(f"c> {op} OK {ok}/{len(names)}")
+        return client.RC.OK if ok == len(names) else client.RC.USER_ERROR
+
+
+    # Publica todos los archivos de un directorio con una (o pocas) peticiones
+    @staticmethod
+    def publishdir(directory, description):
+        if client._current_user is None:
+            print("c> PUBLISH_BATCH FAIL, NOT CONNECTED")
+            return client.RC.USER_ERROR
+
+        try:
+            names = sorted(os.path.join(directory, f) for f in os.listdir(directory)
+                           if os.path.isfile(os.path.join(directory, f)))
+            response, codes = client._batch(b"PUBLISH_BATCH", [[n, description] for n in names])
+            return client._batch_report("PUBLISH_BATCH", names, response, codes,
+                                        {3: "CONTENT ALREADY PUBLISHED"})
+        except Exception as e:
+            print("c> PUBLISH_BATCH FAIL")
+            return client.RC.ERROR
+
+
+    @staticmethod
+    def deletedir(directory):
+        if client._current_user is None:
+            print("c> DELETE_BATCH FAIL, NOT CONNECTED")
+            return client.RC.USER_ERROR
+
+        try:
+            names = sorted(os.path.join(directory, f) for f in os.listdir(directory)
+                           if os.path.isfile(os.path.join(directory, f)))
+            response, codes = client._batch(b"DELETE_BATCH", [[n] for n in names])
+            return client._batch_report("DELETE_BATCH", names, response, codes,
+                                        {3: "FILE NOT FOUND"})
+        except Exception as e:
+            print("c> DELETE_BATCH FAIL")
+            return client.RC.ERROR
+
+
     @staticmethod
     def listusers():
         if client._current_user is None:
@@ -307,11 +651,7 @@ class client :
             return client.RC.USER_ERROR
 
         try:
-            timestamp = get_datetime_from_web()
-
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"LIST_USERS\0" + client._current_user.encode() + b"\0" + timestamp.encode() + b"\0")
+            with client._send_request(b"LIST_USERS\0" + client._current_user.encode() + b"\0") as s:
 
                 result = s.recv(1)
                 if result == b'\x01':
@@ -325,14 +665,9 @@ class client :
                     return client.RC.ERROR
 
                 # Leer el resto de la información (número y lista)
-                data = bytearray()
-                while True:
-                    chunk = s.recv(1024)
-                    if not chunk:
-                        break
-                    data += chunk
+                data = client._recv_all(s)
 
-                entries = data.split(b'\0')
+                entries, _ = client._split(data)
                 if len(entries) < 1:
                     print("c> LIST_USERS FAIL")
                     return client.RC.ERROR
@@ -356,54 +691,263 @@ class client :
             return client.RC.ERROR
 
 
+    # *
+    # * @brief Pide las métricas del servidor (no hace falta estar conectado)
     @staticmethod
-    def listcontent(user):
+    def stats():
+        try:
+            user = client._current_user or ""
+
+            with client._send_request(b"STATS\0" + user.encode() + b"\0") as s:
+                result = s.recv(1)
+                if result != b'\x00':
+                    print("c> STATS FAIL")
+                    return client.RC.ERROR
+
+                data = client._recv_all(s)
+
+                print("c> STATS OK")
+                for line in data.rstrip(b'\0').decode().splitlines():
+                    print("     " + line)
+                return client.RC.OK
+
+        except Exception:
+            print("c> STATS FAIL")
+            return client.RC.ERROR
+
+
+    @staticmethod
+    def search(fileName):
         if client._current_user is None:
-            print("c> LIST_CONTENT FAIL, NOT CONNECTED")
+            print("c> SEARCH FAIL, NOT CONNECTED")
             return client.RC.USER_ERROR
 
         try:
-            timestamp = get_datetime_from_web()
-
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"LIST_CONTENT\0" +
+            with client._send_request(b"SEARCH\0" +
                         client._current_user.encode() + b"\0" +
-                        user.encode() + b"\0" + timestamp.encode() + b"\0")
+                        fileName.encode() + b"\0") as s:
 
                 result = s.recv(1)
                 if result == b'\x01':
-                    print("c> LIST_CONTENT FAIL, USER DOES NOT EXIST")
+                    print("c> SEARCH FAIL, USER DOES NOT EXIST")
                     return client.RC.USER_ERROR
                 elif result == b'\x02':
-                    print("c> LIST_CONTENT FAIL, USER NOT CONNECTED")
-                    return client.RC.USER_ERROR
-                elif result == b'\x03':
-                    print("c> LIST_CONTENT FAIL, REMOTE USER DOES NOT EXIST")
+                    print("c> SEARCH FAIL, USER NOT CONNECTED")
                     return client.RC.USER_ERROR
                 elif result != b'\x00':
-                    print("c> LIST_CONTENT FAIL")
+                    print("c> SEARCH FAIL")
                     return client.RC.ERROR
 
-                # Leer datos
-                data = bytearray()
-                while True:
-                    chunk = s.recv(1024)
-                    if not chunk:
+                # Leer el resto de la información (número y lista de propietarios)
+                data = client._recv_all(s)
+
+                entries, _ = client._split(data)
+                num_owners = int(entries[0].decode())
+                print("c> SEARCH OK")
+                idx = 1
+                for _ in range(num_owners):
+                    if idx + 2 >= len(entries):
                         break
-                    data += chunk
+                    name = entries[idx].decode()
+                    ip = entries[idx + 1].decode()
+                    port = entries[idx + 2].decode()
+                    print(f"     {name} {ip} {port}")
+                    idx += 3
 
-                entries = data.split(b'\0')
-                if len(entries) < 1:
+                return client.RC.OK
+
+        except Exception:
+            print("c> SEARCH FAIL")
+            return client.RC.ERROR
+
+
+    class _TokenReader :
+        # Campos terminados en \0 de una conexión que no se cierra
+        def __init__(self, s):
+            self._s = s
+            self._buf = bytearray()
+
+        def next(self):
+            while True:
+                end = self._buf.find(b'\0')
+                if end >= 0:
+                    token = bytes(self._buf[:end])
+                    del self._buf[:end + 1]
+                    return token.decode()
+                chunk = self._s.recv(65536)
+                if not chunk:
+                    raise ConnectionError("connection closed by server")
+                self._buf += chunk
+
+
+    @staticmethod
+    def _watch_connect():
+        # Siempre v1 (conexión propia): la suscripción se queda con el socket
+        s = socket.create_connection((client._server, client._port))
+        s.sendall(b"WATCH_USERS\0" + client._current_user.encode() + b"\0" +
+                  str(client._watch_seq).encode() + b"\0\0")
+        return s, s.recv(1)
+
+
+    @staticmethod
+    def _watch_event(tokens, verbose):
+        kind = tokens.next()
+        seq = int(tokens.next())
+        if kind == "S":
+            # Foto completa: sustituye a lo que se tuviera
+            count = int(tokens.next())
+            users = {}
+            for _ in range(count):
+                name = tokens.next()
+                users[name] = (tokens.next(), tokens.next())
+            client._watch_users = users
+            if verbose:
+                print(f"c> WATCH_USERS SNAPSHOT {count} users")
+                for name, (ip, port) in users.items():
+                    print(f"     {name} {ip} {port}")
+        elif kind == "C":
+            name = tokens.next()
+            client._watch_users[name] = (tokens.next(), tokens.next())
+            if verbose:
+                ip, port = client._watch_users[name]
+                print(f"c> USER CONNECTED {name} {ip} {port}")
+        elif kind == "D":
+            name = tokens.next()
+            client._watch_users.pop(name, None)
+            if verbose:
+                print(f"c> USER DISCONNECTED {name}")
+        client._watch_seq = seq
+
+
+    @staticmethod
+    def _watch_loop(s):
+        while client._watch_socket is s:
+            try:
+                tokens = client._TokenReader(s)
+                while True:
+                    client._watch_event(tokens, True)
+            except Exception:
+                pass
+            if client._watch_socket is not s:
+                return
+            # Conexión caída: volver con el último seq visto (el servidor
+            # manda sólo lo que falta, o una foto si es demasiado viejo)
+            try:
+                s.close()
+                threading.Event().wait(1)
+                s, result = client._watch_connect()
+                if result != b'\x00':
+                    return
+                client._watch_socket = s
+            except OSError:
+                pass
+
+
+    @staticmethod
+    def _stop_watch():
+        s = client._watch_socket
+        client._watch_socket = None
+        if s is not None:
+            try:
+                s.shutdown(socket.SHUT_RDWR)
+                s.close()
+            except OSError:
+                pass
+
+
+    @staticmethod
+    def watchusers():
+        if client._current_user is None:
+            print("c> WATCH_USERS FAIL, NOT CONNECTED")
+            return client.RC.USER_ERROR
+        if client._watch_socket is not None:
+            print("c> WATCH_USERS OK")
+            return client.RC.OK
+
+        try:
+            s, result = client._watch_connect()
+            if result == b'\x01':
+                print("c> WATCH_USERS FAIL, USER DOES NOT EXIST")
+                s.close()
+                return client.RC.USER_ERROR
+            elif result == b'\x02':
+                print("c> WATCH_USERS FAIL, USER NOT CONNECTED")
+                s.close()
+                return client.RC.USER_ERROR
+            elif result != b'\x00':
+                print("c> WATCH_USERS FAIL")
+                s.close()
+                return client.RC.ERROR
+
+            print("c> WATCH_USERS OK")
+            client._watch_socket = s
+            threading.Thread(target=client._watch_loop, args=(s,), daemon=True).start()
+            return client.RC.OK
+
+        except Exception:
+            print("c> WATCH_USERS FAIL")
+            return client.RC.ERROR
+
+
+    @staticmethod
+    def listcontent(user, descriptions=False, names=None):
+        if client._current_user is None:
+            print("c> LIST_CONTENT FAIL, NOT CONNECTED")
+            return client.RC.USER_ERROR
+
+        # Se pide por páginas: el servidor nunca manda más de LIST_PAGE archivos
+        # de golpe y devuelve el cursor de la siguiente (0 = no hay más)
+        cursor = 0
+        first = True
+        try:
+            while True:
+                with client._send_request(b"LIST_CONTENT_PAGE\0" +
+                            client._current_user.encode() + b"\0" +
+                            user.encode() + b"\0" +
+                            str(cursor).encode() + b"\0" +
+                            str(client.LIST_PAGE).encode() + b"\0" +
+                            (b"d" if descriptions else b"") + b"\0") as s:
+
+                    result = s.recv(1)
+                    if result == b'\x01':
+                        print("c> LIST_CONTENT FAIL, USER DOES NOT EXIST")
+                        return client.RC.USER_ERROR
+                    elif result == b'\x02':
+                        print("c> LIST_CONTENT FAIL, USER NOT CONNECTED")
+                        return client.RC.USER_ERROR
+                    elif result == b'\x03':
+                        print("c> LIST_CONTENT FAIL, REMOTE USER DOES NOT EXIST")
+                        return client.RC.USER_ERROR
+                    elif result != b'\x00':
+                        print("c> LIST_CONTENT FAIL")
+                        return client.RC.ERROR
+
+                    # Leer datos
+                    data = client._recv_all(s)
+
+                entries, _ = client._split(data)
+                count = int(entries[0].decode())
+                fields = 2 if descriptions else 1
+                if len(entries) < 2 + count * fields:
                     print("c> LIST_CONTENT FAIL")
                     return client.RC.ERROR
 
-                count = int(entries[0].decode())
-                print("c> LIST_CONTENT OK")
-                for i in range(1, 1 + count):
-                    print(entries[i].decode())
+                if first and names is None:
+                    print("c> LIST_CONTENT OK")
+                first = False
+                idx = 1
+                for _ in range(count):
+                    if names is not None:
+                        names.append(entries[idx].decode())
+                    elif descriptions:
+                        print(f"{entries[idx].decode()} \"{entries[idx + 1].decode()}\"")
+                    else:
+                        print(entries[idx].decode())
+                    idx += fields
 
-                return client.RC.OK
+                cursor = int(entries[idx].decode())
+                if cursor == 0:
+                    return client.RC.OK
 
         except Exception:
             print("c> LIST_CONTENT FAIL")
@@ -417,96 +961,328 @@ class client :
             return client.RC.USER_ERROR
                 
         try:
-            timestamp = get_datetime_from_web()
+            # Paso 1: Quién tiene el archivo: el dueño y, si se publicó con
+            # hash, cualquier otro conectado con los mismos bytes
+            code, content, sources = client._get_sources(user, remote_fileName)
+            if code == 1:
+                print("c> GET_FILE FAIL, FILE NOT EXIST")
+                return client.RC.USER_ERROR
+            elif code != 0 or not sources:
+                print("c> GET_FILE FAIL")
+                return client.RC.ERROR
 
-            # Paso 1: Obtener IP y puerto del usuario remoto desde el servidor
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                s.connect((client._server, client._port))
-                s.sendall(b"GET_FILE\0" + 
-                        client._current_user.encode() + b"\0" +
-                        user.encode() + b"\0" +
-                        remote_fileName.encode() + b"\0" + timestamp.encode() + b"\0")
-                
-                result = s.recv(1)
-                if result == b'\x01':
-                    print("c> GET_FILE FAIL, FILE NOT EXIST")
-                    return client.RC.USER_ERROR
-                elif result != b'\x00':
-                    print("c> GET_FILE FAIL")
-                    return client.RC.ERROR
+            # Paso 2: Descargar repartiendo entre las fuentes (por trozos si lo
+            # admiten: se retoma si se corta)
+            result = client._swarm_fetch(sources, local_fileName, content)
+            if result == 0:
+                print("c> GET_FILE OK")
+                return client.RC.OK
+            elif result == 1:
+                print("c> GET_FILE FAIL, FILE NOT EXIST")
+                return client.RC.USER_ERROR
+            elif result == 3:
+                print("c> GET_FILE FAIL (incomplete file)")
+                return client.RC.ERROR
+            else:
+                print("c> GET_FILE FAIL")
+                return client.RC.ERROR
 
-                # Leer IP y puerto
-                ip = b''
-                while True:
-                    chunk = s.recv(1)
-                    if chunk == b'\0':
-                        break
-                    ip += chunk
+        except Exception as e:
+            print(f"c> GET_FILE FAIL ({e})")
+            return client.RC.ERROR
 
-                port_str = b''
-                while True:
-                    chunk = s.recv(1)
-                    if chunk == b'\0':
-                        break
-                    port_str += chunk
 
-                ip_addr = ip.decode()
-                port = int(port_str.decode())
+    # GET_SOURCES: (código, (hash, tamaño) o None, [(ip, puerto, archivo)]) con
+    # las fuentes en el orden en que las da el servidor (las menos usadas antes)
+    @staticmethod
+    def _get_sources(user, remote_fileName):
+        with client._send_request(b"GET_SOURCES\0" +
+                    client._current_user.encode() + b"\0" +
+                    user.encode() + b"\0" +
+                    remote_fileName.encode() + b"\0" +
+                    str(client.SOURCES_MAX).encode() + b"\0") as s:
+            result = s.recv(1)
+            if result != b'\x00':
+                return (result[0] if result else -1), None, []
+            data = client._recv_all(s)
+
+        fields, _ = client._split(data)
+        size, digest, count = fields[0], fields[1], int(fields[2])
+        content = (digest.decode(), int(size)) if digest else None
+        sources = []
+        for i in range(count):
+            name, ip, port, fileName = fields[3 + 4 * i:7 + 4 * i]
+            sources.append((ip.decode(), int(port), fileName.decode()))
+        return 0, content, sources
+
+
+    # Resuelve varios (usuario, archivo) con una sola petición al directorio.
+    # Devuelve una lista de (código, ip, puerto) en el mismo orden, o None.
+    @staticmethod
+    def getfiles(items):
+        results = []
+        for start in range(0, len(items), client.GET_FILES_BATCH):
+            batch = items[start:start + client.GET_FILES_BATCH]
+            message = (b"GET_FILES\0" + client._current_user.encode() + b"\0" +
+                       str(len(batch)).encode() + b"\0")
+            for user, fileName in batch:
+                message += user.encode() + b"\0" + fileName.encode() + b"\0"
+
+            with client._send_request(message) as s:
+                if s.recv(1) != b'\x00':
+                    return None
+                data = client._recv_all(s)
+
+            entries, _ = client._split(data)
+            count = int(entries[0].decode())
+            for i in range(count):
+                code, ip, port = entries[1 + 3 * i:4 + 3 * i]
+                results.append((int(code), ip.decode(), int(port) if port else 0))
+        return results
+
+
+    # Copia en localDir todo lo que ha publicado user: un LIST_CONTENT por
+    # páginas, un GET_FILES para todos los archivos y luego las descargas
+    @staticmethod
+    def mirror(user, localDir):
+        if client._current_user is None:
+            print("c> MIRROR FAIL, NOT CONNECTED")
+            return client.RC.USER_ERROR
 
-            # Paso 2: Conectar con el cliente destino
-            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
-                #print(f"Ip_addr: {ip_addr}, Port: {port}")
-                s.connect((ip_addr, port))
-                s.sendall(b"GET_FILE\0" + remote_fileName.encode() + b"\0" + timestamp.encode() + b"\0")
+        try:
+            names = []
+            if client.listcontent(user, names=names) != client.RC.OK:
+                print("c> MIRROR FAIL")
+                return client.RC.ERROR
 
-                result = s.recv(1)
-                if result == b'\x01':
-                    print("c> GET_FILE FAIL, FILE NOT EXIST")
-                    return client.RC.USER_ERROR
-                elif result != b'\x00':
-                    print("c> GET_FILE FAIL")
-                    return client.RC.ERROR
+            owners = client.getfiles([(user, name) for name in names])
+            if owners is None:
+                print("c> MIRROR FAIL")
+                return client.RC.ERROR
 
-                # Leer tamaño del archivo
-                size_str = b''
-                while True:
-                    chunk = s.recv(1)
-                    if chunk == b'\0':
-                        break
-                    size_str += chunk
+            os.makedirs(localDir, exist_ok=True)
+            copied = 0
+            for name, (code, ip, port) in zip(names, owners):
+                local = os.path.join(localDir, os.path.basename(name))
+                if code == 0 and client._fetch_from_peer(ip, port, name, local) == 0:
+                    copied += 1
+                else:
+                    print(f"c> MIRROR {name} FAIL")
+            print(f"c> MIRROR OK {copied}/{len(names)}")
+            return client.RC.OK if copied == len(names) else client.RC.ERROR
 
-                # Leer timestamp
-                timestamp_str = b''
-                while True:
-                    chunk = s.recv(1)
-                    if chunk == b'\0':
+        except Exception as e:
+            print(f"c> MIRROR FAIL ({e})")
+            return client.RC.ERROR
+
+
+    # Descarga remote_fileName del cliente en ip:port.
+    # 0 OK, 1 no existe, 2 error, 3 fichero incompleto (se borra)
+    @staticmethod
+    def _fetch_from_peer(ip_addr, port, remote_fileName, local_fileName):
+        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+            s.connect((ip_addr, port))
+            s.sendall(b"GET_FILE\0" + remote_fileName.encode() + b"\0\0")
+
+            # Código, tamaño y timestamp; lo que venga detrás ya es el archivo
+            result, fields, first = client._recv_head(s, 2)
+            if result == b'\x01':
+                return 1
+            elif result != b'\x00':
+                return 2
+
+            file_size = int(fields[0].decode())
+            timestamp = fields[1].decode()
+
+            # Descargar archivo por bloques
+            received = 0
+            with open(local_fileName, 'wb') as f:
+                if first:
+                    f.write(first[:file_size])
+                    received = min(len(first), file_size)
+                while received < file_size:
+                    chunk = s.recv(min(65536, file_size - received))
+                    if not chunk:
                         break
-                    timestamp_str += chunk
+                    f.write(chunk)
+                    received += len(chunk)
 
-                file_size = int(size_str.decode())
-                timestamp = timestamp_str.decode()
+            if received == file_size:
+                return 0
+            os.remove(local_fileName)
+            return 3
 
-                # Descargar archivo por bloques
-                received = 0
-                with open(local_fileName, 'wb') as f:
-                    while received < file_size:
-                        chunk = s.recv(min(4096, file_size - received))
-                        if not chunk:
-                            break
-                        f.write(chunk)
-                        received += len(chunk)
 
+    # CRC-32 de cada trozo de remote_fileName en ip:port.
+    # (0, tamaño, trozo, [crc...]), (1, ...) si no existe, (2, ...) si el peer no sabe de trozos
+    @staticmethod
+    def _peer_sums(ip_addr, port, remote_fileName, chunk):
+        try:
+            with socket.create_connection((ip_addr, port), timeout=client.PEER_TIMEOUT) as s:
+                s.sendall(b"GET_SUMS\0" + remote_fileName.encode() + b"\0" + str(chunk).encode() + b"\0")
+                data = client._recv_all(s)
+            if data[:1] == b'\x01':
+                return 1, 0, 0, None
+            if data[:1] != b'\x00':
+                return 2, 0, 0, None
+            fields, _ = client._split(data[1:])
+            size, chunk = int(fields[0]), int(fields[1])
+            count = (size + chunk - 1) // chunk
+            if len(fields) < 2 + count:
+                return 2, 0, 0, None
+            return 0, size, chunk, [int(x, 16) for x in fields[2:2 + count]]
+        except (OSError, ValueError):
+            return 2, 0, 0, None
+
+    # Bytes [offset, offset + length) de remote_fileName, o None si falla
+    @staticmethod
+    def _fetch_range(ip_addr, port, remote_fileName, offset, length):
+        try:
+            with socket.create_connection((ip_addr, port), timeout=client.PEER_TIMEOUT) as s:
+                s.sendall(b"GET_RANGE\0" + remote_fileName.encode() + b"\0" +
+                          str(offset).encode() + b"\0" + str(length).encode() + b"\0")
+                result, _, first = client._recv_head(s, 1)  # Código y tamaño total
+                if result != b'\x00':
+                    return None
+                first = first[:length]
+                data = bytearray(length)
+                data[:len(first)] = first
+                view = memoryview(data)
+                got = len(first)
+                while got < length:
+                    n = s.recv_into(view[got:])
+                    if n == 0:
+                        break
+                    got += n
+                return bytes(data[:got])
+        except OSError:
+            return None
+
+    # Descarga un archivo repartiendo sus trozos entre varios peers (ip, port,
+    # nombre con el que lo tiene cada uno) a la vez; cada trozo se comprueba
+    # con su CRC-32 antes de darlo por bueno. Lo comprobado queda en
+    # local.part y la lista en local.part.sums, así que una descarga cortada
+    # sigue desde el último trozo bueno. Un peer que falla o da un trozo que
+    # no cuadra (otro contenido con el mismo nombre) se deja. Con content =
+    # (sha256, tamaño) el archivo terminado se comprueba entero.
+    # Mismos códigos que _fetch_from_peer (3: incompleto, se puede retomar).
+    @staticmethod
+    def _swarm_fetch(sources, local_fileName, content=None):
+        manifest = None
+        old_peer = None
+        for ip_addr, port, name in sources:
+            code, size, chunk, sums = client._peer_sums(ip_addr, port, name, client.SWARM_CHUNK)
+            if code == 0 and (content is None or size == content[1]):
+                manifest = (size, chunk, sums)
+                break
+            if code == 2 and old_peer is None:
+                old_peer = (ip_addr, port, name)
+        if manifest is None:
+            # Nadie da trozos: archivo entero de un peer de la versión anterior
+            if old_peer is None:
+                return 1
+            return client._fetch_from_peer(old_peer[0], old_peer[1], old_peer[2], local_fileName)
+
+        size, chunk, sums = manifest
+        part = local_fileName + ".part"
+        state = part + ".sums"
+        header = f"{size} {chunk} {' '.join('%08x' % c for c in sums)}\n"
+
+        # ¿Hay una descarga a medias del mismo contenido?
+        done = set()
+        try:
+            with open(state) as f:
+                if f.readline() == header and os.path.getsize(part) == size:
+                    done = {int(line) for line in f if line.strip()}
+        except (OSError, ValueError):
+            done = set()
+        if not done:
+            with open(part, 'wb') as f:
+                f.truncate(size)
+            with open(state, 'w') as f:
+                f.write(header)
+
+        pending = [i for i in range(len(sums)) if i not in done]
+        live = list(sources)
+        lock = threading.Lock()
+        fd = os.open(part, os.O_WRONLY)
+        log = open(state, 'a')
+
+        def worker(peer):
+            while True:
+                with lock:
+                    if not pending:
+                        return
+                    i = pending.pop(0)
+                length = min(chunk, size - i * chunk)
+                data = client._fetch_range(peer[0], peer[1], peer[2], i * chunk, length)
+                if data is None or len(data) != length or zlib.crc32(data) != sums[i]:
+                    with lock:
+                        pending.append(i)
+                        live.remove(peer)
+                    return
+                os.pwrite(fd, data, i * chunk)
+                with lock:
+                    log.write(f"{i}\n")
+                    log.flush()
 
-                if received == file_size:
-                    print("c> GET_FILE OK")
-                    return client.RC.OK
-                else:
-                    os.remove(local_fileName)
-                    print("c> GET_FILE FAIL (incomplete file)")
-                    return client.RC.ERROR
+        try:
+            # Una ronda por si un trozo vuelve a la cola cuando los demás ya han acabado
+            while pending and live:
+                threads = [threading.Thread(target=worker, args=(peer,), daemon=True) for peer in list(live)]
+                for t in threads:
+                    t.start()
+                for t in threads:
+                    t.join()
+        finally:
+            os.close(fd)
+            log.close()
+
+        if pending:
+            return 3
+        if content is not None and client._content_hash(part) != content:
+            # Los trozos cuadran con las sumas del primer peer pero no con el
+            # hash publicado: se tira para no retomar sobre algo malo
+            os.remove(part)
+            os.remove(state)
+            return 4
+        os.replace(part, local_fileName)
+        os.remove(state)
+        return 0
+
+    # Descarga remote_fileName de todos los usuarios que lo publican en users a la vez
+    @staticmethod
+    def swarmget(remote_fileName, local_fileName, users):
+        if client._current_user is None:
+            print("c> SWARM_GET FAIL, NOT CONNECTED")
+            return client.RC.USER_ERROR
+
+        try:
+            owners = client.getfiles([(user, remote_fileName) for user in users])
+            if owners is None:
+                print("c> SWARM_GET FAIL")
+                return client.RC.ERROR
+            sources = [(ip, port, remote_fileName) for code, ip, port in owners if code == 0]
+            if not sources:
+                print("c> SWARM_GET FAIL, FILE NOT EXIST")
+                return client.RC.USER_ERROR
+
+            result = client._swarm_fetch(sources, local_fileName)
+            if result == 0:
+                print(f"c> SWARM_GET OK ({len(sources)} sources)")
+                return client.RC.OK
+            elif result == 1:
+                print("c> SWARM_GET FAIL, FILE NOT EXIST")
+                return client.RC.USER_ERROR
+            elif result == 3:
+                print("c> SWARM_GET FAIL (incomplete file, run it again to resume)")
+                return client.RC.ERROR
+            else:
+                print("c> SWARM_GET FAIL")
+                return client.RC.ERROR
 
         except Exception as e:
-            print(f"c> GET_FILE FAIL ({e})")
+            print(f"c> SWARM_GET FAIL ({e})")
             return client.RC.ERROR
 
 
@@ -550,6 +1326,18 @@ class client :
                         else :
                             print("Syntax error. Usage: PUBLISH <fileName> <description>")
 
+                    elif(line[0]=="PUBLISH_DIR") :
+                        if (len(line) >= 3) :
+                            client.publishdir(line[1], ' '.join(line[2:]))
+                        else :
+                            print("Syntax error. Usage: PUBLISH_DIR <directory> <description>")
+
+                    elif(line[0]=="DELETE_DIR") :
+                        if (len(line) == 2) :
+                            client.deletedir(line[1])
+                        else :
+                            print("Syntax error. Usage: DELETE_DIR <directory>")
+
                     elif(line[0]=="DELETE") :
                         if (len(line) == 2) :
                             client.delete(line[1])
@@ -562,11 +1350,31 @@ class client :
                         else :
                             print("Syntax error. Use: LIST_USERS")
 
+                    elif(line[0]=="WATCH_USERS") :
+                        if (len(line) == 1) :
+                            client.watchusers()
+                        else :
+                            print("Syntax error. Use: WATCH_USERS")
+
                     elif(line[0]=="LIST_CONTENT") :
                         if (len(line) == 2) :
                             client.listcontent(line[1])
+                        elif (len(line) == 3 and line[2] == "-d") :
+                            client.listcontent(line[1], True)
                         else :
-                            print("Syntax error. Usage: LIST_CONTENT <userName>")
+                            print("Syntax error. Usage: LIST_CONTENT <userName> [-d]")
+
+                    elif(line[0]=="SEARCH") :
+                        if (len(line) == 2) :
+                            client.search(line[1])
+                        else :
+                            print("Syntax error. Usage: SEARCH <fileName>")
+
+                    elif(line[0]=="STATS") :
+                        if (len(line) == 1) :
+                            client.stats()
+                        else :
+                            print("Syntax error. Use: STATS")
 
                     elif(line[0]=="DISCONNECT") :
                         if (len(line) == 2) :
@@ -580,6 +1388,18 @@ class client :
                         else :
                             print("Syntax error. Usage: GET_FILE <userName> <remote_fileName> <local_fileName>")
 
+                    elif(line[0]=="SWARM_GET") :
+                        if (len(line) >= 4) :
+                            client.swarmget(line[1], line[2], line[3:])
+                        else :
+                            print("Syntax error. Usage: SWARM_GET <remote_fileName> <local_fileName> <userName> [<userName> ...]")
+
+                    elif(line[0]=="MIRROR") :
+                        if (len(line) == 3) :
+                            client.mirror(line[1], line[2])
+                        else :
+                            print("Syntax error. Usage: MIRROR <userName> <localDir>")
+
                     elif(line[0]=="QUIT") :
                         if (len(line) == 1) :
                             break
@@ -604,6 +1424,7 @@ class client :
         parser = argparse.ArgumentParser()
         parser.add_argument('-s', type=str, required=True, help='Server IP')
         parser.add_argument('-p', type=int, required=True, help='Server Port')
+        parser.add_argument('--v2', action='store_true', help='Use one persistent framed connection (protocol v2)')
         args = parser.parse_args()
 
         if (args.s is None):
@@ -616,6 +1437,7 @@ class client :
         
         client._server = args.s
         client._port = args.p
+        client._v2 = args.v2
 
         return True
 
@@ -629,6 +1451,7 @@ class client :
 
         #  Write code here
         client.shell()
+        client._stop_peer_server()
         print("+++ FINISHED +++")
     
 
@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "coarse_clock.h"
+
+static _Atomic uint64_t cached_us = 0;
+static unsigned tick_ns = COARSE_TICK_MS * 1000000u;
+
+static uint64_t read_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void* ticker(void* arg) {
+    struct timespec period = { tick_ns / 1000000000u, tick_ns % 1000000000u };
+    while (1) {
+        nanosleep(&period, NULL);
+        atomic_store_explicit(&cached_us, read_clock_us(), memory_order_relaxed);
+    }
+    return NULL;
+}
+
+int coarse_clock_start(unsigned tick_ms) {
+    if (tick_ms > 0) tick_ns = tick_ms * 1000000u;
+    atomic_store(&cached_us, read_clock_us());
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, ticker, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+uint64_t coarse_now_us(void) {
+    uint64_t now = atomic_load_explicit(&cached_us, memory_order_relaxed);
+    return now ? now : read_clock_us();
+}
+
+void coarse_format(uint64_t time_us, char* out, size_t size) {
+    time_t secs = (time_t)(time_us / 1000000ULL);
+    struct tm tm;
+    localtime_r(&secs, &tm);
+    strftime(out, size, "%d/%m/%Y %H:%M:%S", &tm);
+}
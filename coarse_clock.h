@@ -0,0 +1,26 @@
+#ifndef COARSE_CLOCK_H
+#define COARSE_CLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ----------------------------
+// Reloj de pared "grueso" para sellar las peticiones
+// ----------------------------
+//
+// Un hilo refresca la hora cada tick y los demás sólo leen un entero
+// atómico: poner la hora a cada petición no cuesta ni una llamada al
+// sistema. La hora viaja en binario (microsegundos desde 1970, UTC) por
+// la auditoría y el RPC de log; sólo se convierte a texto para imprimirla.
+
+#define COARSE_TICK_MS 1
+
+int coarse_clock_start(unsigned tick_ms);
+
+// Microsegundos desde epoch. Sin coarse_clock_start lee el reloj directamente.
+uint64_t coarse_now_us(void);
+
+// "dd/mm/yyyy hh:mm:ss" en hora local (el formato que usaba servicio-web.py)
+void coarse_format(uint64_t time_us, char* out, size_t size);
+
+#endif
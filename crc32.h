@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE, el de zlib). Para seguir un cálculo por trozos se pasa el
+// resultado anterior como crc; el primero empieza en 0.
+uint32_t crc32_update(uint32_t crc, const void* data, size_t len);
+
+#endif
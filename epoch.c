@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "epoch.h"
+
+// Registro por hilo. Nunca se libera: cuando el hilo termina queda libre
+// para que lo reutilice otro.
+typedef struct EpochThread {
+    _Atomic uint64_t epoch;         // 0 = fuera de sección; si no, época observada
+    _Atomic int in_use;             // Pertenece a un hilo vivo
+    int nesting;                    // Profundidad de epoch_enter anidados
+    struct EpochThread* next;
+} EpochThread;
+
+// Objeto pendiente de liberar
+typedef struct Retired {
+    void* ptr;
+    void (*free_fn)(void*);
+    struct Retired* next;
+} Retired;
+
+static _Atomic uint64_t global_epoch = 1;
+static EpochThread* _Atomic thread_list = NULL;
+
+static pthread_key_t thread_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static __thread EpochThread* self = NULL;
+
+// Listas de objetos retirados, indexadas por época % 3
+static pthread_mutex_t limbo_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Retired* limbo[3] = { NULL, NULL, NULL };
+static unsigned long limbo_count = 0;
+
+static void release_thread(void* arg) {
+    EpochThread* t = arg;
+    atomic_store(&t->epoch, 0);
+    atomic_store(&t->in_use, 0);
+}
+
+static void make_key(void) {
+    pthread_key_create(&thread_key, release_thread);
+}
+
+static EpochThread* register_thread(void) {
+    pthread_once(&key_once, make_key);
+
+    // Reutilizar el registro de un hilo que ya terminó
+    for (EpochThread* t = atomic_load(&thread_list); t; t = t->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&t->in_use, &expected, 1)) {
+            t->nesting = 0;
+            pthread_setspecific(thread_key, t);
+            return t;
+        }
+    }
+
+    EpochThread* t = calloc(1, sizeof(EpochThread));
+    if (!t) abort(); // Sin registro no hay forma segura de leer
+    atomic_init(&t->in_use, 1);
+
+    EpochThread* head = atomic_load(&thread_list);
+    do {
+        t->next = head;
+    } while (!atomic_compare_exchange_weak(&thread_list, &head, t));
+
+    pthread_setspecific(thread_key, t);
+    return t;
+}
+
+void epoch_enter(void) {
+    if (!self) self = register_thread();
+    if (self->nesting++ > 0) return;
+
+    atomic_store(&self->epoch, atomic_load(&global_epoch));
+    // Que el resto de hilos vea la época antes de que leamos ningún puntero
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+void epoch_exit(void) {
+    if (--self->nesting > 0) return;
+    atomic_store_explicit(&self->epoch, 0, memory_order_release);
+}
+
+void epoch_reclaim(void) {
+    pthread_mutex_lock(&limbo_mutex);
+
+    uint64_t e = atomic_load(&global_epoch);
+    for (EpochThread* t = atomic_load(&thread_list); t; t = t->next) {
+        uint64_t seen = atomic_load(&t->epoch);
+        if (seen != 0 && seen != e) {
+            pthread_mutex_unlock(&limbo_mutex);
+            return; // Algún lector sigue en una época anterior
+        }
+    }
+
+    // Al pasar a e+1 ya nadie puede ver lo retirado en e-1
+    atomic_store(&global_epoch, e + 1);
+    Retired* to_free = limbo[(e + 2) % 3];
+    limbo[(e + 2) % 3] = NULL;
+
+    unsigned long freed = 0;
+    for (Retired* r = to_free; r; r = r->next) freed++;
+    limbo_count -= freed;
+    pthread_mutex_unlock(&limbo_mutex);
+
+    while (to_free) {
+        Retired* next = to_free->next;
+        to_free->free_fn(to_free->ptr);
+        free(to_free);
+        to_free = next;
+    }
+}
+
+void epoch_retire(void* ptr, void (*free_fn)(void*)) {
+    if (!ptr) return;
+
+    Retired* r = malloc(sizeof(Retired));
+    if (!r) return; // Sin memoria: mejor perder el objeto que liberarlo antes de tiempo
+    r->ptr = ptr;
+    r->free_fn = free_fn;
+
+    pthread_mutex_lock(&limbo_mutex);
+    uint64_t e = atomic_load(&global_epoch);
+    r->next = limbo[e % 3];
+    limbo[e % 3] = r;
+    limbo_count++;
+    pthread_mutex_unlock(&limbo_mutex);
+
+    epoch_reclaim();
+}
+
+unsigned long epoch_pending(void) {
+    pthread_mutex_lock(&limbo_mutex);
+    unsigned long n = limbo_count;
+    pthread_mutex_unlock(&limbo_mutex);
+    return n;
+}
@@ -0,0 +1,26 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+// ----------------------------
+// Reclamación de memoria por épocas (EBR)
+// ----------------------------
+//
+// Los lectores recorren estructuras compartidas sin locks entre
+// epoch_enter() y epoch_exit(). Un escritor que desenlaza un nodo no lo
+// libera directamente: lo pasa a epoch_retire() y se libera cuando todos
+// los hilos que estaban dentro de una sección han salido (dos avances de
+// la época global). Las secciones pueden anidarse.
+
+void epoch_enter(void);
+void epoch_exit(void);
+
+// Libera ptr con free_fn cuando ningún lector pueda tenerlo
+void epoch_retire(void* ptr, void (*free_fn)(void*));
+
+// Intenta avanzar la época y liberar lo pendiente (lo llama epoch_retire)
+void epoch_reclaim(void);
+
+// Número de objetos retirados que aún no se han liberado
+unsigned long epoch_pending(void);
+
+#endif
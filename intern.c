@@ -0,0 +1,94 @@
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include "intern.h"
+#include "strmap.h"
+#include "slab.h"
+#include "epoch.h"
+
+typedef struct InternStr {
+    uint32_t refs;            // Referencias vivas (publicaciones, usuarios)
+    uint32_t len;             // Longitud sin el \0
+    void* data;               // Dato asociado (ver intern_data)
+    char str[];
+} InternStr;
+
+static StrMap intern_map;     // cadena -> InternStr* (la clave apunta a str)
+static size_t intern_bytes = 0;
+
+#define NODE_SIZE(len) (sizeof(InternStr) + (len) + 1)
+
+static InternStr* node_of(const char* s) {
+    return (InternStr*)(s - offsetof(InternStr, str));
+}
+
+static void intern_free(void* p) {
+    InternStr* node = p;
+    slab_free_size(node, NODE_SIZE(node->len));
+}
+
+int intern_init(void) {
+    return strmap_init(&intern_map, 64);
+}
+
+int intern_reserve(size_t n) {
+    return strmap_reserve(&intern_map, intern_map.count + n);
+}
+
+const char* intern_acquire(const char* s, size_t max_len) {
+    size_t len = strnlen(s, max_len);
+
+    InternStr* node;
+    if (s[len] == '\0') {
+        node = strmap_get(&intern_map, s);
+    } else {
+        // Hay que truncar: buscar por la versión recortada
+        char key[len + 1];
+        memcpy(key, s, len);
+        key[len] = '\0';
+        node = strmap_get(&intern_map, key);
+    }
+    if (node) {
+        node->refs++;
+        return node->str;
+    }
+
+    node = slab_alloc_size(NODE_SIZE(len));
+    if (!node) return NULL;
+    node->refs = 1;
+    node->len = (uint32_t)len;
+    node->data = NULL;
+    memcpy(node->str, s, len);
+    node->str[len] = '\0';
+
+    if (strmap_put(&intern_map, node->str, node) != 0) {
+        slab_free_size(node, NODE_SIZE(len));
+        return NULL;
+    }
+    intern_bytes += NODE_SIZE(len);
+    return node->str;
+}
+
+const char* intern_find(const char* s) {
+    InternStr* node = strmap_get(&intern_map, s);
+    return node ? node->str : NULL;
+}
+
+void** intern_data(const char* s) {
+    return &node_of(s)->data;
+}
+
+void intern_release(const char* s) {
+    if (!s) return;
+    InternStr* node = node_of(s);
+    if (--node->refs > 0) return;
+
+    strmap_remove(&intern_map, node->str);
+    intern_bytes -= NODE_SIZE(node->len);
+    epoch_retire(node, intern_free);
+}
+
+void intern_usage(size_t* strings, size_t* bytes) {
+    *strings = intern_map.count;
+    *bytes = intern_bytes;
+}
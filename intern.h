@@ -0,0 +1,38 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// ----------------------------
+// Cadenas internadas (nombres y descripciones del registro)
+// ----------------------------
+//
+// Cada cadena distinta se guarda una sola vez, con un contador de
+// referencias, en una clase de tamaño del slab ajustada a su longitud.
+// Cien usuarios publicando "README.md" comparten los mismos bytes.
+//
+// intern_acquire/intern_release requieren user_mutex. Al soltar la última
+// referencia la cadena se retira con epoch_retire, así que un lector sin
+// lock que aún la tenga puede seguir usándola.
+
+int intern_init(void);
+
+// Prepara la tabla para n cadenas más (carga de un snapshot)
+int intern_reserve(size_t n);
+
+// Devuelve la copia internada de s (truncada a max_len bytes) o NULL sin memoria
+const char* intern_acquire(const char* s, size_t max_len);
+void intern_release(const char* s);
+
+// Copia internada de s si existe (sin tomar referencia)
+const char* intern_find(const char* s);
+
+// Puntero libre asociado a una cadena internada (empieza a NULL). El
+// registro lo usa para colgar de cada nombre de archivo sus publicaciones,
+// así el índice global no necesita otra tabla.
+void** intern_data(const char* s);
+
+// Cadenas distintas vivas y bytes que ocupan (cabecera incluida)
+void intern_usage(size_t* strings, size_t* bytes);
+
+#endif
@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log_index.h"
+
+typedef struct {
+    uint64_t hash;           // 0 = hueco libre
+    uint32_t* offsets;
+    uint32_t len, cap;
+} UserPostings;
+
+struct LogIndexBuilder {
+    LogIndexHeader header;
+    LogIndexBlock* blocks;
+    uint32_t blocks_cap;
+    uint32_t in_block;       // Registros en el bloque actual
+    UserPostings* users;     // Direccionamiento abierto, capacidad potencia de 2
+    uint32_t users_cap;
+};
+
+uint64_t log_index_hash(const char* s, size_t len) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+uint64_t log_index_verb_bit(const char* op, size_t len) {
+    const char* space = memchr(op, ' ', len);
+    if (space) len = space - op;
+    return 1ULL << (log_index_hash(op, len) & 63);
+}
+
+// ----------------------------
+// Construcción
+// ----------------------------
+
+LogIndexBuilder* log_index_builder_new(void) {
+    LogIndexBuilder* b = calloc(1, sizeof(LogIndexBuilder));
+    if (!b) return NULL;
+    memcpy(b->header.magic, LOG_INDEX_MAGIC, sizeof(b->header.magic));
+    b->users_cap = 1024;
+    b->users = calloc(b->users_cap, sizeof(UserPostings));
+    if (!b->users) {
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+void log_index_builder_free(LogIndexBuilder* b) {
+    if (!b) return;
+    for (uint32_t i = 0; i < b->users_cap; i++) free(b->users[i].offsets);
+    free(b->users);
+    free(b->blocks);
+    free(b);
+}
+
+static UserPostings* find_user(UserPostings* table, uint32_t cap, uint64_t hash) {
+    uint32_t i = (uint32_t)hash & (cap - 1);
+    while (table[i].hash && table[i].hash != hash) i = (i + 1) & (cap - 1);
+    return &table[i];
+}
+
+static int grow_users(LogIndexBuilder* b) {
+    uint32_t cap = b->users_cap * 2;
+    UserPostings* table = calloc(cap, sizeof(UserPostings));
+    if (!table) return -1;
+    for (uint32_t i = 0; i < b->users_cap; i++) {
+        if (b->users[i].hash) *find_user(table, cap, b->users[i].hash) = b->users[i];
+    }
+    free(b->users);
+    b->users = table;
+    b->users_cap = cap;
+    return 0;
+}
+
+void log_index_add(LogIndexBuilder* b, uint64_t offset, const LogEntry* e) {
+    LogIndexHeader* h = &b->header;
+    if (h->first_seq == 0) {
+        h->first_seq = e->seq;
+        h->min_time = e->time_us;
+    }
+    h->last_seq = e->seq;
+    if (e->time_us < h->min_time) h->min_time = e->time_us;
+    if (e->time_us > h->max_time) h->max_time = e->time_us;
+
+    if (b->in_block == 0) {
+        if (h->nblocks == b->blocks_cap) {
+            uint32_t cap = b->blocks_cap ? b->blocks_cap * 2 : 64;
+            LogIndexBlock* blocks = realloc(b->blocks, cap * sizeof(LogIndexBlock));
+            if (!blocks) return;
+            b->blocks = blocks;
+            b->blocks_cap = cap;
+        }
+        LogIndexBlock* blk = &b->blocks[h->nblocks++];
+        blk->offset = offset;
+        blk->first_seq = e->seq;
+        blk->min_time = blk->max_time = e->time_us;
+        blk->verbs = 0;
+    }
+    LogIndexBlock* blk = &b->blocks[h->nblocks - 1];
+    if (e->time_us < blk->min_time) blk->min_time = e->time_us;
+    if (e->time_us > blk->max_time) blk->max_time = e->time_us;
+    blk->verbs |= log_index_verb_bit(e->operation, e->op_len);
+    b->in_block = (b->in_block + 1) % LOG_INDEX_BLOCK;
+
+    if ((h->nusers + 1) * 2 > b->users_cap && grow_users(b) < 0) return;
+    uint64_t hash = log_index_hash(e->user, e->user_len);
+    UserPostings* u = find_user(b->users, b->users_cap, hash);
+    if (!u->hash) {
+        u->hash = hash;
+        h->nusers++;
+    }
+    if (u->len == u->cap) {
+        uint32_t cap = u->cap ? u->cap * 2 : 4;
+        uint32_t* offsets = realloc(u->offsets, cap * sizeof(uint32_t));
+        if (!offsets) return;
+        u->offsets = offsets;
+        u->cap = cap;
+    }
+    u->offsets[u->len++] = (uint32_t)offset;
+    h->npostings++;
+}
+
+static int by_hash(const void* a, const void* b) {
+    uint64_t x = (*(const UserPostings* const*)a)->hash;
+    uint64_t y = (*(const UserPostings* const*)b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+// Serializa el índice con el formato del .idx: cabecera, bloques, usuarios
+// (ordenados por hash) y postings
+static char* serialize(const LogIndexBuilder* b, uint64_t end, size_t* size) {
+    const LogIndexHeader* h = &b->header;
+    size_t blocks_size = h->nblocks * sizeof(LogIndexBlock);
+    size_t users_size = h->nusers * sizeof(LogIndexUser);
+    *size = sizeof(LogIndexHeader) + blocks_size + users_size + h->npostings * sizeof(uint32_t);
+
+    char* buf = malloc(*size);
+    const UserPostings** sorted = malloc((h->nusers + 1) * sizeof(UserPostings*));
+    if (!buf || !sorted) {
+        free(buf);
+        free(sorted);
+        return NULL;
+    }
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < b->users_cap; i++) {
+        if (b->users[i].hash) sorted[n++] = &b->users[i];
+    }
+    qsort(sorted, n, sizeof(UserPostings*), by_hash);
+
+    LogIndexHeader out = *h;
+    out.end = end;
+    memcpy(buf, &out, sizeof(out));
+    memcpy(buf + sizeof(out), b->blocks, blocks_size);
+
+    LogIndexUser* users = (LogIndexUser*)(buf + sizeof(out) + blocks_size);
+    uint32_t* postings = (uint32_t*)((char*)users + users_size);
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        users[i].hash = sorted[i]->hash;
+        users[i].start = pos;
+        users[i].count = sorted[i]->len;
+        users[i].pad = 0;
+        memcpy(postings + pos, sorted[i]->offsets, sorted[i]->len * sizeof(uint32_t));
+        pos += sorted[i]->len;
+    }
+    free(sorted);
+    return buf;
+}
+
+static int write_file(const char* path, const char* data, size_t size) {
+    char tmp[900];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    if (!f) return -1;
+    int ok = fwrite(data, 1, size, f) == size;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+int log_index_write(const LogIndexBuilder* b, uint64_t end, const char* path) {
+    size_t size;
+    char* data = serialize(b, end, &size);
+    if (!data) return -1;
+    int result = write_file(path, data, size);
+    free(data);
+    return result;
+}
+
+void log_index_snapshot(const LogIndexBuilder* b, uint64_t end, const char* user,
+                        LogIndexSnapshot* out) {
+    memset(out, 0, sizeof(*out));
+    out->header = b->header;
+    out->header.end = end;
+    size_t blocks_size = b->header.nblocks * sizeof(LogIndexBlock);
+    out->blocks = malloc(blocks_size ? blocks_size : 1);
+    if (!out->blocks) {
+        out->header.nblocks = 0;
+    } else {
+        memcpy(out->blocks, b->blocks, blocks_size);
+    }
+
+    if (!user || !*user) return;
+    UserPostings* u = find_user(b->users, b->users_cap, log_index_hash(user, strlen(user)));
+    out->postings = malloc((u->len ? u->len : 1) * sizeof(uint32_t));
+    if (!out->postings) return;
+    memcpy(out->postings, u->offsets, u->len * sizeof(uint32_t));
+    out->npostings = u->len;
+}
+
+void log_index_snapshot_free(LogIndexSnapshot* s) {
+    free(s->blocks);
+    free(s->postings);
+}
+
+// ----------------------------
+// Índices cargados (segmentos cerrados)
+// ----------------------------
+
+// Un .idx en memoria. No cambia una vez cargado; si el segmento crece
+// (se consulta un directorio que otro proceso sigue escribiendo) se carga otro.
+typedef struct {
+    char path[800];
+    char* data;
+    size_t size;
+    int mapped;
+} LoadedIndex;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LoadedIndex** cache = NULL;
+static int cache_len = 0, cache_cap = 0;
+
+static int valid_index(const char* data, size_t size, uint64_t end) {
+    if (size < sizeof(LogIndexHeader)) return 0;
+    const LogIndexHeader* h = (const LogIndexHeader*)data;
+    return memcmp(h->magic, LOG_INDEX_MAGIC, sizeof(h->magic)) == 0 && h->end == end &&
+           size == sizeof(LogIndexHeader) + h->nblocks * sizeof(LogIndexBlock) +
+                   h->nusers * sizeof(LogIndexUser) + h->npostings * sizeof(uint32_t);
+}
+
+static const char* map_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = st.st_size;
+    return data;
+}
+
+// Índice de un segmento leyéndolo entero (falta el .idx o está viejo)
+static char* rebuild(const char* seg_path, uint64_t end, size_t* size) {
+    size_t seg_size;
+    const char* seg = map_file(seg_path, &seg_size);
+    if (!seg) return NULL;
+    size_t len = seg_size < end ? seg_size : end;
+
+    char* data = NULL;
+    LogIndexBuilder* b = log_index_builder_new();
+    if (b && len >= sizeof(LogSegmentHeader)) {
+        size_t off = sizeof(LogSegmentHeader);
+        LogEntry e;
+        size_t at = off;
+        while (log_segment_next(seg, len, &off, &e) == 1) {
+            log_index_add(b, at, &e);
+            at = off;
+        }
+        data = serialize(b, end, size);
+    }
+    log_index_builder_free(b);
+    munmap((void*)seg, seg_size);
+    return data;
+}
+
+static LoadedIndex* load_index(const char* seg_path) {
+    struct stat st;
+    if (stat(seg_path, &st) < 0) return NULL;
+    uint64_t end = st.st_size;
+
+    pthread_mutex_lock(&cache_mutex);
+    for (int i = 0; i < cache_len; i++) {
+        LoadedIndex* li = cache[i];
+        if (strcmp(li->path, seg_path) == 0 &&
+            ((const LogIndexHeader*)li->data)->end == end) {
+            pthread_mutex_unlock(&cache_mutex);
+            return li;
+        }
+    }
+
+    char idx_path[800];
+    snprintf(idx_path, sizeof(idx_path), "%s", seg_path);
+    char* dot = strrchr(idx_path, '.');
+    if (dot) strcpy(dot, ".idx");
+
+    LoadedIndex* li = calloc(1, sizeof(LoadedIndex));
+    if (!li) {
+        pthread_mutex_unlock(&cache_mutex);
+        return NULL;
+    }
+    snprintf(li->path, sizeof(li->path), "%s", seg_path);
+    li->data = (char*)map_file(idx_path, &li->size);
+    li->mapped = 1;
+    if (li->data && !valid_index(li->data, li->size, end)) {
+        munmap(li->data, li->size);
+        li->data = NULL;
+    }
+    if (!li->data) {
+        li->data = rebuild(seg_path, end, &li->size);
+        li->mapped = 0;
+        if (li->data) write_file(idx_path, li->data, li->size); // Si no se puede, se queda en memoria
+    }
+    if (!li->data) {
+        free(li);
+        pthread_mutex_unlock(&cache_mutex);
+        return NULL;
+    }
+
+    // Las versiones viejas se quedan en la caché: otro hilo puede estar usándolas
+    if (cache_len == cache_cap) {
+        int cap = cache_cap ? cache_cap * 2 : 64;
+        LoadedIndex** c = realloc(cache, cap * sizeof(LoadedIndex*));
+        if (c) {
+            cache = c;
+            cache_cap = cap;
+        }
+    }
+    if (cache_len < cache_cap) cache[cache_len++] = li;
+    pthread_mutex_unlock(&cache_mutex);
+    return li;
+}
+
+// ----------------------------
+// Consulta
+// ----------------------------
+
+typedef struct {
+    const LogIndexHeader* header;
+    const LogIndexBlock* blocks;
+    const uint32_t* postings;
+    uint64_t npostings;
+    int by_user;
+} IndexView;
+
+static int segment_may_match(const LogIndexHeader* h, const LogQuery* q) {
+    if (h->first_seq == 0 || h->last_seq <= q->after_seq) return 0;
+    if (q->from_us && h->max_time < q->from_us) return 0;
+    if (q->to_us && h->min_time > q->to_us) return 0;
+    return 1;
+}
+
+static int entry_matches(const LogEntry* e, const LogQuery* q, size_t user_len, size_t op_len) {
+    if (e->seq <= q->after_seq) return 0;
+    if (q->from_us && e->time_us < q->from_us) return 0;
+    if (q->to_us && e->time_us > q->to_us) return 0;
+    if (user_len && (e->user_len != user_len || memcmp(e->user, q->user, user_len) != 0)) return 0;
+    if (op_len) {
+        if (e->op_len < op_len || memcmp(e->operation, q->operation, op_len) != 0) return 0;
+        // El verbo tiene que ser entero: "PUBLISH" no encaja con "PUBLISHED"
+        if (e->op_len > op_len && !memchr(q->operation, ' ', op_len) && e->operation[op_len] != ' ') return 0;
+    }
+    return 1;
+}
+
+static uint64_t lower_bound(const uint32_t* v, uint64_t n, uint64_t value) {
+    uint64_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (v[mid] < value) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int run_query(const char* data, const IndexView* v, const LogQuery* q,
+                     LogQueryFn fn, void* ctx) {
+    const LogIndexHeader* h = v->header;
+    size_t user_len = q->user ? strlen(q->user) : 0;
+    size_t op_len = q->operation ? strlen(q->operation) : 0;
+    uint64_t verb = op_len ? log_index_verb_bit(q->operation, op_len) : 0;
+    uint64_t p = 0;
+
+    for (uint32_t i = 0; i < h->nblocks; i++) {
+        const LogIndexBlock* b = &v->blocks[i];
+        uint64_t stop = i + 1 < h->nblocks ? v->blocks[i + 1].offset : h->end;
+        uint64_t last_seq = i + 1 < h->nblocks ? v->blocks[i + 1].first_seq - 1 : h->last_seq;
+
+        if (last_seq <= q->after_seq) continue;
+        if (q->from_us && b->max_time < q->from_us) continue;
+        if (q->to_us && b->min_time > q->to_us) continue;
+        if (verb && !(b->verbs & verb)) continue;
+
+        LogEntry e;
+        if (v->by_user) {
+            p = lower_bound(v->postings, v->npostings, b->offset);
+            for (; p < v->npostings && v->postings[p] < stop; p++) {
+                size_t off = v->postings[p];
+                if (log_segment_next(data, h->end, &off, &e) != 1) break;
+                if (entry_matches(&e, q, user_len, op_len) && !fn(&e, ctx)) return 1;
+            }
+        } else {
+            size_t off = b->offset;
+            while (off < stop && log_segment_next(data, h->end, &off, &e) == 1) {
+                if (entry_matches(&e, q, user_len, op_len) && !fn(&e, ctx)) return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Proyecta el segmento y ejecuta la consulta sobre él
+static int query_mapped(const char* seg_path, const IndexView* v, const LogQuery* q,
+                        LogQueryFn fn, void* ctx) {
+    size_t size;
+    const char* data = map_file(seg_path, &size);
+    if (!data) return -1;
+    int result = size >= v->header->end ? run_query(data, v, q, fn, ctx) : -1;
+    munmap((void*)data, size);
+    return result;
+}
+
+int log_index_query_segment(const char* seg_path, const LogQuery* q, LogQueryFn fn, void* ctx) {
+    LoadedIndex* li = load_index(seg_path);
+    if (!li) return -1;
+
+    const LogIndexHeader* h = (const LogIndexHeader*)li->data;
+    if (!segment_may_match(h, q)) return 0;
+
+    IndexView v;
+    v.header = h;
+    v.blocks = (const LogIndexBlock*)(li->data + sizeof(LogIndexHeader));
+    v.postings = NULL;
+    v.npostings = 0;
+    v.by_user = q->user && *q->user;
+
+    if (v.by_user) {
+        const LogIndexUser* users = (const LogIndexUser*)(v.blocks + h->nblocks);
+        const uint32_t* postings = (const uint32_t*)(users + h->nusers);
+        uint64_t hash = log_index_hash(q->user, strlen(q->user));
+        uint32_t lo = 0, hi = h->nusers;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (users[mid].hash < hash) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == h->nusers || users[lo].hash != hash) return 0;
+        v.postings = postings + users[lo].start;
+        v.npostings = users[lo].count;
+    }
+    return query_mapped(seg_path, &v, q, fn, ctx);
+}
+
+int log_index_query_snapshot(const char* seg_path, const LogIndexSnapshot* s,
+                             const LogQuery* q, LogQueryFn fn, void* ctx) {
+    if (!segment_may_match(&s->header, q)) return 0;
+    IndexView v;
+    v.header = &s->header;
+    v.blocks = s->blocks;
+    v.postings = s->postings;
+    v.npostings = s->npostings;
+    v.by_user = q->user && *q->user;
+    if (v.by_user && v.npostings == 0) return 0;
+    return query_mapped(seg_path, &v, q, fn, ctx);
+}
+
+static int is_segment(const struct dirent* d) {
+    return strncmp(d->d_name, "log-", 4) == 0 && strstr(d->d_name, ".seg") != NULL;
+}
+
+int log_index_query_dir(const char* dir, const char* before, const LogQuery* q,
+                        LogQueryFn fn, void* ctx) {
+    struct dirent** names;
+    int n = scandir(dir, &names, is_segment, alphasort);
+    if (n < 0) return -1;
+
+    int result = 0;
+    for (int i = 0; i < n; i++) {
+        char path[800];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+        if (result == 0 && (!before || strcmp(path, before) < 0)) {
+            int r = log_index_query_segment(path, q, fn, ctx);
+            if (r == 1) result = 1;
+            else if (r < 0) fprintf(stderr, "log_index: no se puede consultar %s\n", path);
+        }
+        free(names[i]);
+    }
+    free(names);
+    return result;
+}
@@ -0,0 +1,114 @@
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "log_sink.h"
+
+// ----------------------------
+// Índices de los segmentos de log
+// ----------------------------
+//
+// Junto a cada segmento log-X.seg va un log-X.idx con:
+//   - un índice de tiempo disperso: cada LOG_INDEX_BLOCK registros, la
+//     posición del bloque, su primer seq, la hora mínima y máxima y un
+//     mapa de bits de los verbos (primera palabra de la operación). Las
+//     horas llegan casi ordenadas pero no del todo (varios servidores,
+//     lotes), por eso se guarda el rango y no sólo la primera.
+//   - postings por usuario: para cada hash de usuario, las posiciones de
+//     sus registros en el segmento, en orden.
+// Una consulta sólo abre los bloques cuyo rango de horas, verbos y seq
+// encajan, y con usuario sólo lee sus registros. Los hashes pueden chocar:
+// cada registro leído se comprueba entero.
+//
+// El .idx se escribe al cerrar el segmento; el del segmento abierto vive
+// en memoria (LogIndexBuilder) y si falta un .idx (caída) se reconstruye
+// leyendo el segmento la primera vez que se consulta.
+
+#define LOG_INDEX_MAGIC   "P2PIDX01"
+#define LOG_INDEX_BLOCK   1024
+
+typedef struct {
+    char magic[8];
+    uint64_t first_seq, last_seq;
+    uint64_t min_time, max_time;
+    uint64_t end;            // Bytes del segmento que cubre el índice
+    uint32_t nblocks;
+    uint32_t nusers;
+    uint64_t npostings;
+} LogIndexHeader;
+
+typedef struct {
+    uint64_t offset;         // Posición del primer registro del bloque
+    uint64_t first_seq;
+    uint64_t min_time, max_time;
+    uint64_t verbs;          // Un bit por hash de verbo
+} LogIndexBlock;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t start;          // Primer posting (índice en el array de postings)
+    uint32_t count;
+    uint32_t pad;
+} LogIndexUser;
+
+// Filtros de una consulta. Cadenas vacías o NULL = sin filtro.
+// operation es el verbo (PUBLISH) o un prefijo que empiece por él
+// ("PUBLISH fichero"). from_us/to_us inclusivos, 0 = sin límite.
+typedef struct {
+    const char* user;
+    const char* operation;
+    uint64_t from_us, to_us;
+    uint64_t after_seq;      // Sólo registros con seq > after_seq (paginación)
+} LogQuery;
+
+// Recibe cada registro que encaja, en orden de seq. Devuelve 0 para parar.
+typedef int (*LogQueryFn)(const LogEntry* e, void* ctx);
+
+uint64_t log_index_hash(const char* s, size_t len);
+uint64_t log_index_verb_bit(const char* op, size_t len);
+
+// ----------------------------
+// Construcción
+// ----------------------------
+
+typedef struct LogIndexBuilder LogIndexBuilder;
+
+LogIndexBuilder* log_index_builder_new(void);
+void log_index_builder_free(LogIndexBuilder* b);
+void log_index_add(LogIndexBuilder* b, uint64_t offset, const LogEntry* e);
+int log_index_write(const LogIndexBuilder* b, uint64_t end, const char* path);
+
+// Copia de lo necesario para consultar el segmento abierto sin el lock del sumidero
+typedef struct {
+    LogIndexHeader header;
+    LogIndexBlock* blocks;
+    uint32_t* postings;      // Sólo los del usuario consultado
+    uint64_t npostings;
+} LogIndexSnapshot;
+
+void log_index_snapshot(const LogIndexBuilder* b, uint64_t end, const char* user,
+                        LogIndexSnapshot* out);
+void log_index_snapshot_free(LogIndexSnapshot* s);
+
+// ----------------------------
+// Consulta
+// ----------------------------
+
+// Consulta un segmento ya cerrado (carga su .idx o lo reconstruye).
+// Devuelve 0 si hay que seguir con el siguiente, 1 si fn ha pedido parar, -1 si error.
+int log_index_query_segment(const char* seg_path, const LogQuery* q, LogQueryFn fn, void* ctx);
+
+// Igual, para el segmento abierto con una copia de su índice
+int log_index_query_snapshot(const char* seg_path, const LogIndexSnapshot* s,
+                             const LogQuery* q, LogQueryFn fn, void* ctx);
+
+// Todos los segmentos de dir, en orden, hasta el anterior a before (NULL = todos)
+int log_index_query_dir(const char* dir, const char* before, const LogQuery* q,
+                        LogQueryFn fn, void* ctx);
+
+// Todo lo que ha guardado el sumidero abierto, incluido el segmento en curso
+// (está en log_sink.c). Mismos resultados que log_index_query_segment.
+int log_sink_query(const LogQuery* q, LogQueryFn fn, void* ctx);
+
+#endif
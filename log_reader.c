@@ -0,0 +1,284 @@
+#define _GNU_SOURCE     // strptime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+#include "log_rpc.h"
+#include "log_sink.h"
+#include "log_index.h"
+#include "coarse_clock.h"
+
+// ----------------------------
+// Lector de los segmentos de servidor_rpc
+// ----------------------------
+//
+// Saca los registros como texto, con el mismo formato que imprimía
+// servidor_rpc: "usuario OPERACION dd/mm/yyyy hh:mm:ss". Con -f se queda
+// esperando registros nuevos (como tail -f), también en segmentos nuevos.
+//
+// Con -u, -o, -F o -T sólo saca los registros que encajan usando los
+// índices (log_index.h), sin recorrer todo. Con -r host:port la consulta
+// la hace servidor_rpc (QUERY_LOG), página a página.
+
+#define QUERY_PAGE 1000
+
+static const char* dir = "log_segments";
+static int show_seq = 0;
+static int follow = 0;
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [-d dir] [-s] [-f]\n", prog);
+    fprintf(stderr, "     %s [-d dir | -r host:port] [-s] [-u usuario] [-o operación] [-F desde] [-T hasta]\n", prog);
+    fprintf(stderr, "  -d dir   directorio de los segmentos (por defecto log_segments)\n");
+    fprintf(stderr, "  -s       muestra también el número de secuencia\n");
+    fprintf(stderr, "  -f       sigue esperando registros nuevos\n");
+    fprintf(stderr, "  -u       sólo ese usuario\n");
+    fprintf(stderr, "  -o       sólo ese verbo (PUBLISH) o prefijo (\"PUBLISH fichero\")\n");
+    fprintf(stderr, "  -F, -T   rango de horas \"dd/mm/yyyy hh:mm:ss\" (o segundos desde 1970)\n");
+    fprintf(stderr, "  -r       consulta a servidor_rpc en vez de leer el directorio\n");
+}
+
+// "dd/mm/yyyy[ hh:mm[:ss]]" en hora local, o segundos desde 1970. end = 1
+// para el límite superior: incluye todo el segundo (o el día).
+static int parse_time(const char* s, int end, uint64_t* out) {
+    char* rest;
+    long long secs = strtoll(s, &rest, 10);
+    if (*s && *rest == '\0') {
+        *out = (uint64_t)secs * 1000000ULL + (end ? 999999 : 0);
+        return 0;
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    long long span = 1;
+    const char* p = strptime(s, "%d/%m/%Y %H:%M:%S", &tm);
+    if (!p || *p) {
+        memset(&tm, 0, sizeof(tm));
+        span = 60;
+        p = strptime(s, "%d/%m/%Y %H:%M", &tm);
+    }
+    if (!p || *p) {
+        memset(&tm, 0, sizeof(tm));
+        span = 86400;
+        p = strptime(s, "%d/%m/%Y", &tm);
+    }
+    if (!p || *p) return -1;
+    tm.tm_isdst = -1;
+    secs = mktime(&tm);
+    *out = (uint64_t)secs * 1000000ULL + (end ? span * 1000000ULL - 1 : 0);
+    return 0;
+}
+
+static int is_segment(const struct dirent* d) {
+    return strncmp(d->d_name, "log-", 4) == 0 && strstr(d->d_name, ".seg") != NULL;
+}
+
+static void print_entry(const LogEntry* e) {
+    char when[32];
+    coarse_format(e->time_us, when, sizeof(when));
+    if (show_seq) printf("%llu ", (unsigned long long)e->seq);
+    printf("%.*s %.*s %s\n", e->user_len, e->user, e->op_len, e->operation, when);
+}
+
+// Imprime los registros completos de path a partir de *off (0 = desde la
+// cabecera) y deja *off tras el último. Devuelve -1 si hay un registro roto
+// antes del final del fichero.
+static int dump_segment(const char* path, size_t* off) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        perror(path);
+        return -1;
+    }
+
+    size_t size = st.st_size;
+    if (*off == 0) {
+        LogSegmentHeader header;
+        if (size < sizeof(header) || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            memcmp(header.magic, LOG_SEGMENT_MAGIC, sizeof(header.magic)) != 0) {
+            close(fd);
+            // Recién creado: la cabecera aún puede no estar
+            if (follow && size < sizeof(header)) return 0;
+            fprintf(stderr, "%s: no es un segmento de log\n", path);
+            return -1;
+        }
+        *off = sizeof(header);
+    }
+    if (size <= *off) {
+        close(fd);
+        return 0;
+    }
+
+    size_t len = size - *off;
+    char* data = malloc(len);
+    if (!data || pread(fd, data, len, *off) != (ssize_t)len) {
+        free(data);
+        close(fd);
+        perror(path);
+        return -1;
+    }
+    close(fd);
+
+    size_t pos = 0;
+    LogEntry e;
+    int r;
+    while ((r = log_segment_next(data, len, &pos, &e)) == 1) print_entry(&e);
+    free(data);
+    *off += pos;
+    return r < 0 ? -1 : 0;
+}
+
+// ----------------------------
+// Consultas
+// ----------------------------
+
+static int print_match(const LogEntry* e, void* ctx) {
+    print_entry(e);
+    (*(long*)ctx)++;
+    return 1;
+}
+
+static int query_remote(const char* server, const LogQuery* q) {
+    char host[256];
+    snprintf(host, sizeof(host), "%s", server);
+    char* colon = strrchr(host, ':');
+    if (!colon) return -1;
+    *colon = '\0';
+
+    struct hostent* he = gethostbyname(host);
+    if (!he) {
+        fprintf(stderr, "No se puede resolver %s\n", host);
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(colon + 1));
+    memcpy(&addr.sin_addr, he->h_addr_list[0], sizeof(addr.sin_addr));
+    int sock = RPC_ANYSOCK;
+    CLIENT* clnt = clnttcp_create(&addr, LOGPROG, LOGVERS, &sock, 0, 0);
+    if (!clnt) {
+        clnt_pcreateerror(server);
+        return -1;
+    }
+
+    log_query_args args;
+    args.user = (char*)(q->user ? q->user : "");
+    args.operation = (char*)(q->operation ? q->operation : "");
+    args.from = q->from_us;
+    args.to = q->to_us;
+    args.after_seq = 0;
+    args.limit = QUERY_PAGE;
+
+    int result = 0;
+    do {
+        log_query_result res;
+        memset(&res, 0, sizeof(res));
+        if (query_log_1(args, &res, clnt) != RPC_SUCCESS) {
+            clnt_perror(clnt, "QUERY_LOG");
+            result = -1;
+            break;
+        }
+        if (res.status != 0) {
+            fprintf(stderr, "QUERY_LOG: error en servidor_rpc\n");
+            result = -1;
+        }
+        for (u_int i = 0; i < res.records.records_len; i++) {
+            log_record* r = &res.records.records_val[i];
+            LogEntry e = { r->seq, r->timestamp, r->user, (uint16_t)strlen(r->user),
+                           r->operation, (uint16_t)strlen(r->operation) };
+            print_entry(&e);
+        }
+        args.after_seq = res.next_seq;
+        xdr_free((xdrproc_t)xdr_log_query_result, (char*)&res);
+    } while (args.after_seq != 0 && result == 0);
+
+    clnt_destroy(clnt);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    LogQuery q;
+    memset(&q, 0, sizeof(q));
+    const char* server = NULL;
+    int filtered = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:sfu:o:F:T:r:h")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 's': show_seq = 1; break;
+            case 'f': follow = 1; break;
+            case 'u': q.user = optarg; filtered = 1; break;
+            case 'o': q.operation = optarg; filtered = 1; break;
+            case 'F':
+            case 'T':
+                if (parse_time(optarg, opt == 'T', opt == 'F' ? &q.from_us : &q.to_us) < 0) {
+                    fprintf(stderr, "Hora no válida: %s\n", optarg);
+                    return 1;
+                }
+                filtered = 1;
+                break;
+            case 'r': server = optarg; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc || (follow && (filtered || server))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (server) return query_remote(server, &q) < 0 ? 1 : 0;
+    if (filtered) {
+        long found = 0;
+        if (log_index_query_dir(dir, NULL, &q, print_match, &found) < 0) {
+            perror(dir);
+            return 1;
+        }
+        return 0;
+    }
+
+    char current[800] = "";
+    size_t off = 0;
+
+    for (;;) {
+        struct dirent** names;
+        int n = scandir(dir, &names, is_segment, alphasort);
+        if (n < 0) {
+            perror(dir);
+            return 1;
+        }
+
+        for (int i = 0; i < n; i++) {
+            char path[800];
+            snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+            // Al seguir, se salta lo ya leído
+            if (current[0] && strcmp(path, current) < 0) continue;
+            if (strcmp(path, current) != 0) {
+                snprintf(current, sizeof(current), "%s", path);
+                off = 0;
+            }
+
+            // Un registro a medias al final del último segmento es normal
+            // mientras servidor_rpc sigue escribiendo
+            if (dump_segment(path, &off) < 0 && !(follow && i == n - 1)) {
+                fprintf(stderr, "%s: registro roto en el byte %zu, se salta el resto\n", path, off);
+            }
+        }
+        for (int i = 0; i < n; i++) free(names[i]);
+        free(names);
+
+        if (!follow) break;
+        fflush(stdout);
+        usleep(200 * 1000);
+    }
+    return 0;
+}
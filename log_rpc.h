@@ -18,10 +18,46 @@ extern "C" {
 struct log_action_args {
 	char *user;
 	char *operation;
-	char *timestamp;
+	u_quad_t timestamp;
 };
 typedef struct log_action_args log_action_args;
 
+struct log_batch_args {
+	struct {
+		u_int records_len;
+		log_action_args *records_val;
+	} records;
+};
+typedef struct log_batch_args log_batch_args;
+
+struct log_query_args {
+	char *user;
+	char *operation;
+	u_quad_t from;
+	u_quad_t to;
+	u_quad_t after_seq;
+	u_int limit;
+};
+typedef struct log_query_args log_query_args;
+
+struct log_record {
+	u_quad_t seq;
+	char *user;
+	char *operation;
+	u_quad_t timestamp;
+};
+typedef struct log_record log_record;
+
+struct log_query_result {
+	int status;
+	struct {
+		u_int records_len;
+		log_record *records_val;
+	} records;
+	u_quad_t next_seq;
+};
+typedef struct log_query_result log_query_result;
+
 #define LOGPROG 100495755
 #define LOGVERS 1
 
@@ -29,12 +65,24 @@ typedef struct log_action_args log_action_args;
 #define LOG_ACTION 1
 extern  enum clnt_stat log_action_1(log_action_args , void *, CLIENT *);
 extern  bool_t log_action_1_svc(log_action_args , void *, struct svc_req *);
+#define LOG_BATCH 2
+extern  enum clnt_stat log_batch_1(log_batch_args , void *, CLIENT *);
+extern  bool_t log_batch_1_svc(log_batch_args , void *, struct svc_req *);
+#define QUERY_LOG 3
+extern  enum clnt_stat query_log_1(log_query_args , log_query_result *, CLIENT *);
+extern  bool_t query_log_1_svc(log_query_args , log_query_result *, struct svc_req *);
 extern int logprog_1_freeresult (SVCXPRT *, xdrproc_t, caddr_t);
 
 #else /* K&R C */
 #define LOG_ACTION 1
 extern  enum clnt_stat log_action_1();
 extern  bool_t log_action_1_svc();
+#define LOG_BATCH 2
+extern  enum clnt_stat log_batch_1();
+extern  bool_t log_batch_1_svc();
+#define QUERY_LOG 3
+extern  enum clnt_stat query_log_1();
+extern  bool_t query_log_1_svc();
 extern int logprog_1_freeresult ();
 #endif /* K&R C */
 
@@ -42,9 +90,17 @@ extern int logprog_1_freeresult ();
 
 #if defined(__STDC__) || defined(__cplusplus)
 extern  bool_t xdr_log_action_args (XDR *, log_action_args*);
+extern  bool_t xdr_log_batch_args (XDR *, log_batch_args*);
+extern  bool_t xdr_log_query_args (XDR *, log_query_args*);
+extern  bool_t xdr_log_record (XDR *, log_record*);
+extern  bool_t xdr_log_query_result (XDR *, log_query_result*);
 
 #else /* K&R C */
 extern bool_t xdr_log_action_args ();
+extern bool_t xdr_log_batch_args ();
+extern bool_t xdr_log_query_args ();
+extern bool_t xdr_log_record ();
+extern bool_t xdr_log_query_result ();
 
 #endif /* K&R C */
 
@@ -1,12 +1,41 @@
-
 struct log_action_args {
     string user<256>;       
     string operation<512>;   
-    string timestamp<32>;   
+    unsigned hyper timestamp;   /* Microsegundos desde 1970 (UTC), lo pone el servidor */
+};
+
+/* Lote de registros enviados en una sola llamada */
+struct log_batch_args {
+    log_action_args records<>;
+};
+
+/* Consulta sobre el log guardado (QUERY_LOG). Cadenas vacías y 0 = sin filtro */
+struct log_query_args {
+    string user<256>;           /* Usuario exacto */
+    string operation<512>;      /* Verbo (PUBLISH) o prefijo que empieza por él */
+    unsigned hyper from;        /* Microsegundos desde 1970, inclusivo */
+    unsigned hyper to;          /* Inclusivo */
+    unsigned hyper after_seq;   /* Sólo registros posteriores (para pedir la página siguiente) */
+    unsigned int limit;         /* Máximo de registros en la respuesta */
+};
+
+struct log_record {
+    unsigned hyper seq;
+    string user<256>;
+    string operation<512>;
+    unsigned hyper timestamp;
+};
+
+struct log_query_result {
+    int status;                 /* 0 = OK, -1 = error */
+    log_record records<>;       /* En orden de seq */
+    unsigned hyper next_seq;    /* after_seq de la página siguiente, 0 si no hay más */
 };
 
 program LOGPROG {
     version LOGVERS {
         void LOG_ACTION(log_action_args) = 1;
+        void LOG_BATCH(log_batch_args) = 2;
+        log_query_result QUERY_LOG(log_query_args) = 3;
     } = 1;
 } = 100495755;
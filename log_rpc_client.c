@@ -14,6 +14,12 @@ logprog_1(char *host)
 	enum clnt_stat retval_1;
 	void *result_1;
 	log_action_args log_action_1_arg1;
+	enum clnt_stat retval_2;
+	void *result_2;
+	log_batch_args log_batch_1_arg1;
+	enum clnt_stat retval_3;
+	log_query_result result_3;
+	log_query_args query_log_1_arg1;
 
 #ifndef	DEBUG
 	clnt = clnt_create (host, LOGPROG, LOGVERS, "udp");
@@ -27,6 +33,14 @@ logprog_1(char *host)
 	if (retval_1 != RPC_SUCCESS) {
 		clnt_perror (clnt, "call failed");
 	}
+	retval_2 = log_batch_1(log_batch_1_arg1, &result_2, clnt);
+	if (retval_2 != RPC_SUCCESS) {
+		clnt_perror (clnt, "call failed");
+	}
+	retval_3 = query_log_1(query_log_1_arg1, &result_3, clnt);
+	if (retval_3 != RPC_SUCCESS) {
+		clnt_perror (clnt, "call failed");
+	}
 #ifndef	DEBUG
 	clnt_destroy (clnt);
 #endif	 /* DEBUG */
@@ -17,3 +17,21 @@ log_action_1(log_action_args arg1, void *clnt_res,  CLIENT *clnt)
 		(xdrproc_t) xdr_void, (caddr_t) clnt_res,
 		TIMEOUT));
 }
+
+enum clnt_stat 
+log_batch_1(log_batch_args arg1, void *clnt_res,  CLIENT *clnt)
+{
+	return (clnt_call(clnt, LOG_BATCH,
+		(xdrproc_t) xdr_log_batch_args, (caddr_t) &arg1,
+		(xdrproc_t) xdr_void, (caddr_t) clnt_res,
+		TIMEOUT));
+}
+
+enum clnt_stat 
+query_log_1(log_query_args arg1, log_query_result *clnt_res,  CLIENT *clnt)
+{
+	return (clnt_call(clnt, QUERY_LOG,
+		(xdrproc_t) xdr_log_query_args, (caddr_t) &arg1,
+		(xdrproc_t) xdr_log_query_result, (caddr_t) clnt_res,
+		TIMEOUT));
+}
@@ -18,6 +18,30 @@ log_action_1_svc(log_action_args arg1, void *result,  struct svc_req *rqstp)
 	return retval;
 }
 
+bool_t
+log_batch_1_svc(log_batch_args arg1, void *result,  struct svc_req *rqstp)
+{
+	bool_t retval;
+
+	/*
+	 * insert server code here
+	 */
+
+	return retval;
+}
+
+bool_t
+query_log_1_svc(log_query_args arg1, log_query_result *result,  struct svc_req *rqstp)
+{
+	bool_t retval;
+
+	/*
+	 * insert server code here
+	 */
+
+	return retval;
+}
+
 int
 logprog_1_freeresult (SVCXPRT *transp, xdrproc_t xdr_result, caddr_t result)
 {
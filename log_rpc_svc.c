@@ -22,13 +22,28 @@ _log_action_1 (log_action_args  *argp, void *result, struct svc_req *rqstp)
 	return (log_action_1_svc(*argp, result, rqstp));
 }
 
+int
+_log_batch_1 (log_batch_args  *argp, void *result, struct svc_req *rqstp)
+{
+	return (log_batch_1_svc(*argp, result, rqstp));
+}
+
+int
+_query_log_1 (log_query_args  *argp, void *result, struct svc_req *rqstp)
+{
+	return (query_log_1_svc(*argp, result, rqstp));
+}
+
 static void
 logprog_1(struct svc_req *rqstp, register SVCXPRT *transp)
 {
 	union {
 		log_action_args log_action_1_arg;
+		log_batch_args log_batch_1_arg;
+		log_query_args query_log_1_arg;
 	} argument;
 	union {
+		log_query_result query_log_1_res;
 	} result;
 	bool_t retval;
 	xdrproc_t _xdr_argument, _xdr_result;
@@ -45,6 +60,18 @@ logprog_1(struct svc_req *rqstp, register SVCXPRT *transp)
 		local = (bool_t (*) (char *, void *,  struct svc_req *))_log_action_1;
 		break;
 
+	case LOG_BATCH:
+		_xdr_argument = (xdrproc_t) xdr_log_batch_args;
+		_xdr_result = (xdrproc_t) xdr_void;
+		local = (bool_t (*) (char *, void *,  struct svc_req *))_log_batch_1;
+		break;
+
+	case QUERY_LOG:
+		_xdr_argument = (xdrproc_t) xdr_log_query_args;
+		_xdr_result = (xdrproc_t) xdr_log_query_result;
+		local = (bool_t (*) (char *, void *,  struct svc_req *))_query_log_1;
+		break;
+
 	default:
 		svcerr_noproc (transp);
 		return;
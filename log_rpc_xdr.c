@@ -14,7 +14,69 @@ xdr_log_action_args (XDR *xdrs, log_action_args *objp)
 		 return FALSE;
 	 if (!xdr_string (xdrs, &objp->operation, 512))
 		 return FALSE;
-	 if (!xdr_string (xdrs, &objp->timestamp, 32))
+	 if (!xdr_u_quad_t (xdrs, &objp->timestamp))
+		 return FALSE;
+	return TRUE;
+}
+
+bool_t
+xdr_log_batch_args (XDR *xdrs, log_batch_args *objp)
+{
+	register int32_t *buf;
+
+	 if (!xdr_array (xdrs, (char **)&objp->records.records_val, (u_int *) &objp->records.records_len, ~0,
+		sizeof (log_action_args), (xdrproc_t) xdr_log_action_args))
+		 return FALSE;
+	return TRUE;
+}
+
+bool_t
+xdr_log_query_args (XDR *xdrs, log_query_args *objp)
+{
+	register int32_t *buf;
+
+	 if (!xdr_string (xdrs, &objp->user, 256))
+		 return FALSE;
+	 if (!xdr_string (xdrs, &objp->operation, 512))
+		 return FALSE;
+	 if (!xdr_u_quad_t (xdrs, &objp->from))
+		 return FALSE;
+	 if (!xdr_u_quad_t (xdrs, &objp->to))
+		 return FALSE;
+	 if (!xdr_u_quad_t (xdrs, &objp->after_seq))
+		 return FALSE;
+	 if (!xdr_u_int (xdrs, &objp->limit))
+		 return FALSE;
+	return TRUE;
+}
+
+bool_t
+xdr_log_record (XDR *xdrs, log_record *objp)
+{
+	register int32_t *buf;
+
+	 if (!xdr_u_quad_t (xdrs, &objp->seq))
+		 return FALSE;
+	 if (!xdr_string (xdrs, &objp->user, 256))
+		 return FALSE;
+	 if (!xdr_string (xdrs, &objp->operation, 512))
+		 return FALSE;
+	 if (!xdr_u_quad_t (xdrs, &objp->timestamp))
+		 return FALSE;
+	return TRUE;
+}
+
+bool_t
+xdr_log_query_result (XDR *xdrs, log_query_result *objp)
+{
+	register int32_t *buf;
+
+	 if (!xdr_int (xdrs, &objp->status))
+		 return FALSE;
+	 if (!xdr_array (xdrs, (char **)&objp->records.records_val, (u_int *) &objp->records.records_len, ~0,
+		sizeof (log_record), (xdrproc_t) xdr_log_record))
+		 return FALSE;
+	 if (!xdr_u_quad_t (xdrs, &objp->next_seq))
 		 return FALSE;
 	return TRUE;
 }
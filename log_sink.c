@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "log_sink.h"
+#include "log_index.h"
+#include "crc32.h"
+
+#define SINK_BUFFER     (1 << 20)    // Se escribe al llenarse (o al volcar)
+#define MAX_FIELD       0xFFFF       // user_len y op_len son u16
+
+static pthread_mutex_t sink_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sink_cv = PTHREAD_COND_INITIALIZER;
+
+static LogSinkConfig config;
+static char sink_dir[512];
+static int sink_fd = -1;
+static int running = 0;
+static int stopping = 0;
+static pthread_t flusher;
+
+static char* buf = NULL;
+static size_t buf_len = 0;
+
+static uint64_t segment_size = 0;      // Bytes del segmento actual (incluido lo que hay en buf)
+static uint64_t segment_created = 0;   // Microsegundos
+static uint64_t next_seq = 1;
+static uint64_t synced_seq = 0;        // Último seq con fdatasync hecho (o perdido)
+static uint64_t buf_first_seq = 0;     // seq del primer registro de buf
+static char segment_path[800];
+static LogIndexBuilder* seg_index = NULL;  // Índice del segmento en curso (log_index.h)
+
+static LogSinkStats stats;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static unsigned long env_or(const char* name, unsigned long def) {
+    const char* v = getenv(name);
+    return v && *v ? strtoul(v, NULL, 10) : def;
+}
+
+void log_sink_config_env(LogSinkConfig* cfg) {
+    const char* dir = getenv("LOG_DIR");
+    cfg->dir = dir && *dir ? dir : "log_segments";
+    cfg->segment_bytes = (uint64_t)env_or("LOG_SEGMENT_MB", 64) << 20;
+    cfg->segment_secs = (unsigned)env_or("LOG_SEGMENT_SECS", 3600);
+    cfg->fsync_ms = (unsigned)env_or("LOG_FSYNC_MS", 100);
+    cfg->fsync_records = (unsigned)env_or("LOG_FSYNC_RECORDS", 0);
+}
+
+// ----------------------------
+// Segmentos
+// ----------------------------
+
+static int is_segment(const struct dirent* d) {
+    return strncmp(d->d_name, "log-", 4) == 0 && strstr(d->d_name, ".seg") != NULL;
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Tras un error de escritura: el segmento se corta en good (el final del
+// último registro entero) y se cierra sin .idx, que tendría posiciones de lo
+// perdido (se reconstruye al consultar). Detrás de un registro a medias
+// log_segment_next ya no vería nada, así que no se sigue escribiendo en él:
+// el flusher abre otro. Requiere sink_mutex.
+static void abandon_segment(uint64_t good) {
+    if (ftruncate(sink_fd, good) == 0) fdatasync(sink_fd);
+    close(sink_fd);
+    sink_fd = -1;
+    log_index_builder_free(seg_index);
+    seg_index = NULL;
+    synced_seq = next_seq - 1;
+}
+
+// Escribe el buffer en el segmento (sin fdatasync). Requiere sink_mutex.
+static void write_buffer(void) {
+    if (buf_len == 0) return;
+    if (write_all(sink_fd, buf, buf_len) < 0) {
+        perror("log_sink: fallo al escribir, se pierden registros");
+        stats.lost += next_seq - buf_first_seq;
+        abandon_segment(segment_size - buf_len);
+    } else {
+        stats.bytes += buf_len;
+    }
+    buf_len = 0;
+}
+
+// Volcado completo con fdatasync. Requiere sink_mutex.
+static void sync_locked(void) {
+    write_buffer();
+    if (sink_fd < 0 || synced_seq == next_seq - 1) return;
+    fdatasync(sink_fd);
+    stats.fsyncs++;
+    synced_seq = next_seq - 1;
+}
+
+static int open_segment(void) {
+    char path[800];
+    snprintf(path, sizeof(path), "%s/log-%016llx.seg", sink_dir, (unsigned long long)next_seq);
+    LogIndexBuilder* b = log_index_builder_new();
+    int fd = b ? open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644) : -1;
+    if (fd < 0) {
+        log_index_builder_free(b);
+        return -1;
+    }
+
+    LogSegmentHeader header;
+    memcpy(header.magic, LOG_SEGMENT_MAGIC, sizeof(header.magic));
+    header.first_seq = next_seq;
+    header.created_us = now_us();
+    if (write_all(fd, (const char*)&header, sizeof(header)) < 0) {
+        close(fd);
+        log_index_builder_free(b);
+        return -1;
+    }
+
+    int dfd = open(sink_dir, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+
+    sink_fd = fd;
+    seg_index = b;
+    snprintf(segment_path, sizeof(segment_path), "%s", path);
+    segment_size = sizeof(header);
+    segment_created = header.created_us;
+    stats.segments++;
+    stats.bytes += sizeof(header);
+    return 0;
+}
+
+// Cierra el segmento actual (en disco entero, con su .idx). Requiere sink_mutex.
+static void close_segment(void) {
+    if (sink_fd < 0) return;
+    sync_locked();
+    if (sink_fd < 0) return; // Ha fallado la escritura: ya está cerrado
+    close(sink_fd);
+    sink_fd = -1;
+
+    // Si no se puede escribir el .idx se reconstruye al consultar
+    char idx_path[800];
+    snprintf(idx_path, sizeof(idx_path), "%.*s.idx", (int)(strlen(segment_path) - 4), segment_path);
+    log_index_write(seg_index, segment_size, idx_path);
+    log_index_builder_free(seg_index);
+    seg_index = NULL;
+}
+
+// Cierra el segmento actual y abre el siguiente. Requiere sink_mutex.
+static void rotate_locked(void) {
+    close_segment();
+    if (open_segment() < 0) perror("log_sink: no se puede abrir un segmento nuevo");
+}
+
+// Sigue la numeración del último segmento que haya en el directorio
+static uint64_t recover_next_seq(void) {
+    struct dirent** names;
+    int n = scandir(sink_dir, &names, is_segment, alphasort);
+    if (n <= 0) return 1;
+
+    char path[800];
+    snprintf(path, sizeof(path), "%s/%s", sink_dir, names[n - 1]->d_name);
+    for (int i = 0; i < n; i++) free(names[i]);
+    free(names);
+
+    uint64_t next = 1;
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(LogSegmentHeader)) {
+        if (fd >= 0) close(fd);
+        return next;
+    }
+    char* data = malloc(st.st_size);
+    if (data && read(fd, data, st.st_size) == st.st_size) {
+        LogSegmentHeader header;
+        memcpy(&header, data, sizeof(header));
+        next = header.first_seq;
+
+        size_t off = sizeof(header);
+        LogEntry e;
+        while (log_segment_next(data, st.st_size, &off, &e) == 1) next = e.seq + 1;
+    }
+    free(data);
+    close(fd);
+    return next;
+}
+
+// ----------------------------
+// Escritura
+// ----------------------------
+
+// Añade un registro al buffer. Requiere sink_mutex.
+static void append_locked(const char* user, const char* operation, uint64_t time_us) {
+    size_t user_len = strnlen(user, MAX_FIELD);
+    size_t op_len = strnlen(operation, MAX_FIELD);
+    size_t payload = LOG_RECORD_FIXED + user_len + op_len;
+    size_t total = LOG_RECORD_HEADER + payload;
+
+    if (buf_len + total > SINK_BUFFER) write_buffer();
+
+    // Sin segmento (no se pudo abrir o falló la escritura) hasta que el
+    // flusher consiga otro: el registro se pierde sin gastar seq
+    if (sink_fd < 0) {
+        stats.lost++;
+        return;
+    }
+
+    char* rec = buf + buf_len;
+    char* p = rec + LOG_RECORD_HEADER;
+    if (buf_len == 0) buf_first_seq = next_seq;
+    uint64_t seq = next_seq++;
+    LogEntry e = { seq, time_us, user, (uint16_t)user_len, operation, (uint16_t)op_len };
+    if (seg_index) log_index_add(seg_index, segment_size, &e);
+    uint16_t ulen = (uint16_t)user_len, olen = (uint16_t)op_len;
+    memcpy(p, &seq, 8);
+    memcpy(p + 8, &time_us, 8);
+    memcpy(p + 16, &ulen, 2);
+    memcpy(p + 18, &olen, 2);
+    memcpy(p + LOG_RECORD_FIXED, user, user_len);
+    memcpy(p + LOG_RECORD_FIXED + user_len, operation, op_len);
+
+    uint32_t len32 = (uint32_t)payload;
+    uint32_t crc = crc32_update(0, p, payload);
+    memcpy(rec, &len32, 4);
+    memcpy(rec + 4, &crc, 4);
+
+    buf_len += total;
+    segment_size += total;
+    stats.records++;
+
+    if (config.fsync_records && next_seq - 1 - synced_seq >= config.fsync_records) sync_locked();
+    if (segment_size >= config.segment_bytes) rotate_locked();
+}
+
+void log_sink_append(const char* user, const char* operation, uint64_t time_us) {
+    LogSinkRecord rec = { user, operation, time_us };
+    log_sink_append_batch(&rec, 1);
+}
+
+void log_sink_append_batch(const LogSinkRecord* recs, size_t n) {
+    pthread_mutex_lock(&sink_mutex);
+    if (!running) {
+        pthread_mutex_unlock(&sink_mutex);
+        return;
+    }
+    for (size_t i = 0; i < n; i++) append_locked(recs[i].user, recs[i].operation, recs[i].time_us);
+    if (config.fsync_ms == 0) sync_locked();
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+void log_sink_sync(void) {
+    pthread_mutex_lock(&sink_mutex);
+    if (running) sync_locked();
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+// Volcado periódico y rotación por tiempo
+static void* flusher_thread(void* arg) {
+    unsigned period_ms = config.fsync_ms ? config.fsync_ms : 1000;
+
+    pthread_mutex_lock(&sink_mutex);
+    while (!stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += period_ms / 1000;
+        deadline.tv_nsec += (long)(period_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&sink_cv, &sink_mutex, &deadline);
+        if (stopping) break;
+
+        // Reintento tras un error de escritura o de rotación
+        if (sink_fd < 0 && open_segment() < 0) continue;
+
+        if (config.segment_secs && segment_size > sizeof(LogSegmentHeader) &&
+            now_us() - segment_created >= (uint64_t)config.segment_secs * 1000000ULL) {
+            rotate_locked();
+            continue;
+        }
+
+        // write() con el lock; el fdatasync fuera, sobre un duplicado del
+        // descriptor por si entretanto se rota el segmento. Hasta que acaba
+        // no cuenta como hecho: log_sink_sync no debe volver antes.
+        write_buffer();
+        if (sink_fd < 0 || synced_seq == next_seq - 1) continue;
+        uint64_t target = next_seq - 1;
+        int fd = dup(sink_fd);
+        pthread_mutex_unlock(&sink_mutex);
+
+        int synced = fd >= 0 && fdatasync(fd) == 0;
+        if (fd >= 0) close(fd);
+
+        pthread_mutex_lock(&sink_mutex);
+        stats.fsyncs++;
+        if (synced && target > synced_seq) synced_seq = target;
+    }
+    pthread_mutex_unlock(&sink_mutex);
+    return NULL;
+}
+
+int log_sink_open(const LogSinkConfig* cfg) {
+    config = *cfg;
+    if (config.segment_bytes < 4096) config.segment_bytes = 4096;
+    if (config.segment_bytes > (3ULL << 30)) config.segment_bytes = 3ULL << 30; // Posiciones de 32 bits en el .idx
+    snprintf(sink_dir, sizeof(sink_dir), "%s", cfg->dir);
+    config.dir = sink_dir;
+
+    if (mkdir(sink_dir, 0755) < 0 && errno != EEXIST) return -1;
+    if (!buf) buf = malloc(SINK_BUFFER);
+    if (!buf) return -1;
+
+    pthread_mutex_lock(&sink_mutex);
+    next_seq = recover_next_seq();
+    synced_seq = next_seq - 1;
+    int result = open_segment();
+    if (result == 0) {
+        stopping = 0;
+        running = 1;
+    }
+    pthread_mutex_unlock(&sink_mutex);
+    if (result < 0) return -1;
+
+    if (pthread_create(&flusher, NULL, flusher_thread, NULL) != 0) return -1;
+    return 0;
+}
+
+void log_sink_close(void) {
+    pthread_mutex_lock(&sink_mutex);
+    if (!running) {
+        pthread_mutex_unlock(&sink_mutex);
+        return;
+    }
+    stopping = 1;
+    pthread_cond_signal(&sink_cv);
+    pthread_mutex_unlock(&sink_mutex);
+    pthread_join(flusher, NULL);
+
+    pthread_mutex_lock(&sink_mutex);
+    close_segment();
+    running = 0;
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+void log_sink_stats(LogSinkStats* out) {
+    pthread_mutex_lock(&sink_mutex);
+    *out = stats;
+    out->next_seq = next_seq;
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+// ----------------------------
+// Consultas (log_index.h)
+// ----------------------------
+
+// Los segmentos cerrados con sus .idx; el abierto con una copia de su índice
+// hecha con el lock, para no parar la ingesta mientras se lee
+int log_sink_query(const LogQuery* q, LogQueryFn fn, void* ctx) {
+    char active[800];
+    LogIndexSnapshot snap;
+
+    pthread_mutex_lock(&sink_mutex);
+    if (running) write_buffer();
+    if (!running || !seg_index) {
+        pthread_mutex_unlock(&sink_mutex);
+        return -1;
+    }
+    snprintf(active, sizeof(active), "%s", segment_path);
+    log_index_snapshot(seg_index, segment_size, q->user, &snap);
+    pthread_mutex_unlock(&sink_mutex);
+
+    int result = log_index_query_dir(sink_dir, active, q, fn, ctx);
+    if (result == 0) result = log_index_query_snapshot(active, &snap, q, fn, ctx);
+    log_index_snapshot_free(&snap);
+    return result < 0 ? -1 : 0;
+}
+
+// ----------------------------
+// Lectura
+// ----------------------------
+
+int log_segment_next(const char* data, size_t size, size_t* off, LogEntry* out) {
+    if (*off == size) return 0;
+    if (*off + LOG_RECORD_HEADER > size) return -1;
+
+    uint32_t len, crc;
+    memcpy(&len, data + *off, 4);
+    memcpy(&crc, data + *off + 4, 4);
+    if (len < LOG_RECORD_FIXED || *off + LOG_RECORD_HEADER + len > size) return -1;
+
+    const char* p = data + *off + LOG_RECORD_HEADER;
+    if (crc32_update(0, p, len) != crc) return -1;
+
+    memcpy(&out->seq, p, 8);
+    memcpy(&out->time_us, p + 8, 8);
+    memcpy(&out->user_len, p + 16, 2);
+    memcpy(&out->op_len, p + 18, 2);
+    if ((size_t)LOG_RECORD_FIXED + out->user_len + out->op_len != len) return -1;
+    out->user = p + LOG_RECORD_FIXED;
+    out->operation = out->user + out->user_len;
+
+    *off += LOG_RECORD_HEADER + len;
+    return 1;
+}
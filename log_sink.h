@@ -0,0 +1,92 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ----------------------------
+// Sumidero de registros de auditoría de servidor_rpc
+// ----------------------------
+//
+// Los registros se acumulan en un buffer y se escriben de una vez en
+// segmentos binarios de sólo-añadir. Un hilo de fondo vuelca el buffer y
+// hace fdatasync cada fsync_ms (o cada fsync_records registros), y rota
+// el segmento cuando pasa de segment_bytes o de segment_secs.
+//
+// Fichero log-<primer seq en hex>.seg:
+//   cabecera LogSegmentHeader
+//   registros [u32 len][u32 crc][u64 seq][u64 time_us][u16 user_len][u16 op_len] user op
+// len cuenta lo que va tras el crc; el crc cubre esos len bytes. Un
+// registro roto marca el final del segmento (caída a mitad de escritura).
+// Cada arranque abre un segmento nuevo, así nunca se escribe tras basura; si
+// falla una escritura, el segmento se corta en el último registro entero y
+// se sigue en otro (lo que estaba en el buffer se pierde).
+
+#define LOG_SEGMENT_MAGIC   "P2PLOG01"
+#define LOG_RECORD_HEADER   8          // len + crc
+#define LOG_RECORD_FIXED    20         // seq + time_us + user_len + op_len
+
+typedef struct {
+    char magic[8];
+    uint64_t first_seq;      // seq del primer registro del segmento
+    uint64_t created_us;     // Hora de creación (microsegundos desde 1970)
+} LogSegmentHeader;
+
+typedef struct {
+    const char* dir;          // Directorio de los segmentos
+    uint64_t segment_bytes;   // Rotar al pasar de este tamaño
+    unsigned segment_secs;    // Rotar al pasar de esta edad (0 = nunca)
+    unsigned fsync_ms;        // Volcado + fdatasync periódico (0 = en cada lote)
+    unsigned fsync_records;   // Volcar también al juntar tantos registros (0 = no)
+} LogSinkConfig;
+
+typedef struct {
+    uint64_t records;         // Registros aceptados
+    uint64_t bytes;           // Bytes escritos en segmentos
+    uint64_t fsyncs;
+    uint64_t segments;        // Segmentos abiertos desde el arranque
+    uint64_t lost;            // Registros perdidos por errores de escritura
+    uint64_t next_seq;
+} LogSinkStats;
+
+// Rellena cfg con los valores por defecto y lo que digan las variables
+// LOG_DIR, LOG_SEGMENT_MB, LOG_SEGMENT_SECS, LOG_FSYNC_MS y LOG_FSYNC_RECORDS
+void log_sink_config_env(LogSinkConfig* cfg);
+
+int log_sink_open(const LogSinkConfig* cfg);
+void log_sink_close(void);
+
+// Añade registros. Varios hilos pueden llamarlo: se serializan dentro.
+void log_sink_append(const char* user, const char* operation, uint64_t time_us);
+
+// Igual, para un lote entero con una sola toma del lock
+typedef struct {
+    const char* user;
+    const char* operation;
+    uint64_t time_us;
+} LogSinkRecord;
+void log_sink_append_batch(const LogSinkRecord* recs, size_t n);
+
+// Fuerza el volcado y el fdatasync de lo pendiente
+void log_sink_sync(void);
+
+void log_sink_stats(LogSinkStats* out);
+
+// ----------------------------
+// Lectura (log_reader y consultas)
+// ----------------------------
+
+typedef struct {
+    uint64_t seq;
+    uint64_t time_us;
+    const char* user;         // Apuntan dentro del segmento leído (sin \0)
+    uint16_t user_len;
+    const char* operation;
+    uint16_t op_len;
+} LogEntry;
+
+// Decodifica el registro en data[*off]. 1 si hay uno válido (y avanza *off),
+// 0 si se acaba el segmento, -1 si está roto.
+int log_segment_next(const char* data, size_t size, size_t* off, LogEntry* out);
+
+#endif
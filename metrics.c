@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "metrics.h"
+#include "registry.h"
+#include "wal.h"
+
+static const char* op_names[METRIC_OPS] = {
+    "REGISTER", "UNREGISTER", "CONNECT", "DISCONNECT", "PUBLISH",
+    "DELETE", "LIST_USERS", "LIST_CONTENT", "SEARCH", "GET_FILE",
+    "WATCH_USERS", "GET_FILES", "PUBLISH_BATCH", "DELETE_BATCH",
+    "HEARTBEAT", "STATS", "OTHER"
+};
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+typedef struct {
+    _Atomic uint64_t results[METRIC_RESULTS];
+    Histogram latency;
+} OpMetrics;
+
+// Todo lo que escribe un hilo. Sólo lo modifica su dueño; los lectores
+// suman con cargas relajadas y pueden ver una petición a medio apuntar.
+typedef struct MetricsShard {
+    OpMetrics ops[METRIC_OPS];
+    Histogram lock_wait;
+    Histogram lock_hold;
+    _Atomic uint64_t lock_contended;
+    struct MetricsShard* next;
+} MetricsShard;
+
+static MetricsShard* _Atomic shards = NULL;
+static _Atomic size_t shard_count = 0;
+static __thread MetricsShard* my_shard = NULL;
+static __thread uint64_t hold_start = 0;
+
+static _Atomic int64_t connections_active = 0;
+static _Atomic uint64_t connections_total = 0;
+static int event_loops = 0;
+
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static MetricsShard* shard(void) {
+    if (my_shard) return my_shard;
+
+    MetricsShard* s = calloc(1, sizeof(MetricsShard));
+    if (!s) abort();
+    s->next = atomic_load(&shards);
+    while (!atomic_compare_exchange_weak(&shards, &s->next, s)) { }
+    atomic_fetch_add(&shard_count, 1);
+    my_shard = s;
+    return s;
+}
+
+// Incremento de un contador del que este hilo es el único escritor
+static inline void bump(_Atomic uint64_t* c, uint64_t n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// ----------------------------
+// Histogramas
+// ----------------------------
+
+static int bucket_of(uint64_t v) {
+    if (v >= (1ULL << HIST_MAX_BITS)) v = (1ULL << HIST_MAX_BITS) - 1;
+    if (v < HIST_SUB) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB + (int)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+// Valor representativo (punto medio) de un cubo
+static uint64_t bucket_value(int idx) {
+    if (idx < HIST_SUB) return idx;
+    int shift = idx / HIST_SUB - 1;
+    uint64_t low = (uint64_t)(HIST_SUB + idx % HIST_SUB) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+static void hist_add(Histogram* h, uint64_t v) {
+    bump(&h->count, 1);
+    bump(&h->sum_ns, v);
+    if (v > atomic_load_explicit(&h->max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max_ns, v, memory_order_relaxed);
+    }
+    bump(&h->buckets[bucket_of(v)], 1);
+}
+
+// Suma el histograma de un shard en un acumulador local
+typedef struct {
+    uint64_t count, sum_ns, max_ns;
+    uint64_t buckets[HIST_BUCKETS];
+} HistTotal;
+
+static void hist_merge(HistTotal* t, Histogram* h) {
+    t->count += atomic_load_explicit(&h->count, memory_order_relaxed);
+    t->sum_ns += atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    if (max > t->max_ns) t->max_ns = max;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        t->buckets[i] += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+}
+
+static uint64_t hist_percentile(const HistTotal* t, double p) {
+    uint64_t total = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) total += t->buckets[i];
+    if (total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(p * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += t->buckets[i];
+        if (seen >= rank) {
+            uint64_t v = bucket_value(i);
+            return v < t->max_ns ? v : t->max_ns;
+        }
+    }
+    return t->max_ns;
+}
+
+// ----------------------------
+// Puntos de medida
+// ----------------------------
+
+MetricOp metrics_op(const char* name) {
+    if (strcmp(name, "LIST_CONTENT_PAGE") == 0) return MOP_LIST_CONTENT; // Misma operación, por páginas
+    if (strcmp(name, "PUBLISH_CONTENT") == 0) return MOP_PUBLISH;        // Con hash
+    if (strcmp(name, "GET_SOURCES") == 0) return MOP_GET_FILE;           // Todas las fuentes
+    for (int i = 0; i < MOP_OTHER; i++) {
+        if (strcmp(name, op_names[i]) == 0) return (MetricOp)i;
+    }
+    return MOP_OTHER;
+}
+
+void metrics_request(MetricOp op, int result, uint64_t elapsed_ns) {
+    OpMetrics* m = &shard()->ops[op];
+    int code = result >= 0 && result < METRIC_RESULTS - 1 ? result : METRIC_RESULTS - 1;
+    bump(&m->results[code], 1);
+    hist_add(&m->latency, elapsed_ns);
+}
+
+void metrics_lock(pthread_mutex_t* mutex) {
+    MetricsShard* s = shard();
+    if (pthread_mutex_trylock(mutex) == 0) {
+        hold_start = metrics_now_ns();
+        hist_add(&s->lock_wait, 0);
+        return;
+    }
+
+    uint64_t t0 = metrics_now_ns();
+    pthread_mutex_lock(mutex);
+    hold_start = metrics_now_ns();
+    bump(&s->lock_contended, 1);
+    hist_add(&s->lock_wait, hold_start - t0);
+}
+
+void metrics_unlock(pthread_mutex_t* mutex) {
+    uint64_t held = metrics_now_ns() - hold_start;
+    pthread_mutex_unlock(mutex);
+    hist_add(&shard()->lock_hold, held);
+}
+
+void metrics_conn_opened(void) {
+    atomic_fetch_add_explicit(&connections_active, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&connections_total, 1, memory_order_relaxed);
+}
+
+void metrics_conn_closed(void) {
+    atomic_fetch_sub_explicit(&connections_active, 1, memory_order_relaxed);
+}
+
+void metrics_set_event_loops(int n) {
+    event_loops = n;
+}
+
+// ----------------------------
+// Volcado en texto
+// ----------------------------
+
+void metrics_printf(MetricsText* t, const char* fmt, ...) {
+    va_list ap;
+    while (1) {
+        size_t room = t->cap - t->len;
+        va_start(ap, fmt);
+        int n = vsnprintf(t->data ? t->data + t->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < room) {
+            t->len += n;
+            return;
+        }
+        size_t new_cap = t->cap ? t->cap * 2 : 16384;
+        while (new_cap - t->len <= (size_t)n) new_cap *= 2;
+        char* bigger = realloc(t->data, new_cap);
+        if (!bigger) return; // Sin memoria: el texto se trunca
+        t->data = bigger;
+        t->cap = new_cap;
+    }
+}
+
+static void render_hist(MetricsText* t, const char* name, const char* labels, const HistTotal* h) {
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+    char braces[96] = "";
+    if (labels[0]) snprintf(braces, sizeof(braces), "{%s}", labels);
+    const char* sep = labels[0] ? "," : "";
+
+    for (int i = 0; i < 3; i++) {
+        metrics_printf(t, "%s_us{%s%squantile=\"%g\"} %.1f\n", name, labels, sep, quantiles[i],
+                       hist_percentile(h, quantiles[i]) / 1e3);
+    }
+    metrics_printf(t, "%s_us_max%s %.1f\n", name, braces, h->max_ns / 1e3);
+    metrics_printf(t, "%s_us_sum%s %.1f\n", name, braces, h->sum_ns / 1e3);
+    metrics_printf(t, "%s_count%s %llu\n", name, braces, (unsigned long long)h->count);
+}
+
+// Hilos del proceso según /proc (incluye los de WAL, auditoría, etc.)
+static long process_threads(void) {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (!f) return -1;
+    char line[256];
+    long threads = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Threads: %ld", &threads) == 1) break;
+    }
+    fclose(f);
+    return threads;
+}
+
+void metrics_render(MetricsText* t) {
+    HistTotal* h = malloc(sizeof(HistTotal));
+    if (!h) return;
+
+    // Peticiones por operación
+    for (int op = 0; op < METRIC_OPS; op++) {
+        memset(h, 0, sizeof(*h));
+        uint64_t results[METRIC_RESULTS] = {0};
+        for (MetricsShard* s = atomic_load(&shards); s; s = s->next) {
+            hist_merge(h, &s->ops[op].latency);
+            for (int r = 0; r < METRIC_RESULTS; r++) {
+                results[r] += atomic_load_explicit(&s->ops[op].results[r], memory_order_relaxed);
+            }
+        }
+        if (h->count == 0) continue;
+
+        for (int r = 0; r < METRIC_RESULTS; r++) {
+            if (results[r] == 0) continue;
+            if (r == METRIC_RESULTS - 1) {
+                metrics_printf(t, "requests_total{op=\"%s\",result=\"other\"} %llu\n",
+                               op_names[op], (unsigned long long)results[r]);
+            } else {
+                metrics_printf(t, "requests_total{op=\"%s\",result=\"%d\"} %llu\n",
+                               op_names[op], r, (unsigned long long)results[r]);
+            }
+        }
+        char labels[64];
+        snprintf(labels, sizeof(labels), "op=\"%s\"", op_names[op]);
+        render_hist(t, "request_latency", labels, h);
+    }
+
+    // user_mutex
+    uint64_t contended = 0;
+    memset(h, 0, sizeof(*h));
+    for (MetricsShard* s = atomic_load(&shards); s; s = s->next) {
+        hist_merge(h, &s->lock_wait);
+        contended += atomic_load_explicit(&s->lock_contended, memory_order_relaxed);
+    }
+    render_hist(t, "user_mutex_wait", "", h);
+    metrics_printf(t, "user_mutex_contended_total %llu\n", (unsigned long long)contended);
+
+    memset(h, 0, sizeof(*h));
+    for (MetricsShard* s = atomic_load(&shards); s; s = s->next) hist_merge(h, &s->lock_hold);
+    render_hist(t, "user_mutex_hold", "", h);
+    free(h);
+
+    // Conexiones e hilos
+    metrics_printf(t, "connections_active %lld\n", (long long)atomic_load(&connections_active));
+    metrics_printf(t, "connections_total %llu\n", (unsigned long long)atomic_load(&connections_total));
+    metrics_printf(t, "threads_event_loop %d\n", event_loops);
+    metrics_printf(t, "threads_total %ld\n", process_threads());
+    metrics_printf(t, "metric_shards %zu\n", atomic_load(&shard_count));
+
+    // Registro y su memoria
+    RegistryMemory mem;
+    registry_memory(&mem);
+    metrics_printf(t, "registry_users %zu\n", mem.users);
+    metrics_printf(t, "registry_users_connected %zu\n", mem.connected);
+    metrics_printf(t, "registry_files %zu\n", mem.files);
+    metrics_printf(t, "registry_contents %zu\n", mem.contents);
+    metrics_printf(t, "registry_expired_total %zu\n", mem.expired);
+    metrics_printf(t, "registry_strings %zu\n", mem.strings);
+    metrics_printf(t, "registry_bytes{kind=\"users\"} %zu\n", mem.user_bytes);
+    metrics_printf(t, "registry_bytes{kind=\"files\"} %zu\n", mem.file_bytes);
+    metrics_printf(t, "registry_bytes{kind=\"endpoints\"} %zu\n", mem.endpoint_bytes);
+    metrics_printf(t, "registry_bytes{kind=\"file_owners\"} %zu\n", mem.owners_bytes);
+    metrics_printf(t, "registry_bytes{kind=\"contents\"} %zu\n", mem.content_bytes);
+    metrics_printf(t, "registry_bytes{kind=\"strings\"} %zu\n", mem.string_bytes);
+    metrics_printf(t, "registry_bytes{kind=\"user_index\"} %zu\n", mem.index_bytes);
+    metrics_printf(t, "registry_bytes{kind=\"size_classes\"} %zu\n", mem.class_used);
+    metrics_printf(t, "registry_reserved_bytes %zu\n", mem.reserved);
+
+    // WAL (todo a 0 si el servidor no tiene -d)
+    WalStats wal;
+    wal_stats(&wal);
+    metrics_printf(t, "wal_records_total %llu\n", (unsigned long long)wal.records);
+    metrics_printf(t, "wal_bytes_total %llu\n", (unsigned long long)wal.bytes);
+    metrics_printf(t, "wal_fsyncs_total %llu\n", (unsigned long long)wal.fsyncs);
+    metrics_printf(t, "wal_durable_lsn %llu\n", (unsigned long long)wal.durable_lsn);
+}
+
+// ----------------------------
+// Endpoint HTTP
+// ----------------------------
+
+static int http_fd = -1;
+static void (*http_render)(MetricsText* t) = NULL;
+
+static void http_reply(int fd) {
+    // Basta con leer la cabecera; la ruta y el método dan igual
+    char req[2048];
+    size_t got = 0;
+    while (got < sizeof(req) - 1) {
+        ssize_t n = recv(fd, req + got, sizeof(req) - 1 - got, 0);
+        if (n <= 0) break;
+        got += n;
+        req[got] = '\0';
+        if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) break;
+    }
+
+    MetricsText body = { NULL, 0, 0 };
+    http_render(&body);
+
+    char header[128];
+    int hlen = snprintf(header, sizeof(header),
+                        "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n\r\n", body.len);
+    send(fd, header, hlen, MSG_NOSIGNAL);
+    for (size_t sent = 0; sent < body.len; ) {
+        ssize_t n = send(fd, body.data + sent, body.len - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += n;
+    }
+    free(body.data);
+}
+
+static void* http_thread(void* arg) {
+    while (1) {
+        int fd = accept(http_fd, NULL, NULL);
+        if (fd < 0) continue;
+        struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        http_reply(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_http_start(int port, void (*render)(MetricsText* t)) {
+    http_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (http_fd < 0) return -1;
+
+    int reuse = 1;
+    setsockopt(http_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)   // Sólo local
+    };
+    if (bind(http_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(http_fd, 16) < 0) {
+        close(http_fd);
+        http_fd = -1;
+        return -1;
+    }
+
+    http_render = render;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, http_thread, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
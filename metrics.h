@@ -0,0 +1,69 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// ----------------------------
+// Métricas del servidor
+// ----------------------------
+//
+// Cada hilo que atiende peticiones escribe en su propio shard (se crea la
+// primera vez y no se libera nunca), así que apuntar una petición son unos
+// cuantos incrementos sin lock ni instrucciones atómicas caras: el único
+// escritor de un shard es su hilo. Al pedir las estadísticas (STATS o el
+// endpoint HTTP) se suman todos los shards.
+//
+// Las latencias van a histogramas log-lineales estilo HDR: 16 cubos por
+// cada potencia de 2 (error < 6.25%) hasta 2^40 ns.
+
+#define HIST_SUB_BITS   4
+#define HIST_SUB        (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS   40
+#define HIST_BUCKETS    ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+// Operaciones del protocolo que se cuentan por separado
+typedef enum {
+    MOP_REGISTER, MOP_UNREGISTER, MOP_CONNECT, MOP_DISCONNECT, MOP_PUBLISH,
+    MOP_DELETE, MOP_LIST_USERS, MOP_LIST_CONTENT, MOP_SEARCH, MOP_GET_FILE,
+    MOP_WATCH_USERS, MOP_GET_FILES, MOP_PUBLISH_BATCH, MOP_DELETE_BATCH,
+    MOP_HEARTBEAT, MOP_STATS, MOP_OTHER, METRIC_OPS
+} MetricOp;
+
+#define METRIC_RESULTS  6     // Códigos de respuesta 0..4 y "otro"
+
+// Texto de las estadísticas en construcción
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} MetricsText;
+
+uint64_t metrics_now_ns(void);
+
+// Operación a partir de su nombre en el protocolo (MOP_OTHER si no se conoce)
+MetricOp metrics_op(const char* name);
+
+// Una petición atendida: operación, código de respuesta y duración
+void metrics_request(MetricOp op, int result, uint64_t elapsed_ns);
+
+// user_mutex con tiempos de espera y de retención
+void metrics_lock(pthread_mutex_t* mutex);
+void metrics_unlock(pthread_mutex_t* mutex);
+
+// Gauges de conexiones e hilos
+void metrics_conn_opened(void);
+void metrics_conn_closed(void);
+void metrics_set_event_loops(int n);
+
+// Formato texto "nombre{etiquetas} valor" (una métrica por línea)
+void metrics_printf(MetricsText* t, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void metrics_render(MetricsText* t);
+
+// Sirve las estadísticas por HTTP en 127.0.0.1:port (GET de cualquier ruta).
+// render construye el texto completo de cada respuesta.
+int metrics_http_start(int port, void (*render)(MetricsText* t));
+
+#endif
@@ -0,0 +1,342 @@
+// peer_server.c: Servidor de archivos de un cliente (lado peer de GET_FILE).
+//
+// client.py lo lanza al hacer CONNECT en lugar de su hilo de escucha, que
+// atendía una descarga detrás de otra copiando el archivo por Python en
+// trozos de 4 KB. Aquí varios hilos con epoll atienden muchas descargas a
+// la vez y el contenido va del page cache al socket con sendfile(), sin
+// pasar por memoria de usuario. Una petición por conexión:
+//     "GET_FILE\0nombre\0"
+//         -> "\0tamaño\0dd/mm/yyyy hh:mm:ss\0" + bytes
+//     "GET_RANGE\0nombre\0offset\0longitud\0"
+//         -> "\0tamaño\0" + bytes de [offset, offset + longitud) (menos al final)
+//     "GET_SUMS\0nombre\0trozo\0"
+//         -> "\0tamaño\0trozo\0" + un CRC-32 en hex por trozo, cada uno con "\0"
+// "\1" si el archivo no existe y "\2" si el rango empieza más allá del final.
+// Con GET_SUMS y GET_RANGE un cliente baja trozos de varios peers a la vez,
+// los comprueba y retoma una descarga cortada donde se quedó.
+// El nombre se abre relativo al directorio de trabajo, como hacía el cliente.
+//
+// Uso: ./peer_server (-p <port> | -f <fd de escucha heredado>) [-t hilos]
+//      Con -p 0 elige un puerto libre y lo escribe en stdout ("PORT n").
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "coarse_clock.h"
+#include "crc32.h"
+
+#define MAX_EVENTS    64
+#define REQUEST_MAX   4200          // "GET_RANGE\0" + nombre (PATH_MAX) + offset + longitud
+#define SEND_CHUNK    (1 << 20)     // Bytes por llamada a sendfile
+#define SUM_MIN       (64 << 10)    // Tamaños de trozo que se aceptan en GET_SUMS
+#define SUM_MAX       (64 << 20)
+#define SUM_READ      (1 << 20)     // Lectura para calcular los CRC
+
+typedef struct {
+    int fd;
+    int file_fd;                    // -1 hasta tener la petición
+    char in[REQUEST_MAX];
+    int in_len;
+    char small[64];
+    char* head;                     // Cabecera de la respuesta (small o, con GET_SUMS, malloc)
+    size_t head_len, head_pos;
+    off_t offset, end;              // Lo que falta por mandar del archivo
+} PeerConn;
+
+typedef struct {
+    int epfd;
+    int listen_fd;
+    pthread_t tid;
+} Loop;
+
+static void conn_close(Loop* loop, PeerConn* c) {
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    if (c->file_fd >= 0) close(c->file_fd);
+    if (c->head != c->small) free(c->head);
+    free(c);
+}
+
+// Campos de la petición en in (el primero es la operación); 0 si aún no
+// ha llegado el último "\0"
+static int split_fields(PeerConn* c, char** fields, int n) {
+    char* p = c->in;
+    char* end = c->in + c->in_len;
+    for (int i = 0; i < n; i++) {
+        char* z = memchr(p, '\0', end - p);
+        if (!z) return 0;
+        fields[i] = p;
+        p = z + 1;
+    }
+    return 1;
+}
+
+static int parse_offset(const char* s, off_t* out) {
+    char* end;
+    errno = 0;
+    long long v = strtoll(s, &end, 10);
+    if (errno || end == s || *end || v < 0) return -1;
+    *out = v;
+    return 0;
+}
+
+// Un CRC-32 por trozo, en hex: la cabecera entera de GET_SUMS
+static int build_sums(PeerConn* c, off_t size, off_t chunk) {
+    off_t count = (size + chunk - 1) / chunk;
+    size_t cap = 64 + count * 9;
+    char* out = malloc(cap);
+    char* buf = malloc(SUM_READ);
+    if (!out || !buf) {
+        free(out);
+        free(buf);
+        return -1;
+    }
+    out[0] = 0;
+    size_t len = 1 + snprintf(out + 1, cap - 1, "%lld%c%lld", (long long)size, 0, (long long)chunk) + 1;
+
+    for (off_t start = 0; start < size; start += chunk) {
+        off_t stop = start + chunk < size ? start + chunk : size;
+        uint32_t crc = 0;
+        for (off_t pos = start; pos < stop;) {
+            size_t want = stop - pos < SUM_READ ? stop - pos : SUM_READ;
+            ssize_t n = pread(c->file_fd, buf, want, pos);
+            if (n <= 0) {
+                free(out);
+                free(buf);
+                return -1; // El archivo ha encogido mientras tanto
+            }
+            crc = crc32_update(crc, buf, n);
+            pos += n;
+        }
+        len += snprintf(out + len, cap - len, "%08x", crc) + 1;
+    }
+    free(buf);
+    c->head = out;
+    c->head_len = len;
+    return 0;
+}
+
+// ¿Ha llegado la petición entera? Prepara la cabecera y el tramo del archivo.
+// 0 si faltan datos, 1 si ya hay respuesta, -1 si la petición no vale.
+static int parse_request(PeerConn* c) {
+    char* f[4];
+    if (!split_fields(c, f, 1)) return c->in_len < REQUEST_MAX ? 0 : -1;
+    int n = strcmp(f[0], "GET_FILE") == 0 ? 2 :
+            strcmp(f[0], "GET_SUMS") == 0 ? 3 :
+            strcmp(f[0], "GET_RANGE") == 0 ? 4 : 0;
+    if (n == 0) return -1;
+    if (!split_fields(c, f, n)) return c->in_len < REQUEST_MAX ? 0 : -1;
+
+    off_t a = 0, b = 0;
+    if (n > 2 && parse_offset(f[2], &a) < 0) return -1;
+    if (n > 3 && parse_offset(f[3], &b) < 0) return -1;
+
+    struct stat st;
+    c->file_fd = open(f[1], O_RDONLY | O_CLOEXEC);
+    if (c->file_fd < 0 || fstat(c->file_fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        if (c->file_fd >= 0) close(c->file_fd);
+        c->file_fd = -1;
+        c->head[0] = 1; // Archivo no existe
+        c->head_len = 1;
+        return 1;
+    }
+
+    if (n == 2) {
+        char when[32];
+        coarse_format(coarse_now_us(), when, sizeof(when));
+        c->head[0] = 0;
+        c->head_len = 1 + snprintf(c->head + 1, sizeof(c->small) - 1, "%lld%c%s",
+                                   (long long)st.st_size, 0, when) + 1;
+        c->end = st.st_size;
+    } else if (n == 3) {
+        // Se calcula aquí mismo: el hilo se para lo que tarde en leer el
+        // archivo, pero sólo se pide una vez por descarga
+        off_t chunk = a < SUM_MIN ? SUM_MIN : a > SUM_MAX ? SUM_MAX : a;
+        if (build_sums(c, st.st_size, chunk) < 0) return -1;
+        close(c->file_fd);
+        c->file_fd = -1;
+    } else if (a > st.st_size) {
+        c->head[0] = 2; // Rango fuera del archivo
+        c->head_len = 1;
+    } else {
+        c->head[0] = 0;
+        c->head_len = 1 + snprintf(c->head + 1, sizeof(c->small) - 1, "%lld", (long long)st.st_size) + 1;
+        c->offset = a;
+        c->end = b < st.st_size - a ? a + b : st.st_size;
+    }
+    return 1;
+}
+
+// Envía lo que se pueda. 1 si la respuesta está completa, 0 si falta, -1 si error.
+static int send_response(PeerConn* c) {
+    while (c->head_pos < c->head_len) {
+        ssize_t n = send(c->fd, c->head + c->head_pos, c->head_len - c->head_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        c->head_pos += n;
+    }
+    while (c->file_fd >= 0 && c->offset < c->end) {
+        size_t want = c->end - c->offset < SEND_CHUNK ? c->end - c->offset : SEND_CHUNK;
+        ssize_t n = sendfile(c->fd, c->file_fd, &c->offset, want);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        if (n == 0) return -1; // El archivo ha encogido: el cliente lo verá incompleto
+    }
+    return 1;
+}
+
+static void conn_event(Loop* loop, PeerConn* c) {
+    if (c->head_len == 0) {
+        while (c->in_len < REQUEST_MAX) {
+            ssize_t n = recv(c->fd, c->in + c->in_len, REQUEST_MAX - c->in_len, 0);
+            if (n > 0) {
+                c->in_len += n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EAGAIN) break;
+            conn_close(loop, c); // Se ha ido sin pedir nada
+            return;
+        }
+        int r = parse_request(c);
+        if (r == 0) return;
+        if (r < 0) {
+            conn_close(loop, c);
+            return;
+        }
+    }
+
+    int r = send_response(c);
+    if (r != 0) {
+        conn_close(loop, c); // Respuesta enviada (o error): una descarga por conexión
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = c };
+    epoll_ctl(loop->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void accept_all(Loop* loop) {
+    while (1) {
+        int fd = accept(loop->listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        PeerConn* c = calloc(1, sizeof(PeerConn));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->file_fd = -1;
+        c->head = c->small;
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = c };
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+static void* loop_main(void* arg) {
+    Loop* loop = arg;
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int n = epoll_wait(loop->epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) accept_all(loop);
+            else conn_event(loop, events[i].data.ptr);
+        }
+    }
+    return NULL;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s (-p <port> | -f <fd de escucha>) [-t hilos]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    int port = -1;
+    int listen_fd = -1;
+    int num_loops = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:f:t:")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'f': listen_fd = atoi(optarg); break;
+            case 't': num_loops = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if ((port < 0) == (listen_fd < 0) || num_loops <= 0) usage(argv[0]);
+
+    // Si el cliente que lo ha lanzado muere, éste también
+    pid_t parent = getppid();
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != parent) return 0;
+    signal(SIGPIPE, SIG_IGN);
+
+    if (listen_fd < 0) {
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(port),
+            .sin_addr.s_addr = INADDR_ANY
+        };
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            listen(listen_fd, SOMAXCONN) < 0) {
+            perror("peer_server");
+            return 1;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd, (struct sockaddr*)&addr, &len);
+        printf("PORT %d\n", ntohs(addr.sin_port));
+        fflush(stdout);
+    }
+    if (fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        perror("peer_server: socket de escucha");
+        return 1;
+    }
+
+    // Como servidor.c: todos los hilos vigilan el socket de escucha
+    // (EPOLLEXCLUSIVE despierta a uno) y atienden lo que aceptan
+    Loop* loops = calloc(num_loops, sizeof(Loop));
+    for (int i = 0; i < num_loops; i++) {
+        loops[i].listen_fd = listen_fd;
+        loops[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = NULL };
+        if (loops[i].epfd < 0 || epoll_ctl(loops[i].epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+            perror("epoll");
+            return 1;
+        }
+        pthread_create(&loops[i].tid, NULL, loop_main, &loops[i]);
+    }
+    for (int i = 0; i < num_loops; i++) pthread_join(loops[i].tid, NULL);
+    return 0;
+}
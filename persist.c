@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "persist.h"
+#include "registry.h"
+#include "crc32.h"
+
+#define COMPACT_CHECK_SEC 1
+
+static char data_dir[512];
+static uint64_t compact_every = 0;
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void sync_dir(const char* dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// ----------------------------
+// Snapshot
+// ----------------------------
+
+int persist_snapshot(void) {
+    pthread_mutex_lock(&snapshot_mutex);
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+
+    size_t body_len;
+    char* body = registry_snapshot(&body_len, &h.users, &h.files, &h.next_lsn);
+    if (!body) {
+        pthread_mutex_unlock(&snapshot_mutex);
+        return -1;
+    }
+    h.body_len = body_len;
+    h.body_crc = crc32_update(0, body, body_len);
+
+    char tmp_path[600], path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/snapshot.tmp", data_dir);
+    snprintf(path, sizeof(path), "%s/snapshot.bin", data_dir);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int ok = fd >= 0
+          && write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h)
+          && write(fd, body, body_len) == (ssize_t)body_len
+          && fsync(fd) == 0;
+    if (fd >= 0) close(fd);
+    free(body);
+
+    // Sólo cuando el snapshot nuevo está en disco se puede tirar el WAL viejo
+    if (!ok || rename(tmp_path, path) < 0) {
+        perror("snapshot");
+        unlink(tmp_path);
+        pthread_mutex_unlock(&snapshot_mutex);
+        return -1;
+    }
+    sync_dir(data_dir);
+    wal_remove_before(data_dir, h.next_lsn);
+
+    pthread_mutex_unlock(&snapshot_mutex);
+    return 0;
+}
+
+// Carga snapshot.bin. Devuelve el LSN desde el que aplicar el WAL (1 si no hay snapshot).
+static int load_snapshot(uint64_t* next_lsn, uint64_t* users, uint64_t* files) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/snapshot.bin", data_dir);
+    *next_lsn = 1;
+    *users = *files = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return errno == ENOENT ? 0 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    SnapshotHeader h;
+    memcpy(&h, map, sizeof(h));
+    const char* body = map + sizeof(h);
+    int with_content = memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) == 0;
+    if ((!with_content && memcmp(h.magic, SNAPSHOT_MAGIC_V1, sizeof(h.magic)) != 0)
+        || h.body_len != st.st_size - sizeof(h)
+        || crc32_update(0, body, h.body_len) != h.body_crc) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    registry_reserve(h.users, h.files);
+
+    // Las cadenas se usan directamente desde el mapeo (intern_acquire las copia)
+    const char* p = body;
+    const char* end = body + h.body_len;
+    int failed = 0;
+    while (p < end && !failed) {
+        const char* name = p;
+        const char* nul = memchr(p, '\0', end - p);
+        uint32_t nfiles;
+        if (!nul || nul + 1 + sizeof(nfiles) > end) { failed = 1; break; }
+        memcpy(&nfiles, nul + 1, sizeof(nfiles));
+        p = nul + 1 + sizeof(nfiles);
+
+        if (registry_restore_user(name) != 0) failed = 1;
+        (*users)++;
+
+        for (uint32_t i = 0; i < nfiles && !failed; i++) {
+            const char* filename = p;
+            nul = memchr(p, '\0', end - p);
+            if (!nul) { failed = 1; break; }
+            const char* description = nul + 1;
+            nul = memchr(description, '\0', end - description);
+            if (!nul) { failed = 1; break; }
+            p = nul + 1;
+            const char* content = "";
+            if (with_content) {
+                content = p;
+                nul = memchr(p, '\0', end - p);
+                if (!nul) { failed = 1; break; }
+                p = nul + 1;
+            }
+
+            if (registry_restore_file(name, filename, description) != 0) failed = 1;
+            if (*content && registry_restore_content(name, filename, content) != 0) failed = 1;
+            (*files)++;
+        }
+    }
+
+    munmap(map, st.st_size);
+    if (failed) return -1;
+    *next_lsn = h.next_lsn;
+    return 0;
+}
+
+// ----------------------------
+// Recuperación y compactación
+// ----------------------------
+
+static uint64_t replayed = 0;
+
+static void apply_record(char type, const char* fields[3]) {
+    replayed++;
+    switch (type) {
+        case WAL_REGISTER:   if (fields[0]) registry_restore_user(fields[0]); break;
+        case WAL_UNREGISTER: if (fields[0]) unregister_user(fields[0]); break;
+        case WAL_PUBLISH:
+            if (fields[2]) registry_restore_file(fields[0], fields[1], fields[2]);
+            break;
+        case WAL_DELETE:
+            if (fields[1]) registry_restore_delete(fields[0], fields[1]);
+            break;
+        case WAL_CONTENT:
+            if (fields[2]) registry_restore_content(fields[0], fields[1], fields[2]);
+            break;
+        default:
+            fprintf(stderr, "WAL: registro de tipo desconocido '%c'\n", type);
+    }
+}
+
+static void* compact_thread(void* arg) {
+    uint64_t last_records = 0;
+    while (1) {
+        sleep(COMPACT_CHECK_SEC);
+        WalStats st;
+        wal_stats(&st);
+        if (st.records - last_records >= compact_every) {
+            if (persist_snapshot() == 0) last_records = st.records;
+        }
+    }
+    return NULL;
+}
+
+int persist_start(const char* dir, WalSync policy, uint64_t every) {
+    snprintf(data_dir, sizeof(data_dir), "%s", dir);
+    compact_every = every;
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+
+    double t0 = now_ms();
+    uint64_t next_lsn, users, files;
+    if (load_snapshot(&next_lsn, &users, &files) < 0) {
+        fprintf(stderr, "snapshot: %s/snapshot.bin está corrupto\n", dir);
+        return -1;
+    }
+    uint64_t last = wal_replay(dir, next_lsn - 1, apply_record);
+
+    printf("s> registro recuperado de %s: %llu usuarios y %llu archivos del snapshot + %llu cambios del WAL (%.1f ms)\n",
+           dir, (unsigned long long)users, (unsigned long long)files,
+           (unsigned long long)replayed, now_ms() - t0);
+
+    if (wal_open(dir, policy, last + 1) < 0) return -1;
+
+    if (compact_every > 0) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, compact_thread, NULL) != 0) return -1;
+        pthread_detach(tid);
+    }
+    return 0;
+}
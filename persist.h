@@ -0,0 +1,44 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include "wal.h"
+
+// ----------------------------
+// Persistencia del registro: snapshot + WAL
+// ----------------------------
+//
+// Al arrancar se carga el último snapshot (con mmap) y se aplica encima
+// la cola del WAL. Un hilo de compactación escribe un snapshot nuevo cada
+// compact_every registros del WAL y borra los segmentos que ya cubre.
+//
+// Sólo se guardan usuarios y publicaciones: tras reiniciar todos los
+// usuarios están desconectados (su IP/puerto ya no tiene por qué valer) y
+// sólo tienen que volver a hacer CONNECT.
+//
+// Fichero snapshot.bin: cabecera SnapshotHeader y después, por usuario,
+//   nombre\0 [u32 n] n x (archivo\0 descripción\0 contenido\0)
+// con contenido = "hash:tamaño" o vacío. Los de la versión anterior
+// (SNAPSHOT_MAGIC_V1) no llevan contenido y se siguen pudiendo cargar.
+
+#define SNAPSHOT_MAGIC    "P2PSNAP2"
+#define SNAPSHOT_MAGIC_V1 "P2PSNAP1"
+
+typedef struct {
+    char magic[8];
+    uint64_t next_lsn;       // El WAL se aplica a partir de este LSN
+    uint64_t users;
+    uint64_t files;
+    uint64_t body_len;
+    uint32_t body_crc;
+    uint32_t reserved;
+} SnapshotHeader;
+
+// Recupera el registro desde dir (lo crea si no existe), abre el WAL y
+// lanza la compactación (compact_every = 0 la desactiva)
+int persist_start(const char* dir, WalSync policy, uint64_t compact_every);
+
+// Escribe un snapshot ahora y borra los segmentos del WAL que cubre
+int persist_snapshot(void);
+
+#endif
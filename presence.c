@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "presence.h"
+
+#define REC_MAX 320     // "C\0" + seq + nombre (255) + ip + puerto, con margen
+
+typedef struct {
+    uint64_t seq;
+    int len;
+    char data[REC_MAX];
+} Event;
+
+// El anillo lo escriben los escritores del registro (ya con user_mutex) y
+// lo leen los hilos de eventos; el mutex propio sólo cubre la copia.
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Event* ring = NULL;
+static int ring_size = 0;
+static _Atomic uint64_t last_seq = 0;
+static uint64_t first_seq = 0;           // Seq del primer evento del arranque
+
+static void (*notify_fn)(void*) = NULL;
+static void* notify_arg = NULL;
+
+int presence_init(int capacity) {
+    ring = calloc(capacity, sizeof(Event));
+    if (!ring) return -1;
+    ring_size = capacity;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    first_seq = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+    atomic_store(&last_seq, first_seq);
+    return 0;
+}
+
+void presence_set_notify(void (*fn)(void* arg), void* arg) {
+    notify_arg = arg;
+    notify_fn = fn;
+}
+
+uint64_t presence_seq(void) {
+    return atomic_load_explicit(&last_seq, memory_order_acquire);
+}
+
+void presence_record(int kind, const char* name, const char* ip, int port) {
+    if (!ring) return;
+
+    pthread_mutex_lock(&ring_mutex);
+    uint64_t seq = atomic_load_explicit(&last_seq, memory_order_relaxed) + 1;
+    Event* e = &ring[seq % ring_size];
+    e->seq = seq;
+    if (kind == PRESENCE_CONNECT) {
+        e->len = snprintf(e->data, REC_MAX, "C%c%llu%c%.255s%c%s%c%d", 0, (unsigned long long)seq,
+                          0, name, 0, ip, 0, port) + 1;
+    } else {
+        e->len = snprintf(e->data, REC_MAX, "D%c%llu%c%.255s", 0, (unsigned long long)seq, 0, name) + 1;
+    }
+    atomic_store_explicit(&last_seq, seq, memory_order_release);
+    pthread_mutex_unlock(&ring_mutex);
+
+    if (notify_fn) notify_fn(notify_arg);
+}
+
+int presence_since(uint64_t after, int max, void (*visit)(const char* rec, int len, void* ctx),
+                   void* ctx, uint64_t* last) {
+    *last = after;
+    pthread_mutex_lock(&ring_mutex);
+    uint64_t seq = atomic_load_explicit(&last_seq, memory_order_relaxed);
+
+    // Más viejo que el anillo, o de otro arranque: foto completa
+    uint64_t oldest = seq - first_seq < (uint64_t)ring_size ? first_seq : seq - ring_size;
+    if (after > seq || after < oldest) {
+        pthread_mutex_unlock(&ring_mutex);
+        return 1;
+    }
+
+    for (uint64_t s = after + 1; s <= seq && max > 0; s++, max--) {
+        const Event* e = &ring[s % ring_size];
+        visit(e->data, e->len, ctx);
+        *last = s;
+    }
+    pthread_mutex_unlock(&ring_mutex);
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include <stdint.h>
+
+// ----------------------------
+// Log de cambios de presencia (WATCH_USERS)
+// ----------------------------
+//
+// Cada CONNECT/DISCONNECT del registro deja un evento con un número de
+// secuencia creciente en un anillo de tamaño fijo, ya serializado tal
+// como se manda a los suscriptores:
+//     "C\0seq\0nombre\0ip\0puerto\0"   conectado
+//     "D\0seq\0nombre\0"               desconectado
+// Un suscriptor que vuelve con su último seq recibe sólo lo que le falta;
+// si ya no está en el anillo le toca una foto completa (LIST_USERS).
+//
+// Los seq empiezan en la hora de arranque en microsegundos: un seq de
+// antes de reiniciar el servidor siempre queda por detrás del anillo.
+
+#define PRESENCE_LOG_DEFAULT 4096           // Eventos que se recuerdan
+
+enum { PRESENCE_CONNECT = 'C', PRESENCE_DISCONNECT = 'D' };
+
+int presence_init(int capacity);
+
+// Avisa a fn(arg) después de cada evento nuevo (despertar a los hilos de eventos)
+void presence_set_notify(void (*fn)(void* arg), void* arg);
+
+// Apunta un evento. Lo llama el registro con user_mutex, después de
+// publicar el cambio: quien lea el seq ya ve el cambio en el registro.
+void presence_record(int kind, const char* name, const char* ip, int port);
+
+// Último seq asignado
+uint64_t presence_seq(void);
+
+// Entrega a visit hasta max eventos con seq > after, en orden, y deja en
+// *last el seq del último (after si no hay ninguno). Devuelve 1 si after
+// ya no está en el anillo (hace falta una foto) y 0 si no.
+int presence_since(uint64_t after, int max, void (*visit)(const char* rec, int len, void* ctx),
+                   void* ctx, uint64_t* last);
+
+#endif
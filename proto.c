@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+#include "proto.h"
+
+typedef struct {
+    const char* name;
+    int len;
+    int args;                   // Campos propios (en los lotes, el contador)
+    int item_fields;            // Campos por elemento (0 si no es un lote)
+} OpInfo;
+
+#define OP(name, args, items) { name, sizeof(name) - 1, args, items }
+
+static const OpInfo ops[PROTO_OPS] = {
+    [PROTO_REGISTER]          = OP("REGISTER", 0, 0),
+    [PROTO_UNREGISTER]        = OP("UNREGISTER", 0, 0),
+    [PROTO_CONNECT]           = OP("CONNECT", 1, 0),            // puerto
+    [PROTO_DISCONNECT]        = OP("DISCONNECT", 0, 0),
+    [PROTO_PUBLISH]           = OP("PUBLISH", 2, 0),            // archivo, descripción
+    [PROTO_DELETE]            = OP("DELETE", 1, 0),             // archivo
+    [PROTO_LIST_USERS]        = OP("LIST_USERS", 0, 0),
+    [PROTO_LIST_CONTENT]      = OP("LIST_CONTENT", 1, 0),       // usuario remoto
+    [PROTO_LIST_CONTENT_PAGE] = OP("LIST_CONTENT_PAGE", 4, 0),  // remoto, cursor, límite, flags
+    [PROTO_SEARCH]            = OP("SEARCH", 1, 0),             // archivo
+    [PROTO_GET_FILE]          = OP("GET_FILE", 2, 0),           // usuario remoto, archivo
+    [PROTO_GET_FILES]         = OP("GET_FILES", 1, 2),          // n; usuario, archivo
+    [PROTO_PUBLISH_BATCH]     = OP("PUBLISH_BATCH", 1, 2),      // n; archivo, descripción
+    [PROTO_DELETE_BATCH]      = OP("DELETE_BATCH", 1, 1),       // n; archivo
+    [PROTO_WATCH_USERS]       = OP("WATCH_USERS", 1, 0),        // último seq visto
+    [PROTO_STATS]             = OP("STATS", 0, 0),
+    [PROTO_PUBLISH_CONTENT]   = OP("PUBLISH_CONTENT", 4, 0),    // archivo, descripción, hash, tamaño
+    [PROTO_GET_SOURCES]       = OP("GET_SOURCES", 3, 0),        // usuario remoto, archivo, máximo
+    [PROTO_HEARTBEAT]         = OP("HEARTBEAT", 0, 0),
+    [PROTO_OTHER]             = OP("", 0, 0),
+};
+
+int proto_op(const char* name, int len) {
+    for (int i = 0; i < PROTO_OTHER; i++) {
+        if (ops[i].len == len && memcmp(ops[i].name, name, len) == 0) return i;
+    }
+    return PROTO_OTHER;
+}
+
+const char* proto_op_name(int op) {
+    return op >= 0 && op < PROTO_OPS ? ops[op].name : "";
+}
+
+int proto_op_args(int op) {
+    return op >= 0 && op < PROTO_OPS ? ops[op].args : 0;
+}
+
+int proto_item_fields(int op) {
+    return op >= 0 && op < PROTO_OPS ? ops[op].item_fields : 0;
+}
+
+// Siguiente campo a partir de *p: lo devuelve y deja *p detrás de su \0.
+// NULL si no termina antes de end.
+static const char* next_field(const char** p, const char* end) {
+    const char* start = *p;
+    if (start >= end) return NULL;
+    const char* z = memchr(start, '\0', end - start);
+    if (!z) return NULL;
+    *p = z + 1;
+    return start;
+}
+
+int proto_parse_request(const char* buf, int len, int has_timestamp, int max_batch, ProtoRequest* req) {
+    const char* p = buf;
+    const char* end = buf + len;
+    memset(req, 0, sizeof(*req));
+    req->op = PROTO_OTHER;
+
+    req->name = next_field(&p, end);
+    if (!req->name) return PROTO_ERR_USER;
+    req->op = proto_op(req->name, p - req->name - 1);
+    req->user = next_field(&p, end);
+    if (!req->user) return PROTO_ERR_USER;
+
+    const OpInfo* info = &ops[req->op];
+    for (int i = 0; i < info->args; i++) {
+        req->arg[i] = next_field(&p, end);
+        if (!req->arg[i]) return PROTO_ERR_ARGS;
+    }
+
+    if (info->item_fields) {
+        long n = strtol(req->arg[0], NULL, 10);
+        if (n < 0 || n > max_batch) return PROTO_ERR_COUNT;
+        req->count = (int)n;
+        req->items = p;
+        for (long i = 0; i < n * info->item_fields; i++) {
+            if (!next_field(&p, end)) return PROTO_ERR_ARGS;
+        }
+    }
+
+    if (has_timestamp) {
+        req->timestamp = next_field(&p, end);
+        if (!req->timestamp) return PROTO_ERR_TIMESTAMP;
+    }
+    return PROTO_OK;
+}
+
+void proto_batch_items(const ProtoRequest* req, const char** out) {
+    const char* p = req->items;
+    int n = req->count * ops[req->op].item_fields;
+    for (int i = 0; i < n; i++) {
+        out[i] = p;
+        p += strlen(p) + 1;
+    }
+}
+
+int proto_request_complete(const char* buf, int len, int max_batch) {
+    const char* p = buf;
+    const char* end = buf + len;
+    const char* name = next_field(&p, end);
+    if (!name) return 0;
+    const OpInfo* info = &ops[proto_op(name, p - name - 1)];
+
+    // Usuario + campos propios + timestamp; los lotes, más sus elementos
+    long needed = 1 + info->args + 1;
+    const char* field = NULL;
+    for (long got = 0; got < needed; got++) {
+        field = next_field(&p, end);
+        if (!field) return 0;
+        if (got == 1 && info->item_fields) {
+            long n = strtol(field, NULL, 10);
+            if (n > 0 && n <= max_batch) needed += n * info->item_fields;
+        }
+    }
+    return 1;
+}
+
+int proto_encode(char* out, int cap, const char* const* fields, int n) {
+    int len = 0;
+    for (int i = 0; i < n; i++) {
+        int flen = strlen(fields[i]) + 1;
+        if (len + flen > cap) return -1;
+        memcpy(out + len, fields[i], flen);
+        len += flen;
+    }
+    return len;
+}
+
+int proto_split(const char* data, int len, int max, int* starts, int* lens, int* used) {
+    const char* p = data;
+    const char* end = data + len;
+    int n = 0;
+    while (n < max) {
+        const char* field = next_field(&p, end);
+        if (!field) break;
+        starts[n] = field - data;
+        lens[n] = p - field - 1;
+        n++;
+    }
+    *used = p - data;
+    return n;
+}
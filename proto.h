@@ -0,0 +1,82 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+// ----------------------------
+// Códec del protocolo cliente-servidor (campos terminados en \0)
+// ----------------------------
+//
+// Una petición es "OPERACION\0usuario\0<campos propios>\0...timestamp\0";
+// los lotes (GET_FILES, PUBLISH_BATCH, DELETE_BATCH) llevan además detrás
+// del contador n elementos de 1 o 2 campos. proto_parse_request recorre el
+// buffer una sola vez sin salirse de sus len bytes y deja punteros a cada
+// campo dentro del propio buffer (no copia nada): como cada campo termina
+// en \0 se pueden usar tal cual como cadenas C.
+//
+// Las respuestas son un byte de código y, según la operación, más campos
+// terminados en \0; proto_split da los límites de cada uno (lo usa
+// client.py por ctypes desde libproto.so).
+
+enum {
+    PROTO_REGISTER, PROTO_UNREGISTER, PROTO_CONNECT, PROTO_DISCONNECT,
+    PROTO_PUBLISH, PROTO_DELETE, PROTO_LIST_USERS, PROTO_LIST_CONTENT,
+    PROTO_LIST_CONTENT_PAGE, PROTO_SEARCH, PROTO_GET_FILE, PROTO_GET_FILES,
+    PROTO_PUBLISH_BATCH, PROTO_DELETE_BATCH, PROTO_WATCH_USERS, PROTO_STATS,
+    PROTO_PUBLISH_CONTENT, PROTO_GET_SOURCES, PROTO_HEARTBEAT,
+    PROTO_OTHER, PROTO_OPS
+};
+
+// Resultado de proto_parse_request
+enum {
+    PROTO_OK = 0,
+    PROTO_ERR_USER,          // Falta la operación o el usuario
+    PROTO_ERR_ARGS,          // Faltan campos de la operación o elementos del lote
+    PROTO_ERR_COUNT,         // Contador del lote negativo o mayor que el máximo
+    PROTO_ERR_TIMESTAMP      // Falta el timestamp (sólo si se espera)
+};
+
+#define PROTO_MAX_ARGS 4
+
+typedef struct {
+    int op;                             // PROTO_* (PROTO_OTHER si no se conoce)
+    const char* name;                   // Operación tal como llega
+    const char* user;
+    const char* arg[PROTO_MAX_ARGS];    // Campos propios, en orden (CONNECT: puerto; PUBLISH: archivo, descripción...)
+    int count;                          // Lotes: número de elementos
+    const char* items;                  // Lotes: primer campo del primer elemento
+    const char* timestamp;              // NULL si no viene
+} ProtoRequest;
+
+// Operación a partir de su nombre (len sin el \0)
+int proto_op(const char* name, int len);
+const char* proto_op_name(int op);
+
+// Campos propios de la operación (sin operación, usuario ni timestamp)
+int proto_op_args(int op);
+
+// Campos de cada elemento si la operación es un lote; 0 si no lo es
+int proto_item_fields(int op);
+
+// Trocea buf[0..len). has_timestamp = 0 si el último campo no viene (flag
+// NO_TIMESTAMP de v2). Los lotes de más de max_batch elementos se rechazan.
+// Aunque falle deja en req lo que haya podido leer (op, name, user...).
+int proto_parse_request(const char* buf, int len, int has_timestamp, int max_batch, ProtoRequest* req);
+
+// Punteros a los count * proto_item_fields(op) campos de los elementos de
+// un lote ya validado por proto_parse_request
+void proto_batch_items(const ProtoRequest* req, const char** out);
+
+// ¿Han llegado ya todos los campos de la petición? (para v1, que no lleva
+// longitud). No mira más allá de len.
+int proto_request_complete(const char* buf, int len, int max_batch);
+
+// Escribe los n campos seguidos, cada uno con su \0. Devuelve la longitud
+// o -1 si no caben en cap.
+int proto_encode(char* out, int cap, const char* const* fields, int n);
+
+// Límites de los campos terminados en \0 de data[0..len): deja hasta max
+// posiciones y longitudes y devuelve cuántos campos completos ha visto.
+// *used = bytes hasta el último \0 consumido (lo que sigue, p. ej. el
+// contenido de un archivo, no se toca).
+int proto_split(const char* data, int len, int max, int* starts, int* lens, int* used);
+
+#endif
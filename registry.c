@@ -0,0 +1,1436 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "registry.h"
+#include "strmap.h"
+#include "epoch.h"
+#include "slab.h"
+#include "intern.h"
+#include "wal.h"
+#include "metrics.h"
+#include "presence.h"
+
+// ----------------------------
+// Estado global
+// ----------------------------
+
+static User* _Atomic user_list = NULL;   // Lista global de usuarios registrados (orden de recorrido)
+static StrMap user_map;                  // Índice hash nombre -> User* sobre la misma lista
+static StrMap content_map;               // Hash del contenido -> FileContent* (sólo con user_mutex)
+
+pthread_mutex_t user_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Pools de nodos del registro
+static SlabPool user_pool = SLAB_POOL_INIT(sizeof(User));
+static SlabPool file_pool = SLAB_POOL_INIT(sizeof(FileEntry));
+static SlabPool endpoint_pool = SLAB_POOL_INIT(sizeof(Endpoint));
+static SlabPool owners_pool = SLAB_POOL_INIT(sizeof(FileOwners));
+static SlabPool content_pool = SLAB_POOL_INIT(sizeof(FileContent));
+
+// Caché de LIST_USERS: users_generation cambia con cada CONNECT/DISCONNECT
+// (y al borrar un usuario conectado); la imagen sólo vale si es de la misma.
+static _Atomic uint64_t users_generation = 1;
+static UsersImage* _Atomic users_image = NULL;
+static pthread_mutex_t image_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Contadores para las métricas (sólo escritores, con user_mutex)
+static size_t file_count = 0;
+static uint32_t file_seq = 0;       // Último seq asignado a una publicación
+static size_t connected_count = 0;
+static uint64_t sources_round = 0;  // Baraja los empates de resolve_sources
+static size_t expired_count = 0;
+
+// Caducidad de los conectados (con user_mutex; ver registry.h)
+static TimerWheel liveness_wheel;
+static uint64_t liveness_timeout_us = 0;     // 0 = desactivada
+
+int registry_init(void) {
+    if (strmap_init(&user_map, MAX_USERS) < 0) return -1;
+    if (strmap_init(&content_map, MAX_USERS) < 0) return -1;
+    return intern_init();
+}
+
+// Busca un usuario por nombre en O(1). Requiere user_mutex o estar en una sección de época.
+static User* find_user(const char* name) {
+    return (User*)strmap_get(&user_map, name);
+}
+
+// Funciones de liberación para epoch_retire. Sólo devuelven memoria: las
+// cadenas internadas se sueltan al desenlazar, con user_mutex cogido.
+static void file_free(void* p) {
+    slab_free(&file_pool, p);
+}
+
+static void endpoint_free(void* p) {
+    slab_free(&endpoint_pool, p);
+}
+
+// Reloj monótono grueso: HEARTBEAT no debe costar más que leer la hora
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t liveness_tick(uint64_t us) {
+    return us / LIVENESS_TICK_US;
+}
+
+// Un usuario retirado se libera con sus archivos y su endpoint: ya nadie
+// más los enlaza.
+static void user_free(void* p) {
+    User* u = p;
+    FileEntry* f = u->files;
+    while (f) {
+        FileEntry* next = f->next;
+        file_free(f);
+        f = next;
+    }
+    endpoint_free(u->endpoint);
+    free(u->marks);
+    slab_free(&user_pool, u);
+}
+
+// Hash de una cadena internada: su dirección (tablas temporales de los lotes)
+static uint64_t pointer_hash(const void* p) {
+    return ((uintptr_t)p >> 4) * 0x9E3779B97F4A7C15ULL;
+}
+
+// Suelta las cadenas de una publicación que se acaba de desenlazar
+static void file_release_strings(FileEntry* f) {
+    intern_release(f->filename);
+    intern_release(f->description);
+}
+
+// ----------------------------
+// ÍNDICE GLOBAL DE ARCHIVOS (filename -> publicaciones). Requiere user_mutex.
+// ----------------------------
+
+static void owners_init(FileOwners* owners, const char* key) {
+    owners->filename = key;
+    owners->entries = &owners->single;  // La mayoría tiene un solo dueño
+    owners->count = 0;
+    owners->capacity = 1;
+}
+
+// Añade f al final de owners. Devuelve su posición o -1 sin memoria.
+static int owners_push(FileOwners* owners, FileEntry* f) {
+    if (owners->count == owners->capacity) {
+        int new_cap = owners->capacity * 2 < 4 ? 4 : owners->capacity * 2;
+        FileEntry** entries = owners->entries == &owners->single
+                              ? malloc(new_cap * sizeof(FileEntry*))
+                              : realloc(owners->entries, new_cap * sizeof(FileEntry*));
+        if (!entries) return -1;
+        if (owners->entries == &owners->single) entries[0] = owners->single;
+        owners->entries = entries;
+        owners->capacity = new_cap;
+    }
+    owners->entries[owners->count] = f;
+    return owners->count++;
+}
+
+// Quita la posición pos en O(1): el último ocupa el hueco del borrado.
+// Devuelve el que ha pasado a pos (para que apunte su posición nueva).
+static FileEntry* owners_remove_at(FileOwners* owners, int pos) {
+    FileEntry* last = owners->entries[--owners->count];
+    owners->entries[pos] = last;
+    return last;
+}
+
+static void owners_free_entries(FileOwners* owners) {
+    if (owners->entries != &owners->single) free(owners->entries);
+}
+
+static void content_index_remove(FileEntry* f);
+
+// Las publicaciones de cada nombre cuelgan de su cadena internada
+// (intern_data): f->filename ya es esa cadena, así que no hace falta
+// buscar en ninguna tabla.
+static int file_index_add(FileEntry* f) {
+    FileOwners** slot = (FileOwners**)intern_data(f->filename);
+    FileOwners* owners = *slot;
+    if (!owners) {
+        owners = slab_alloc(&owners_pool);
+        if (!owners) return -1;
+        owners_init(owners, f->filename);
+        *slot = owners;
+    }
+
+    f->index_pos = owners_push(owners, f);
+    if (f->index_pos < 0) {
+        if (owners->count == 0) {
+            *slot = NULL;
+            slab_free(&owners_pool, owners);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Saca f del índice de nombres y, si lo tiene, del de contenido
+static void file_index_remove(FileEntry* f) {
+    if (f->content) content_index_remove(f);
+
+    FileOwners** slot = (FileOwners**)intern_data(f->filename);
+    FileOwners* owners = *slot;
+    if (!owners) return;
+
+    owners_remove_at(owners, f->index_pos)->index_pos = f->index_pos;
+
+    if (owners->count == 0) {
+        *slot = NULL;
+        owners_free_entries(owners);
+        slab_free(&owners_pool, owners);
+    }
+}
+
+// ----------------------------
+// ÍNDICE DE CONTENIDO (hash -> publicaciones con esos bytes). Requiere user_mutex.
+// ----------------------------
+
+// Hexadecimal en minúsculas, de CONTENT_HASH_MIN a CONTENT_HASH_MAX caracteres
+static int valid_hash(const char* hash) {
+    size_t len = strspn(hash, "0123456789abcdef");
+    return hash[len] == '\0' && len >= CONTENT_HASH_MIN && len <= CONTENT_HASH_MAX;
+}
+
+// "hash:tamaño" (WAL y snapshot) -> hash en buf y tamaño. 0 OK, -1 mal formado.
+static int parse_content(const char* content, char* buf, uint64_t* size) {
+    const char* colon = strchr(content, ':');
+    if (!colon || colon - content > CONTENT_HASH_MAX) return -1;
+    memcpy(buf, content, colon - content);
+    buf[colon - content] = '\0';
+    char* end;
+    *size = strtoull(colon + 1, &end, 10);
+    return colon[1] != '\0' && *end == '\0' && valid_hash(buf) ? 0 : -1;
+}
+
+static int format_content(const FileContent* c, char* buf, size_t cap) {
+    return snprintf(buf, cap, "%s:%llu", c->holders.filename, (unsigned long long)c->size);
+}
+
+// Cuelga f del contenido (hash, size), creándolo si es el primero.
+// 0 OK, 1 ese hash ya está con otro tamaño, -1 sin memoria.
+static int content_index_add(FileEntry* f, const char* hash, uint64_t size) {
+    FileContent* c = strmap_get(&content_map, hash);
+    if (c && c->size != size) return 1;
+    if (!c) {
+        c = slab_alloc(&content_pool);
+        if (!c) return -1;
+        const char* key = intern_acquire(hash, CONTENT_HASH_MAX);
+        if (!key || strmap_put(&content_map, key, c) != 0) {
+            if (key) intern_release(key);
+            slab_free(&content_pool, c);
+            return -1;
+        }
+        owners_init(&c->holders, key);
+        c->size = size;
+    }
+
+    f->content_pos = owners_push(&c->holders, f);
+    if (f->content_pos < 0) {
+        if (c->holders.count == 0) {
+            strmap_remove(&content_map, c->holders.filename);
+            intern_release(c->holders.filename);
+            slab_free(&content_pool, c);
+        }
+        return -1;
+    }
+    f->content = c;
+    return 0;
+}
+
+static void content_index_remove(FileEntry* f) {
+    FileContent* c = f->content;
+    owners_remove_at(&c->holders, f->content_pos)->content_pos = f->content_pos;
+
+    if (c->holders.count == 0) {
+        strmap_remove(&content_map, c->holders.filename);
+        intern_release(c->holders.filename);
+        owners_free_entries(&c->holders);
+        slab_free(&content_pool, c);
+    }
+}
+
+// ----------------------------
+// FUNCIONES PARA EL MANEJO DE USUARIOS (register, unregister, connect, disconnect, list_users)
+// ----------------------------
+
+// Crea y enlaza un usuario nuevo (desconectado). Requiere user_mutex.
+// 0 OK, 1 ya existe, 2 error.
+static int add_user_locked(const char* name) {
+    // Verifica si el usuario ya existe
+    if (find_user(name) != NULL) return 1; // Usuario ya existe
+
+    // Para crear nuevo nodo (usuario)
+    User* new_user = slab_alloc(&user_pool);
+    if (!new_user) return 2; // Error
+
+    // Inicializamos todos los campos del usuario antes de publicarlo
+    new_user->name = intern_acquire(name, MAX_NAME_LEN - 1);
+    if (!new_user->name) {
+        slab_free(&user_pool, new_user);
+        return 2; // Error
+    }
+    atomic_init(&new_user->endpoint, NULL);
+    atomic_init(&new_user->files, NULL);
+    atomic_init(&new_user->marks, NULL);
+    new_user->unmarked = 0;
+    new_user->handouts = 0;
+    atomic_init(&new_user->last_seen_us, 0);
+    timer_node_init(&new_user->alive);
+    new_user->prev = NULL;
+    atomic_init(&new_user->next, atomic_load(&user_list));
+
+    if (strmap_put(&user_map, new_user->name, new_user) != 0) {
+        intern_release(new_user->name);
+        slab_free(&user_pool, new_user);
+        return 2; // Error
+    }
+
+    User* head = atomic_load(&user_list);
+    if (head) head->prev = new_user;
+    atomic_store_explicit(&user_list, new_user, memory_order_release);
+    return 0; // OK
+}
+
+int register_user(const char* name) {
+    metrics_lock(&user_mutex);
+
+    int result = add_user_locked(name);
+    if (result == 0) wal_append(WAL_REGISTER, name, NULL, NULL);
+
+    metrics_unlock(&user_mutex);
+    return result;
+}
+
+
+int unregister_user(const char* name) {
+    metrics_lock(&user_mutex);
+
+    User* current = strmap_remove(&user_map, name);
+    if (current == NULL) {
+        metrics_unlock(&user_mutex);
+        return 1; // Usuario no encontrado
+    }
+
+    // Desenlazar. current->next no se toca: un lector parado en current
+    // sigue pudiendo avanzar.
+    User* next = current->next;
+    if (current->prev == NULL) {
+        atomic_store_explicit(&user_list, next, memory_order_release);
+    } else {
+        atomic_store_explicit(&current->prev->next, next, memory_order_release);
+    }
+    if (next) next->prev = current->prev;
+    if (current->endpoint) {
+        atomic_fetch_add(&users_generation, 1);
+        connected_count--;
+        presence_record(PRESENCE_DISCONNECT, current->name, NULL, 0);
+    }
+    timer_wheel_del(&current->alive);
+
+    wal_append(WAL_UNREGISTER, current->name, NULL, NULL);
+
+    for (FileEntry* f = current->files; f; f = f->next) {
+        file_index_remove(f);
+        file_release_strings(f);
+        file_count--;
+    }
+    intern_release(current->name);
+    epoch_retire(current, user_free);
+
+    metrics_unlock(&user_mutex);
+    return 0; // OK
+}
+
+int connect_user(const char* name, const char* ip, int port) {
+    metrics_lock(&user_mutex);
+
+    User* current = find_user(name);
+    if (current == NULL) {
+        metrics_unlock(&user_mutex);
+        return 1; // Usuario no existe
+    }
+
+    if (current->endpoint != NULL) {
+        metrics_unlock(&user_mutex);
+        return 2; // Ya conectado
+    }
+
+    Endpoint* ep = slab_alloc(&endpoint_pool);
+    if (!ep) {
+        metrics_unlock(&user_mutex);
+        return 3; // Error
+    }
+    strncpy(ep->ip, ip, INET_ADDRSTRLEN - 1);
+    ep->ip[INET_ADDRSTRLEN - 1] = '\0';
+    ep->port = port;
+    atomic_store_explicit(&current->endpoint, ep, memory_order_release);
+    atomic_fetch_add(&users_generation, 1);
+    connected_count++;
+    presence_record(PRESENCE_CONNECT, current->name, ep->ip, ep->port);
+
+    uint64_t now = monotonic_us();
+    atomic_store_explicit(&current->last_seen_us, now, memory_order_relaxed);
+    if (liveness_timeout_us) {
+        timer_wheel_add(&liveness_wheel, &current->alive, liveness_tick(now + liveness_timeout_us));
+    }
+
+    metrics_unlock(&user_mutex);
+    return 0; // OK
+}
+
+// Deja desconectado a un usuario conectado. Requiere user_mutex.
+static void drop_endpoint_locked(User* u) {
+    Endpoint* ep = u->endpoint;
+    atomic_store_explicit(&u->endpoint, NULL, memory_order_release);
+    atomic_fetch_add(&users_generation, 1);
+    connected_count--;
+    presence_record(PRESENCE_DISCONNECT, u->name, NULL, 0);
+    timer_wheel_del(&u->alive);
+    epoch_retire(ep, endpoint_free);
+}
+
+int disconnect_user(const char* name) {
+    metrics_lock(&user_mutex);
+
+    User* current = find_user(name);
+    if (current == NULL) {
+        metrics_unlock(&user_mutex);
+        return 1; // Usuario no existe
+    }
+
+    if (current->endpoint == NULL) {
+        metrics_unlock(&user_mutex);
+        return 2; // Usuario no está conectado
+    }
+
+    drop_endpoint_locked(current);
+
+    metrics_unlock(&user_mutex);
+    return 0; // OK
+}
+
+// ----------------------------
+// CADUCIDAD (HEARTBEAT y rueda de temporizadores)
+// ----------------------------
+
+void registry_set_liveness(uint64_t timeout_us) {
+    metrics_lock(&user_mutex);
+    timer_wheel_init(&liveness_wheel, liveness_tick(monotonic_us()));
+    liveness_timeout_us = timeout_us;
+    metrics_unlock(&user_mutex);
+}
+
+uint64_t registry_liveness_timeout(void) {
+    return liveness_timeout_us;
+}
+
+// Sólo apunta la hora: el temporizador no se toca hasta que vence
+int registry_touch(const char* name) {
+    epoch_enter();
+    User* u = find_user(name);
+    int result = !u ? 1 : atomic_load_explicit(&u->endpoint, memory_order_acquire) ? 0 : 2;
+    if (result == 0) atomic_store_explicit(&u->last_seen_us, monotonic_us(), memory_order_relaxed);
+    epoch_exit();
+    return result;
+}
+
+typedef struct {
+    uint64_t now;
+    int expired;
+    void (*fn)(const char* name, const Endpoint* ep, void* ctx);
+    void* ctx;
+} ExpireRun;
+
+static void liveness_fire(TimerNode* n, void* arg) {
+    ExpireRun* run = arg;
+    User* u = (User*)((char*)n - offsetof(User, alive));
+
+    // Ha dado señales desde que se programó: se aplaza hasta su nuevo plazo
+    uint64_t deadline = atomic_load_explicit(&u->last_seen_us, memory_order_relaxed) + liveness_timeout_us;
+    if (deadline > run->now) {
+        timer_wheel_add(&liveness_wheel, n, liveness_tick(deadline));
+        return;
+    }
+
+    if (run->fn) run->fn(u->name, u->endpoint, run->ctx);
+    drop_endpoint_locked(u);
+    expired_count++;
+    run->expired++;
+}
+
+int registry_expire(void (*expired)(const char* name, const Endpoint* ep, void* ctx), void* ctx) {
+    if (!liveness_timeout_us) return 0;
+    ExpireRun run = { monotonic_us(), 0, expired, ctx };
+    metrics_lock(&user_mutex);
+    timer_wheel_advance(&liveness_wheel, liveness_tick(run.now), liveness_fire, &run);
+    metrics_unlock(&user_mutex);
+    return run.expired;
+}
+
+// Construye la imagen de LIST_USERS de la generación gen en una sola pasada,
+// leyendo el endpoint de cada usuario una única vez para que IP y puerto
+// casen. Requiere estar en una sección de época.
+static UsersImage* build_users_image(uint64_t gen) {
+    // Las entradas se escriben detrás de un hueco para el código y el contador
+    const int header = 16;
+    int capacity = 1024;
+    int pos = header;
+    int count = 0;
+    UsersImage* img = malloc(sizeof(UsersImage) + capacity);
+    if (!img) return NULL;
+
+    for (User* u = atomic_load_explicit(&user_list, memory_order_acquire); u;
+         u = atomic_load_explicit(&u->next, memory_order_acquire)) {
+        Endpoint* ep = atomic_load_explicit(&u->endpoint, memory_order_acquire);
+        if (!ep) continue;
+
+        int need = MAX_NAME_LEN + INET_ADDRSTRLEN + 16;
+        if (pos + need > capacity) {
+            while (pos + need > capacity) capacity *= 2;
+            UsersImage* bigger = realloc(img, sizeof(UsersImage) + capacity);
+            if (!bigger) {
+                free(img);
+                return NULL;
+            }
+            img = bigger;
+        }
+        pos += snprintf(img->data + pos, capacity - pos, "%s", u->name) + 1;
+        pos += snprintf(img->data + pos, capacity - pos, "%s", ep->ip) + 1;
+        pos += snprintf(img->data + pos, capacity - pos, "%d", ep->port) + 1;
+        count++;
+    }
+
+    // Colocar el código de éxito y el contador y pegarles las entradas
+    img->data[0] = 0;
+    int count_len = snprintf(img->data + 1, header - 1, "%d", count) + 1;
+    memmove(img->data + 1 + count_len, img->data + header, pos - header);
+
+    img->generation = gen;
+    img->len = 1 + count_len + pos - header;
+    return img;
+}
+
+// Deja en *out la respuesta completa de LIST_USERS (código 0 incluido). La
+// imagen se reconstruye sólo si ha habido CONNECT/DISCONNECT desde la
+// última; si no, es la misma para todas las peticiones. Requiere estar en
+// una sección de época mientras se usa *out.
+int list_connected_users(const char* requester, const UsersImage** out) {
+    if (!requester) return connected_users_image(out); // Ya comprobado en su shard
+
+    User* req = find_user(requester);
+    if (!req) return 1; // Usuario que realiza la operación no existe
+    if (atomic_load_explicit(&req->endpoint, memory_order_acquire) == NULL) {
+        return 2; // Usuario no conectado
+    }
+    return connected_users_image(out);
+}
+
+// La misma imagen sin comprobar quién la pide (fotos de WATCH_USERS).
+// Refleja como mínimo todos los cambios con seq <= presence_seq() leído antes.
+int connected_users_image(const UsersImage** out) {
+    uint64_t gen = atomic_load(&users_generation);
+    UsersImage* img = atomic_load_explicit(&users_image, memory_order_acquire);
+    if (img && img->generation == gen) {
+        *out = img;
+        return 0;
+    }
+
+    // Caché obsoleta: la reconstruye un solo hilo y el resto la reutiliza
+    pthread_mutex_lock(&image_mutex);
+    gen = atomic_load(&users_generation);
+    img = atomic_load(&users_image);
+    if (!img || img->generation != gen) {
+        UsersImage* fresh = build_users_image(gen);
+        if (!fresh) {
+            pthread_mutex_unlock(&image_mutex);
+            return 4; // Error de memoria
+        }
+        atomic_store_explicit(&users_image, fresh, memory_order_release);
+        epoch_retire(img, free);
+        img = fresh;
+    }
+    pthread_mutex_unlock(&image_mutex);
+
+    *out = img;
+    return 0;
+}
+
+
+// ----------------------------
+// MARCAS PARA PAGINAR (seq -> sitio de la lista del usuario)
+// ----------------------------
+//
+// Una marca cada FILE_MARK_EVERY publicaciones de un usuario, en orden de
+// seq. at es la primera publicación viva con seq <= la de la marca: al
+// borrar una publicación, las marcas que la apuntaban pasan a su siguiente.
+// Así LIST_CONTENT_PAGE busca la marca por encima del cursor y sólo recorre
+// lo que hay entre ella y el cursor, en vez de la lista desde head.
+// Escrituras con user_mutex; los lectores, dentro de la época.
+
+#define FILE_MARK_EVERY 64
+
+typedef struct {
+    uint32_t seq;                  // seq de la publicación marcada (no cambia)
+    FileEntry* _Atomic at;         // NULL = no queda ninguna con seq <= seq
+} FileMark;
+
+typedef struct FileMarks {
+    _Atomic int count;
+    int capacity;
+    FileMark marks[];
+} FileMarks;
+
+// Primera marca con seq >= seq (count si no hay)
+static int marks_lower_bound(const FileMarks* m, int count, uint32_t seq) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m->marks[mid].seq < seq) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Marca f si le toca (f es la publicación más nueva del usuario, aunque en
+// un lote todavía no esté publicada). Al crecer el array se quitan las
+// marcas que apuntan al mismo sitio que la siguiente: con muchos borrados
+// hay como mucho una por publicación viva. Sin memoria no pasa nada: sólo
+// se salta menos.
+static void file_marks_add(User* user, FileEntry* f) {
+    if (++user->unmarked < FILE_MARK_EVERY) return;
+    user->unmarked = 0;
+
+    FileMarks* m = user->marks;
+    int count = m ? m->count : 0;
+    if (!m || count == m->capacity) {
+        int capacity = count < 8 ? 16 : count * 2;
+        FileMarks* bigger = malloc(sizeof(FileMarks) + capacity * sizeof(FileMark));
+        if (!bigger) return;
+        int kept = 0;
+        for (int i = 0; i < count; i++) {
+            FileEntry* at = m->marks[i].at;
+            if (i + 1 < count && m->marks[i + 1].at == at) continue;
+            bigger->marks[kept].seq = m->marks[i].seq;
+            atomic_init(&bigger->marks[kept].at, at);
+            kept++;
+        }
+        atomic_init(&bigger->count, kept);
+        bigger->capacity = capacity;
+        atomic_store_explicit(&user->marks, bigger, memory_order_release);
+        epoch_retire(m, free);
+        m = bigger;
+        count = kept;
+    }
+
+    m->marks[count].seq = f->seq;
+    atomic_init(&m->marks[count].at, f);
+    atomic_store_explicit(&m->count, count + 1, memory_order_release);
+}
+
+// f se acaba de desenlazar: las marcas que la apuntaban (van seguidas desde
+// la primera con seq >= f->seq) pasan a la siguiente publicación.
+static void file_marks_forget(User* user, FileEntry* f) {
+    FileMarks* m = user->marks;
+    if (!m) return;
+    int count = m->count;
+    for (int i = marks_lower_bound(m, count, f->seq); i < count && m->marks[i].at == f; i++) {
+        atomic_store_explicit(&m->marks[i].at, f->next, memory_order_release);
+    }
+}
+
+// Desde dónde buscar seq < cursor: la marca más baja con seq >= cursor. Las
+// marcas por encima de head (lote aún sin publicar o publicación posterior)
+// no valen, y entonces se empieza por head. Dentro de la época.
+static FileEntry* file_marks_seek(const User* user, FileEntry* head, uint32_t cursor) {
+    const FileMarks* m = atomic_load_explicit(&user->marks, memory_order_acquire);
+    if (!head || !m || cursor > head->seq) return head;
+
+    int count = atomic_load_explicit(&m->count, memory_order_acquire);
+    int i = marks_lower_bound(m, count, cursor);
+    if (i == count || m->marks[i].seq > head->seq) return head;
+    return atomic_load_explicit(&m->marks[i].at, memory_order_acquire);
+}
+
+
+// ----------------------------
+// FUNCIONES PARA LA GESTIÓN DE ARCHIVOS (publish, delete, list_content, get_file)
+// ----------------------------
+
+// ¿Ha publicado ya user este nombre? Requiere user_mutex. Se mira en el
+// índice global (casi siempre uno o pocos dueños); sólo con nombres muy
+// repetidos sale más a cuenta recorrer la lista del usuario desde head.
+#define OWNERS_SCAN_MAX 32
+
+static int user_has_file(const User* user, const FileEntry* head, const char* filename) {
+    const char* key = intern_find(filename);
+    if (!key) return 0; // Nadie lo ha publicado
+    FileOwners* owners = *(FileOwners**)intern_data(key);
+    if (!owners) return 0; // Sólo existe como descripción
+
+    if (owners->count <= OWNERS_SCAN_MAX) {
+        for (int i = 0; i < owners->count; i++) {
+            if (owners->entries[i]->owner == user) return 1;
+        }
+        return 0;
+    }
+    for (const FileEntry* f = head; f; f = f->next) {
+        if (f->filename == key) return 1;
+    }
+    return 0;
+}
+
+// Crea la publicación delante de *head sin publicarla en user->files (un
+// lote entero se publica de una vez). Con hash entra también en el índice
+// de contenido. Requiere user_mutex.
+// 0 OK, 3 ya publicado, 4 error de memoria (o hash con otro tamaño).
+static int link_file_locked(User* user, FileEntry** head, const char* filename, const char* description,
+                            const char* hash, uint64_t size) {
+    if (user_has_file(user, *head, filename)) return 3; // Archivo ya publicado
+
+    // Crear nuevo archivo
+    FileEntry* new_file = slab_alloc(&file_pool);
+    if (!new_file) return 4; // Error de memoria
+
+    new_file->filename = intern_acquire(filename, 255);
+    new_file->description = intern_acquire(description, 255);
+    if (!new_file->filename || !new_file->description) {
+        file_release_strings(new_file);
+        slab_free(&file_pool, new_file);
+        return 4; // Error de memoria
+    }
+    new_file->owner = user;
+    new_file->content = NULL;
+    new_file->seq = ++file_seq;
+    atomic_init(&new_file->next, *head);
+
+    if (file_index_add(new_file) < 0) {
+        file_release_strings(new_file);
+        slab_free(&file_pool, new_file);
+        return 4; // Error de memoria
+    }
+    if (hash && content_index_add(new_file, hash, size) != 0) {
+        file_index_remove(new_file);
+        file_release_strings(new_file);
+        slab_free(&file_pool, new_file);
+        return 4; // Sin memoria o el hash ya está con otro tamaño
+    }
+
+    *head = new_file;
+    file_marks_add(user, new_file);
+    file_count++;
+    return 0; // OK
+}
+
+// Añade una publicación al usuario. Requiere user_mutex.
+// 0 OK, 3 ya publicado, 4 error de memoria.
+static int add_file_locked(User* user, const char* filename, const char* description,
+                           const char* hash, uint64_t size) {
+    FileEntry* head = user->files;
+    int result = link_file_locked(user, &head, filename, description, hash, size);
+    if (result == 0) atomic_store_explicit(&user->files, head, memory_order_release);
+    return result;
+}
+
+// Quita una publicación del usuario. Requiere user_mutex. 0 OK, 3 no existe.
+static int remove_file_locked(User* user, const char* filename) {
+    FileEntry* prev = NULL;
+    FileEntry* current = user->files;
+
+    while (current) {
+        if (strcmp(current->filename, filename) == 0) {
+            FileEntry* next = current->next;
+            if (prev == NULL) {
+                atomic_store_explicit(&user->files, next, memory_order_release);
+            } else {
+                atomic_store_explicit(&prev->next, next, memory_order_release);
+            }
+            file_marks_forget(user, current);
+            file_index_remove(current);
+            file_release_strings(current);
+            epoch_retire(current, file_free);
+            file_count--;
+            return 0; // OK
+        }
+        prev = current;
+        current = current->next;
+    }
+    return 3; // Archivo no encontrado
+}
+
+static int publish_common(const char* username, const char* filename, const char* description,
+                          const char* hash, uint64_t size) {
+    metrics_lock(&user_mutex);
+
+    User* user = find_user(username);
+    if (user == NULL) {
+        metrics_unlock(&user_mutex);
+        return 1; // Usuario no existe
+    }
+
+    if (user->endpoint == NULL) {
+        metrics_unlock(&user_mutex);
+        return 2; // Usuario no conectado
+    }
+
+    int result = hash && !valid_hash(hash) ? 4 : add_file_locked(user, filename, description, hash, size);
+    if (result == 0) {
+        FileEntry* added = user->files;
+        wal_append(WAL_PUBLISH, user->name, added->filename, added->description);
+        if (added->content) {
+            char content[CONTENT_HASH_MAX + 24];
+            format_content(added->content, content, sizeof(content));
+            wal_append(WAL_CONTENT, user->name, added->filename, content);
+        }
+    }
+
+    metrics_unlock(&user_mutex);
+    return result;
+}
+
+int publish_file(const char* username, const char* filename, const char* description) {
+    return publish_common(username, filename, description, NULL, 0);
+}
+
+int publish_file_content(const char* username, const char* filename, const char* description,
+                         const char* hash, uint64_t size) {
+    return publish_common(username, filename, description, hash, size);
+}
+
+// PUBLISH_BATCH: todas las entradas con un solo user_mutex y la lista del
+// usuario publicada de una vez (un lector ve el lote entero o nada).
+// results[i] = 0 OK, 3 ya publicado, 4 error de memoria.
+int publish_files(const char* username, int n, const char* const* filenames,
+                  const char* const* descriptions, char* results, int* applied) {
+    *applied = 0;
+    metrics_lock(&user_mutex);
+
+    User* user = find_user(username);
+    if (user == NULL) {
+        metrics_unlock(&user_mutex);
+        return 1; // Usuario no existe
+    }
+
+    if (user->endpoint == NULL) {
+        metrics_unlock(&user_mutex);
+        return 2; // Usuario no conectado
+    }
+
+    FileEntry* head = user->files;
+    for (int i = 0; i < n; i++) {
+        results[i] = (char)link_file_locked(user, &head, filenames[i], descriptions[i], NULL, 0);
+        if (results[i] == 0) {
+            wal_append(WAL_PUBLISH, user->name, head->filename, head->description);
+            (*applied)++;
+        }
+    }
+    atomic_store_explicit(&user->files, head, memory_order_release);
+
+    metrics_unlock(&user_mutex);
+    return 0;
+}
+
+// DELETE_BATCH: una sola pasada por la lista del usuario, con los nombres
+// pedidos en una tabla temporal (punteros internados).
+// results[i] = 0 OK, 3 no publicado (o repetido en el lote), 4 error de memoria.
+int delete_files(const char* username, int n, const char* const* filenames,
+                 char* results, int* applied) {
+    *applied = 0;
+    int mask = 15;
+    while (mask + 1 < 2 * n) mask = mask * 2 + 1;
+    int* table = malloc((mask + 1) * sizeof(int));
+    const char** keys = malloc((n > 0 ? n : 1) * sizeof(char*));
+    if (!table || !keys) {
+        free(table);
+        free(keys);
+        for (int i = 0; i < n; i++) results[i] = 4;
+        return 0;
+    }
+    for (int k = 0; k <= mask; k++) table[k] = -1;
+
+    metrics_lock(&user_mutex);
+
+    User* user = find_user(username);
+    if (user == NULL || user->endpoint == NULL) {
+        metrics_unlock(&user_mutex);
+        free(table);
+        free(keys);
+        return user ? 2 : 1; // Usuario no existe / no conectado
+    }
+
+    int pending = 0;
+    for (int i = 0; i < n; i++) {
+        results[i] = 3; // Archivo no encontrado (hasta encontrarlo)
+        const char* key = keys[i] = intern_find(filenames[i]);
+        if (!key) continue;
+        for (int slot = pointer_hash(key) & mask; ; slot = (slot + 1) & mask) {
+            if (table[slot] < 0) {
+                table[slot] = i;
+                pending++;
+                break;
+            }
+            if (keys[table[slot]] == key) break; // Repetido: el primero se lo lleva
+        }
+    }
+
+    FileEntry* prev = NULL;
+    FileEntry* current = user->files;
+    while (current && pending > 0) {
+        FileEntry* next = current->next;
+        int found = -1;
+        for (int slot = pointer_hash(current->filename) & mask; table[slot] >= 0; slot = (slot + 1) & mask) {
+            if (keys[table[slot]] == current->filename) {
+                found = table[slot];
+                break;
+            }
+        }
+        if (found < 0) {
+            prev = current;
+            current = next;
+            continue;
+        }
+
+        if (prev == NULL) {
+            atomic_store_explicit(&user->files, next, memory_order_release);
+        } else {
+            atomic_store_explicit(&prev->next, next, memory_order_release);
+        }
+        wal_append(WAL_DELETE, user->name, current->filename, NULL);
+        file_marks_forget(user, current);
+        file_index_remove(current);
+        file_release_strings(current);
+        epoch_retire(current, file_free);
+        file_count--;
+        results[found] = 0;
+        (*applied)++;
+        pending--;
+        current = next;
+    }
+
+    metrics_unlock(&user_mutex);
+    free(table);
+    free(keys);
+    return 0;
+}
+
+int delete_file(const char* username, const char* filename) {
+    metrics_lock(&user_mutex);
+
+    User* user = find_user(username);
+    if (user == NULL) {
+        metrics_unlock(&user_mutex);
+        return 1; // Usuario no existe
+    }
+
+    if (user->endpoint == NULL) {
+        metrics_unlock(&user_mutex);
+        return 2; // No conectado
+    }
+
+    int result = remove_file_locked(user, filename);
+    if (result == 0) wal_append(WAL_DELETE, user->name, filename, NULL);
+
+    metrics_unlock(&user_mutex);
+    return result;
+}
+
+// Sin lock. Cada archivo de la página se entrega a visit dentro de la
+// época (el FileEntry y sus cadenas sólo valen durante la llamada); con
+// cursor se empieza por la marca más cercana (file_marks_seek).
+int list_user_files(const char* requester, const char* target, uint32_t cursor, int limit,
+                    void (*visit)(const FileEntry* f, void* ctx), void* ctx, uint32_t* next) {
+    *next = 0;
+    epoch_enter();
+
+    User* req = requester ? find_user(requester) : NULL;
+    User* tgt = find_user(target);
+
+    if (requester && !req) {
+        epoch_exit();
+        return 1; // Usuario que realiza la operación no existe
+    }
+
+    if (req && atomic_load_explicit(&req->endpoint, memory_order_acquire) == NULL) {
+        epoch_exit();
+        return 2; // Usuario no conectado
+    }
+
+    if (!tgt) {
+        epoch_exit();
+        return 3; // Usuario remoto no existe
+    }
+
+    // La lista va de más nuevo a más viejo, así que el cursor es el seq del
+    // último archivo de la página anterior
+    FileEntry* head = atomic_load_explicit(&tgt->files, memory_order_acquire);
+    int count = 0;
+    for (FileEntry* f = cursor ? file_marks_seek(tgt, head, cursor) : head; f;
+         f = atomic_load_explicit(&f->next, memory_order_acquire)) {
+        if (cursor && f->seq >= cursor) continue;
+        if (count == limit) {
+            *next = cursor;
+            break;
+        }
+        visit(f, ctx);
+        cursor = f->seq;
+        count++;
+    }
+    epoch_exit();
+    return 0;
+}
+
+// Busca qué usuarios conectados han publicado un archivo.
+// Deja en *out una respuesta "count\0nombre\0ip\0puerto\0..." reservada con malloc.
+int search_file(const char* requester, const char* filename, char** out, int* out_len) {
+    metrics_lock(&user_mutex);
+
+    User* req = requester ? find_user(requester) : NULL;
+    if (requester && !req) {
+        metrics_unlock(&user_mutex);
+        return 1; // Usuario que realiza la operación no existe
+    }
+
+    if (req && req->endpoint == NULL) {
+        metrics_unlock(&user_mutex);
+        return 2; // Usuario no conectado
+    }
+
+    const char* key = intern_find(filename);
+    FileOwners* owners = key ? *(FileOwners**)intern_data(key) : NULL;
+    int n = owners ? owners->count : 0;
+
+    // Cota superior: contador + (nombre, ip, puerto) por cada publicación
+    int max_len = 16 + n * (MAX_NAME_LEN + INET_ADDRSTRLEN + 8);
+    char* buffer = malloc(max_len);
+    if (!buffer) {
+        metrics_unlock(&user_mutex);
+        return 4; // Error de memoria
+    }
+
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (owners->entries[i]->owner->endpoint) count++;
+    }
+
+    int pos = snprintf(buffer, max_len, "%d", count) + 1;
+    for (int i = 0; i < n; i++) {
+        User* u = owners->entries[i]->owner;
+        Endpoint* ep = u->endpoint;
+        if (!ep) continue;
+        pos += snprintf(buffer + pos, max_len - pos, "%s", u->name) + 1;
+        pos += snprintf(buffer + pos, max_len - pos, "%s", ep->ip) + 1;
+        pos += snprintf(buffer + pos, max_len - pos, "%d", ep->port) + 1;
+    }
+
+    metrics_unlock(&user_mutex);
+    *out = buffer;
+    *out_len = pos;
+    return 0;
+}
+
+// Para get_file: copia en *out la dirección del dueño si tiene el archivo.
+// 0 OK, 1 archivo no existe, 2 algún usuario no existe o no está conectado.
+int resolve_file(const char* requester, const char* target, const char* filename, Endpoint* out) {
+    epoch_enter();
+
+    User* req = requester ? find_user(requester) : NULL;
+    if (requester && (!req || atomic_load_explicit(&req->endpoint, memory_order_acquire) == NULL)) {
+        epoch_exit();
+        return 2; // Usuario no existe o no conectado
+    }
+
+    User* tgt = find_user(target);
+    Endpoint* ep = tgt ? atomic_load_explicit(&tgt->endpoint, memory_order_acquire) : NULL;
+    if (!ep) {
+        epoch_exit();
+        return 2; // Usuario destino no existe o no conectado
+    }
+
+    int result = 1; // Archivo no existe
+    for (FileEntry* f = atomic_load_explicit(&tgt->files, memory_order_acquire); f;
+         f = atomic_load_explicit(&f->next, memory_order_acquire)) {
+        if (strcmp(f->filename, filename) == 0) {
+            *out = *ep;
+            result = 0;
+            break;
+        }
+    }
+
+    epoch_exit();
+    return result;
+}
+
+// Candidato de resolve_sources
+typedef struct {
+    FileEntry* file;
+    uint64_t tiebreak;
+} Source;
+
+static int cmp_source_owner(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)((const Source*)a)->file->owner;
+    uintptr_t y = (uintptr_t)((const Source*)b)->file->owner;
+    return x < y ? -1 : x > y;
+}
+
+// Menos veces dado como fuente primero; los empates, barajados en cada llamada
+static int cmp_source_rank(const void* a, const void* b) {
+    const Source* x = a;
+    const Source* y = b;
+    if (x->file->owner->handouts != y->file->owner->handouts) {
+        return x->file->owner->handouts < y->file->owner->handouts ? -1 : 1;
+    }
+    return x->tiebreak < y->tiebreak ? -1 : x->tiebreak > y->tiebreak;
+}
+
+// Con user_mutex, como search_file: se leen los dueños del contenido y se
+// apunta a quién se ha dado, para que el siguiente reparta hacia otros.
+int resolve_sources(const char* requester, const char* target, const char* filename, int max,
+                    char** out, int* out_len) {
+    metrics_lock(&user_mutex);
+
+    User* req = requester ? find_user(requester) : NULL;
+    if (requester && (!req || req->endpoint == NULL)) {
+        metrics_unlock(&user_mutex);
+        return 2; // Usuario no existe o no conectado
+    }
+
+    User* tgt = find_user(target);
+    if (!tgt) {
+        metrics_unlock(&user_mutex);
+        return 3; // Usuario remoto no existe
+    }
+
+    const char* key = intern_find(filename);
+    FileEntry* file = NULL;
+    for (FileEntry* f = key ? tgt->files : NULL; f; f = f->next) {
+        if (f->filename == key) {
+            file = f;
+            break;
+        }
+    }
+    if (!file) {
+        metrics_unlock(&user_mutex);
+        return 1; // Archivo no existe
+    }
+
+    // Sin hash sólo lo tiene el propio target
+    FileContent* c = file->content;
+    int n = c ? c->holders.count : 1;
+    Source* src = malloc(n * sizeof(Source));
+    int max_len = 64 + CONTENT_HASH_MAX + n * (2 * MAX_NAME_LEN + INET_ADDRSTRLEN + 8);
+    char* buffer = malloc(max_len);
+    if (!src || !buffer) {
+        metrics_unlock(&user_mutex);
+        free(src);
+        free(buffer);
+        return 4; // Error de memoria
+    }
+
+    // Conectados y uno por usuario (puede tener los mismos bytes con dos nombres)
+    uint64_t round = ++sources_round;
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        FileEntry* f = c ? c->holders.entries[i] : file;
+        if (!f->owner->endpoint) continue;
+        src[count].file = f;
+        src[count].tiebreak = pointer_hash(f->owner) ^ (round * 0x9E3779B97F4A7C15ULL);
+        count++;
+    }
+    qsort(src, count, sizeof(Source), cmp_source_owner);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || src[unique - 1].file->owner != src[i].file->owner) src[unique++] = src[i];
+    }
+    qsort(src, unique, sizeof(Source), cmp_source_rank);
+    if (unique > max) unique = max;
+
+    int pos = 0;
+    if (c) {
+        pos += snprintf(buffer, max_len, "%llu", (unsigned long long)c->size) + 1;
+        pos += snprintf(buffer + pos, max_len - pos, "%s", c->holders.filename) + 1;
+    } else {
+        buffer[pos++] = '\0';
+        buffer[pos++] = '\0';
+    }
+    pos += snprintf(buffer + pos, max_len - pos, "%d", unique) + 1;
+    for (int i = 0; i < unique; i++) {
+        User* u = src[i].file->owner;
+        u->handouts++;
+        pos += snprintf(buffer + pos, max_len - pos, "%s", u->name) + 1;
+        pos += snprintf(buffer + pos, max_len - pos, "%s", u->endpoint->ip) + 1;
+        pos += snprintf(buffer + pos, max_len - pos, "%d", u->endpoint->port) + 1;
+        pos += snprintf(buffer + pos, max_len - pos, "%s", src[i].file->filename) + 1;
+    }
+
+    metrics_unlock(&user_mutex);
+    free(src);
+    *out = buffer;
+    *out_len = pos;
+    return 0;
+}
+
+// Par de resolve_files, para ordenarlos por usuario destino
+typedef struct {
+    const char* target;
+    const char* name;         // Nombre internado (NULL si nadie lo ha publicado)
+    int index;                // Posición en la petición
+    int next_same;            // Otro par del mismo destino con el mismo nombre
+} FileQuery;
+
+static int cmp_query_target(const void* a, const void* b) {
+    return strcmp(((const FileQuery*)a)->target, ((const FileQuery*)b)->target);
+}
+
+int resolve_files(const char* requester, int n, const char* const* targets,
+                  const char* const* filenames, FileResolution* out) {
+    int cap = 16;
+    while (cap < 2 * n) cap *= 2;
+    FileQuery* q = malloc((n > 0 ? n : 1) * sizeof(FileQuery));
+    int* table = malloc(cap * sizeof(int));
+    if (!q || !table) {
+        free(q);
+        free(table);
+        return 4; // Error de memoria
+    }
+
+    epoch_enter();
+
+    User* req = requester ? find_user(requester) : NULL;
+    if (requester && (!req || atomic_load_explicit(&req->endpoint, memory_order_acquire) == NULL)) {
+        epoch_exit();
+        free(q);
+        free(table);
+        return 2; // Usuario no existe o no conectado
+    }
+
+    for (int i = 0; i < n; i++) {
+        q[i].target = targets[i];
+        q[i].name = intern_find(filenames[i]);
+        q[i].index = i;
+        q[i].next_same = -1;
+    }
+    qsort(q, n, sizeof(FileQuery), cmp_query_target);
+
+    // Por cada usuario destino: se busca una vez y se recorre su lista una
+    // sola vez, mirando cada archivo en una tabla con los nombres pedidos.
+    // Los nombres están internados: basta comparar punteros.
+    for (int g = 0; g < n; ) {
+        int end = g + 1;
+        while (end < n && strcmp(q[end].target, q[g].target) == 0) end++;
+
+        User* tgt = find_user(q[g].target);
+        Endpoint* ep = tgt ? atomic_load_explicit(&tgt->endpoint, memory_order_acquire) : NULL;
+        if (!ep) {
+            for (int k = g; k < end; k++) out[q[k].index].code = 2; // Destino no existe o no conectado
+            g = end;
+            continue;
+        }
+
+        int mask = 15;
+        while (mask + 1 < 2 * (end - g)) mask = mask * 2 + 1;
+        for (int k = 0; k <= mask; k++) table[k] = -1;
+        for (int k = g; k < end; k++) {
+            out[q[k].index].code = 1; // Archivo no existe (hasta encontrarlo)
+            if (!q[k].name) continue;
+            for (int slot = pointer_hash(q[k].name) & mask; ; slot = (slot + 1) & mask) {
+                if (table[slot] < 0 || q[table[slot]].name == q[k].name) {
+                    q[k].next_same = table[slot]; // El mismo archivo pedido dos veces
+                    table[slot] = k;
+                    break;
+                }
+            }
+        }
+
+        for (FileEntry* f = atomic_load_explicit(&tgt->files, memory_order_acquire); f;
+             f = atomic_load_explicit(&f->next, memory_order_acquire)) {
+            for (int slot = pointer_hash(f->filename) & mask; table[slot] >= 0; slot = (slot + 1) & mask) {
+                if (q[table[slot]].name != f->filename) continue;
+                for (int k = table[slot]; k >= 0; k = q[k].next_same) {
+                    out[q[k].index].code = 0;
+                    out[q[k].index].endpoint = *ep;
+                }
+                break;
+            }
+        }
+        g = end;
+    }
+
+    epoch_exit();
+    free(q);
+    free(table);
+    return 0;
+}
+
+// ----------------------------
+// MEMORIA (para las métricas)
+// ----------------------------
+
+void registry_memory(RegistryMemory* out) {
+    memset(out, 0, sizeof(*out));
+    size_t reserved;
+
+    metrics_lock(&user_mutex);
+    out->users = user_map.count;
+    out->connected = connected_count;
+    out->files = file_count;
+    out->contents = content_map.count;
+    out->expired = expired_count;
+    out->index_bytes = atomic_load(&user_map.table)->capacity * sizeof(StrMapSlot);
+    intern_usage(&out->strings, &out->string_bytes);
+    metrics_unlock(&user_mutex);
+
+    slab_usage(&user_pool, &out->user_bytes, &reserved);
+    out->reserved += reserved;
+    slab_usage(&file_pool, &out->file_bytes, &reserved);
+    out->reserved += reserved;
+    slab_usage(&endpoint_pool, &out->endpoint_bytes, &reserved);
+    out->reserved += reserved;
+    slab_usage(&owners_pool, &out->owners_bytes, &reserved);
+    out->reserved += reserved;
+    slab_usage(&content_pool, &out->content_bytes, &reserved);
+    out->reserved += reserved;
+    slab_class_usage(&out->class_used, &reserved);
+    out->reserved += reserved;
+}
+
+// ----------------------------
+// PERSISTENCIA (snapshot y recuperación, ver persist.c)
+// ----------------------------
+
+typedef struct DumpBuffer {
+    char* data;
+    size_t len;
+    size_t cap;
+} DumpBuffer;
+
+static int dump_append(DumpBuffer* d, const void* src, size_t n) {
+    if (d->len + n > d->cap) {
+        size_t new_cap = d->cap ? d->cap : 1 << 20;
+        while (d->len + n > new_cap) new_cap *= 2;
+        char* bigger = realloc(d->data, new_cap);
+        if (!bigger) return -1;
+        d->data = bigger;
+        d->cap = new_cap;
+    }
+    memcpy(d->data + d->len, src, n);
+    d->len += n;
+    return 0;
+}
+
+// Serializa el registro entero con el formato del cuerpo del snapshot
+// (persist.h) y rota el WAL en el mismo instante, con user_mutex cogido:
+// el snapshot contiene exactamente los cambios con LSN < *next_lsn.
+// Se recorre desde el final para que al restaurar (insertando por la
+// cabeza) quede el mismo orden.
+void* registry_snapshot(size_t* len, uint64_t* users, uint64_t* files, uint64_t* next_lsn) {
+    DumpBuffer d = { NULL, 0, 0 };
+    *users = *files = 0;
+
+    metrics_lock(&user_mutex);
+
+    *next_lsn = wal_rotate();
+    if (*next_lsn == 0) {
+        metrics_unlock(&user_mutex);
+        return NULL; // WAL cerrado o rotación anterior sin terminar
+    }
+
+    User* tail = user_list;
+    while (tail && tail->next) tail = tail->next;
+
+    FileEntry** stack = NULL;
+    size_t stack_cap = 0;
+    int failed = 0;
+
+    for (User* u = tail; u && !failed; u = u->prev) {
+        uint32_t nfiles = 0;
+        for (FileEntry* f = u->files; f; f = f->next) {
+            if (nfiles == stack_cap) {
+                size_t new_cap = stack_cap ? stack_cap * 2 : 64;
+                FileEntry** bigger = realloc(stack, new_cap * sizeof(FileEntry*));
+                if (!bigger) { failed = 1; break; }
+                stack = bigger;
+                stack_cap = new_cap;
+            }
+            stack[nfiles++] = f;
+        }
+
+        failed |= dump_append(&d, u->name, strlen(u->name) + 1);
+        failed |= dump_append(&d, &nfiles, sizeof(nfiles));
+        for (uint32_t i = nfiles; i > 0 && !failed; i--) {
+            FileEntry* f = stack[i - 1];
+            failed |= dump_append(&d, f->filename, strlen(f->filename) + 1);
+            failed |= dump_append(&d, f->description, strlen(f->description) + 1);
+            char content[CONTENT_HASH_MAX + 24] = "";
+            if (f->content) format_content(f->content, content, sizeof(content));
+            failed |= dump_append(&d, content, strlen(content) + 1);
+        }
+        (*users)++;
+        *files += nfiles;
+    }
+
+    metrics_unlock(&user_mutex);
+    free(stack);
+
+    if (failed) {
+        free(d.data);
+        return NULL;
+    }
+    *len = d.len;
+    return d.data ? d.data : malloc(1);
+}
+
+// Dimensiona los índices antes de restaurar un snapshot, para no ir
+// redimensionando tablas durante la carga
+int registry_reserve(uint64_t users, uint64_t files) {
+    metrics_lock(&user_mutex);
+    int result = strmap_reserve(&user_map, user_map.count + users)
+               | intern_reserve(users + files);
+    metrics_unlock(&user_mutex);
+    return result;
+}
+
+// Restauración: sin comprobar conexión y sin pasar por el WAL
+int registry_restore_user(const char* name) {
+    metrics_lock(&user_mutex);
+    int result = add_user_locked(name);
+    metrics_unlock(&user_mutex);
+    return result;
+}
+
+int registry_restore_file(const char* username, const char* filename, const char* description) {
+    metrics_lock(&user_mutex);
+    User* user = find_user(username);
+    int result = user ? add_file_locked(user, filename, description, NULL, 0) : 1;
+    metrics_unlock(&user_mutex);
+    return result;
+}
+
+int registry_restore_content(const char* username, const char* filename, const char* content) {
+    char hash[CONTENT_HASH_MAX + 1];
+    uint64_t size;
+    if (parse_content(content, hash, &size) < 0) return 4;
+
+    metrics_lock(&user_mutex);
+    User* user = find_user(username);
+    const char* key = intern_find(filename);
+    int result = user && key ? 3 : 1;
+    for (FileEntry* f = user && key ? user->files : NULL; f; f = f->next) {
+        if (f->filename != key) continue;
+        result = f->content ? 3 : content_index_add(f, hash, size) == 0 ? 0 : 4;
+        break;
+    }
+    metrics_unlock(&user_mutex);
+    return result;
+}
+
+int registry_restore_delete(const char* username, const char* filename) {
+    metrics_lock(&user_mutex);
+    User* user = find_user(username);
+    int result = user ? remove_file_locked(user, filename) : 1;
+    metrics_unlock(&user_mutex);
+    return result;
+}
@@ -0,0 +1,192 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include "timer_wheel.h"
+
+// ----------------------------
+// Registro de usuarios y archivos publicados
+// ----------------------------
+//
+// Las escrituras (register, connect, publish...) se serializan con
+// user_mutex. Las lecturas (list_connected_users, list_user_files,
+// resolve_file) no toman ningún lock: recorren las estructuras dentro de
+// una sección de época (epoch.h) y los escritores publican versiones
+// nuevas y retiran las viejas con epoch_retire.
+
+#define MAX_USERS 100
+#define MAX_NAME_LEN 256
+
+// Dirección de escucha de un usuario conectado. Es inmutable: al
+// conectar/desconectar se publica otra (o NULL) y la vieja se retira.
+typedef struct Endpoint {
+    char ip[INET_ADDRSTRLEN];  // Dirección IP del usuario
+    int port;                  // Puerto de conexión del usuario
+} Endpoint;
+
+// Los nombres y descripciones son cadenas internadas (intern.h) y los
+// nodos salen de pools de slab (slab.h): un nodo ocupa unos 40 bytes en
+// lugar de los >512 de los antiguos arrays fijos.
+typedef struct FileEntry {
+    const char* filename;     // Nombre del archivo (internado)
+    const char* description;  // Descripción del archivo (internada)
+    struct User* owner;       // Usuario que lo ha publicado
+    struct FileContent* content;  // Hash y tamaño si se publicó con PUBLISH_CONTENT (NULL si no)
+    int index_pos;            // Posición dentro de su entrada del índice global
+    int content_pos;          // Posición dentro de los dueños de su contenido
+    uint32_t seq;             // Orden de publicación (crece; la lista va de mayor a menor)
+    struct FileEntry* _Atomic next;   // Puntero al siguiente archivo (lista enlazada)
+} FileEntry;
+
+// Entrada del índice invertido: todos los FileEntry publicados con un nombre
+// (cuelga de la cadena internada del nombre, ver intern_data)
+typedef struct FileOwners {
+    const char* filename;     // Nombre del archivo (la misma cadena internada de las publicaciones)
+    FileEntry** entries;      // Array dinámico de publicaciones
+    int count;                // Número de publicaciones
+    int capacity;             // Capacidad del array
+    FileEntry* single;        // Hueco para el primer dueño (entries apunta aquí hasta crecer)
+} FileOwners;
+
+// Índice de contenido: todas las publicaciones con los mismos bytes, sea
+// cual sea su nombre (holders.filename es el hash, internado)
+typedef struct FileContent {
+    FileOwners holders;
+    uint64_t size;
+} FileContent;
+
+#define CONTENT_HASH_MIN 8        // Hash en hexadecimal (minúsculas)
+#define CONTENT_HASH_MAX 128
+
+typedef struct User {
+    const char* name;                  // Nombre del usuario (internado)
+    Endpoint* _Atomic endpoint;        // NULL = desconectado
+    FileEntry* _Atomic files;          // Lista enlazada para los archivos publicados por el usuario
+    struct FileMarks* _Atomic marks;   // Marcas para saltar al cursor de una página (registry.c)
+    uint32_t unmarked;                 // Publicaciones desde la última marca (con user_mutex)
+    uint32_t handouts;                 // Veces que se ha dado como fuente (resolve_sources, con user_mutex)
+    _Atomic uint64_t last_seen_us;     // Última petición o HEARTBEAT (reloj monótono)
+    TimerNode alive;                   // Caducidad mientras está conectado (con user_mutex)
+    struct User* prev;                 // Puntero al usuario anterior (sólo escritores)
+    struct User* _Atomic next;         // Puntero al siguiente usuario (lista enlazada)
+} User;
+
+// Respuesta de LIST_USERS ya serializada ("\0count\0nombre\0ip\0puerto\0...")
+typedef struct UsersImage {
+    uint64_t generation;      // Generación de la lista de conectados que refleja
+    int len;                  // Bytes en data
+    char data[];
+} UsersImage;
+
+// Tamaño del registro (STATS). Los bytes son los entregados por los slabs;
+// las cadenas internadas también están dentro de size_classes.
+typedef struct {
+    size_t users, connected, files, strings, contents;
+    size_t expired;           // Desconectados por caducidad desde el arranque
+    size_t user_bytes, file_bytes, endpoint_bytes, owners_bytes, content_bytes;
+    size_t string_bytes;      // Cadenas internadas (cabecera incluida)
+    size_t index_bytes;       // Tabla hash de usuarios
+    size_t class_used;        // Clases de tamaño del slab (cadenas, imágenes...)
+    size_t reserved;          // Bytes pedidos al sistema por todos los pools
+} RegistryMemory;
+
+// user_mutex se coge con metrics_lock/metrics_unlock (mide espera y retención)
+extern pthread_mutex_t user_mutex;
+
+int registry_init(void);
+
+// Escrituras (toman user_mutex)
+int register_user(const char* name);
+int unregister_user(const char* name);
+int connect_user(const char* name, const char* ip, int port);
+int disconnect_user(const char* name);
+int publish_file(const char* username, const char* filename, const char* description);
+// PUBLISH_CONTENT: además entra en el índice de contenido. 4 si el hash no
+// es válido o ya hay otro contenido con ese hash y distinto tamaño.
+int publish_file_content(const char* username, const char* filename, const char* description,
+                         const char* hash, uint64_t size);
+int delete_file(const char* username, const char* filename);
+// Lotes: un código por entrada en results y en *applied las aplicadas.
+// Devuelven 1/2 (usuario no existe / no conectado) o 0.
+int publish_files(const char* username, int n, const char* const* filenames,
+                  const char* const* descriptions, char* results, int* applied);
+int delete_files(const char* username, int n, const char* const* filenames,
+                 char* results, int* applied);
+int search_file(const char* requester, const char* filename, char** out, int* out_len);
+
+// Las consultas con requester (search_file y las de abajo) lo comprueban
+// antes que nada; con requester NULL no: en modo shards (shard.h) ya lo ha
+// comprobado su shard, que puede ser otro.
+
+// Lecturas sin lock (list_connected_users dentro de epoch_enter/epoch_exit)
+int list_connected_users(const char* requester, const UsersImage** out);
+int connected_users_image(const UsersImage** out);
+// Recorre hasta limit archivos de target con seq < cursor (0 = desde el
+// principio), del más nuevo al más viejo, llamando a visit con cada uno
+// dentro de la época. *next = seq del último entregado si quedan más, 0 si no.
+// Llegar al cursor cuesta O(log N) más como mucho FILE_MARK_EVERY saltos
+// (marcas de registry.c), así que recorrer todas las páginas es O(N).
+int list_user_files(const char* requester, const char* target, uint32_t cursor, int limit,
+                    void (*visit)(const FileEntry* f, void* ctx), void* ctx, uint32_t* next);
+int resolve_file(const char* requester, const char* target, const char* filename, Endpoint* out);
+
+// Resultado de cada archivo de resolve_files: code 0 (endpoint válido),
+// 1 archivo no existe, 2 usuario destino no existe o no conectado
+typedef struct {
+    int code;
+    Endpoint endpoint;
+} FileResolution;
+
+// Resuelve n pares (targets[i], filenames[i]) en una sola sección de época.
+// Devuelve 2 si requester no existe o no está conectado y 0 si no.
+int resolve_files(const char* requester, int n, const char* const* targets,
+                  const char* const* filenames, FileResolution* out);
+
+// GET_SOURCES: todos los usuarios conectados que tienen los mismos bytes que
+// filename de target (si se publicó con hash; si no, sólo target), hasta
+// max, primero los que menos veces se han dado como fuente. Deja en *out
+// (malloc) "tamaño\0hash\0count\0" y por fuente "nombre\0ip\0puerto\0archivo\0";
+// sin hash, tamaño y hash van vacíos. 0 OK, 1 archivo no existe,
+// 2 requester no existe o no conectado, 3 target no existe, 4 error.
+int resolve_sources(const char* requester, const char* target, const char* filename, int max,
+                    char** out, int* out_len);
+
+// ----------------------------
+// Caducidad de los conectados que dejan de dar señales
+// ----------------------------
+//
+// Cada conectado tiene un temporizador en una rueda (timer_wheel.h) que
+// vence a los timeout_us de su última señal. HEARTBEAT (o cualquier otra
+// petición) sólo apunta la hora, sin lock; al vencer se mira esa hora y,
+// si ha habido señal, se reprograma. Si no, se le desconecta como con
+// DISCONNECT (lista de conectados, WATCH_USERS, fuentes de GET_SOURCES).
+
+#define LIVENESS_TICK_US 100000       // Resolución de la rueda
+
+// timeout_us = 0 la desactiva. Llamar antes de atender peticiones.
+void registry_set_liveness(uint64_t timeout_us);
+uint64_t registry_liveness_timeout(void);
+
+// Señal de vida de un conectado (sin lock): 0 OK, 1 no existe, 2 no conectado
+int registry_touch(const char* name);
+
+// Avanza la rueda hasta ahora, desconecta a los que llevan timeout_us sin
+// señal y llama a expired con cada uno (con user_mutex cogido: sólo
+// encolar, nada lento). Devuelve cuántos. Se llama cada LIVENESS_TICK_US.
+int registry_expire(void (*expired)(const char* name, const Endpoint* ep, void* ctx), void* ctx);
+
+void registry_memory(RegistryMemory* out);
+
+// Persistencia (persist.c)
+void* registry_snapshot(size_t* len, uint64_t* users, uint64_t* files, uint64_t* next_lsn);
+int registry_reserve(uint64_t users, uint64_t files);
+int registry_restore_user(const char* name);
+int registry_restore_file(const char* username, const char* filename, const char* description);
+int registry_restore_delete(const char* username, const char* filename);
+// content = "hash:tamaño" (registro WAL_CONTENT o campo del snapshot)
+int registry_restore_content(const char* username, const char* filename, const char* content);
+
+#endif
@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "rpc_pool.h"
+
+#define READ_CHUNK      65536
+#define MAX_MESSAGE     (16 << 20)   // Llamadas más grandes cierran la conexión
+#define LAST_FRAGMENT   0x80000000u
+#define REPLY_SIZE      1024
+
+typedef struct {
+    int fd;
+    int listener;
+    char* in;               // Bytes leídos aún sin trocear en fragmentos
+    size_t in_len, in_cap;
+    char* msg;              // Llamada en reconstrucción (fragmentos juntados)
+    size_t msg_len, msg_cap;
+} Conn;
+
+static int epfd = -1;
+static const RpcProgram* program = NULL;
+
+static int grow(char** buf, size_t* cap, size_t need) {
+    if (need <= *cap) return 0;
+    size_t new_cap = *cap ? *cap : 4096;
+    while (new_cap < need) new_cap *= 2;
+    char* p = realloc(*buf, new_cap);
+    if (!p) return -1;
+    *buf = p;
+    *cap = new_cap;
+    return 0;
+}
+
+static void rearm(Conn* c) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void close_conn(Conn* c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->msg);
+    free(c);
+}
+
+// ----------------------------
+// Respuestas
+// ----------------------------
+
+static int send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                struct pollfd p = { fd, POLLOUT, 0 };
+                poll(&p, 1, 1000);
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Respuesta aceptada (stat = SUCCESS, PROC_UNAVAIL, ...). results sólo con SUCCESS.
+static int send_reply(Conn* c, uint32_t xid, enum accept_stat stat,
+                      xdrproc_t xdr_result, void* result) {
+    struct rpc_msg reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.rm_xid = xid;
+    reply.rm_direction = REPLY;
+    reply.rm_reply.rp_stat = MSG_ACCEPTED;
+    reply.acpted_rply.ar_verf = _null_auth;
+    reply.acpted_rply.ar_stat = stat;
+    if (stat == SUCCESS) {
+        reply.acpted_rply.ar_results.where = result;
+        reply.acpted_rply.ar_results.proc = xdr_result;
+    } else if (stat == PROG_MISMATCH) {
+        reply.acpted_rply.ar_vers.low = program->vers;
+        reply.acpted_rply.ar_vers.high = program->vers;
+    }
+
+    // Las respuestas pequeñas (las de LOG_ACTION/LOG_BATCH) van en la pila
+    char small[REPLY_SIZE];
+    size_t cap = 4 + xdr_sizeof((xdrproc_t)xdr_replymsg, &reply);
+    char* buf = cap <= sizeof(small) ? small : malloc(cap);
+    if (!buf) return -1;
+
+    XDR x;
+    xdrmem_create(&x, buf + 4, cap - 4, XDR_ENCODE);
+    int ok = xdr_replymsg(&x, &reply);
+    uint32_t len = xdr_getpos(&x);
+    xdr_destroy(&x);
+
+    int sent = -1;
+    if (ok) {
+        uint32_t mark = htonl(LAST_FRAGMENT | len);
+        memcpy(buf, &mark, 4);
+        sent = send_all(c->fd, buf, 4 + len);
+    }
+    if (buf != small) free(buf);
+    return sent;
+}
+
+// ----------------------------
+// Despacho de una llamada completa
+// ----------------------------
+
+static int dispatch(Conn* c) {
+    struct rpc_msg call;
+    char cred_area[2 * MAX_AUTH_BYTES];
+    memset(&call, 0, sizeof(call));
+    call.rm_call.cb_cred.oa_base = cred_area;
+    call.rm_call.cb_verf.oa_base = cred_area + MAX_AUTH_BYTES;
+
+    XDR x;
+    xdrmem_create(&x, c->msg, c->msg_len, XDR_DECODE);
+    if (!xdr_callmsg(&x, &call) || call.rm_direction != CALL) {
+        xdr_destroy(&x);
+        return -1; // Basura: no hay xid fiable al que contestar
+    }
+
+    uint32_t xid = call.rm_xid;
+    const RpcProc* proc = NULL;
+    int result = 0;
+
+    if (call.rm_call.cb_prog != program->prog) {
+        result = send_reply(c, xid, PROG_UNAVAIL, NULL, NULL);
+    } else if (call.rm_call.cb_vers != program->vers) {
+        result = send_reply(c, xid, PROG_MISMATCH, NULL, NULL);
+    } else if (call.rm_call.cb_proc == NULLPROC) {
+        result = send_reply(c, xid, SUCCESS, (xdrproc_t)xdr_void, NULL);
+    } else {
+        for (int i = 0; i < program->nprocs; i++) {
+            if (program->procs[i].proc == call.rm_call.cb_proc) proc = &program->procs[i];
+        }
+        if (!proc) result = send_reply(c, xid, PROC_UNAVAIL, NULL, NULL);
+    }
+    if (!proc) {
+        xdr_destroy(&x);
+        return result;
+    }
+
+    char arg_buf[256], res_buf[64];
+    void* arg = proc->arg_size <= sizeof(arg_buf) ? arg_buf : malloc(proc->arg_size);
+    void* res = proc->result_size <= sizeof(res_buf) ? res_buf : malloc(proc->result_size);
+    memset(arg, 0, proc->arg_size);
+    memset(res, 0, proc->result_size);
+
+    if (!proc->xdr_arg(&x, arg)) {
+        result = send_reply(c, xid, GARBAGE_ARGS, NULL, NULL);
+    } else if (proc->local(arg, res, NULL)) {
+        result = send_reply(c, xid, SUCCESS, proc->xdr_result, res);
+        xdr_free(proc->xdr_result, res);
+    } else {
+        result = send_reply(c, xid, SYSTEM_ERR, NULL, NULL);
+    }
+    xdr_free(proc->xdr_arg, arg);
+    xdr_destroy(&x);
+
+    if (arg != arg_buf) free(arg);
+    if (res != res_buf) free(res);
+    return result;
+}
+
+// Trocea lo leído en fragmentos y despacha cada llamada completa
+static int process_input(Conn* c) {
+    size_t pos = 0;
+    while (c->in_len - pos >= 4) {
+        uint32_t mark;
+        memcpy(&mark, c->in + pos, 4);
+        mark = ntohl(mark);
+        size_t len = mark & ~LAST_FRAGMENT;
+        if (c->msg_len + len > MAX_MESSAGE) return -1;
+        if (c->in_len - pos - 4 < len) break;
+
+        if (grow(&c->msg, &c->msg_cap, c->msg_len + len) < 0) return -1;
+        memcpy(c->msg + c->msg_len, c->in + pos + 4, len);
+        c->msg_len += len;
+        pos += 4 + len;
+
+        if (mark & LAST_FRAGMENT) {
+            if (dispatch(c) < 0) return -1;
+            c->msg_len = 0;
+        }
+    }
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+    return 0;
+}
+
+// Lee todo lo disponible. -1 si la conexión se ha cerrado o hay error.
+static int serve_conn(Conn* c) {
+    while (1) {
+        if (grow(&c->in, &c->in_cap, c->in_len + READ_CHUNK) < 0) return -1;
+        ssize_t n = recv(c->fd, c->in + c->in_len, READ_CHUNK, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        c->in_len += n;
+        if (process_input(c) < 0) return -1;
+    }
+}
+
+static void accept_all(Conn* listener) {
+    while (1) {
+        int fd = accept(listener->fd, NULL, NULL);
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Conn* c = calloc(1, sizeof(Conn));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = c;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+// ----------------------------
+// Workers
+// ----------------------------
+
+static void* worker_main(void* arg) {
+    while (1) {
+        struct epoll_event ev;
+        if (epoll_wait(epfd, &ev, 1, -1) <= 0) continue;
+
+        Conn* c = ev.data.ptr;
+        if (c->listener) {
+            accept_all(c);
+            rearm(c);
+        } else if (serve_conn(c) < 0 || (ev.events & (EPOLLHUP | EPOLLERR))) {
+            close_conn(c);
+        } else {
+            rearm(c);
+        }
+    }
+    return NULL;
+}
+
+int rpc_pool_listen(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int rpc_pool_port(int listen_fd) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(listen_fd, (struct sockaddr*)&addr, &len) < 0) return -1;
+    return ntohs(addr.sin_port);
+}
+
+int rpc_pool_start(int listen_fd, const RpcProgram* prog, int workers) {
+    program = prog;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) return -1;
+
+    Conn* listener = calloc(1, sizeof(Conn));
+    if (!listener) return -1;
+    listener->fd = listen_fd;
+    listener->listener = 1;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = listener;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) return -1;
+
+    for (int i = 0; i < workers; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, worker_main, NULL) != 0) return -1;
+        pthread_detach(tid);
+    }
+    return 0;
+}
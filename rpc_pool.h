@@ -0,0 +1,43 @@
+#ifndef RPC_POOL_H
+#define RPC_POOL_H
+
+#include <stddef.h>
+#include <rpc/rpc.h>
+
+// ----------------------------
+// Servidor ONC RPC (TCP) con un pool de hilos
+// ----------------------------
+//
+// Sustituye a svc_run(), que atiende las llamadas de una en una. Los
+// hilos del pool esperan todos en el mismo epoll; cada conexión se vigila
+// con EPOLLONESHOT, así que la atiende un solo hilo cada vez (las
+// respuestas salen en orden) y conexiones distintas van en paralelo.
+// Habla el mismo protocolo que svctcp: record marking + rpc_msg en XDR,
+// de modo que los clientes de rpcgen (clnt_create/clnttcp_create) sirven
+// tal cual.
+
+// Un procedimiento del programa, con la firma de los stubs de rpcgen -M
+typedef struct {
+    rpcproc_t proc;
+    xdrproc_t xdr_arg;
+    size_t arg_size;
+    xdrproc_t xdr_result;
+    size_t result_size;
+    bool_t (*local)(char* arg, void* result, struct svc_req* rqstp);
+} RpcProc;
+
+typedef struct {
+    rpcprog_t prog;
+    rpcvers_t vers;
+    const RpcProc* procs;
+    int nprocs;
+} RpcProgram;
+
+// Socket de escucha en 0.0.0.0:port (0 = cualquier puerto libre)
+int rpc_pool_listen(int port);
+int rpc_pool_port(int listen_fd);
+
+// Arranca workers hilos que atienden las llamadas a prog en listen_fd
+int rpc_pool_start(int listen_fd, const RpcProgram* prog, int workers);
+
+#endif
@@ -3,10 +3,27 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
 #include <tirpc/rpc/rpc.h>
 #include "log_rpc.h"
+#include "registry.h"
+#include "epoch.h"
+#include "audit_log.h"
+#include "persist.h"
+#include "metrics.h"
+#include "coarse_clock.h"
+#include "presence.h"
+#include "proto.h"
+#include "shard.h"
 
 
 
@@ -14,706 +31,1786 @@
 // Constantes y estructuras
 // ----------------------------
 
-#define MAX_USERS 100
-#define MAX_NAME_LEN 256
 #define BUFFER_SIZE 1024
+#define LIST_PAGE_DEFAULT 500       // Archivos por página de LIST_CONTENT_PAGE si no se pide otro número
+#define LIST_PAGE_MAX 1000          // Tope por respuesta (también para LIST_CONTENT sin páginas)
+#define SOURCES_DEFAULT 8           // Fuentes por GET_SOURCES si no se pide otro número
+#define SOURCES_MAX 64
+#define BATCH_MAX 20000             // Elementos por GET_FILES/PUBLISH_BATCH/DELETE_BATCH
+#define LIVENESS_DEFAULT_SEC 0      // Caducidad de -k: desactivada salvo que se pida (hay clientes sin HEARTBEAT)
 
-typedef struct FileEntry {
-    char filename[256];       // Nombre del archivo
-    char description[256];    // Descripción del archivo
-    struct FileEntry* next;   // Puntero al siguiente archivo (lista enlazada)
-} FileEntry;
+CLIENT *log_clnt = NULL; // Cliente RPC para logging
 
+// Con -n no se imprime una línea por petición (cuesta tiempo en cada una)
+static int log_requests = 1;
+#define log_op(...) do { if (log_requests) printf(__VA_ARGS__); } while (0)
 
-typedef struct User {
-    char name[MAX_NAME_LEN];   // Nombre del usuario
-    int is_connected;          // Flag de conexión (1=conectado, 0=desconectado)
-    char ip[INET_ADDRSTRLEN];  // Dirección IP del usuario
-    int port;                  // Puerto de conexión del usuario
-    FileEntry* files;          // Lista enlazada para los archivos publicados por el usuario
-    struct User* next;         // Puntero al siguiente usuario (lista enlazada)
-} User;
 
-User* user_list = NULL;   // Lista global de usuarios registrados
-CLIENT *log_clnt = NULL; // Cliente RPC para logging
+// ----------------------------
+// Manejo de clientes
+// ----------------------------
 
-pthread_mutex_t user_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Respuesta pendiente de enviar a un cliente
+typedef struct Reply {
+    char* data;
+    int len;
+    int capacity;
+    uint64_t wait_lsn;        // Con WAL: no enviar hasta que este LSN esté en disco (0 = nada)
+} Reply;
+
+static void reply_append(Reply* reply, const void* data, int n) {
+    if (reply->len + n > reply->capacity) {
+        int new_cap = reply->capacity ? reply->capacity : 64;
+        while (new_cap < reply->len + n) new_cap *= 2;
+        char* new_data = realloc(reply->data, new_cap);
+        if (!new_data) return; // Sin memoria: la respuesta se trunca
+        reply->data = new_data;
+        reply->capacity = new_cap;
+    }
+    memcpy(reply->data + reply->len, data, n);
+    reply->len += n;
+}
+
+// Texto de STATS y del endpoint HTTP: métricas generales más la cola de auditoría
+static void render_stats(MetricsText* t) {
+    metrics_render(t);
+
+    AuditStats a;
+    audit_log_stats(&a);
+    metrics_printf(t, "audit_queue_depth %llu\n", (unsigned long long)a.depth);
+    metrics_printf(t, "audit_enqueued_total %llu\n", (unsigned long long)a.enqueued);
+    metrics_printf(t, "audit_shipped_total %llu\n", (unsigned long long)a.shipped);
+    metrics_printf(t, "audit_dropped_total %llu\n", (unsigned long long)a.dropped);
+    metrics_printf(t, "audit_spilled_total %llu\n", (unsigned long long)a.spilled);
+    metrics_printf(t, "audit_batches_total %llu\n", (unsigned long long)a.batches);
+    metrics_printf(t, "audit_failed_batches_total %llu\n", (unsigned long long)a.failed_batches);
+
+    if (shard_enabled()) {
+        ShardStats s;
+        shard_stats(&s);
+        metrics_printf(t, "shard_index %d\n", shard_self());
+        metrics_printf(t, "shard_count %d\n", shard_count());
+        metrics_printf(t, "shard_calls_total %llu\n", (unsigned long long)s.calls);
+        metrics_printf(t, "shard_served_total %llu\n", (unsigned long long)s.served);
+        metrics_printf(t, "shard_failures_total %llu\n", (unsigned long long)s.failures);
+    }
+}
 
 // ----------------------------
-// FUNCIONES PARA EL MANEJO DE USUARIOS (register, unregister, connect, disconnect, list_users)
+// LIST_CONTENT por páginas
 // ----------------------------
 
-int register_user(const char* name) {
-    pthread_mutex_lock(&user_mutex);
+typedef struct {
+    Reply* reply;
+    int with_desc;
+    int count;
+} ListCtx;
+
+// Copia cada archivo directamente del registro a la respuesta
+static void list_visit(const FileEntry* f, void* arg) {
+    ListCtx* ctx = arg;
+    reply_append(ctx->reply, f->filename, strlen(f->filename) + 1);
+    if (ctx->with_desc) reply_append(ctx->reply, f->description, strlen(f->description) + 1);
+    ctx->count++;
+}
 
-    // Verifica si el usuario ya existe
-    User* current = user_list;
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) {
-            pthread_mutex_unlock(&user_mutex);
-            return 1; // Usuario ya existe
-        }
-        current = current->next;
+// Deja en reply: código, "count\0", los archivos (nombre\0 [descripción\0]) y,
+// si paged, "siguiente_cursor\0". Sin paged (LIST_CONTENT clásico) una lista
+// de más de limit archivos es el error 4 de siempre.
+static void reply_file_list(Reply* reply, const char* user, const char* target,
+                            uint32_t cursor, int limit, int with_desc, int paged) {
+    int start = reply->len;
+    char ok = 0;
+    reply_append(reply, &ok, 1);
+    int names_at = reply->len;
+
+    ListCtx ctx = { reply, with_desc, 0 };
+    uint32_t next = 0;
+    int result = list_user_files(user, target, cursor, limit, list_visit, &ctx, &next);
+    if (result == 0 && next && !paged) result = 4; // No cabe en una respuesta
+
+    if (result != 0) {
+        reply->len = start;
+        char err_code = (char)result; // 1 USER DOES NOT EXIST, 2 NOT CONNECTED, 3 REMOTE DOES NOT EXIST
+        reply_append(reply, &err_code, 1);
+        return;
     }
 
-    // Para crear nuevo nodo (usuario)
-    User* new_user = malloc(sizeof(User));
-    if (!new_user) {
-        pthread_mutex_unlock(&user_mutex);
-        return 2; // Error
+    // El número de archivos va delante: se hace hueco moviendo los nombres
+    char count_str[12];
+    int count_len = snprintf(count_str, sizeof(count_str), "%d", ctx.count) + 1;
+    int names_len = reply->len - names_at;
+    reply_append(reply, count_str, count_len);
+    memmove(reply->data + names_at + count_len, reply->data + names_at, names_len);
+    memcpy(reply->data + names_at, count_str, count_len);
+
+    if (paged) {
+        char next_str[12];
+        int next_len = snprintf(next_str, sizeof(next_str), "%u", next) + 1;
+        reply_append(reply, next_str, next_len);
     }
+}
 
-    // Inicializamos todos los campos del usuario
-    strncpy(new_user->name, name, MAX_NAME_LEN);
-    new_user->is_connected = 0;
-    new_user->ip[0] = '\0';
-    new_user->port = 0;
-    new_user->next = user_list;
-    user_list = new_user;
+// Código de "formato incorrecto" de cada operación cuando le faltan sus
+// campos (el que ha devuelto siempre cada una)
+static char format_error(const ProtoRequest* req, int parsed, int has_timestamp) {
+    if (parsed == PROTO_ERR_USER || parsed == PROTO_ERR_TIMESTAMP) return 2;
+    if (parsed == PROTO_ERR_ARGS && has_timestamp) return 2; // Ni siquiera llega el timestamp
+    switch (req->op) {
+        case PROTO_CONNECT: return 3;
+        case PROTO_GET_FILE:
+        case PROTO_GET_FILES: return 2;
+        default: return 4;
+    }
+}
 
-    pthread_mutex_unlock(&user_mutex);
-    return 0; // OK
+// Código de error genérico de cada operación: el que sale si el shard que
+// le toca no contesta (modo shards) o si el cambio no ha llegado al WAL
+static const char op_failure[PROTO_OPS] = {
+    [PROTO_REGISTER] = 2, [PROTO_UNREGISTER] = 2, [PROTO_CONNECT] = 3, [PROTO_DISCONNECT] = 3,
+    [PROTO_PUBLISH] = 4, [PROTO_DELETE] = 4, [PROTO_LIST_USERS] = 3, [PROTO_LIST_CONTENT] = 4,
+    [PROTO_LIST_CONTENT_PAGE] = 4, [PROTO_SEARCH] = 4, [PROTO_GET_FILE] = 2, [PROTO_GET_FILES] = 2,
+    [PROTO_PUBLISH_BATCH] = 4, [PROTO_DELETE_BATCH] = 4, [PROTO_WATCH_USERS] = 4, [PROTO_STATS] = 4,
+    [PROTO_PUBLISH_CONTENT] = 4, [PROTO_GET_SOURCES] = 4, [PROTO_HEARTBEAT] = 4, [PROTO_OTHER] = 3,
+};
+
+// Con WAL, un cambio no se confirma hasta que está en disco. Aquí no se
+// espera: el LSN queda en la respuesta y el hilo de eventos la aparca hasta
+// que el volcado lo alcanza (conn_park). -1 si ya se sabe que no llegará.
+static int reply_wait_wal(Reply* reply) {
+    uint64_t lsn = wal_thread_lsn();
+    int state = wal_durable(lsn);
+    if (state == 0 && lsn > reply->wait_lsn) reply->wait_lsn = lsn;
+    return state < 0 ? -1 : 0;
 }
 
+// Operaciones que dejan registro en el WAL (CONNECT/DISCONNECT no: tras
+// reiniciar todos están desconectados)
+static int wal_logged(int op) {
+    return op == PROTO_REGISTER || op == PROTO_UNREGISTER || op == PROTO_PUBLISH ||
+           op == PROTO_PUBLISH_CONTENT || op == PROTO_DELETE || op == PROTO_PUBLISH_BATCH ||
+           op == PROTO_DELETE_BATCH;
+}
 
-int unregister_user(const char* name) {
-    pthread_mutex_lock(&user_mutex);
+// Procesa una petición ya troceada por proto_parse_request (parsed es lo
+// que devolvió) y deja la respuesta en reply. Los campos apuntan al buffer
+// de entrada de la conexión: no se copian. shard_flags son los SHARD_FLAG_*
+// de una parte que manda otro shard (0 si viene de un cliente).
+void handle_request(const ProtoRequest* req, int parsed, int has_timestamp, const char* client_ip,
+                    int shard_flags, Reply* reply) {
+    const char* op = req->name;
+    const char* user = req->user;
+
+    // Con CHECKED el shard del usuario ya lo ha comprobado y auditado: las
+    // consultas van sin requester (ver registry.h)
+    int checked = shard_flags & SHARD_FLAG_CHECKED;
+    const char* requester = checked ? NULL : user;
+
+    // El timestamp del cliente sólo delimita la petición
+    if (parsed != PROTO_OK) {
+        log_op("s> Invalid message format\n");
+        char resultado = format_error(req, parsed, has_timestamp);
+        reply_append(reply, &resultado, 1);
+        return;
+    }
 
-    User* current = user_list;
-    User* previous = NULL;
+    // La hora la pone el servidor con el reloj grueso, en binario; sólo se
+    // formatea si hay que imprimirla
+    uint64_t now_us = coarse_now_us();
+    char when[32] = "";
+    if (log_requests) coarse_format(now_us, when, sizeof(when));
 
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) {
-            if (previous == NULL) {
-                user_list = current->next;
-            } else {
-                previous->next = current->next;
-            }
-            free(current);
-            pthread_mutex_unlock(&user_mutex);
-            return 0; // OK
+    char resultado = 2; // Valor por defecto: error
+
+    // Con el WAL roto no se aceptan cambios que no podrían quedar en disco
+    if (wal_logged(req->op) && wal_failed()) {
+        log_op("s> OPERATION %s FROM %s rechazada: WAL roto at %s\n", op, user, when);
+        reply_append(reply, &op_failure[req->op], 1);
+        return;
+    }
+
+    // STATS: "\0" + métricas en texto + "\0". No toca el registro ni se audita.
+    if (req->op == PROTO_STATS) {
+        MetricsText text = { NULL, 0, 0 };
+        render_stats(&text);
+        char ok = 0;
+        reply_append(reply, &ok, 1);
+        reply_append(reply, text.data, text.len);
+        reply_append(reply, &ok, 1);
+        free(text.data);
+        return;
+    }
+
+    // HEARTBEAT: "\0segundos\0" con el plazo de caducidad (0 si no hay), para
+    // que el cliente sepa cada cuánto repetirlo. Tampoco se audita.
+    if (req->op == PROTO_HEARTBEAT) {
+        char code = (char)registry_touch(user);
+        reply_append(reply, &code, 1);
+        if (code == 0) {
+            char secs[24];
+            int len = snprintf(secs, sizeof(secs), "%llu",
+                               (unsigned long long)(registry_liveness_timeout() / 1000000)) + 1;
+            reply_append(reply, secs, len);
         }
-        previous = current;
-        current = current->next;
+        return;
     }
 
-    pthread_mutex_unlock(&user_mutex);
-    return 1; // Usuario no encontrado
-}
+    // Cualquier otra petición de un conectado también cuenta como señal de vida
+    int alive = checked ? 0 : registry_touch(user);
 
-int connect_user(const char* name, const char* ip, int port) {
-    pthread_mutex_lock(&user_mutex);
+     // 4. Preparar el registro de auditoría
+     char operation_str[512];
+     memset(operation_str, 0, sizeof(operation_str));  // Limpiamos el buffer
 
-    User* current = user_list;
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) {  // Si el usuario está registrado...
-            if (current->is_connected) {
-                pthread_mutex_unlock(&user_mutex);
-                return 2; // Ya conectado
-            }
+    //// Asignamos el nombre de la operación ANTES de la llamada RPC
+    switch (req->op) {
+        case PROTO_PUBLISH:
+        case PROTO_DELETE:
+        case PROTO_SEARCH:
+            // Formato: "PUBLISH filename", "DELETE filename", "SEARCH filename"
+            snprintf(operation_str, sizeof(operation_str), "%s %s", op, req->arg[0]);
+            break;
+        case PROTO_GET_FILES:
+        case PROTO_PUBLISH_BATCH:
+        case PROTO_DELETE_BATCH:
+            // Un solo registro para todo el lote: "GET_FILES n", "PUBLISH_BATCH n"...
+            snprintf(operation_str, sizeof(operation_str), "%s %d", op, req->count);
+            break;
+        case PROTO_LIST_CONTENT_PAGE:
+            strncpy(operation_str, "LIST_CONTENT", sizeof(operation_str));
+            break;
+        case PROTO_PUBLISH_CONTENT:
+            // Para el log es un PUBLISH más
+            snprintf(operation_str, sizeof(operation_str), "PUBLISH %s", req->arg[0]);
+            break;
+        case PROTO_GET_SOURCES:
+            strncpy(operation_str, "GET_FILE", sizeof(operation_str));
+            break;
+        case PROTO_OTHER:
+            break;
+        default:
+            strncpy(operation_str, op, sizeof(operation_str) - 1);
+    }
 
-            current->is_connected = 1;
-            strncpy(current->ip, ip, INET_ADDRSTRLEN);
-            current->port = port;
+    //// Registro de auditoría: se encola y lo envía el hilo shipper
+    if (!checked) audit_log_record(user, operation_str, now_us);
 
-            pthread_mutex_unlock(&user_mutex);
-            return 0; // OK
-        }
-        current = current->next;
+    log_op("s> op='%s' | user='%s'\n", op, user);
+
+    // AUTH: otro shard atiende la operación y aquí sólo se mira al usuario
+    if (shard_flags & SHARD_FLAG_AUTH) {
+        char code = (char)alive; // 0 OK, 1 no existe, 2 no conectado
+        reply_append(reply, &code, 1);
+        return;
     }
 
-    pthread_mutex_unlock(&user_mutex);
-    return 1; // Usuario no existe
-}
 
-int disconnect_user(const char* name) {
-    pthread_mutex_lock(&user_mutex);
+    // 5. Procesar cada tipo de operación
+    if (req->op == PROTO_REGISTER) {
+        resultado = (char)register_user(user);
+        log_op("s> OPERATION REGISTER FROM %s at %s\n", user, when);
 
-    User* current = user_list;
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) {
-            if (!current->is_connected) {
-                pthread_mutex_unlock(&user_mutex);
-                return 2; // Usuario no está conectado
-            }
+        strcpy(operation_str, "REGISTER");
+
+    } else if (req->op == PROTO_UNREGISTER) {
+        resultado = (char)unregister_user(user);
+        log_op("s> OPERATION UNREGISTER FROM %s at %s\n", user, when);
 
-            current->is_connected = 0;
-            current->ip[0] = '\0';
-            current->port = 0;
+        strcpy(operation_str, "UNREGISTER");
+
+    } else if (req->op == PROTO_DISCONNECT) {
+        resultado = (char)disconnect_user(user);
+        log_op("s> OPERATION DISCONNECT FROM %s at %s\n", user, when);
+
+        strcpy(operation_str, "DISCONNECT");
+
+    } else if (req->op == PROTO_CONNECT) {
+        int client_port = atoi(req->arg[0]);
+
+        resultado = (char)connect_user(user, client_ip, client_port);
+        log_op("s> OPERATION CONNECT FROM %s (%s:%d) at %s\n", user, client_ip, client_port, when);
+
+        strcpy(operation_str, "CONNECT");
+
+    } else if (req->op == PROTO_LIST_USERS) {
+        log_op("s> OPERATION LIST_USERS FROM %s at %s\n", user, when);
+
+        // La imagen cacheada ya lleva el código 0: se copia de una vez
+        epoch_enter();
+        const UsersImage* image = NULL;
+        int result = list_connected_users(requester, &image);
 
-            pthread_mutex_unlock(&user_mutex);
-            return 0; // OK
+        if (result == 0) {
+            reply_append(reply, image->data, image->len);
+        } else {
+            char err_code = (char)result; // 1 USER DOES NOT EXIST, 2 USER NOT CONNECTED
+            reply_append(reply, &err_code, 1);
         }
-        current = current->next;
-    }
+        epoch_exit();
+        return;
 
-    pthread_mutex_unlock(&user_mutex);
-    return 1; // Usuario no existe
-}
+        
+    } else if (req->op == PROTO_PUBLISH) {
+        const char* filename = req->arg[0];
+        const char* description = req->arg[1];
 
-int list_connected_users(char* buffer, int max_len) {
-    pthread_mutex_lock(&user_mutex);
+        resultado = (char)publish_file(user, filename, description);
+        log_op("s> OPERATION PUBLISH FROM %s: %s (%s) at %s\n", user, filename, description, when);
 
-    int pos = 0;
-    User* current = user_list;
-    while (current) {
-        if (current->is_connected) {
-            // Formatear la línea: "NOMBRE IP PORT\0"
-            char line[INET_ADDRSTRLEN + MAX_NAME_LEN + 10]; // Suficiente espacio para nombre, IP y puerto
-            int line_len = snprintf(line, sizeof(line), "%s %s %d", current->name, current->ip, current->port);
-            
-            // Verificar si hay espacio en el buffer
-            if (pos + line_len + 1 >= max_len - 1) { // +1 por el \0 adicional
-                pthread_mutex_unlock(&user_mutex);
-                return -1; // No hay espacio
-            }
+        snprintf(operation_str, sizeof(operation_str),"PUBLISH %s", filename);
+
+    } else if (req->op == PROTO_PUBLISH_CONTENT) {
+        const char* filename = req->arg[0];
+        const char* description = req->arg[1];
+        const char* hash = req->arg[2];
+        char* end;
+        uint64_t size = strtoull(req->arg[3], &end, 10);
+
+        resultado = *req->arg[3] && *end == '\0'
+                    ? (char)publish_file_content(user, filename, description, hash, size)
+                    : 4;
+        log_op("s> OPERATION PUBLISH FROM %s: %s (%s) [%s, %llu bytes] at %s\n",
+               user, filename, description, hash, (unsigned long long)size, when);
+
+    } else if (req->op == PROTO_DELETE) {
+        const char* filename = req->arg[0];
+
+        resultado = (char)delete_file(user, filename);
+        log_op("s> OPERATION DELETE FROM %s: %s at %s\n", user, filename, when);
+        snprintf(operation_str, sizeof(operation_str), "DELETE %s", filename);
+
+    } else if (req->op == PROTO_LIST_CONTENT) {
+        const char* target_user = req->arg[0];
+
+        reply_file_list(reply, requester, target_user, 0, LIST_PAGE_MAX, 0, 0);
+        log_op("s> OPERATION LIST_CONTENT FROM %s TO %s at %s\n", user, target_user, when);
+
+        strcpy(operation_str, "LIST CONTENT");
+
+        return;
+
+    } else if (req->op == PROTO_LIST_CONTENT_PAGE) {
+        const char* target_user = req->arg[0];
+        const char* cursor_str = req->arg[1];
+        const char* limit_str = req->arg[2];
+        const char* flags = req->arg[3];
+
+        // La página nunca pasa de LIST_PAGE_MAX archivos: memoria acotada por petición
+        uint32_t cursor = (uint32_t)strtoul(cursor_str, NULL, 10);
+        int limit = atoi(limit_str);
+        if (limit <= 0) limit = LIST_PAGE_DEFAULT;
+        if (limit > LIST_PAGE_MAX) limit = LIST_PAGE_MAX;
+        int with_desc = strchr(flags, 'd') != NULL;
+
+        reply_file_list(reply, requester, target_user, cursor, limit, with_desc, 1);
+        log_op("s> OPERATION LIST_CONTENT FROM %s TO %s (cursor %u, limit %d) at %s\n",
+               user, target_user, cursor, limit, when);
+        return;
+
+    } else if (req->op == PROTO_SEARCH) {
+        const char* filename = req->arg[0];
 
-            // Copiar la línea al buffer
-            memcpy(buffer + pos, line, line_len + 1); // +1 para incluir el \0
-            pos += line_len + 1;
+        char* search_buffer = NULL;
+        int search_len = 0;
+        int result = search_file(requester, filename, &search_buffer, &search_len);
+
+        if (result == 0) {
+            char ok = 0;
+            reply_append(reply, &ok, 1);
+            reply_append(reply, search_buffer, search_len);
+            free(search_buffer);
+        } else {
+            char err_code = (char)result;
+            reply_append(reply, &err_code, 1);
         }
-        current = current->next;
+        log_op("s> OPERATION SEARCH FROM %s: %s at %s\n", user, filename, when);
+
+        return;
+
+    } else if (req->op == PROTO_GET_FILE) {
+        const char* target_user = req->arg[0];
+        const char* filename = req->arg[1];
+
+        Endpoint owner;
+        resultado = (char)resolve_file(requester, target_user, filename, &owner);
+
+        if (resultado == 0) {
+            // Enviar información de conexión del usuario destino
+            log_op("s> OPERATION GET_FILE FROM %s TO %s: %s at %s\n", user, target_user, filename, when);
+            reply_append(reply, &resultado, 1);
+
+            // Enviar IP y puerto del usuario destino
+            reply_append(reply, owner.ip, strlen(owner.ip) + 1);
+            char port_str[10];
+            snprintf(port_str, sizeof(port_str), "%d", owner.port);
+            reply_append(reply, port_str, strlen(port_str) + 1);
+
+            return;
+        }
+        log_op("s> OPERATION GET_FILE FROM %s TO %s: %s at %s\n", user, target_user, filename, when);
+
+        snprintf(operation_str, sizeof(operation_str), "GET_FILE %s", filename);
+
+    } else if (req->op == PROTO_GET_SOURCES) {
+        // Respuesta: 0, "tamaño\0hash\0count\0" y por fuente
+        // "nombre\0ip\0puerto\0archivo\0" (ver resolve_sources)
+        const char* target_user = req->arg[0];
+        const char* filename = req->arg[1];
+        int max = atoi(req->arg[2]);
+        if (max <= 0) max = SOURCES_DEFAULT;
+        if (max > SOURCES_MAX) max = SOURCES_MAX;
+
+        char* sources = NULL;
+        int sources_len = 0;
+        int result = resolve_sources(requester, target_user, filename, max, &sources, &sources_len);
+
+        char code = (char)result;
+        reply_append(reply, &code, 1);
+        if (result == 0) {
+            reply_append(reply, sources, sources_len);
+            free(sources);
+        }
+        log_op("s> OPERATION GET_SOURCES FROM %s TO %s: %s at %s\n", user, target_user, filename, when);
+        return;
+
+    } else if (req->op == PROTO_GET_FILES) {
+        // Respuesta: 0, "count\0" y por cada par "código\0ip\0puerto\0" (ip y
+        // puerto vacíos si el código no es 0)
+        int n = req->count;
+        const char** fields = malloc((2 * n + 1) * sizeof(char*));
+        FileResolution* res = malloc((n + 1) * sizeof(FileResolution));
+        const char** targets = malloc((n + 1) * sizeof(char*));
+        const char** filenames = malloc((n + 1) * sizeof(char*));
+        int result = fields && res && targets && filenames ? 0 : 2;
+        if (result == 0) proto_batch_items(req, fields);
+        for (int i = 0; i < n && result == 0; i++) {
+            targets[i] = fields[2 * i];
+            filenames[i] = fields[2 * i + 1];
+        }
+        if (result == 0) result = resolve_files(requester, n, targets, filenames, res);
+        log_op("s> OPERATION GET_FILES FROM %s: %d files at %s\n", user, n, when);
+
+        char code = (char)result;
+        reply_append(reply, &code, 1);
+        if (result == 0) {
+            char num[16];
+            reply_append(reply, num, snprintf(num, sizeof(num), "%d", n) + 1);
+            for (int i = 0; i < n; i++) {
+                char item[64];
+                int item_len = res[i].code == 0
+                    ? snprintf(item, sizeof(item), "0%c%s%c%d", 0, res[i].endpoint.ip, 0, res[i].endpoint.port) + 1
+                    : snprintf(item, sizeof(item), "%d%c%c", res[i].code, 0, 0) + 1;
+                reply_append(reply, item, item_len);
+            }
+        }
+        free(fields);
+        free(targets);
+        free(filenames);
+        free(res);
+        return;
+
+    } else if (req->op == PROTO_PUBLISH_BATCH || req->op == PROTO_DELETE_BATCH) {
+        // Respuesta: código, "count\0" y un dígito por entrada ("0030...\0")
+        int publish = req->op == PROTO_PUBLISH_BATCH;
+        int n = req->count;
+        int per_item = proto_item_fields(req->op);
+        const char** fields = malloc((per_item * n + 1) * sizeof(char*));
+        const char** filenames = malloc((n + 1) * sizeof(char*));
+        const char** descriptions = malloc((n + 1) * sizeof(char*));
+        char* results = malloc(n + 1);
+        int result = fields && filenames && descriptions && results ? 0 : 4;
+        if (result == 0) proto_batch_items(req, fields);
+
+        int applied = 0;
+        if (result == 0) {
+            for (int i = 0; i < n; i++) {
+                filenames[i] = fields[per_item * i];
+                descriptions[i] = publish ? fields[2 * i + 1] : NULL;
+            }
+            result = publish ? publish_files(user, n, filenames, descriptions, results, &applied)
+                             : delete_files(user, n, filenames, results, &applied);
+        }
+        log_op("s> OPERATION %s FROM %s: %d/%d at %s\n", op, user, applied, n, when);
+
+        // Con WAL, no confirmar hasta que está en disco (un solo sync para el lote)
+        if (applied > 0 && reply_wait_wal(reply) < 0) result = op_failure[req->op];
+
+        char code = (char)result;
+        reply_append(reply, &code, 1);
+        if (result == 0) {
+            char num[16];
+            reply_append(reply, num, snprintf(num, sizeof(num), "%d", n) + 1);
+            for (int i = 0; i < n; i++) results[i] += '0';
+            results[n] = '\0';
+            reply_append(reply, results, n + 1);
+        }
+        free(fields);
+        free(filenames);
+        free(descriptions);
+        free(results);
+        return;
+
+    } else {
+        log_op("s> UNKNOWN OPERATION: %s at %s\n", op, when);
+        resultado = 3;
     }
 
-    buffer[pos++] = '\0'; // Doble \0 final
-    pthread_mutex_unlock(&user_mutex);
-    return pos; // Número de bytes escritos
+    // 6. Con WAL, no confirmar un cambio del registro hasta que está en disco
+    if (resultado == 0 && reply_wait_wal(reply) < 0) resultado = op_failure[req->op];
+
+    // 7. Respuesta de un byte con el resultado
+    reply_append(reply, &resultado, 1);
 }
 
 
 // ----------------------------
-// FUNCIONES PARA LA GESTIÓN DE ARCHIVOS (publish, delete, list_content, get_file)
+// Modo shards (shard.h): reenvío al shard dueño y reparto entre todos
 // ----------------------------
+//
+// Las operaciones de un solo usuario (REGISTER, CONNECT, PUBLISH, lotes,
+// HEARTBEAT...) se mandan enteras a su shard, que responde como siempre.
+// Las que miran a otro usuario (LIST_CONTENT, GET_FILE, GET_SOURCES) van
+// con AUTH al shard del que pide y con CHECKED al del destino, a la vez.
+// LIST_USERS y SEARCH preguntan a todos y suman; GET_FILES parte el lote
+// por shard destino y recoloca las respuestas. WATCH_USERS y STATS se
+// quedan en el shard al que se conecta el cliente, y GET_SOURCES sólo ve
+// las copias del shard del destino (cada shard tiene su índice de contenido).
+// Todo esto espera al canal interno, así que no corre en los hilos de
+// eventos sino en los reenviadores (ver el reactor).
+
+// Una parte de una petición repartida
+typedef struct {
+    int shard;
+    int flags;                // SHARD_FLAG_*
+    const char* request;      // Campos terminados en \0
+    int len;
+    int sent;                 // Generación de shard_send (-1 = no mandada)
+    Reply reply;              // len 0 si el shard no ha contestado
+} ShardCall;
+
+static ShardCall shard_call(int shard, int flags, const char* request, int len) {
+    ShardCall call = { .shard = shard, .flags = flags, .request = request, .len = len };
+    return call;
+}
 
-int publish_file(const char* username, const char* filename, const char* description) {
-    pthread_mutex_lock(&user_mutex);
+// Manda las partes de otros shards, atiende aquí las propias mientras
+// tanto y luego recoge las respuestas (cada shard contesta en orden)
+static void shard_calls_run(ShardCall* calls, int n, const char* ip) {
+    for (int i = 0; i < n; i++) {
+        calls[i].sent = calls[i].shard == shard_self()
+                        ? -1 : shard_send(calls[i].shard, calls[i].flags, ip, calls[i].request, calls[i].len);
+    }
+    for (int i = 0; i < n; i++) {
+        if (calls[i].shard != shard_self()) continue;
+        int has_timestamp = !(calls[i].flags & SHARD_FLAG_NO_TIMESTAMP);
+        ProtoRequest req;
+        int parsed = proto_parse_request(calls[i].request, calls[i].len, has_timestamp, BATCH_MAX, &req);
+        handle_request(&req, parsed, has_timestamp, ip, calls[i].flags, &calls[i].reply);
+    }
+    for (int i = 0; i < n; i++) {
+        char* data;
+        int len;
+        if (calls[i].sent >= 0 && shard_recv(calls[i].shard, calls[i].sent, &data, &len) == 0) {
+            calls[i].reply = (Reply){ .data = data, .len = len, .capacity = len };
+        }
+    }
+}
 
-    User* user = user_list;
-    while (user) {
-        if (strcmp(user->name, username) == 0) {
-            if (!user->is_connected) {
-                pthread_mutex_unlock(&user_mutex);
-                return 2; // Usuario no conectado
-            }
+static void shard_calls_free(ShardCall* calls, int n) {
+    for (int i = 0; i < n; i++) free(calls[i].reply.data);
+}
 
-            // Verificar si ya publicó ese archivo
-            FileEntry* f = user->files;
-            while (f) {
-                if (strcmp(f->filename, filename) == 0) {
-                    pthread_mutex_unlock(&user_mutex);
-                    return 3; // Archivo ya publicado
-                }
-                f = f->next;
-            }
+static int call_code(const ShardCall* call) {
+    return call->reply.len > 0 ? (unsigned char)call->reply.data[0] : -1;
+}
 
-            // Crear nuevo archivo
-            FileEntry* new_file = malloc(sizeof(FileEntry));
-            if (!new_file) {
-                pthread_mutex_unlock(&user_mutex);
-                return 4; // Error de memoria
-            }
+// LIST_USERS y SEARCH: cada shard responde "\0count\0campos..." con los
+// suyos; se suman los contadores y se juntan los campos. El error del
+// shard del que pide (1, 2) manda sobre los demás.
+static void shard_merge_counts(Reply* reply, int op, ShardCall* calls, int n, int home) {
+    for (int i = 0; i < n; i++) {
+        int code = call_code(&calls[i]);
+        if (calls[i].shard == home && code > 0) {
+            char c = (char)code;
+            reply_append(reply, &c, 1);
+            return;
+        }
+    }
+
+    long total = 0;
+    for (int i = 0; i < n; i++) {
+        int code = call_code(&calls[i]);
+        if (code != 0 || !memchr(calls[i].reply.data + 1, '\0', calls[i].reply.len - 1)) {
+            char c = code > 0 ? (char)code : op_failure[op];
+            reply_append(reply, &c, 1);
+            return;
+        }
+        total += strtol(calls[i].reply.data + 1, NULL, 10);
+    }
 
-            strncpy(new_file->filename, filename, 256);
-            strncpy(new_file->description, description, 256);
-            new_file->next = user->files;
-            user->files = new_file;
+    char head[24];
+    int head_len = snprintf(head, sizeof(head), "%c%ld", 0, total) + 1;
+    reply_append(reply, head, head_len);
+    for (int i = 0; i < n; i++) {
+        int skip = 1 + strlen(calls[i].reply.data + 1) + 1;
+        reply_append(reply, calls[i].reply.data + skip, calls[i].reply.len - skip);
+    }
+}
+
+// Una parte de GET_FILES ("\0k\0" y por par "código\0ip\0puerto\0"): deja
+// en at/len dónde empieza y cuánto ocupa la respuesta de cada par de shard.
+// 0 si la respuesta no trae los k pares.
+static int split_get_files(const ShardCall* call, int k, const int* owner, int n, int shard,
+                           const char** at, int* len) {
+    if (call_code(call) != 0) return 0;
+    int want = 1 + 3 * k, used;
+    int* starts = malloc(want * sizeof(int));
+    int* lens = malloc(want * sizeof(int));
+    int ok = starts && lens &&
+             proto_split(call->reply.data + 1, call->reply.len - 1, want, starts, lens, &used) == want;
+    for (int i = 0, j = 1; ok && i < n; i++) {
+        if (owner[i] != shard) continue;
+        at[i] = call->reply.data + 1 + starts[j];
+        len[i] = starts[j + 2] + lens[j + 2] + 1 - starts[j];
+        j += 3;
+    }
+    free(starts);
+    free(lens);
+    return ok;
+}
 
-            pthread_mutex_unlock(&user_mutex);
-            return 0; // OK
+// GET_FILES repartido: AUTH al shard del que pide y un GET_FILES con
+// CHECKED a cada shard destino con sus pares (owner[i] = shard de cada par);
+// las respuestas se recolocan en el orden pedido
+static void shard_get_files_split(const ProtoRequest* req, const char** fields, const int* owner,
+                                  const char* raw, int len, int ts_flag, const char* ip, Reply* reply) {
+    int n = req->count;
+    int shards = shard_count();
+    int* part_n = calloc(shards, sizeof(int));
+    int* part_call = malloc(shards * sizeof(int));
+    ShardCall* calls = calloc(shards + 1, sizeof(ShardCall));
+    const char** sub = malloc((2 * n + 3) * sizeof(char*));
+    const char** item_at = calloc(n + 1, sizeof(char*));
+    int* item_len = malloc((n + 1) * sizeof(int));
+    if (!part_n || !part_call || !calls || !sub || !item_at || !item_len) {
+        reply_append(reply, &op_failure[PROTO_GET_FILES], 1);
+        free(part_n);
+        free(part_call);
+        free(calls);
+        free(sub);
+        free(item_at);
+        free(item_len);
+        return;
+    }
+    for (int i = 0; i < n; i++) part_n[owner[i]]++;
+
+    int ncalls = 0;
+    calls[ncalls++] = shard_call(shard_owner(req->user), ts_flag | SHARD_FLAG_AUTH, raw, len);
+    for (int s = 0; s < shards; s++) {
+        if (part_n[s] == 0) continue;
+
+        // "GET_FILES\0usuario\0k\0destino\0archivo\0..." sin timestamp
+        char count[16];
+        snprintf(count, sizeof(count), "%d", part_n[s]);
+        int m = 0;
+        int cap = strlen(req->name) + strlen(req->user) + strlen(count) + 3;
+        sub[m++] = req->name;
+        sub[m++] = req->user;
+        sub[m++] = count;
+        for (int i = 0; i < n; i++) {
+            if (owner[i] != s) continue;
+            sub[m++] = fields[2 * i];
+            sub[m++] = fields[2 * i + 1];
+            cap += strlen(fields[2 * i]) + strlen(fields[2 * i + 1]) + 2;
+        }
+        char* buf = malloc(cap);
+        int buf_len = buf ? proto_encode(buf, cap, sub, m) : 0;
+        part_call[s] = ncalls;
+        calls[ncalls++] = shard_call(s, SHARD_FLAG_NO_TIMESTAMP | SHARD_FLAG_CHECKED, buf, buf_len);
+    }
+    shard_calls_run(calls, ncalls, ip);
+
+    if (call_code(&calls[0]) != 0) {
+        // Quien pide no existe o no está conectado (o su shard no contesta)
+        reply_append(reply, &op_failure[PROTO_GET_FILES], 1);
+    } else {
+        // Los pares de un shard que no contesta se quedan con el código 2
+        for (int s = 0; s < shards; s++) {
+            if (part_n[s] > 0) split_get_files(&calls[part_call[s]], part_n[s], owner, n, s, item_at, item_len);
+        }
+        char head[16];
+        int head_len = snprintf(head, sizeof(head), "%c%d", 0, n) + 1;
+        reply_append(reply, head, head_len);
+        for (int i = 0; i < n; i++) {
+            if (item_at[i]) reply_append(reply, item_at[i], item_len[i]);
+            else reply_append(reply, "2\0\0", 4);
         }
-        user = user->next;
     }
 
-    pthread_mutex_unlock(&user_mutex);
-    return 1; // Usuario no existe
+    for (int i = 1; i < ncalls; i++) free((char*)calls[i].request);
+    shard_calls_free(calls, ncalls);
+    free(part_n);
+    free(part_call);
+    free(calls);
+    free(sub);
+    free(item_at);
+    free(item_len);
 }
 
-int delete_file(const char* username, const char* filename) {
-    pthread_mutex_lock(&user_mutex);
+// GET_FILES en modo shards. Devuelve 0 si todos los pares (y quien pide)
+// son de este shard.
+static int shard_get_files(const ProtoRequest* req, const char* raw, int len, int ts_flag,
+                           const char* ip, Reply* reply) {
+    int n = req->count;
+    int home = shard_owner(req->user);
+    const char** fields = malloc((2 * n + 1) * sizeof(char*));
+    int* owner = malloc((n + 1) * sizeof(int));
+    if (!fields || !owner) {
+        free(fields);
+        free(owner);
+        reply_append(reply, &op_failure[PROTO_GET_FILES], 1);
+        return 1;
+    }
+    proto_batch_items(req, fields);
 
-    User* user = user_list;
-    while (user) {
-        if (strcmp(user->name, username) == 0) {
-            if (!user->is_connected) {
-                pthread_mutex_unlock(&user_mutex);
-                return 2; // No conectado
-            }
+    int single = 1;
+    for (int i = 0; i < n; i++) {
+        owner[i] = shard_owner(fields[2 * i]);
+        if (owner[i] != home) single = 0;
+    }
 
-            FileEntry* prev = NULL;
-            FileEntry* current = user->files;
-
-            while (current) {
-                if (strcmp(current->filename, filename) == 0) {
-                    if (prev == NULL) {
-                        user->files = current->next;
-                    } else {
-                        prev->next = current->next;
-                    }
-                    free(current);
-                    pthread_mutex_unlock(&user_mutex);
-                    return 0; // OK
-                }
-                prev = current;
-                current = current->next;
-            }
+    int handled = 1;
+    if (!single) {
+        shard_get_files_split(req, fields, owner, raw, len, ts_flag, ip, reply);
+    } else if (home == shard_self()) {
+        handled = 0;
+    } else {
+        // Todo en el shard del que pide: se le manda entera
+        ShardCall call = shard_call(home, ts_flag, raw, len);
+        shard_calls_run(&call, 1, ip);
+        if (call.reply.len > 0) reply_append(reply, call.reply.data, call.reply.len);
+        else reply_append(reply, &op_failure[PROTO_GET_FILES], 1);
+        shard_calls_free(&call, 1);
+    }
+    free(fields);
+    free(owner);
+    return handled;
+}
 
-            pthread_mutex_unlock(&user_mutex);
-            return 3; // Archivo no encontrado
+// Operaciones de un solo usuario con respuesta de un byte (o casi): las
+// escrituras que serializa user_mutex. Devuelve el shard al que se
+// reenvían o -1 si no es una de ellas o es de este shard.
+static int shard_pipelined(const ProtoRequest* req, int parsed) {
+    if (parsed != PROTO_OK) return -1;
+    switch (req->op) {
+        case PROTO_REGISTER:
+        case PROTO_UNREGISTER:
+        case PROTO_CONNECT:
+        case PROTO_DISCONNECT:
+        case PROTO_PUBLISH:
+        case PROTO_PUBLISH_CONTENT:
+        case PROTO_DELETE:
+        case PROTO_HEARTBEAT: {
+            int home = shard_owner(req->user);
+            return home == shard_self() ? -1 : home;
         }
-        user = user->next;
+        default:
+            return -1;
     }
-
-    pthread_mutex_unlock(&user_mutex);
-    return 1; // Usuario no existe
 }
 
-int list_user_files(const char* requester, const char* target, char* buffer, int max_len) {
-    pthread_mutex_lock(&user_mutex);
+// Atiende req en modo shards si no le toca sólo a este shard (raw y len
+// son la petición tal cual llegó). Devuelve 0 si hay que atenderla aquí
+// como siempre.
+static int shard_route(const ProtoRequest* req, int parsed, const char* raw, int len, int has_timestamp,
+                       const char* ip, Reply* reply) {
+    if (parsed != PROTO_OK) return 0;
+    int ts_flag = has_timestamp ? 0 : SHARD_FLAG_NO_TIMESTAMP;
+    int home = shard_owner(req->user);
+
+    switch (req->op) {
+        case PROTO_STATS:
+        case PROTO_WATCH_USERS:
+        case PROTO_OTHER:
+            return 0;
+
+        case PROTO_LIST_USERS:
+        case PROTO_SEARCH: {
+            // El del que pide responde entero (lo comprueba y audita); el resto, sólo lo suyo
+            int n = shard_count();
+            ShardCall* calls = calloc(n, sizeof(ShardCall));
+            if (!calls) break;
+            for (int s = 0; s < n; s++) {
+                calls[s] = shard_call(s, ts_flag | (s == home ? 0 : SHARD_FLAG_CHECKED), raw, len);
+            }
+            shard_calls_run(calls, n, ip);
+            shard_merge_counts(reply, req->op, calls, n, home);
+            shard_calls_free(calls, n);
+            free(calls);
+            return 1;
+        }
+
+        case PROTO_LIST_CONTENT:
+        case PROTO_LIST_CONTENT_PAGE:
+        case PROTO_GET_FILE:
+        case PROTO_GET_SOURCES: {
+            int target = shard_owner(req->arg[0]);
+            if (target == home) break;
+
+            ShardCall calls[2] = {
+                shard_call(home, ts_flag | SHARD_FLAG_AUTH, raw, len),
+                shard_call(target, ts_flag | SHARD_FLAG_CHECKED, raw, len),
+            };
+            shard_calls_run(calls, 2, ip);
+            int code = call_code(&calls[0]);
+            if (code == 0 && calls[1].reply.len > 0) {
+                reply_append(reply, calls[1].reply.data, calls[1].reply.len);
+            } else {
+                // LIST_CONTENT distingue 1 (no existe) y 2 (no conectado); las demás, 2
+                int list = req->op == PROTO_LIST_CONTENT || req->op == PROTO_LIST_CONTENT_PAGE;
+                char c = code > 0 ? (list ? (char)code : 2) : op_failure[req->op];
+                reply_append(reply, &c, 1);
+            }
+            shard_calls_free(calls, 2);
+            return 1;
+        }
 
-    User* req = NULL;
-    User* tgt = NULL;
-    User* current = user_list;
+        case PROTO_GET_FILES:
+            return shard_get_files(req, raw, len, ts_flag, ip, reply);
 
-    while (current) {
-        if (strcmp(current->name, requester) == 0) req = current;
-        if (strcmp(current->name, target) == 0) tgt = current;
-        current = current->next;
+        default:
+            break;
     }
 
-    if (!req) {
-        pthread_mutex_unlock(&user_mutex);
-        return 1; // Usuario que realiza la operación no existe
+    // Todo en un solo shard: el del usuario
+    if (home == shard_self()) return 0;
+    ShardCall call = shard_call(home, ts_flag, raw, len);
+    shard_calls_run(&call, 1, ip);
+    if (call.reply.len > 0) {
+        reply_append(reply, call.reply.data, call.reply.len);
+    } else {
+        reply_append(reply, &op_failure[req->op], 1);
     }
+    shard_calls_free(&call, 1);
+    return 1;
+}
+
+// ¿Tiene shard_route que esperar a otro shard para atender req? Es lo
+// mismo que decide shard_route, sin mandar nada.
+static int shard_remote(const ProtoRequest* req, int parsed) {
+    if (parsed != PROTO_OK) return 0;
+    int self = shard_self();
+    int home = shard_owner(req->user);
+
+    switch (req->op) {
+        case PROTO_STATS:
+        case PROTO_WATCH_USERS:
+        case PROTO_OTHER:
+            return 0;
+
+        case PROTO_LIST_USERS:
+        case PROTO_SEARCH:
+            return shard_count() > 1;
+
+        case PROTO_LIST_CONTENT:
+        case PROTO_LIST_CONTENT_PAGE:
+        case PROTO_GET_FILE:
+        case PROTO_GET_SOURCES:
+            return home != self || shard_owner(req->arg[0]) != self;
+
+        case PROTO_GET_FILES: {
+            if (home != self) return 1;
+            const char* p = req->items; // Pares destino\0archivo\0
+            for (int i = 0; i < req->count; i++) {
+                if (shard_owner(p) != self) return 1;
+                p += strlen(p) + 1;
+                p += strlen(p) + 1;
+            }
+            return 0;
+        }
 
-    if (!req->is_connected) {
-        pthread_mutex_unlock(&user_mutex);
-        return 2; // Usuario no conectado
+        default:
+            return home != self;
     }
+}
 
-    if (!tgt) {
-        pthread_mutex_unlock(&user_mutex);
-        return 3; // Usuario remoto no existe
+// Petición de otro shard por el canal interno: se atiende aquí sin
+// reenviarla (ni WATCH_USERS, que sólo tiene sentido en una conexión de cliente)
+static void shard_serve_request(const char* request, int len, int flags, const char* ip,
+                                char** out, int* out_len) {
+    Reply reply = { .data = NULL };
+    int has_timestamp = !(flags & SHARD_FLAG_NO_TIMESTAMP);
+    ProtoRequest req;
+    int parsed = proto_parse_request(request, len, has_timestamp, BATCH_MAX, &req);
+    if (req.op == PROTO_WATCH_USERS) {
+        reply_append(&reply, &op_failure[PROTO_WATCH_USERS], 1);
+    } else {
+        handle_request(&req, parsed, has_timestamp, ip, flags, &reply);
     }
 
-    // Contar archivos publicados
-    int count = 0;
-    FileEntry* f = tgt->files;
-    while (f) {
-        count++;
-        f = f->next;
+    // Este hilo no es de eventos: puede esperar al WAL aquí mismo
+    if (wal_wait(reply.wait_lsn) < 0) {
+        reply.len = 0;
+        reply_append(&reply, &op_failure[req.op], 1);
     }
+    *out = reply.data;
+    *out_len = reply.len;
+}
+
+
+// ----------------------------
+// Reactor epoll: varios hilos de eventos multiplexan todos los sockets
+// ----------------------------
+//
+// Protocolo v1: una petición por conexión, campos terminados en \0, y el
+// servidor cierra tras responder. El último campo (timestamp) puede ir
+// vacío: la hora de cada petición la pone siempre el servidor.
+//
+// Protocolo v2 (mismo puerto): el cliente empieza con los 4 bytes V2_MAGIC
+// y la conexión queda abierta. Cada petición va en una trama
+//     [longitud u32 big-endian][flags u8][campos v1 terminados en \0]
+// donde la longitud cuenta sólo los campos. Cada respuesta va como
+//     [longitud u32 big-endian][bytes que se enviarían en v1]
+// Se pueden encadenar peticiones sin esperar; las respuestas salen en orden.
+// Con el flag V2_FLAG_NO_TIMESTAMP la trama omite el campo timestamp.
+//
+// WATCH_USERS (user, último seq visto o 0) convierte la conexión, v1 o v2,
+// en una suscripción: tras el código 0 el servidor va mandando los eventos
+// de presence.h (en v2 cada tanda en su trama) y ya no atiende peticiones.
+// Si el seq no está en el log de cambios manda antes una foto:
+//     "S\0seq\0count\0nombre\0ip\0puerto\0..."
+// Cada CONNECT/DISCONNECT despierta (eventfd) a los hilos de eventos con
+// suscriptores y cada uno copia a los suyos sólo lo nuevo.
+//
+// Con WAL en modo group, la respuesta a un cambio no sale hasta que está en
+// disco, pero el hilo de eventos no espera al fdatasync: la conexión queda
+// aparcada con esa respuesta y todo lo que venga detrás (para no
+// desordenarlas) y sigue atendiendo al resto. El hilo del WAL despierta con
+// el mismo eventfd a los hilos con conexiones aparcadas tras cada tanda.
+//
+// En modo shards, las peticiones que esperan a otro shard (shard_remote)
+// tampoco se atienden en el hilo de eventos: la conexión sale de su epoll
+// y pasa entera a uno de los SHARD_FORWARDERS hilos reenviadores, que
+// atiende esa trama y las siguientes que también sean para otros shards y
+// la devuelve (eventfd otra vez) en cuanto llega una local. Mientras está
+// fuera sólo la toca el reenviador; nunca sale aparcada ni suscrita, así
+// que el WAL y WATCH_USERS se quedan en el hilo de eventos.
+
+#define MAX_EVENTS       64
+#define V2_MAGIC         "\0V2\0"
+#define V2_MAGIC_LEN     4
+#define V2_HEADER_LEN    5              // longitud (4) + flags (1)
+#define V2_FLAG_NO_TIMESTAMP 0x01       // La trama no trae el campo timestamp
+#define V2_MAX_FRAME     (1 << 20)      // Tamaño máximo de una petición v2
+#define OUT_HIGH_WATER   (4 << 20)      // Con más respuesta pendiente se deja de leer
+#define WATCH_PUSH_MAX   1024           // Eventos por tanda a un suscriptor
+#define SHARD_PIPELINE   64             // Reenvíos v2 en vuelo por conexión (modo shards)
+#define SHARD_FORWARDERS 16             // Hilos reenviadores (modo shards)
+
+enum { PROTO_UNKNOWN, PROTO_V1, PROTO_V2 };
+
+// Estado de una conexión de cliente (sólo la toca su hilo de eventos, o
+// el reenviador mientras forwarding)
+typedef struct Connection {
+    int fd;
+    int proto;                          // PROTO_UNKNOWN hasta ver los primeros bytes
+    int closing;                        // Cerrar en cuanto se vacíe la salida
+    uint32_t events;                    // Eventos registrados ahora en epoll
+    char ip[INET_ADDRSTRLEN];           // IP del cliente (para CONNECT)
+    char* in;                           // Bytes recibidos aún sin procesar
+    int in_len;
+    int in_cap;
+    Reply out;                          // Respuestas pendientes de enviar
+    int out_pos;
+    int out_held;                       // Con out.wait_lsn, desde aquí esperan al WAL
+    struct EventLoop* loop;             // Hilo de eventos al que pertenece
+    int watching;                       // Suscrita a WATCH_USERS
+    uint64_t watch_seq;                 // Último evento enviado
+    struct Connection* watch_prev;      // Lista de suscriptores del hilo
+    struct Connection* watch_next;
+    struct Connection* park_prev;       // Lista de aparcadas (esperando al WAL) del hilo
+    struct Connection* park_next;
+    int forwarding;                     // Fuera de epoll: en un hilo reenviador o esperándolo
+    struct Connection* forward_next;    // Cola de los reenviadores o de vuelta al hilo
+} Connection;
+
+typedef struct EventLoop {
+    int epfd;
+    int listen_fd;
+    int wake_fd;                        // eventfd: eventos de presencia nuevos o WAL volcado
+    _Atomic int watchers;               // Suscriptores de este hilo (lo leen los escritores)
+    Connection* watch_list;
+    _Atomic int parked;                 // Conexiones esperando al WAL (lo lee el hilo del WAL)
+    Connection* park_list;
+    pthread_mutex_t returned_mutex;
+    Connection* returned;               // Las que devuelven los reenviadores
+    pthread_t tid;
+} EventLoop;
+
+static EventLoop* event_loops = NULL;
+static int num_event_loops = 0;
+static __thread int forward_thread = 0;     // 1 en los hilos reenviadores
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
 
-    int pos = snprintf(buffer, max_len, "%d", count);
-    buffer[pos++] = '\0';  // Añadimos manualmente el \0 que separa cadenas
+// La salida desde held espera a que out.wait_lsn esté en disco
+static void conn_park(Connection* conn, int held) {
+    EventLoop* loop = conn->loop;
+    conn->out_held = held;
+    conn->park_prev = NULL;
+    conn->park_next = loop->park_list;
+    if (loop->park_list) loop->park_list->park_prev = conn;
+    loop->park_list = conn;
+    atomic_fetch_add(&loop->parked, 1);
+}
 
-    if (pos < 0 || pos >= max_len) {
-        pthread_mutex_unlock(&user_mutex);
-        return 4;
+static void conn_unpark(Connection* conn) {
+    EventLoop* loop = conn->loop;
+    if (conn->park_prev) conn->park_prev->park_next = conn->park_next;
+    else loop->park_list = conn->park_next;
+    if (conn->park_next) conn->park_next->park_prev = conn->park_prev;
+    atomic_fetch_sub(&loop->parked, 1);
+    conn->out.wait_lsn = 0;
+}
+
+// ¿Ha llegado ya el WAL a lo que espera la salida aparcada? Si se ha roto,
+// esas respuestas confirmarían cambios que no están en disco: se descartan
+// y se cierra la conexión (el cliente no recibe confirmación).
+static void conn_check_wal(Connection* conn) {
+    int state = wal_durable(conn->out.wait_lsn);
+    if (state == 0) return;
+    if (state < 0) {
+        conn->out.len = conn->out_held;
+        conn->closing = 1;
     }
+    conn_unpark(conn);
+}
 
-    f = tgt->files;
-    while (f) {
-        int len = strlen(f->filename) + 1;
-        if (pos + len >= max_len) {
-            pthread_mutex_unlock(&user_mutex);
-            return 4; // Error por falta de espacio
-        }
-        memcpy(buffer + pos, f->filename, len);
-        pos += len;
-        f = f->next;
+static void conn_close(EventLoop* loop, Connection* conn) {
+    metrics_conn_closed();
+    if (conn->out.wait_lsn) conn_unpark(conn);
+    if (conn->watching) {
+        if (conn->watch_prev) conn->watch_prev->watch_next = conn->watch_next;
+        else loop->watch_list = conn->watch_next;
+        if (conn->watch_next) conn->watch_next->watch_prev = conn->watch_prev;
+        atomic_fetch_sub(&loop->watchers, 1);
     }
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn->in);
+    free(conn->out.data);
+    free(conn);
+}
+
+// Número de bytes de entrada permitidos según el protocolo
+static int conn_in_limit(const Connection* conn) {
+    if (conn->proto == PROTO_V2) return V2_HEADER_LEN + V2_MAX_FRAME;
+    // Un lote en v1 no cabe en BUFFER_SIZE
+    const char* op_end = memchr(conn->in, '\0', conn->in_len);
+    if (op_end && proto_item_fields(proto_op(conn->in, op_end - conn->in))) return V2_MAX_FRAME;
+    return BUFFER_SIZE;
+}
 
-    pthread_mutex_unlock(&user_mutex);
-    return pos; // devuelve bytes escritos si éxito
+static int ensure_capacity(char** buf, int* cap, int needed) {
+    if (needed <= *cap) return 0;
+    int new_cap = *cap ? *cap : BUFFER_SIZE;
+    while (new_cap < needed) new_cap *= 2;
+    char* p = realloc(*buf, new_cap);
+    if (!p) return -1;
+    *buf = p;
+    *cap = new_cap;
+    return 0;
 }
 
-// Para get_file
-User* get_user_by_name(const char* name) {
-    pthread_mutex_lock(&user_mutex);
-    User* current = user_list;
-    while (current != NULL) {
-        if (strcmp(current->name, name) == 0) {
-            pthread_mutex_unlock(&user_mutex);
-            return current;
+// ¿Ha llegado ya la petición v1 entera? (operación + todos sus campos)
+static int v1_request_complete(const Connection* conn) {
+    if (conn->in_len >= conn_in_limit(conn)) return 1;
+    return proto_request_complete(conn->in, conn->in_len, BATCH_MAX);
+}
+
+// Envía lo que se pueda de la salida (sin pasar de lo aparcado). Devuelve 1
+// si ya está todo lo que se puede enviar.
+static int conn_flush(Connection* conn) {
+    int limit = conn->out.wait_lsn ? conn->out_held : conn->out.len;
+    while (conn->out_pos < limit) {
+        ssize_t n = send(conn->fd, conn->out.data + conn->out_pos, limit - conn->out_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            conn->closing = 1; // El cliente se ha ido: descartar la salida
+            if (conn->out.wait_lsn) conn_unpark(conn);
+            conn->out.len = conn->out_pos = 0;
+            return 1;
         }
-        current = current->next;
+        conn->out_pos += n;
     }
-    pthread_mutex_unlock(&user_mutex);
-    return NULL;
+
+    // Lo aparcado pasa al principio
+    if (conn->out.wait_lsn && conn->out_pos > 0) {
+        memmove(conn->out.data, conn->out.data + conn->out_pos, conn->out.len - conn->out_pos);
+        conn->out_held -= conn->out_pos;
+        conn->out.len -= conn->out_pos;
+    } else if (!conn->out.wait_lsn) {
+        conn->out.len = 0;
+    }
+    conn->out_pos = 0;
+    return 1;
 }
 
 // ----------------------------
-// Manejo de clientes
+// Suscripciones de presencia (WATCH_USERS)
 // ----------------------------
 
-void* client_handler(void* arg) {
-    // 1. Obtener socket del cliente y liberar memoria del argumento
-    int client_sock = *(int*)arg;
-    free(arg);
-
-    // 2. Recibir datos del cliente
-    char buffer[BUFFER_SIZE];
-    int len = recv(client_sock, buffer, BUFFER_SIZE, 0);
-    if (len <= 0) {
-        close(client_sock);
-        return NULL;
-    }
-    buffer[len] = '\0';  // Le añadimos \0 al final de la cadena
-
-    // 3. Parsear operación y usuario
-    char* op = buffer;
-    char* user = strchr(op, '\0') + 1;
-
-    // 4. Manejo de timestamp
-    char *timestamp;
-
-    if (strcmp(op, "CONNECT") == 0) {
-        char *port_str = strchr(user, '\0') + 1;
-        timestamp = strchr(port_str, '\0') + 1;
-    } 
-    else if (strcmp(op, "PUBLISH") == 0) {
-        char *filename = strchr(user, '\0') + 1;
-        char *description = strchr(filename, '\0') + 1;
-        timestamp = strchr(description, '\0') + 1;
-    }
-    else if (strcmp(op, "DELETE") == 0) {
-        char *filename = strchr(user, '\0') + 1;
-        timestamp = strchr(filename, '\0') + 1;
-    }
-    else if (strcmp(op, "LIST_CONTENT") == 0) {
-        char *target_user = strchr(user, '\0') + 1;
-        timestamp = strchr(target_user, '\0') + 1;
-    }
-    else if (strcmp(op, "GET_FILE") == 0) {
-        char *target_user = strchr(user, '\0') + 1;
-        char *filename = strchr(target_user, '\0') + 1;
-        timestamp = strchr(filename, '\0') + 1;
-    }
-    else {
-        // Operaciones simples: REGISTER, UNREGISTER, DISCONNECT, LIST_USERS
-        timestamp = strchr(user, '\0') + 1;
-    }
-
-    // 5. Verificación del formato básico
-    if (user >= buffer + len) {
-        printf("s> Invalid message format\n");
-        char resultado = 2;
-        send(client_sock, &resultado, 1, 0);
-        close(client_sock);
-        return NULL;
-    }
-    if (timestamp >= buffer + len) {
-        printf("s> Invalid message format\n");
-        char resultado = 2;
-        send(client_sock, &resultado, 1, 0);
-        close(client_sock);
-        return NULL;
+// Lo llama presence_record (con user_mutex): un write al eventfd de cada
+// hilo que tenga suscriptores; sin suscriptores no cuesta nada
+static void watch_notify(void* arg) {
+    uint64_t one = 1;
+    for (int i = 0; i < num_event_loops; i++) {
+        if (atomic_load_explicit(&event_loops[i].watchers, memory_order_relaxed) > 0 &&
+            write(event_loops[i].wake_fd, &one, sizeof(one)) < 0) {
+            // Contador del eventfd lleno: el hilo ya tiene un aviso pendiente
+        }
     }
+}
 
-    char resultado = 2; // Valor por defecto: error
+static void watch_visit(const char* rec, int len, void* ctx) {
+    reply_append(ctx, rec, len);
+}
 
-     // 6. Preparar args para RPC
-     char operation_str[512];
-     memset(operation_str, 0, sizeof(operation_str));  // Limpiamos el buffer
+// Foto completa de los conectados con el seq al que corresponde
+static void watch_snapshot(Connection* conn) {
+    uint64_t seq = presence_seq(); // Antes de la imagen: la imagen ya lo incluye
+    epoch_enter();
+    const UsersImage* image = NULL;
+    if (connected_users_image(&image) == 0) {
+        char head[32];
+        int n = snprintf(head, sizeof(head), "S%c%llu", 0, (unsigned long long)seq) + 1;
+        reply_append(&conn->out, head, n);
+        reply_append(&conn->out, image->data + 1, image->len - 1); // Sin el código
+        conn->watch_seq = seq;
+    }
+    epoch_exit();
+}
 
-    //// Asignamos el nombre de la operación ANTES de la llamada RPC
-    if (strcmp(op, "REGISTER") == 0) {
-        strncpy(operation_str, "REGISTER", sizeof(operation_str));
-    } else if (strcmp(op, "UNREGISTER") == 0) {
-        strncpy(operation_str, "UNREGISTER", sizeof(operation_str));
-    } else if (strcmp(op, "CONNECT") == 0) {
-        strncpy(operation_str, "CONNECT", sizeof(operation_str));
-    } else if (strcmp(op, "DISCONNECT") == 0) {
-        strncpy(operation_str, "DISCONNECT", sizeof(operation_str));
-    } else if (strcmp(op, "PUBLISH") == 0) {
-        char *filename = strchr(user, '\0') + 1;
-        char *description = strchr(filename, '\0') + 1;
-        timestamp = strchr(description, '\0') + 1;
-        // Formato: "PUBLISH filename"
-        snprintf(operation_str, sizeof(operation_str), "PUBLISH %s", filename);
-    } else if (strcmp(op, "DELETE") == 0) {
-        char *filename = strchr(user, '\0') + 1;
-        timestamp = strchr(filename, '\0') + 1;        
-        // Formato: "DELETE filename"
-        snprintf(operation_str, sizeof(operation_str), "DELETE %s", filename);
-    } else if (strcmp(op, "GET_FILE") == 0) {
-        strncpy(operation_str, "GET_FILE", sizeof(operation_str));
-    } else if (strcmp(op, "LIST_USERS") == 0) {
-        strncpy(operation_str, "LIST_USERS", sizeof(operation_str));
-    } else if (strcmp(op, "LIST_CONTENT") == 0) {
-        strncpy(operation_str, "LIST_CONTENT", sizeof(operation_str));
-    }
-
-    //// Construimos los args 
-    struct log_action_args args;
-    args.user      = (char*)user;
-    args.operation = operation_str;
-    args.timestamp = (char*)timestamp;
-
-    //// Definimos el timeout en una variable (sin coma al final)
-    struct timeval timeout = { 5, 0 };
-
-    //// Invocamos la macro con 7 args EXACTOS
-    enum clnt_stat st = clnt_call(
-    log_clnt,                       /* CLIENT * */
-        LOG_ACTION,                      /* procedimiento */
-        (xdrproc_t)xdr_log_action_args, /* xdr args */
-        (caddr_t)&args,                 /* puntero args */
-        (xdrproc_t)xdr_bool,            /* xdr result */
-        (caddr_t)&resultado,            /* puntero result */
-        timeout                         /* struct timeval */
-    );
-
-    printf("s> op='%s' | user='%s'\n", op, user);
-
-
-    // 7. Procesar cada tipo de operación
-    if (strcmp(op, "REGISTER") == 0) {
-        resultado = (char)register_user(user);
-        printf("s> OPERATION REGISTER FROM %s at %s\n", user, timestamp);
+// Añade a la salida los eventos que le faltan al suscriptor, mientras haya
+// sitio. Devuelve 1 si ha añadido algo.
+static int watch_push(Connection* conn) {
+    int added = 0;
+    while (conn->out.len - conn->out_pos < OUT_HIGH_WATER && conn->watch_seq != presence_seq()) {
+        int header_at = conn->out.len;
+        if (conn->proto == PROTO_V2) {
+            char header[4] = {0};
+            reply_append(&conn->out, header, 4);
+        }
+        int events_at = conn->out.len;
 
-        strcpy(operation_str, "REGISTER");
+        uint64_t last;
+        if (presence_since(conn->watch_seq, WATCH_PUSH_MAX, watch_visit, &conn->out, &last)) {
+            watch_snapshot(conn); // Se ha quedado demasiado atrás
+        } else {
+            conn->watch_seq = last;
+        }
 
-    } else if (strcmp(op, "UNREGISTER") == 0) {
-        resultado = (char)unregister_user(user);
-        printf("s> OPERATION UNREGISTER FROM %s at %s\n", user, timestamp);
+        if (conn->out.len == events_at) {
+            conn->out.len = header_at;
+            break;
+        }
+        if (conn->proto == PROTO_V2) {
+            uint32_t payload = htonl(conn->out.len - events_at);
+            memcpy(conn->out.data + header_at, &payload, 4);
+        }
+        added = 1;
+    }
+    return added;
+}
 
-        strcpy(operation_str, "UNREGISTER");
+// WATCH_USERS: valida como LIST_USERS, contesta 0 y deja la conexión suscrita.
+// Lo que falte desde el seq pedido sale con el siguiente watch_push.
+static void watch_start(Connection* conn, const ProtoRequest* req, int parsed) {
+    const char* user = req->user;
+    const char* since_str = req->arg[0];
+    if (parsed != PROTO_OK) {
+        log_op("s> Invalid message format\n");
+        char code = 4;
+        reply_append(&conn->out, &code, 1);
+        return;
+    }
 
-    } else if (strcmp(op, "DISCONNECT") == 0) {
-        resultado = (char)disconnect_user(user);
-        printf("s> OPERATION DISCONNECT FROM %s at %s\n", user, timestamp);
+    epoch_enter();
+    const UsersImage* image = NULL;
+    char code = (char)list_connected_users(user, &image); // 1 USER DOES NOT EXIST, 2 NOT CONNECTED
+    epoch_exit();
+    reply_append(&conn->out, &code, 1);
+    if (code != 0) return;
+
+    uint64_t now_us = coarse_now_us();
+    audit_log_record(user, "WATCH_USERS", now_us);
+    if (log_requests) {
+        char when[32];
+        coarse_format(now_us, when, sizeof(when));
+        log_op("s> OPERATION WATCH_USERS FROM %s (desde %s) at %s\n", user, since_str, when);
+    }
 
-        strcpy(operation_str, "DISCONNECT");
+    EventLoop* loop = conn->loop;
+    conn->watching = 1;
+    conn->watch_seq = strtoull(since_str, NULL, 10);
+    conn->watch_prev = NULL;
+    conn->watch_next = loop->watch_list;
+    if (loop->watch_list) loop->watch_list->watch_prev = conn;
+    loop->watch_list = conn;
+    atomic_fetch_add(&loop->watchers, 1);
+
+    // Sin seq (o uno que ya no está en el log): la foto va en la propia respuesta
+    uint64_t last;
+    if (conn->watch_seq == 0 || presence_since(conn->watch_seq, 0, watch_visit, NULL, &last)) {
+        watch_snapshot(conn);
+    }
+}
 
-    } else if (strcmp(op, "CONNECT") == 0) {
-        char* port_str = strchr(user, '\0') + 1;
-        char* timestamp = strchr(port_str, '\0') + 1; 
+// Modo shards: tramas v2 seguidas que se reenvían enteras a otro shard
+// (shard_pipelined) salen todas antes de esperar la primera respuesta, como
+// hace el cliente con el servidor. Cualquier otra petición espera a que se
+// hayan recogido, así las respuestas salen en orden.
+typedef struct {
+    int count;
+    int shard[SHARD_PIPELINE];          // -1 si no se pudo mandar
+    int generation[SHARD_PIPELINE];     // De la conexión por la que salió (shard_send)
+    int op[SHARD_PIPELINE];
+    uint64_t t0[SHARD_PIPELINE];
+} ShardPipeline;
+
+static void shard_pipeline_drain(Connection* conn, ShardPipeline* pipe) {
+    for (int i = 0; i < pipe->count; i++) {
+        char* data = NULL;
+        int len = 0;
+        int answered = pipe->shard[i] >= 0 &&
+                       shard_recv(pipe->shard[i], pipe->generation[i], &data, &len) == 0 && len > 0;
+
+        uint32_t payload = htonl(answered ? len : 1);
+        reply_append(&conn->out, &payload, 4);
+        if (answered) reply_append(&conn->out, data, len);
+        else reply_append(&conn->out, &op_failure[pipe->op[i]], 1);
+        int result = answered ? (unsigned char)data[0] : op_failure[pipe->op[i]];
+        metrics_request(metrics_op(proto_op_name(pipe->op[i])), result, metrics_now_ns() - pipe->t0[i]);
+        free(data);
+    }
+    pipe->count = 0;
+}
 
-        if (port_str >= buffer + len) {
-            resultado = 3;
-        } else {
-            int client_port = atoi(port_str);
+// Procesa una petición y añade la respuesta (enmarcada si es v2) a la salida.
+// Se apunta en las métricas con el primer byte de la respuesta como código.
+// pipe (sólo v2 en modo shards, si no NULL) recoge los reenvíos que pueden
+// quedarse en vuelo. Devuelve 0, sin tocar nada, si la petición le toca al
+// otro tipo de hilo (modo shards: reenviador o de eventos).
+static int conn_dispatch(Connection* conn, char* request, int len, int has_timestamp, ShardPipeline* pipe) {
+    uint64_t t0 = metrics_now_ns();
+
+    // Un solo recorrido de la petición; los campos se quedan en el buffer
+    ProtoRequest req;
+    int parsed = proto_parse_request(request, len, has_timestamp, BATCH_MAX, &req);
+    int held = conn->out.wait_lsn != 0;
+
+    if (shard_enabled() && shard_remote(&req, parsed) != forward_thread) return 0;
+
+    if (pipe) {
+        int shard = shard_pipelined(&req, parsed);
+        if (shard >= 0) {
+            if (pipe->count == SHARD_PIPELINE) shard_pipeline_drain(conn, pipe);
+            int flags = has_timestamp ? 0 : SHARD_FLAG_NO_TIMESTAMP;
+            pipe->generation[pipe->count] = shard_send(shard, flags, conn->ip, request, len);
+            pipe->shard[pipe->count] = pipe->generation[pipe->count] >= 0 ? shard : -1;
+            pipe->op[pipe->count] = req.op;
+            pipe->t0[pipe->count] = t0;
+            pipe->count++;
+            return 1;
+        }
+        shard_pipeline_drain(conn, pipe);
+    }
 
-            struct sockaddr_in addr;
-            socklen_t addr_len = sizeof(addr);
+    int header_at = conn->out.len;
+    if (conn->proto == PROTO_V2) {
+        char header[4] = {0};
+        reply_append(&conn->out, header, 4);
+    }
+    int reply_at = conn->out.len;
 
-            getpeername(client_sock, (struct sockaddr*)&addr, &addr_len);
+    if (req.op == PROTO_WATCH_USERS) {
+        watch_start(conn, &req, parsed);
+    } else if (!shard_enabled() || !shard_route(&req, parsed, request, len, has_timestamp, conn->ip, &conn->out)) {
+        handle_request(&req, parsed, has_timestamp, conn->ip, 0, &conn->out);
+    }
 
-            char client_ip[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+    if (conn->proto == PROTO_V2) {
+        uint32_t payload = htonl(conn->out.len - reply_at);
+        memcpy(conn->out.data + header_at, &payload, 4);
+    }
+    int result = conn->out.len > reply_at ? (unsigned char)conn->out.data[reply_at] : -1;
+    metrics_request(metrics_op(req.name ? req.name : ""), result, metrics_now_ns() - t0);
 
-            resultado = (char)connect_user(user, client_ip, client_port);
-            printf("s> OPERATION CONNECT FROM %s (%s:%d) at %s\n", user, client_ip, client_port, timestamp);
+    // Un cambio que aún no está en disco: su respuesta y las siguientes esperan
+    if (!held && conn->out.wait_lsn) conn_park(conn, header_at);
+    return 1;
+}
 
-            strcpy(operation_str, "CONNECT");
+// Consume las tramas v2 completas del buffer de entrada que le tocan a este
+// hilo. En el de eventos, al llegar a una para otros shards deja marcada la
+// conexión para reenviarla (si no está aparcada: entonces espera a salir).
+static void v2_process_frames(Connection* conn) {
+    ShardPipeline pipe;
+    pipe.count = 0;
+    int pos = 0;
+    while (conn->in_len - pos >= V2_HEADER_LEN && conn->out.len - conn->out_pos < OUT_HIGH_WATER &&
+           !conn->watching) {
+        uint32_t frame_len;
+        memcpy(&frame_len, conn->in + pos, 4);
+        frame_len = ntohl(frame_len);
+        if (frame_len > V2_MAX_FRAME) {
+            conn->closing = 1; // Trama inválida: no se puede resincronizar
+            break;
+        }
+        if (conn->in_len - pos < V2_HEADER_LEN + (int)frame_len) break; // Incompleta
+
+        // Se procesa en el sitio: proto_parse_request no pasa del final de la trama
+        int flags = (unsigned char)conn->in[pos + 4];
+        if (!conn_dispatch(conn, conn->in + pos + V2_HEADER_LEN, frame_len, !(flags & V2_FLAG_NO_TIMESTAMP),
+                           shard_enabled() ? &pipe : NULL)) {
+            if (!forward_thread && !conn->out.wait_lsn) conn->forwarding = 1;
+            break;
         }
+        pos += V2_HEADER_LEN + frame_len;
+    }
+    shard_pipeline_drain(conn, &pipe);
 
-    } else if (strcmp(op, "LIST_USERS") == 0) {
-        printf("s> OPERATION LIST_USERS FROM %s at %s\n", user, timestamp);
+    // Compactar lo que quede (trama a medias)
+    if (pos > 0) {
+        memmove(conn->in, conn->in + pos, conn->in_len - pos);
+        conn->in_len -= pos;
+    }
+}
 
-        pthread_mutex_lock(&user_mutex);
-        User* requester = user_list;
-        int found = 0;
-        while (requester) {
-            if (strcmp(requester->name, user) == 0) {
-                found = 1;
-                break;
-            }
-            requester = requester->next;
-        }
+// Decide el protocolo a partir de los primeros bytes. 0 si faltan datos.
+static int detect_protocol(Connection* conn) {
+    if (conn->in_len == 0) return 0;
+    if (conn->in[0] != '\0') {
+        conn->proto = PROTO_V1; // Una operación v1 nunca empieza por \0
+        return 1;
+    }
+    if (conn->in_len < V2_MAGIC_LEN) return 0;
+
+    if (memcmp(conn->in, V2_MAGIC, V2_MAGIC_LEN) == 0) {
+        conn->proto = PROTO_V2;
+        conn->in_len -= V2_MAGIC_LEN;
+        memmove(conn->in, conn->in + V2_MAGIC_LEN, conn->in_len);
+    } else {
+        conn->proto = PROTO_V1; // Acabará en "Invalid message format"
+    }
+    return 1;
+}
 
-        if (!found) {
-            pthread_mutex_unlock(&user_mutex);
-            char code = 1; // USER DOES NOT EXIST
-            send(client_sock, &code, 1, 0);
-            close(client_sock);
-            return NULL;
-        }
+// ----------------------------
+// Hilos reenviadores (modo shards)
+// ----------------------------
 
-        if (!requester->is_connected) {
-            pthread_mutex_unlock(&user_mutex);
-            char code = 2; // USER NOT CONNECTED
-            send(client_sock, &code, 1, 0);
-            close(client_sock);
-            return NULL;
-        }
+static pthread_mutex_t forward_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t forward_cond = PTHREAD_COND_INITIALIZER;
+static Connection* forward_head = NULL;
+static Connection* forward_tail = NULL;
+
+// Desde su hilo de eventos: la conexión sale de epoll y pasa a la cola
+static void forward_submit(EventLoop* loop, Connection* conn) {
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    conn->events = 0;
+    conn->forward_next = NULL;
+    pthread_mutex_lock(&forward_mutex);
+    if (forward_tail) forward_tail->forward_next = conn;
+    else forward_head = conn;
+    forward_tail = conn;
+    pthread_cond_signal(&forward_cond);
+    pthread_mutex_unlock(&forward_mutex);
+}
 
-        // Contar usuarios conectados
-        int count = 0;
-        User* u = user_list;
-        while (u) {
-            if (u->is_connected) count++;
-            u = u->next;
+// Atiende lo que le toca y devuelve la conexión a su hilo de eventos, que
+// la vuelve a meter en epoll (loop_wakeup)
+static void* forward_worker(void* arg) {
+    forward_thread = 1;
+    while (1) {
+        pthread_mutex_lock(&forward_mutex);
+        while (!forward_head) pthread_cond_wait(&forward_cond, &forward_mutex);
+        Connection* conn = forward_head;
+        forward_head = conn->forward_next;
+        if (!forward_head) forward_tail = NULL;
+        pthread_mutex_unlock(&forward_mutex);
+
+        if (conn->proto == PROTO_V2) {
+            v2_process_frames(conn);
+        } else {
+            conn_dispatch(conn, conn->in, conn->in_len, 1, NULL);
+            conn->in_len = 0;
+            conn->closing = 1;
         }
 
-        // Enviar código de éxito
-        char ok = 0;
-        send(client_sock, &ok, 1, 0);
-
-        // Enviar número de usuarios como cadena con '\0'
-        char count_str[10];
-        snprintf(count_str, sizeof(count_str), "%d", count);
-        send(client_sock, count_str, strlen(count_str) + 1, 0);
-
-        // Enviar nombre, IP y puerto de cada usuario
-        u = user_list;
-        while (u) {
-            if (u->is_connected) {
-                send(client_sock, u->name, strlen(u->name) + 1, 0);
-                send(client_sock, u->ip, strlen(u->ip) + 1, 0);
-                char port_str[10];
-                snprintf(port_str, sizeof(port_str), "%d", u->port);
-                send(client_sock, port_str, strlen(port_str) + 1, 0);
-            }
-            u = u->next;
+        EventLoop* loop = conn->loop;
+        pthread_mutex_lock(&loop->returned_mutex);
+        conn->forward_next = loop->returned;
+        loop->returned = conn;
+        pthread_mutex_unlock(&loop->returned_mutex);
+        uint64_t one = 1;
+        if (write(loop->wake_fd, &one, sizeof(one)) < 0) {
+            // Contador del eventfd lleno: el hilo ya tiene un aviso pendiente
         }
+    }
+    return NULL;
+}
 
-        strcpy(operation_str, "LIST USERS");
+static int forward_start(void) {
+    for (int i = 0; i < SHARD_FORWARDERS; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, forward_worker, NULL) != 0) return -1;
+        pthread_detach(tid);
+    }
+    return 0;
+}
 
-        pthread_mutex_unlock(&user_mutex);
-        close(client_sock);
-        return NULL;
+// Ajusta los eventos de epoll al estado de la conexión (o la cierra)
+static void conn_update(EventLoop* loop, Connection* conn) {
+    if (conn->out.wait_lsn) conn_check_wal(conn);
+    int flushed = conn_flush(conn);
+
+    // Tramas que se quedaron sin procesar por tener demasiada salida pendiente
+    // (o esperando al WAL o a que volviera del reenviador)
+    if (flushed && conn->proto == PROTO_V2 && !conn->closing && !conn->forwarding &&
+        conn->in_len >= V2_HEADER_LEN) {
+        v2_process_frames(conn);
+        flushed = conn_flush(conn);
+    }
 
-        
-    } else if (strcmp(op, "PUBLISH") == 0) {
-        char* filename = strchr(user, '\0') + 1;
-        char* description = strchr(filename, '\0') + 1;
-        char* timestamp = strchr(description, '\0') + 1;
+    if (conn->forwarding) {
+        forward_submit(loop, conn);
+        return;
+    }
 
-        if (description >= buffer + len) {
-            resultado = 4;
-        } else {
-            resultado = (char)publish_file(user, filename, description);
-            printf("s> OPERATION PUBLISH FROM %s: %s (%s) at %s\n", user, filename, description, timestamp);
+    // Suscriptor: eventos nuevos en cuanto hay sitio en la salida
+    if (conn->watching && !conn->closing && watch_push(conn)) flushed = conn_flush(conn);
+
+    if (flushed && conn->closing && !conn->out.wait_lsn) {
+        conn_close(loop, conn);
+        return;
+    }
+
+    uint32_t events = 0;
+    if (!conn->closing && conn->out.len - conn->out_pos < OUT_HIGH_WATER) events |= EPOLLIN | EPOLLRDHUP;
+    if (!flushed) events |= EPOLLOUT;
+
+    if (events != conn->events) {
+        struct epoll_event ev = { .events = events, .data.ptr = conn };
+        epoll_ctl(loop->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+        conn->events = events;
+    }
+}
+
+static void conn_readable(EventLoop* loop, Connection* conn) {
+    int eof = 0;
 
-            snprintf(operation_str, sizeof(operation_str),"PUBLISH %s", filename);
+    // Un suscriptor ya no manda peticiones: se descarta lo que llegue y
+    // sólo importa si cierra
+    if (conn->watching) {
+        char discard[512];
+        ssize_t n;
+        while ((n = recv(conn->fd, discard, sizeof(discard), 0)) > 0 || (n < 0 && errno == EINTR)) {
         }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) conn->closing = 1;
+        conn_update(loop, conn);
+        return;
+    }
 
-    } else if (strcmp(op, "DELETE") == 0) {
-        char* filename = strchr(user, '\0') + 1;
-        char* timestamp = strchr(filename, '\0') + 1;
+    while (!conn->closing && !conn->forwarding) {
+        int limit = conn_in_limit(conn);
+        if (conn->in_len >= limit) break;
+        if (ensure_capacity(&conn->in, &conn->in_cap, conn->in_len + 4096 < limit ? conn->in_len + 4096 : limit) < 0) {
+            eof = 1;
+            break;
+        }
 
-        if (filename >= buffer + len) {
-            resultado = 4; // Mal formato
-        } else {
-            resultado = (char)delete_file(user, filename);
-            printf("s> OPERATION DELETE FROM %s: %s at %s\n", user, filename, timestamp);
-            snprintf(operation_str, sizeof(operation_str), "DELETE %s", filename);
+        ssize_t n = recv(conn->fd, conn->in + conn->in_len, conn->in_cap - conn->in_len, 0);
+        if (n > 0) {
+            conn->in_len += n;
+            if (conn->proto == PROTO_UNKNOWN) detect_protocol(conn);
+            if (conn->proto == PROTO_V1 && v1_request_complete(conn)) break;
+            if (conn->proto == PROTO_V2) v2_process_frames(conn);
+            continue;
         }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        eof = 1; // Cierre del cliente o error
+        break;
+    }
 
-    } else if (strcmp(op, "LIST_CONTENT") == 0) {
-        char* target_user = strchr(user, '\0') + 1;
-        char* timestamp = strchr(target_user, '\0') + 1;
-        if (target_user >= buffer + len) {
-            char code = 4;
-            send(client_sock, &code, 1, 0);
-            close(client_sock);
-            return NULL;
+    if (conn->proto == PROTO_V2) {
+        if (!conn->forwarding) v2_process_frames(conn);
+        // Si se va a reenviar, el cierre se vuelve a ver a la vuelta, tras lo que quede
+        if (eof && !conn->forwarding) conn->closing = 1;
+    } else if (eof || (conn->proto == PROTO_V1 && v1_request_complete(conn))) {
+        // Petición v1 completa (o el cliente cerró con lo que hubiera)
+        if (conn->in_len > 0) {
+            if (conn->proto == PROTO_UNKNOWN) conn->proto = PROTO_V1;
+            conn->forwarding = !conn_dispatch(conn, conn->in, conn->in_len, 1, NULL);
         }
+        if (!conn->forwarding) {
+            conn->in_len = 0;
+            conn->closing = !conn->watching;
+        }
+    }
 
-        char list_buffer[BUFFER_SIZE];
-        int result = list_user_files(user, target_user, list_buffer, BUFFER_SIZE);
+    conn_update(loop, conn);
+}
 
-        if (result >= 0) {
-            char ok = 0;
-            send(client_sock, &ok, 1, 0);
-            send(client_sock, list_buffer, result, 0);
-        } else {
-            char err_code = (char)result;
-            send(client_sock, &err_code, 1, 0);
+static void accept_connections(EventLoop* loop) {
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        int fd = accept(loop->listen_fd, (struct sockaddr*)&client_addr, &addr_len);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
         }
-        printf("s> OPERATION LIST_CONTENT FROM %s TO %s at %s\n", user, target_user, timestamp);
 
-        strcpy(operation_str, "LIST CONTENT");
+        Connection* conn = calloc(1, sizeof(Connection));
+        if (!conn || set_nonblocking(fd) < 0) {
+            free(conn);
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->loop = loop;
+        conn->proto = PROTO_UNKNOWN;
+        conn->events = EPOLLIN | EPOLLRDHUP;
+        inet_ntop(AF_INET, &client_addr.sin_addr, conn->ip, INET_ADDRSTRLEN);
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct epoll_event ev = { .events = conn->events, .data.ptr = conn };
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("epoll_ctl");
+            close(fd);
+            free(conn);
+            continue;
+        }
+        metrics_conn_opened();
+    }
+}
 
-        close(client_sock);
-        return NULL;
+// Lo llama el hilo del WAL tras cada tanda: despierta a los hilos de
+// eventos que tienen conexiones aparcadas
+static void wal_notify(void* arg) {
+    uint64_t one = 1;
+    for (int i = 0; i < num_event_loops; i++) {
+        if (atomic_load(&event_loops[i].parked) > 0 &&
+            write(event_loops[i].wake_fd, &one, sizeof(one)) < 0) {
+            // Contador del eventfd lleno: el hilo ya tiene un aviso pendiente
+        }
+    }
+}
 
-    } else if (strcmp(op, "GET_FILE") == 0) {
-        char* target_user = strchr(user, '\0') + 1; // Coge target_user como todo lo que hay detrás del primer \0
-        char* filename = strchr(target_user, '\0') + 1;  // Coge filename como lo que hay detras del \0 en target_user (o sea el segundo \0)
-        char* timestamp = strchr(filename, '\0') + 1;
+// Eventos de presencia nuevos, WAL volcado o conexiones que vuelven de un
+// reenviador: cada suscriptor del hilo recibe lo suyo, las aparcadas que
+// ya están en disco salen y las devueltas vuelven a epoll
+static void loop_wakeup(EventLoop* loop) {
+    uint64_t pending;
+    if (read(loop->wake_fd, &pending, sizeof(pending)) < 0) {
+        // Otro aviso ya lo había vaciado
+    }
+    pthread_mutex_lock(&loop->returned_mutex);
+    Connection* returned = loop->returned;
+    loop->returned = NULL;
+    pthread_mutex_unlock(&loop->returned_mutex);
+    while (returned) {
+        Connection* next = returned->forward_next;
+        returned->forwarding = 0;
+        returned->events = EPOLLIN | EPOLLRDHUP;
+        struct epoll_event ev = { .events = returned->events, .data.ptr = returned };
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, returned->fd, &ev) < 0) returned->closing = 1;
+        conn_update(loop, returned);
+        returned = next;
+    }
+    Connection* conn = loop->watch_list;
+    while (conn) {
+        Connection* next = conn->watch_next; // conn_update puede cerrarla
+        conn_update(loop, conn);
+        conn = next;
+    }
+    conn = loop->park_list;
+    while (conn) {
+        Connection* next = conn->park_next; // conn_update puede sacarla de la lista
+        conn_update(loop, conn);
+        conn = next;
+    }
+}
 
-        if (filename >= buffer + len) {
-            resultado = 2; // Formato incorrecto
-        } else {
-            User* requester = get_user_by_name(user);
-            User* target = get_user_by_name(target_user);
-            
-            if (!requester || !requester->is_connected) {
-                resultado = 2; // Usuario no existe o no conectado
-            } else if (!target || !target->is_connected) {
-                resultado = 2; // Usuario destino no existe o no conectado
+// ----------------------------
+// Caducidad de conectados sin señales (ver registry_expire)
+// ----------------------------
+
+typedef struct {
+    char name[MAX_NAME_LEN];
+    Endpoint endpoint;
+} Expired;
+
+typedef struct {
+    Expired* list;
+    int count;
+    int capacity;
+} ExpiredList;
+
+// Con user_mutex cogido: sólo se copia, la auditoría va después
+static void liveness_collect(const char* name, const Endpoint* ep, void* arg) {
+    ExpiredList* out = arg;
+    if (out->count == out->capacity) {
+        int new_cap = out->capacity ? out->capacity * 2 : 16;
+        Expired* bigger = realloc(out->list, new_cap * sizeof(Expired));
+        if (!bigger) return;
+        out->list = bigger;
+        out->capacity = new_cap;
+    }
+    Expired* e = &out->list[out->count++];
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->endpoint = *ep;
+}
+
+static void* liveness_thread(void* arg) {
+    ExpiredList expired = { NULL, 0, 0 };
+    while (1) {
+        usleep(LIVENESS_TICK_US);
+        expired.count = 0;
+        if (registry_expire(liveness_collect, &expired) == 0) continue;
+
+        uint64_t now_us = coarse_now_us();
+        for (int i = 0; i < expired.count; i++) {
+            Expired* e = &expired.list[i];
+            audit_log_record(e->name, "DISCONNECT EXPIRED", now_us);
+            log_op("s> EXPIRED %s (%s:%d): sin señales en %llu s\n", e->name, e->endpoint.ip, e->endpoint.port,
+                   (unsigned long long)(registry_liveness_timeout() / 1000000));
+        }
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+static void* event_loop(void* arg) {
+    EventLoop* loop = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (1) {
+        int n = epoll_wait(loop->epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        int wake = 0;
+        for (int i = 0; i < n; i++) {
+            Connection* conn = events[i].data.ptr;
+            if (conn == NULL) {
+                accept_connections(loop);   // El socket de escucha no lleva ptr
+            } else if ((void*)conn == (void*)loop) {
+                wake = 1;                   // El eventfd lleva el propio loop
+            } else if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                conn_readable(loop, conn);
             } else {
-                // Verificar si el archivo existe en el usuario destino
-                FileEntry* f = target->files;
-                int file_exists = 0;
-                while (f) {
-                    if (strcmp(f->filename, filename) == 0) {
-                        file_exists = 1;
-                        break;
-                    }
-                    f = f->next;
-                }
-                
-                if (file_exists) {
-                    // Enviar información de conexión del usuario destino
-                    printf("s> OPERATION GET_FILE FROM %s TO %s: %s at %s\n", user, target_user, filename, timestamp);
-                    resultado = 0; // Éxito
-                    send(client_sock, &resultado, 1, 0);
-                    
-                    // Enviar IP y puerto del usuario destino
-                    send(client_sock, target->ip, strlen(target->ip) + 1, 0);
-                    char port_str[10];
-                    snprintf(port_str, sizeof(port_str), "%d", target->port);
-                    send(client_sock, port_str, strlen(port_str) + 1, 0);
-                    
-                    close(client_sock);
-                    return NULL;
-                } else {
-                    resultado = 1; // Archivo no existe
-                }
+                conn_update(loop, conn);
             }
-            printf("s> OPERATION GET_FILE FROM %s TO %s: %s at %s\n", user, target_user, filename, timestamp);
-
-            snprintf(operation_str, sizeof(operation_str), "GET_FILE %s", filename);
         }
 
-        } else {
-            printf("s> UNKNOWN OPERATION: %s at %s\n", op, timestamp);
-            resultado = 3;
+        // Al final: puede cerrar o reenviar conexiones que vengan en esta tanda
+        if (wake) loop_wakeup(loop);
     }
-
-    // 8. Enviar respuesta al cliente y cerrar
-    send(client_sock, &resultado, 1, 0);
-    close(client_sock);
     return NULL;
 }
 
-
 // ----------------------------
 // Main
 // ----------------------------
 
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s -p <port> [-b <backlog>] [-t <hilos de eventos>]\n"
+                    "          [-q <tamaño cola de log>] [-o drop|block|spill]\n"
+                    "          [-d <directorio de datos> [-s group|async] [-c <registros por snapshot>]]\n"
+                    "          [-m <puerto HTTP de métricas>] [-n (sin log por petición)]\n"
+                    "          [-w <eventos del log de WATCH_USERS>]\n"
+                    "          [-k <segundos sin señales para desconectar, por defecto 0 = nunca>]\n"
+                    "          [-S <host:puerto interno de cada shard,...> -i <posición de este>]\n", prog);
+    exit(1);
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 3 || strcmp(argv[1], "-p") != 0) {
-        fprintf(stderr, "Uso: %s -p <port>\n", argv[0]);
+    int port = -1;
+    int backlog = SOMAXCONN;
+    int num_loops = (int)sysconf(_SC_NPROCESSORS_ONLN); // Un hilo de eventos por CPU
+    int log_queue = 8192;
+    AuditOverflow log_overflow = AUDIT_OVERFLOW_DROP;
+    const char* data_dir = NULL;                 // Sin -d el registro sólo vive en memoria
+    WalSync wal_policy = WAL_SYNC_GROUP;
+    long long compact_every = 100000;
+    int metrics_port = -1;                       // Sin -m no hay endpoint HTTP
+    int watch_log = PRESENCE_LOG_DEFAULT;
+    long liveness_sec = LIVENESS_DEFAULT_SEC;
+    const char* shard_spec = NULL;               // Sin -S un solo servidor con todo el registro
+    int shard_index = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:b:t:q:o:d:s:c:m:nw:k:S:i:")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'b': backlog = atoi(optarg); break;
+            case 't': num_loops = atoi(optarg); break;
+            case 'q': log_queue = atoi(optarg); break;
+            case 'o':
+                if (audit_parse_overflow(optarg, &log_overflow) < 0) usage(argv[0]);
+                break;
+            case 'd': data_dir = optarg; break;
+            case 's':
+                if (wal_parse_sync(optarg, &wal_policy) < 0) usage(argv[0]);
+                break;
+            case 'c': compact_every = atoll(optarg); break;
+            case 'm': metrics_port = atoi(optarg); break;
+            case 'n': log_requests = 0; break;
+            case 'w': watch_log = atoi(optarg); break;
+            case 'k': liveness_sec = atol(optarg); break;
+            case 'S': shard_spec = optarg; break;
+            case 'i': shard_index = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (port == -1 || optind != argc || backlog <= 0 || num_loops <= 0 || log_queue <= 0 || compact_every < 0 ||
+        watch_log <= 0 || liveness_sec < 0 || (shard_spec != NULL) != (shard_index >= 0)) {
+        usage(argv[0]);
+    }
+    if (shard_spec && shard_configure(shard_spec, shard_index) < 0) {
+        fprintf(stderr, "Lista de shards no válida: %s (posición %d)\n", shard_spec, shard_index);
         exit(1);
     }
 
-    int port = atoi(argv[2]);
     if (port < 1024 || port > 65535) {
         fprintf(stderr, "Puerto fuera de rango (1024-65535)\n");
         exit(1);
     }
 
+    signal(SIGPIPE, SIG_IGN); // Un cliente que se va no debe tumbar el servidor
+
     int server_sock = socket(AF_INET, SOCK_STREAM, 0);
     if (server_sock < 0) {
         perror("socket");
         exit(1);
     }
 
+    int reuse = 1;
+    setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
     struct sockaddr_in server_addr = {
         .sin_family = AF_INET,
         .sin_port = htons(port),
@@ -726,13 +1823,30 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
-    if (listen(server_sock, 10) < 0) {
+    if (listen(server_sock, backlog) < 0 || set_nonblocking(server_sock) < 0) {
         perror("listen");
         close(server_sock);
         exit(1);
     }
 
+    if (coarse_clock_start(COARSE_TICK_MS) < 0 || registry_init() < 0 || presence_init(watch_log) < 0) {
+        perror("registry_init");
+        close(server_sock);
+        exit(1);
+    }
+
+    if (data_dir && persist_start(data_dir, wal_policy, (uint64_t)compact_every) < 0) {
+        perror("persist_start");
+        close(server_sock);
+        exit(1);
+    }
+
+    registry_set_liveness((uint64_t)liveness_sec * 1000000ULL);
+
     printf("s> init server 127.0.0.1:%d\ns>\n", port);
+    if (shard_enabled()) {
+        printf("s> shard %d de %d (canal interno %s)\n", shard_self(), shard_count(), shard_name(shard_self()));
+    }
 
     /* 1) Leer la IP del servidor RPC desde la variable de entorno */
     char *rpc_host = getenv("LOG_RPC_IP");
@@ -741,27 +1855,79 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
-    /* 2) Crear cliente RPC sobre TCP */
-    log_clnt = clnt_create(rpc_host, LOGPROG, LOGVERS, "tcp");
+    /* 2) Crear cliente RPC sobre TCP. Con LOG_RPC_PORT se conecta directamente
+          a ese puerto de servidor_rpc, sin preguntar a rpcbind */
+    char *rpc_port = getenv("LOG_RPC_PORT");
+    if (rpc_port) {
+        struct sockaddr_in rpc_addr;
+        memset(&rpc_addr, 0, sizeof(rpc_addr));
+        rpc_addr.sin_family = AF_INET;
+        rpc_addr.sin_port = htons(atoi(rpc_port));
+        struct hostent *he = gethostbyname(rpc_host);
+        if (he) memcpy(&rpc_addr.sin_addr, he->h_addr_list[0], sizeof(rpc_addr.sin_addr));
+        int rpc_sock = RPC_ANYSOCK;
+        log_clnt = he ? clnttcp_create(&rpc_addr, LOGPROG, LOGVERS, &rpc_sock, 0, 0) : NULL;
+    } else {
+        log_clnt = clnt_create(rpc_host, LOGPROG, LOGVERS, "tcp");
+    }
     if (log_clnt == NULL) {
         clnt_pcreateerror("Error conectando al servidor RPC");
         exit(1);
     }
 
-    while (1) {
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
-        int* client_sock = malloc(sizeof(int));
-        *client_sock = accept(server_sock, (struct sockaddr*)&client_addr, &addr_len);
-        if (*client_sock < 0) {
-            perror("accept");
-            free(client_sock);
-            continue;
+    if (audit_log_init(log_clnt, log_queue, log_overflow, "audit_spill.bin") < 0) {
+        perror("audit_log_init");
+        exit(1);
+    }
+
+    if (metrics_port > 0 && metrics_http_start(metrics_port, render_stats) < 0) {
+        perror("metrics_http_start");
+        exit(1);
+    }
+    metrics_set_event_loops(num_loops);
+
+    if (shard_enabled() && shard_serve(shard_serve_request) < 0) {
+        perror("shard_serve");
+        exit(1);
+    }
+
+    pthread_t liveness_tid;
+    if (liveness_sec > 0) {
+        pthread_create(&liveness_tid, NULL, liveness_thread, NULL);
+        pthread_detach(liveness_tid);
+    }
+
+    /* 4) Lanzar los hilos de eventos. Todos vigilan el socket de escucha
+          (EPOLLEXCLUSIVE despierta sólo a uno) y se quedan con lo que aceptan */
+    EventLoop* loops = calloc(num_loops, sizeof(EventLoop));
+    for (int i = 0; i < num_loops; i++) {
+        loops[i].listen_fd = server_sock;
+        loops[i].epfd = epoll_create1(0);
+        loops[i].wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        pthread_mutex_init(&loops[i].returned_mutex, NULL);
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = NULL };
+        struct epoll_event wake = { .events = EPOLLIN, .data.ptr = &loops[i] };
+        if (loops[i].epfd < 0 || loops[i].wake_fd < 0 ||
+            epoll_ctl(loops[i].epfd, EPOLL_CTL_ADD, server_sock, &ev) < 0 ||
+            epoll_ctl(loops[i].epfd, EPOLL_CTL_ADD, loops[i].wake_fd, &wake) < 0) {
+            perror("epoll");
+            exit(1);
         }
+    }
+    event_loops = loops;
+    num_event_loops = num_loops;
+    if (shard_enabled() && forward_start() < 0) {
+        perror("forward_start");
+        exit(1);
+    }
+    presence_set_notify(watch_notify, NULL);
+    wal_set_notify(wal_notify, NULL);
+    for (int i = 0; i < num_loops; i++) {
+        pthread_create(&loops[i].tid, NULL, event_loop, &loops[i]);
+    }
 
-        pthread_t tid;
-        pthread_create(&tid, NULL, client_handler, client_sock);
-        pthread_detach(tid); // No hay necesidad de hacer join
+    for (int i = 0; i < num_loops; i++) {
+        pthread_join(loops[i].tid, NULL);
     }
 
     close(server_sock);
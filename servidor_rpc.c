@@ -5,21 +5,123 @@
  */
 
 #include "log_rpc.h"
+#include "coarse_clock.h"
+#include "log_sink.h"
+#include "log_index.h"
+#include "rpc_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <rpc/pmap_clnt.h>
+
+// ----------------------------
+// Sumidero: los registros van a segmentos binarios (ver log_sink.h y
+// log_reader). Se configura con LOG_DIR, LOG_SEGMENT_MB, LOG_SEGMENT_SECS,
+// LOG_FSYNC_MS y LOG_FSYNC_RECORDS. Con LOG_ECHO=1 también se imprimen por
+// pantalla con el formato de siempre (sin fflush por registro).
+// ----------------------------
+
+static int echo = 0;
+
+static void sink_init(void) {
+	LogSinkConfig cfg;
+	log_sink_config_env(&cfg);
+	if (log_sink_open(&cfg) < 0) {
+		perror("servidor_rpc: no se puede abrir el directorio de log");
+		exit(1);
+	}
+	const char *e = getenv("LOG_ECHO");
+	echo = e && *e == '1';
+}
+
+static void echo_record(const log_action_args *rec) {
+	/* Imprime: Nombre_usuario OPERACION [<fichero>]  dd/mm/yyyy hh:mm:ss */
+	char when[32];
+	coarse_format(rec->timestamp, when, sizeof(when));
+	printf("%s %s %s\n", rec->user, rec->operation, when);
+}
 
 bool_t
 log_action_1_svc(log_action_args arg1, void *result,  struct svc_req *rqstp)
 {
-	/* Imprime: Nombre_usuario OPERACION [<fichero>]  dd/mm/yyyy hh:mm:ss */
-	
-    printf("%s %s %s\n",
-		arg1.user,
-		arg1.operation,
-		arg1.timestamp);
-	fflush(stdout);
+	log_sink_append(arg1.user, arg1.operation, arg1.timestamp);
+	if (echo) echo_record(&arg1);
 	*(bool_t *)result = TRUE;
     return TRUE;
 }
 
+#define SINK_CHUNK 256
+
+bool_t
+log_batch_1_svc(log_batch_args arg1, void *result,  struct svc_req *rqstp)
+{
+	/* Un lote de registros: se pasan al sumidero en trozos, una toma del lock por trozo */
+	LogSinkRecord recs[SINK_CHUNK];
+	u_int n = arg1.records.records_len;
+	for (u_int i = 0; i < n; i += SINK_CHUNK) {
+		u_int m = n - i < SINK_CHUNK ? n - i : SINK_CHUNK;
+		for (u_int j = 0; j < m; j++) {
+			log_action_args *rec = &arg1.records.records_val[i + j];
+			recs[j].user = rec->user;
+			recs[j].operation = rec->operation;
+			recs[j].time_us = rec->timestamp;
+			if (echo) echo_record(rec);
+		}
+		log_sink_append_batch(recs, m);
+	}
+	return TRUE;
+}
+
+// ----------------------------
+// QUERY_LOG: consultas con los índices del sumidero (log_index.h)
+// ----------------------------
+
+#define QUERY_MAX_RECORDS 10000
+
+typedef struct {
+	log_query_result *result;
+	u_int limit;
+	int more;
+} QueryCtx;
+
+static int collect_record(const LogEntry *e, void *arg) {
+	QueryCtx *ctx = arg;
+	if (ctx->result->records.records_len == ctx->limit) {
+		ctx->more = 1; /* Hay al menos uno más: se pedirá en otra página */
+		return 0;
+	}
+	log_record *r = &ctx->result->records.records_val[ctx->result->records.records_len++];
+	r->seq = e->seq;
+	r->user = strndup(e->user, e->user_len);
+	r->operation = strndup(e->operation, e->op_len);
+	r->timestamp = e->time_us;
+	return 1;
+}
+
+bool_t
+query_log_1_svc(log_query_args arg1, log_query_result *result,  struct svc_req *rqstp)
+{
+	QueryCtx ctx;
+	ctx.result = result;
+	ctx.limit = arg1.limit == 0 || arg1.limit > QUERY_MAX_RECORDS ? QUERY_MAX_RECORDS : arg1.limit;
+	ctx.more = 0;
+
+	result->records.records_len = 0;
+	result->records.records_val = calloc(ctx.limit, sizeof(log_record));
+	result->next_seq = 0;
+	if (!result->records.records_val) {
+		result->status = -1;
+		return TRUE;
+	}
+
+	LogQuery q = { arg1.user, arg1.operation, arg1.from, arg1.to, arg1.after_seq };
+	result->status = log_sink_query(&q, collect_record, &ctx) < 0 ? -1 : 0;
+	if (ctx.more) result->next_seq = result->records.records_val[result->records.records_len - 1].seq;
+	return TRUE;
+}
+
 int
 logprog_1_freeresult (SVCXPRT *transp, xdrproc_t xdr_result, caddr_t result)
 {
@@ -31,3 +133,101 @@ logprog_1_freeresult (SVCXPRT *transp, xdrproc_t xdr_result, caddr_t result)
 
 	return 1;
 }
+
+// ----------------------------
+// Main: en vez del svc_run() de log_rpc_svc.c (una llamada cada vez), un
+// pool de hilos (rpc_pool.h). Las escrituras en el sumidero siguen en serie:
+// log_sink las ordena con su propio lock.
+// ----------------------------
+
+/* Como _log_action_1/_log_batch_1 de log_rpc_svc.c */
+static bool_t
+_log_action_1 (char *argp, void *result, struct svc_req *rqstp)
+{
+	return (log_action_1_svc(*(log_action_args *) argp, result, rqstp));
+}
+
+static bool_t
+_log_batch_1 (char *argp, void *result, struct svc_req *rqstp)
+{
+	return (log_batch_1_svc(*(log_batch_args *) argp, result, rqstp));
+}
+
+static bool_t
+_query_log_1 (char *argp, void *result, struct svc_req *rqstp)
+{
+	return (query_log_1_svc(*(log_query_args *) argp, result, rqstp));
+}
+
+static const RpcProc logprog_procs[] = {
+	{ LOG_ACTION, (xdrproc_t) xdr_log_action_args, sizeof(log_action_args),
+	  (xdrproc_t) xdr_void, sizeof(bool_t), _log_action_1 },
+	{ LOG_BATCH, (xdrproc_t) xdr_log_batch_args, sizeof(log_batch_args),
+	  (xdrproc_t) xdr_void, sizeof(bool_t), _log_batch_1 },
+	{ QUERY_LOG, (xdrproc_t) xdr_log_query_args, sizeof(log_query_args),
+	  (xdrproc_t) xdr_log_query_result, sizeof(log_query_result), _query_log_1 },
+};
+
+static const RpcProgram logprog = { LOGPROG, LOGVERS, logprog_procs, 3 };
+
+static void usage(const char *prog) {
+	fprintf(stderr, "Uso: %s [-p <port>] [-w <hilos>]\n"
+	                "  Sin -p se usa LOG_RPC_PORT o, si no está, un puerto libre\n"
+	                "  (los clientes lo encuentran por rpcbind)\n", prog);
+	exit(1);
+}
+
+int
+main (int argc, char **argv)
+{
+	const char *env_port = getenv("LOG_RPC_PORT");
+	int port = env_port ? atoi(env_port) : 0;
+	int workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+	int opt;
+	while ((opt = getopt(argc, argv, "p:w:")) != -1) {
+		switch (opt) {
+			case 'p': port = atoi(optarg); break;
+			case 'w': workers = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || port < 0 || port > 65535 || workers <= 0) usage(argv[0]);
+
+	signal(SIGPIPE, SIG_IGN);
+	sink_init();
+
+	int listen_fd = rpc_pool_listen(port);
+	if (listen_fd < 0) {
+		perror("servidor_rpc: no se puede escuchar");
+		exit(1);
+	}
+	port = rpc_pool_port(listen_fd);
+
+	// Registro en rpcbind para clnt_create. Sin rpcbind los clientes tienen
+	// que conectar directamente al puerto (LOG_RPC_PORT en servidor)
+	pmap_unset(LOGPROG, LOGVERS);
+	if (!pmap_set(LOGPROG, LOGVERS, IPPROTO_TCP, port)) {
+		fprintf(stderr, "servidor_rpc: sin registro en rpcbind, usa LOG_RPC_PORT=%d en los clientes\n", port);
+	}
+
+	// SIGINT/SIGTERM los recoge el hilo principal (los workers los heredan
+	// bloqueados) para volcar el sumidero antes de salir
+	sigset_t stop;
+	sigemptyset(&stop);
+	sigaddset(&stop, SIGINT);
+	sigaddset(&stop, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+	if (rpc_pool_start(listen_fd, &logprog, workers) < 0) {
+		perror("servidor_rpc: rpc_pool_start");
+		exit(1);
+	}
+	fprintf(stderr, "servidor_rpc: puerto %d, %d hilos\n", port, workers);
+
+	int sig;
+	sigwait(&stop, &sig);
+	log_sink_close();
+	pmap_unset(LOGPROG, LOGVERS);
+	return 0;
+}
@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "shard.h"
+#include "strmap.h"
+
+// Punto del anillo: los usuarios con hash en (punto anterior, point] son de shard
+typedef struct {
+    uint64_t point;
+    int shard;
+} RingPoint;
+
+static int num_shards = 0;              // 0 = sin modo shards
+static int self_shard = -1;
+static char names[SHARD_MAX][64];
+static struct sockaddr_in addrs[SHARD_MAX];
+static RingPoint ring[SHARD_MAX * SHARD_VNODES];
+static int ring_len = 0;
+
+static ShardHandler serve_handler = NULL;
+static int serve_fd = -1;
+
+static _Atomic uint64_t stat_calls = 0;
+static _Atomic uint64_t stat_served = 0;
+static _Atomic uint64_t stat_failures = 0;
+
+// Conexión de un hilo con otro shard (fd -1 = sin abrir). generation
+// cambia cada vez que se cierra: lo que quedara pendiente en la anterior
+// ya no se puede leer de la nueva.
+typedef struct {
+    int fd;
+    int pending;              // Respuestas por leer
+    int generation;
+} Link;
+
+static __thread Link* links = NULL;
+
+// FNV-1a (el de strmap) deja los nombres parecidos en puntos cercanos:
+// se remueve con el final de splitmix64 para repartirlos por todo el anillo
+static uint64_t ring_hash(const char* key) {
+    uint64_t h = strmap_hash(key);
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static int cmp_point(const void* a, const void* b) {
+    uint64_t x = ((const RingPoint*)a)->point;
+    uint64_t y = ((const RingPoint*)b)->point;
+    return x < y ? -1 : x > y;
+}
+
+static int parse_addr(const char* item, int shard) {
+    char host[48];
+    const char* colon = strrchr(item, ':');
+    if (!colon || colon == item || colon - item >= (int)sizeof(host)) return -1;
+    int port = atoi(colon + 1);
+    if (port <= 0 || port > 65535) return -1;
+
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - item), item);
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0 || !res) return -1;
+    addrs[shard] = *(struct sockaddr_in*)res->ai_addr;
+    addrs[shard].sin_port = htons(port);
+    freeaddrinfo(res);
+
+    snprintf(names[shard], sizeof(names[shard]), "%s:%d", host, port);
+    return 0;
+}
+
+int shard_configure(const char* spec, int self) {
+    char copy[SHARD_MAX * 64];
+    snprintf(copy, sizeof(copy), "%s", spec);
+
+    int n = 0;
+    char* save = NULL;
+    for (char* item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        if (n == SHARD_MAX || parse_addr(item, n) < 0) return -1;
+        n++;
+    }
+    if (n == 0 || self < 0 || self >= n) return -1;
+
+    // Los puntos dependen de la dirección, no de la posición en la lista
+    ring_len = 0;
+    for (int s = 0; s < n; s++) {
+        for (int v = 0; v < SHARD_VNODES; v++) {
+            char key[96];
+            snprintf(key, sizeof(key), "%s#%d", names[s], v);
+            ring[ring_len].point = ring_hash(key);
+            ring[ring_len].shard = s;
+            ring_len++;
+        }
+    }
+    qsort(ring, ring_len, sizeof(RingPoint), cmp_point);
+
+    num_shards = n;
+    self_shard = self;
+    return 0;
+}
+
+int shard_enabled(void) {
+    return num_shards > 0;
+}
+
+int shard_count(void) {
+    return num_shards;
+}
+
+int shard_self(void) {
+    return self_shard;
+}
+
+const char* shard_name(int shard) {
+    return shard >= 0 && shard < num_shards ? names[shard] : "";
+}
+
+// Primer punto con hash >= el del usuario (el anillo da la vuelta)
+int shard_owner(const char* user) {
+    if (num_shards <= 1) return 0;
+    uint64_t h = ring_hash(user);
+    int lo = 0, hi = ring_len;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (ring[mid].point < h) lo = mid + 1;
+        else hi = mid;
+    }
+    return ring[lo == ring_len ? 0 : lo].shard;
+}
+
+// ----------------------------
+// Tramas
+// ----------------------------
+
+static int send_all(int fd, const void* buf, int n, int more) {
+    const char* p = buf;
+    while (n > 0) {
+        ssize_t sent = send(fd, p, n, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return -1;
+        p += sent;
+        n -= sent;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void* buf, int n) {
+    char* p = buf;
+    while (n > 0) {
+        ssize_t got = recv(fd, p, n, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        p += got;
+        n -= got;
+    }
+    return 0;
+}
+
+// ----------------------------
+// Lado servidor: un hilo por conexión de otro shard
+// ----------------------------
+
+static void* serve_conn(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    char* frame = NULL;
+    int cap = 0;
+
+    while (1) {
+        unsigned char header[5];
+        if (recv_all(fd, header, 5) < 0) break;
+        uint32_t len;
+        memcpy(&len, header, 4);
+        len = ntohl(len);
+        if (len > SHARD_MAX_FRAME) break;
+        if ((int)len + 1 > cap) {
+            char* bigger = realloc(frame, len + 1);
+            if (!bigger) break;
+            frame = bigger;
+            cap = len + 1;
+        }
+        if (recv_all(fd, frame, len) < 0) break;
+        frame[len] = '\0';
+
+        // Primer campo: la ip del cliente original (para CONNECT)
+        const char* ip = frame;
+        int ip_len = strnlen(frame, len) + 1;
+        if (ip_len > (int)len) break;
+
+        char* reply = NULL;
+        int reply_len = 0;
+        serve_handler(frame + ip_len, len - ip_len, header[4], ip, &reply, &reply_len);
+        atomic_fetch_add_explicit(&stat_served, 1, memory_order_relaxed);
+
+        uint32_t out_len = htonl(reply_len);
+        int failed = send_all(fd, &out_len, 4, reply_len > 0) < 0 ||
+                     (reply_len > 0 && send_all(fd, reply, reply_len, 0) < 0);
+        free(reply);
+        if (failed) break;
+    }
+    free(frame);
+    close(fd);
+    return NULL;
+}
+
+// ¿Viene de la dirección de algún shard de la lista? Las tramas se creen
+// los flags (CHECKED, AUTH) y la ip del cliente, así que nadie más puede hablar
+static int known_peer(const struct sockaddr_in* from) {
+    for (int s = 0; s < num_shards; s++) {
+        if (addrs[s].sin_addr.s_addr == from->sin_addr.s_addr) return 1;
+    }
+    return 0;
+}
+
+static void* accept_thread(void* arg) {
+    while (1) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int fd = accept(serve_fd, (struct sockaddr*)&from, &from_len);
+        if (fd < 0) {
+            if (errno != EINTR) perror("accept (shards)");
+            continue;
+        }
+        if (!known_peer(&from)) {
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip));
+            fprintf(stderr, "shards: conexión de %s rechazada (no está en -S)\n", ip);
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, serve_conn, (void*)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+    return NULL;
+}
+
+int shard_serve(ShardHandler handler) {
+    serve_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (serve_fd < 0) return -1;
+
+    int reuse = 1;
+    setsockopt(serve_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = addrs[self_shard].sin_port,
+        .sin_addr = addrs[self_shard].sin_addr   // Sólo la dirección de -S, no todas
+    };
+    if (bind(serve_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(serve_fd, SOMAXCONN) < 0) {
+        close(serve_fd);
+        serve_fd = -1;
+        return -1;
+    }
+
+    serve_handler = handler;
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, accept_thread, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
+
+// ----------------------------
+// Lado cliente
+// ----------------------------
+
+static void link_close(Link* link) {
+    if (link->fd >= 0) close(link->fd);
+    link->fd = -1;
+    link->pending = 0;
+    link->generation = (link->generation + 1) & 0x7fffffff;
+}
+
+static Link* link_get(int shard) {
+    if (!links) {
+        links = malloc(SHARD_MAX * sizeof(Link));
+        if (!links) return NULL;
+        for (int i = 0; i < SHARD_MAX; i++) links[i] = (Link){ -1, 0, 0 };
+    }
+    Link* link = &links[shard];
+    if (link->fd >= 0) return link;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return NULL;
+    struct timeval tv = { SHARD_TIMEOUT_MS / 1000, (SHARD_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // Salir desde la dirección propia de -S: es la que el otro shard acepta
+    struct sockaddr_in local = { .sin_family = AF_INET, .sin_addr = addrs[self_shard].sin_addr };
+    bind(fd, (struct sockaddr*)&local, sizeof(local));
+    if (connect(fd, (struct sockaddr*)&addrs[shard], sizeof(addrs[shard])) < 0) {
+        close(fd);
+        return NULL;
+    }
+    link->fd = fd;
+    link->pending = 0;
+    return link;
+}
+
+int shard_send(int shard, int flags, const char* ip, const char* request, int len) {
+    if (shard < 0 || shard >= num_shards) return -1;
+    atomic_fetch_add_explicit(&stat_calls, 1, memory_order_relaxed);
+    Link* link = link_get(shard);
+    if (!link) {
+        atomic_fetch_add_explicit(&stat_failures, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    int ip_len = strlen(ip) + 1;
+    unsigned char header[5];
+    uint32_t frame_len = htonl(ip_len + len);
+    memcpy(header, &frame_len, 4);
+    header[4] = (unsigned char)flags;
+    if (send_all(link->fd, header, 5, 1) < 0 || send_all(link->fd, ip, ip_len, 1) < 0 ||
+        send_all(link->fd, request, len, 0) < 0) {
+        // Lo que hubiera pendiente en esta conexión también se pierde
+        atomic_fetch_add_explicit(&stat_failures, 1 + link->pending, memory_order_relaxed);
+        link_close(link);
+        return -1;
+    }
+    link->pending++;
+    return link->generation;
+}
+
+int shard_recv(int shard, int generation, char** reply, int* reply_len) {
+    *reply = NULL;
+    *reply_len = 0;
+    if (shard < 0 || shard >= num_shards || !links || generation < 0) return -1;
+    Link* link = &links[shard];
+    // Se cerró al fallar un envío o una respuesta anterior: ya contada como fallo
+    if (link->generation != generation || link->fd < 0 || link->pending == 0) return -1;
+
+    uint32_t len;
+    char* data = NULL;
+    if (recv_all(link->fd, &len, 4) == 0) {
+        len = ntohl(len);
+        data = len <= SHARD_MAX_FRAME ? malloc(len ? len : 1) : NULL;
+        if (data && recv_all(link->fd, data, len) == 0) {
+            link->pending--;
+            *reply = data;
+            *reply_len = len;
+            return 0;
+        }
+    }
+    free(data);
+    atomic_fetch_add_explicit(&stat_failures, link->pending, memory_order_relaxed);
+    link_close(link);
+    return -1;
+}
+
+void shard_stats(ShardStats* out) {
+    out->calls = atomic_load(&stat_calls);
+    out->served = atomic_load(&stat_served);
+    out->failures = atomic_load(&stat_failures);
+}
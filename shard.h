@@ -0,0 +1,74 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+// ----------------------------
+// Directorio repartido entre varios procesos servidor (modo shards)
+// ----------------------------
+//
+// Con -S host:puerto,host:puerto,... -i <posición propia en la lista>, cada
+// servidor es dueño de los usuarios que le tocan en un anillo de hash
+// consistente (SHARD_VNODES puntos por shard, colocados según su dirección):
+// todo lo de un usuario (alta, conexión, archivos, WAL, caducidad) vive
+// sólo en su shard, con su propio user_mutex. Todos los shards tienen que
+// arrancar con la misma lista. Los puertos de -S son los del canal interno;
+// los clientes pueden ir al puerto normal (-p) de cualquiera.
+//
+// Canal interno: conexiones TCP persistentes, una por hilo y shard destino,
+// con tramas como las de v2:
+//     petición  [longitud u32 big-endian][flags u8]"ip del cliente\0" + campos de la petición
+//     respuesta [longitud u32 big-endian][lo que se le respondería al cliente]
+// En cada conexión las respuestas salen en el orden de las peticiones, así
+// que se pueden mandar varias antes de leer. Las atiende un hilo por
+// conexión que nunca reenvía: un shard que espera a otro no puede acabar
+// esperándose a sí mismo. El canal se fía de los flags y de la ip que trae
+// cada trama, así que sólo escucha en la dirección propia de -S y sólo
+// acepta conexiones que vengan de las direcciones de la lista (cada shard
+// sale desde la suya).
+
+#include <stdint.h>
+
+#define SHARD_MAX        64
+#define SHARD_VNODES     64             // Puntos de cada shard en el anillo
+#define SHARD_TIMEOUT_MS 3000           // Sin respuesta en este tiempo, el shard se da por caído
+#define SHARD_MAX_FRAME  (64 << 20)
+
+// Flags de la trama interna
+#define SHARD_FLAG_NO_TIMESTAMP 0x01    // Como en v2: la petición no trae timestamp
+#define SHARD_FLAG_CHECKED      0x02    // El shard del usuario ya lo ha comprobado (y auditado)
+#define SHARD_FLAG_AUTH         0x04    // Sólo comprobar al usuario y auditar: responde 0/1/2
+
+typedef struct {
+    uint64_t calls;           // Tramas mandadas a otros shards
+    uint64_t served;          // Tramas atendidas de otros shards
+    uint64_t failures;        // Tramas sin respuesta (shard caído, plazo agotado...)
+} ShardStats;
+
+// Lee la lista de -S y la posición propia. -1 si no vale.
+int shard_configure(const char* spec, int self);
+int shard_enabled(void);
+int shard_count(void);
+int shard_self(void);
+const char* shard_name(int shard);    // "host:puerto" tal como vino en -S
+
+// Shard dueño de un usuario
+int shard_owner(const char* user);
+
+// Atiende el canal interno en el puerto propio de -S. handler recibe la
+// petición sin la ip y deja en *reply (malloc) la respuesta.
+typedef void (*ShardHandler)(const char* request, int len, int flags, const char* ip,
+                             char** reply, int* reply_len);
+int shard_serve(ShardHandler handler);
+
+// Cliente del canal interno (conexiones propias del hilo que llama).
+// shard_send manda una petición y devuelve la generación de la conexión
+// por la que ha salido (>= 0). shard_recv lee la siguiente respuesta de ese
+// shard en *reply (malloc), siempre que la conexión siga siendo de esa
+// generación: si se cerró por un fallo, lo pendiente en ella falla en vez
+// de llevarse respuestas de peticiones mandadas después por la nueva.
+// -1 si el shard no está o no contesta.
+int shard_send(int shard, int flags, const char* ip, const char* request, int len);
+int shard_recv(int shard, int generation, char** reply, int* reply_len);
+
+void shard_stats(ShardStats* out);
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include "slab.h"
+
+// Clases de tamaño para slab_alloc_size (cada una ~1.5x la anterior)
+static SlabPool classes[] = {
+    SLAB_POOL_INIT(16),  SLAB_POOL_INIT(24),  SLAB_POOL_INIT(32),
+    SLAB_POOL_INIT(48),  SLAB_POOL_INIT(64),  SLAB_POOL_INIT(96),
+    SLAB_POOL_INIT(128), SLAB_POOL_INIT(192), SLAB_POOL_INIT(256),
+    SLAB_POOL_INIT(384), SLAB_POOL_INIT(512),
+};
+#define NUM_CLASSES (sizeof(classes) / sizeof(classes[0]))
+
+void* slab_alloc(SlabPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+
+    void* obj = pool->free_list;
+    if (obj) {
+        pool->free_list = *(void**)obj;
+    } else {
+        if (pool->chunk_pos == NULL || pool->chunk_pos + pool->obj_size > pool->chunk_end) {
+            char* chunk = malloc(SLAB_CHUNK_SIZE);
+            if (!chunk) {
+                pthread_mutex_unlock(&pool->lock);
+                return NULL;
+            }
+            pool->chunk_pos = chunk;
+            pool->chunk_end = chunk + SLAB_CHUNK_SIZE;
+            pool->reserved += SLAB_CHUNK_SIZE;
+        }
+        obj = pool->chunk_pos;
+        pool->chunk_pos += pool->obj_size;
+    }
+    pool->in_use++;
+
+    pthread_mutex_unlock(&pool->lock);
+    return obj;
+}
+
+void slab_free(SlabPool* pool, void* ptr) {
+    if (!ptr) return;
+    pthread_mutex_lock(&pool->lock);
+    *(void**)ptr = pool->free_list;
+    pool->free_list = ptr;
+    pool->in_use--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static SlabPool* class_for(size_t size) {
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        if (size <= classes[i].obj_size) return &classes[i];
+    }
+    return NULL;
+}
+
+void* slab_alloc_size(size_t size) {
+    SlabPool* pool = class_for(size);
+    return pool ? slab_alloc(pool) : malloc(size);
+}
+
+void slab_free_size(void* ptr, size_t size) {
+    SlabPool* pool = class_for(size);
+    if (pool) slab_free(pool, ptr);
+    else free(ptr);
+}
+
+void slab_usage(SlabPool* pool, size_t* used, size_t* reserved) {
+    pthread_mutex_lock(&pool->lock);
+    *used = pool->in_use * pool->obj_size;
+    *reserved = pool->reserved;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void slab_class_usage(size_t* used, size_t* reserved) {
+    *used = *reserved = 0;
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        size_t u, r;
+        slab_usage(&classes[i], &u, &r);
+        *used += u;
+        *reserved += r;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// ----------------------------
+// Pools de objetos de tamaño fijo (slabs)
+// ----------------------------
+//
+// Cada pool reparte objetos de un único tamaño sacados de bloques grandes
+// (SLAB_CHUNK_SIZE) y recicla los liberados con una lista libre. Los
+// bloques no se devuelven nunca al sistema. Sin la cabecera de malloc por
+// objeto y sin redondear a su granularidad, un nodo ocupa lo que mide.
+//
+// Además hay clases de tamaño (16..512 bytes) para objetos de longitud
+// variable: slab_alloc_size/slab_free_size, pasando el mismo tamaño.
+
+#define SLAB_CHUNK_SIZE (64 * 1024)
+
+typedef struct SlabPool {
+    size_t obj_size;          // Tamaño de cada objeto (múltiplo de 8)
+    pthread_mutex_t lock;
+    void* free_list;          // Objetos liberados (enlazados por su primera palabra)
+    char* chunk_pos;          // Siguiente objeto sin estrenar del bloque actual
+    char* chunk_end;
+    size_t in_use;            // Objetos entregados
+    size_t reserved;          // Bytes pedidos al sistema en bloques
+} SlabPool;
+
+#define SLAB_POOL_INIT(size) \
+    { (((size) + 7) & ~(size_t)7), PTHREAD_MUTEX_INITIALIZER, NULL, NULL, NULL, 0, 0 }
+
+void* slab_alloc(SlabPool* pool);
+void slab_free(SlabPool* pool, void* ptr);
+
+// Objetos de tamaño variable; por encima de 512 bytes se usa malloc
+void* slab_alloc_size(size_t size);
+void slab_free_size(void* ptr, size_t size);
+
+// Bytes entregados y bytes reservados de un pool
+void slab_usage(SlabPool* pool, size_t* used, size_t* reserved);
+
+// Lo mismo, sumando todas las clases de tamaño
+void slab_class_usage(size_t* used, size_t* reserved);
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "strmap.h"
+#include "epoch.h"
+
+// Valores reservados del campo hash
+#define SLOT_EMPTY      0
+#define SLOT_TOMBSTONE  1
+
+#define MIN_CAPACITY    16
+
+// FNV-1a de 64 bits. Se evitan los valores reservados 0 y 1.
+uint64_t strmap_hash(const char* key) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char* p = (const unsigned char*)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h < 2 ? h + 2 : h;
+}
+
+static size_t round_capacity(size_t n) {
+    size_t cap = MIN_CAPACITY;
+    while (cap < n) cap <<= 1;
+    return cap;
+}
+
+static StrMapTable* table_new(size_t capacity) {
+    StrMapTable* t = calloc(1, sizeof(StrMapTable) + capacity * sizeof(StrMapSlot));
+    if (t) t->capacity = capacity;
+    return t;
+}
+
+int strmap_init(StrMap* map, size_t initial_capacity) {
+    StrMapTable* t = table_new(round_capacity(initial_capacity));
+    atomic_init(&map->table, t);
+    map->count = 0;
+    map->tombstones = 0;
+    return t ? 0 : -1;
+}
+
+void strmap_destroy(StrMap* map) {
+    free(atomic_load(&map->table));
+    atomic_store(&map->table, NULL);
+    map->count = map->tombstones = 0;
+}
+
+// Busca el hueco de la clave. Devuelve su índice o -1 si no está.
+// Seguro frente a un escritor concurrente: se relee el hash tras leer
+// clave y valor, y si el hueco ha cambiado se vuelve a mirar.
+static long find_slot(const StrMapTable* t, const char* key, uint64_t h, void** value) {
+    size_t mask = t->capacity - 1;
+    size_t i = h & mask;
+
+    while (1) {
+        const StrMapSlot* s = &t->slots[i];
+        uint64_t slot_hash = atomic_load_explicit(&s->hash, memory_order_acquire);
+        if (slot_hash == SLOT_EMPTY) return -1;
+
+        if (slot_hash == h) {
+            const char* slot_key = atomic_load_explicit(&s->key, memory_order_relaxed);
+            void* slot_value = atomic_load_explicit(&s->value, memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&s->hash, memory_order_relaxed) != slot_hash) continue;
+
+            if (strcmp(slot_key, key) == 0) {
+                if (value) *value = slot_value;
+                return (long)i;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+// Reconstruye la tabla con la capacidad indicada (descarta las lápidas).
+// La tabla vieja se retira: puede haber lectores recorriéndola.
+static int rehash(StrMap* map, size_t new_capacity) {
+    StrMapTable* old = atomic_load(&map->table);
+    StrMapTable* t = table_new(new_capacity);
+    if (!t) return -1;
+
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < old->capacity; i++) {
+        StrMapSlot* s = &old->slots[i];
+        uint64_t h = atomic_load_explicit(&s->hash, memory_order_relaxed);
+        if (h < 2) continue;
+
+        size_t j = h & mask;
+        while (atomic_load_explicit(&t->slots[j].hash, memory_order_relaxed) != SLOT_EMPTY) j = (j + 1) & mask;
+        atomic_store_explicit(&t->slots[j].key, atomic_load_explicit(&s->key, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&t->slots[j].value, atomic_load_explicit(&s->value, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&t->slots[j].hash, h, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&map->table, t, memory_order_release);
+    map->tombstones = 0;
+    epoch_retire(old, free);
+    return 0;
+}
+
+int strmap_reserve(StrMap* map, size_t n) {
+    size_t cap = round_capacity(n * 10 / 7 + 1);
+    StrMapTable* t = atomic_load(&map->table);
+    if (cap <= t->capacity) return 0;
+    return rehash(map, cap);
+}
+
+void* strmap_get(const StrMap* map, const char* key) {
+    void* value = NULL;
+    StrMapTable* t = atomic_load_explicit(&map->table, memory_order_acquire);
+    return find_slot(t, key, strmap_hash(key), &value) < 0 ? NULL : value;
+}
+
+int strmap_put(StrMap* map, const char* key, void* value) {
+    uint64_t h = strmap_hash(key);
+    StrMapTable* t = atomic_load(&map->table);
+    if (find_slot(t, key, h, NULL) >= 0) return 1; // Ya existe
+
+    // Mantener ocupados + lápidas por debajo del 70%
+    if ((map->count + map->tombstones + 1) * 10 > t->capacity * 7) {
+        // Si sobran lápidas basta con limpiar; si no, duplicar
+        size_t new_cap = (map->count + 1) * 10 > t->capacity * 5
+                         ? t->capacity * 2 : t->capacity;
+        if (rehash(map, new_cap) < 0) return -1;
+        t = atomic_load(&map->table);
+    }
+
+    // Reutilizar la primera lápida o hueco vacío del sondeo
+    size_t mask = t->capacity - 1;
+    size_t i = h & mask;
+    while (atomic_load_explicit(&t->slots[i].hash, memory_order_relaxed) >= 2) i = (i + 1) & mask;
+
+    StrMapSlot* s = &t->slots[i];
+    if (atomic_load_explicit(&s->hash, memory_order_relaxed) == SLOT_TOMBSTONE) map->tombstones--;
+    atomic_store_explicit(&s->key, key, memory_order_relaxed);
+    atomic_store_explicit(&s->value, value, memory_order_relaxed);
+    atomic_store_explicit(&s->hash, h, memory_order_release); // Publicar la entrada
+    map->count++;
+    return 0;
+}
+
+void* strmap_remove(StrMap* map, const char* key) {
+    void* value = NULL;
+    StrMapTable* t = atomic_load(&map->table);
+    long i = find_slot(t, key, strmap_hash(key), &value);
+    if (i < 0) return NULL;
+
+    // Clave y valor se dejan: un lector que ya pasó por el hash aún los usa
+    atomic_store_explicit(&t->slots[i].hash, SLOT_TOMBSTONE, memory_order_release);
+    map->count--;
+    map->tombstones++;
+    return value;
+}
+
+int strmap_next(const StrMap* map, size_t* pos, const char** key, void** value) {
+    StrMapTable* t = atomic_load_explicit(&map->table, memory_order_acquire);
+    while (*pos < t->capacity) {
+        StrMapSlot* s = &t->slots[(*pos)++];
+        if (atomic_load_explicit(&s->hash, memory_order_acquire) < 2) continue;
+        if (key) *key = atomic_load_explicit(&s->key, memory_order_relaxed);
+        if (value) *value = atomic_load_explicit(&s->value, memory_order_relaxed);
+        return 1;
+    }
+    return 0;
+}
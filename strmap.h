@@ -0,0 +1,57 @@
+#ifndef STRMAP_H
+#define STRMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ----------------------------
+// Tabla hash de direccionamiento abierto (clave = cadena)
+// ----------------------------
+//
+// Sondeo lineal sobre una tabla de tamaño potencia de 2. Los borrados dejan
+// una lápida (tombstone) para no romper las cadenas de sondeo, y la tabla se
+// redimensiona (o se rehace al mismo tamaño) cuando ocupados + lápidas
+// superan el 70% de la capacidad.
+//
+// La clave NO se copia: el puntero debe seguir siendo válido mientras la
+// entrada esté en la tabla (normalmente apunta a un campo del propio valor).
+//
+// Las escrituras (put/remove) las serializa el llamante con su lock.
+// strmap_get y strmap_next se pueden llamar sin lock dentro de una sección
+// epoch_enter/epoch_exit: al redimensionar, la tabla vieja se retira con
+// epoch_retire, y un hueco borrado conserva su clave y su valor hasta que
+// se reutiliza.
+
+typedef struct {
+    _Atomic uint64_t hash;        // Hash de la clave (0 = vacío, 1 = lápida)
+    const char* _Atomic key;      // Clave (prestada)
+    void* _Atomic value;          // Valor asociado
+} StrMapSlot;
+
+typedef struct {
+    size_t capacity;              // Número de huecos (potencia de 2)
+    StrMapSlot slots[];
+} StrMapTable;
+
+typedef struct {
+    StrMapTable* _Atomic table;   // Tabla actual (se sustituye entera al redimensionar)
+    size_t count;                 // Entradas vivas
+    size_t tombstones;            // Huecos marcados como borrados
+} StrMap;
+
+uint64_t strmap_hash(const char* key);
+
+int strmap_init(StrMap* map, size_t initial_capacity);
+void strmap_destroy(StrMap* map);
+
+// Deja sitio para n entradas sin redimensionar (p. ej. antes de una carga masiva)
+int strmap_reserve(StrMap* map, size_t n);
+
+void* strmap_get(const StrMap* map, const char* key);
+int strmap_put(StrMap* map, const char* key, void* value);   // 0 OK, 1 ya existe, -1 sin memoria
+void* strmap_remove(StrMap* map, const char* key);           // Devuelve el valor borrado o NULL
+
+// Recorrido: *pos debe empezar a 0. Devuelve 0 al terminar.
+int strmap_next(const StrMap* map, size_t* pos, const char** key, void** value);
+
+#endif
@@ -0,0 +1,34 @@
+# test10.sh: Prueba SEARCH sobre el índice global de archivos
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+echo "== Test10: SEARCH de un archivo publicado por varios usuarios =="
+
+# Dos usuarios publican el mismo archivo en paralelo
+for i in {2..3}; do
+  printf "REGISTER sr$i\nCONNECT sr$i\nPUBLISH report.pdf Informe$i\nQUIT\n" | $CLIENT &
+  sleep 0.05
+done
+wait
+
+# sr1 lo publica y lo borra: la búsqueda sólo debe devolver sr2 y sr3
+$CLIENT <<EOT
+REGISTER sr1
+CONNECT sr1
+PUBLISH report.pdf Informe1
+DELETE report.pdf
+SEARCH report.pdf
+SEARCH noexiste.pdf
+DISCONNECT sr1
+UNREGISTER sr1
+QUIT
+EOT
+
+# Limpieza
+for i in {2..3}; do
+  printf "DISCONNECT sr$i\nUNREGISTER sr$i\nQUIT\n" | $CLIENT
+done
+
+echo "== Test10: Finalizado =="
@@ -0,0 +1,20 @@
+# test11.sh: Prueba del protocolo v2 (una sola conexión persistente)
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT --v2"
+
+echo "== Test11: Secuencia completa sobre una conexión v2 =="
+$CLIENT <<EOF2
+REGISTER v2user
+CONNECT v2user
+PUBLISH v2.txt Descripcion_v2
+LIST_USERS
+LIST_CONTENT v2user
+DELETE v2.txt
+DISCONNECT v2user
+UNREGISTER v2user
+QUIT
+EOF2
+
+echo "== Test11: Finalizado =="
@@ -0,0 +1,23 @@
+# test12.sh: LIST_USERS tras cambios de conexión (la caché debe invalidarse)
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+echo "== Test12: LIST_USERS refleja cada CONNECT/DISCONNECT =="
+$CLIENT <<EOF2
+REGISTER cache1
+REGISTER cache2
+CONNECT cache1
+LIST_USERS
+LIST_USERS
+DISCONNECT cache1
+CONNECT cache2
+LIST_USERS
+DISCONNECT cache2
+UNREGISTER cache1
+UNREGISTER cache2
+QUIT
+EOF2
+
+echo "== Test12: Finalizado =="
@@ -0,0 +1,20 @@
+# test13.sh: STATS devuelve las métricas del servidor (contadores por operación)
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+echo "== Test13: STATS tras unas cuantas operaciones =="
+$CLIENT <<EOF2
+REGISTER stats1
+CONNECT stats1
+PUBLISH stats.txt fichero de prueba
+LIST_USERS
+STATS
+DELETE stats.txt
+DISCONNECT stats1
+UNREGISTER stats1
+QUIT
+EOF2
+
+echo "== Test13: Finalizado =="
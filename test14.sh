@@ -0,0 +1,22 @@
+# test14.sh: LIST_CONTENT de un catálogo grande, por páginas y con descripciones
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+echo "== Test14: LIST_CONTENT de 1200 archivos (varias páginas) =="
+{
+    echo "REGISTER archivo1"
+    echo "CONNECT archivo1"
+    for i in $(seq 1 1200); do
+        echo "PUBLISH fichero_$i.txt copia numero $i"
+    done
+    echo "LIST_CONTENT archivo1"
+    echo "LIST_CONTENT archivo1 -d"
+    echo "LIST_CONTENT nadie"
+    echo "DISCONNECT archivo1"
+    echo "UNREGISTER archivo1"
+    echo "QUIT"
+} | $CLIENT | grep -c "^fichero_"
+
+echo "== Test14: Finalizado =="
@@ -0,0 +1,29 @@
+# test15.sh: WATCH_USERS recibe los CONNECT/DISCONNECT de otros clientes sin preguntar
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+echo "== Test15: un cliente suscrito ve entrar y salir a otro =="
+{
+    echo "REGISTER vigia"
+    echo "CONNECT vigia"
+    echo "WATCH_USERS"
+    sleep 2
+    echo "DISCONNECT vigia"
+    echo "UNREGISTER vigia"
+    echo "QUIT"
+} | $CLIENT &
+WATCHER=$!
+
+sleep 1
+$CLIENT <<EOF2
+REGISTER visita
+CONNECT visita
+DISCONNECT visita
+UNREGISTER visita
+QUIT
+EOF2
+
+wait $WATCHER
+echo "== Test15: Finalizado =="
@@ -0,0 +1,35 @@
+# test16.sh: MIRROR copia todo lo publicado por otro usuario con un solo GET_FILES
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+for i in $(seq 1 20); do echo "contenido $i" > espejo_$i.txt; done
+
+echo "== Test16: MIRROR de 20 archivos (un GET_FILES para todos) =="
+{
+    echo "REGISTER origen"
+    echo "CONNECT origen"
+    for i in $(seq 1 20); do echo "PUBLISH espejo_$i.txt copia $i"; done
+    sleep 2
+    echo "DISCONNECT origen"
+    echo "UNREGISTER origen"
+    echo "QUIT"
+} | $CLIENT > /dev/null &
+ORIGIN=$!
+
+sleep 1
+$CLIENT <<EOF2
+REGISTER copia
+CONNECT copia
+MIRROR origen espejo_destino
+MIRROR nadie espejo_destino
+DISCONNECT copia
+UNREGISTER copia
+QUIT
+EOF2
+
+wait $ORIGIN
+ls espejo_destino | wc -l
+rm -rf espejo_destino espejo_*.txt
+echo "== Test16: Finalizado =="
@@ -0,0 +1,24 @@
+# test17.sh: PUBLISH_DIR/DELETE_DIR publican y borran un directorio entero por lotes
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+mkdir -p lote_dir
+for i in $(seq 1 3000); do : > lote_dir/f_$i.txt; done
+
+echo "== Test17: 3000 archivos con PUBLISH_BATCH, repetidos y DELETE_BATCH =="
+$CLIENT <<EOF2
+REGISTER lote1
+CONNECT lote1
+PUBLISH lote_dir/f_7.txt publicado antes
+PUBLISH_DIR lote_dir archivo del lote
+DELETE lote_dir/f_9.txt
+DELETE_DIR lote_dir
+DISCONNECT lote1
+UNREGISTER lote1
+QUIT
+EOF2
+
+rm -rf lote_dir
+echo "== Test17: Finalizado =="
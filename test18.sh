@@ -0,0 +1,46 @@
+# test18.sh: Varias descargas a la vez del mismo archivo grande (peer_server con sendfile)
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+N=8
+
+head -c 64M /dev/urandom > grande.bin
+
+echo "== Test18: $N GET_FILE simultáneos de 64 MB al mismo cliente =="
+{
+    echo "REGISTER fuente"
+    echo "CONNECT fuente"
+    echo "PUBLISH grande.bin archivo grande"
+    sleep 15
+    echo "DISCONNECT fuente"
+    echo "UNREGISTER fuente"
+    echo "QUIT"
+} | $CLIENT > /dev/null &
+ORIGIN=$!
+
+sleep 2
+PIDS=""
+for i in $(seq 1 $N); do
+    $CLIENT > /dev/null <<EOF2 &
+REGISTER bajada_$i
+CONNECT bajada_$i
+GET_FILE fuente grande.bin grande_$i.bin
+DISCONNECT bajada_$i
+UNREGISTER bajada_$i
+QUIT
+EOF2
+    PIDS="$PIDS $!"
+done
+wait $PIDS
+
+ORIG=$(md5sum < grande.bin)
+OK=0
+for i in $(seq 1 $N); do
+    [ "$(md5sum < grande_$i.bin)" = "$ORIG" ] && OK=$((OK + 1))
+done
+echo "$OK/$N copias idénticas"
+
+wait $ORIGIN
+rm -f grande.bin grande_*.bin
+echo "== Test18: Finalizado =="
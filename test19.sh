@@ -0,0 +1,56 @@
+# test19.sh: SWARM_GET de un archivo que publican tres usuarios, y reanudación tras cortar la descarga
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+head -c 256M /dev/urandom > enjambre.bin
+
+echo "== Test19: SWARM_GET de 256 MB desde 3 fuentes =="
+PIDS=""
+for i in 1 2 3; do
+    {
+        echo "REGISTER fuente_$i"
+        echo "CONNECT fuente_$i"
+        echo "PUBLISH enjambre.bin copia $i"
+        sleep 15
+        echo "DISCONNECT fuente_$i"
+        echo "UNREGISTER fuente_$i"
+        echo "QUIT"
+    } | $CLIENT > /dev/null &
+    PIDS="$PIDS $!"
+done
+sleep 2
+
+# Primer intento cortado en cuanto hay trozos comprobados: deja enjambre_copia.bin.part
+{
+    echo "REGISTER cortado"
+    echo "CONNECT cortado"
+    echo "SWARM_GET enjambre.bin enjambre_copia.bin fuente_1 fuente_2 fuente_3"
+} | $CLIENT > /dev/null &
+CUT=$!
+disown $CUT
+for t in $(seq 1 1000); do
+    [ "$(cat enjambre_copia.bin.part.sums 2>/dev/null | wc -l)" -ge 8 ] && break
+    sleep 0.01
+done
+kill -9 $CUT 2>/dev/null
+sleep 0.5
+echo "descarga cortada con $(($(wc -l < enjambre_copia.bin.part.sums) - 1)) trozos de 64 ya comprobados"
+
+$CLIENT <<EOF2
+REGISTER enjambre
+CONNECT enjambre
+SWARM_GET enjambre.bin enjambre_copia.bin fuente_1 fuente_2 fuente_3 nadie
+SWARM_GET noexiste.bin x.bin fuente_1
+DISCONNECT enjambre
+UNREGISTER enjambre
+QUIT
+EOF2
+
+[ "$(md5sum < enjambre.bin)" = "$(md5sum < enjambre_copia.bin)" ] && echo "copia idéntica" || echo "copia DISTINTA"
+ls enjambre_copia.bin.part* 2>/dev/null
+
+wait $PIDS
+rm -f enjambre.bin enjambre_copia.bin*
+echo "== Test19: Finalizado =="
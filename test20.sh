@@ -0,0 +1,65 @@
+# test20.sh: GET_FILE de un archivo cuyo dueño se ha desconectado, servido por quien tiene los mismos bytes con otro nombre
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+head -c 64M /dev/urandom > original.bin
+cp original.bin copia_a.bin
+cp original.bin copia_b.bin
+head -c 64M /dev/urandom > otro.bin
+
+echo "== Test20: índice de contenido (PUBLISH con hash + GET_SOURCES) =="
+# El dueño publica y se va; otros dos tienen el mismo contenido con otro nombre
+{
+    echo "REGISTER dueno"
+    echo "CONNECT dueno"
+    echo "PUBLISH original.bin el original"
+    echo "PUBLISH fantasma.txt sin copia local"
+    sleep 3
+    echo "DISCONNECT dueno"
+    sleep 20
+    echo "UNREGISTER dueno"
+    echo "QUIT"
+} | $CLIENT > /dev/null &
+PIDS="$!"
+for u in a b; do
+    {
+        echo "REGISTER copia_$u"
+        echo "CONNECT copia_$u"
+        echo "PUBLISH copia_$u.bin otra copia"
+        sleep 22
+        echo "DISCONNECT copia_$u"
+        echo "UNREGISTER copia_$u"
+        echo "QUIT"
+    } | $CLIENT > /dev/null &
+    PIDS="$PIDS $!"
+done
+{
+    echo "REGISTER distinto"
+    echo "CONNECT distinto"
+    echo "PUBLISH otro.bin mismo tamaño, otros bytes"
+    sleep 22
+    echo "DISCONNECT distinto"
+    echo "UNREGISTER distinto"
+    echo "QUIT"
+} | $CLIENT > /dev/null &
+PIDS="$PIDS $!"
+sleep 6
+
+$CLIENT <<EOF2
+REGISTER descarga
+CONNECT descarga
+GET_FILE dueno original.bin descargado.bin
+GET_FILE dueno fantasma.txt fantasma_copia.txt
+GET_FILE dueno noexiste.bin x.bin
+DISCONNECT descarga
+UNREGISTER descarga
+QUIT
+EOF2
+
+[ "$(md5sum < original.bin)" = "$(md5sum < descargado.bin)" ] && echo "copia idéntica" || echo "copia DISTINTA"
+
+wait $PIDS
+rm -f original.bin copia_a.bin copia_b.bin otro.bin descargado.bin* fantasma_copia.txt*
+echo "== Test20: Finalizado =="
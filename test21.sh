@@ -0,0 +1,59 @@
+# test21.sh: un cliente que se cae sin DISCONNECT deja de aparecer al pasar el plazo sin HEARTBEAT
+# (servidor arrancado con -k 3: tres segundos sin señales y se le da por desconectado)
+#!/bin/bash
+SERVER=localhost
+PORT=5000
+CLIENT="python3 client.py -s $SERVER -p $PORT"
+
+head -c 8M /dev/urandom > latido.bin
+
+echo "== Test21: caducidad de clientes caídos (HEARTBEAT + rueda de temporizadores) =="
+# vivo sigue dando señales; caido publica lo mismo y muere con kill -9
+{
+    echo "REGISTER vivo"
+    echo "CONNECT vivo"
+    echo "PUBLISH latido.bin sigue aquí"
+    sleep 14
+    echo "DISCONNECT vivo"
+    echo "UNREGISTER vivo"
+    echo "QUIT"
+} | $CLIENT > /dev/null &
+VIVO=$!
+{
+    echo "REGISTER caido"
+    echo "CONNECT caido"
+    echo "PUBLISH latido.bin se va a caer"
+    sleep 30
+} | $CLIENT > /dev/null &
+CAIDO=$!
+disown $CAIDO
+sleep 3
+kill -9 $CAIDO
+sleep 0.5
+
+# Recién caído todavía figura como conectado y su GET_FILE va a un puerto muerto
+$CLIENT <<EOF2 | grep -v "^c> $"
+REGISTER observa
+CONNECT observa
+LIST_USERS
+QUIT
+EOF2
+
+sleep 5
+
+# Pasado el plazo: fuera de LIST_USERS y su archivo se sirve desde vivo
+$CLIENT <<EOF2 | grep -v "^c> $"
+CONNECT observa
+LIST_USERS
+GET_FILE caido latido.bin latido_copia.bin
+DISCONNECT observa
+UNREGISTER observa
+UNREGISTER caido
+QUIT
+EOF2
+
+[ "$(md5sum < latido.bin)" = "$(md5sum < latido_copia.bin)" ] && echo "copia idéntica" || echo "copia DISTINTA"
+
+wait $VIVO
+rm -f latido.bin latido_copia.bin*
+echo "== Test21: Finalizado =="
@@ -0,0 +1,58 @@
+# test22.sh: el directorio repartido entre tres servidores; cada cliente entra por uno distinto y ve a todos
+# (arrancados antes con la misma lista de shards y cada uno con su posición:
+#    ./servidor -p 5000 -S 127.0.0.1:6000,127.0.0.1:6001,127.0.0.1:6002 -i 0
+#    ./servidor -p 5001 -S 127.0.0.1:6000,127.0.0.1:6001,127.0.0.1:6002 -i 1
+#    ./servidor -p 5002 -S 127.0.0.1:6000,127.0.0.1:6001,127.0.0.1:6002 -i 2)
+#!/bin/bash
+SERVER=localhost
+CLIENT="python3 client.py -s $SERVER -p"
+
+head -c 16M /dev/urandom > repartido.bin
+
+echo "== Test22: modo shards (anillo de hash consistente + reenvío entre servidores) =="
+# Cada uno se registra, conecta y publica por un servidor distinto
+PIDS=""
+for entry in "ana 5000 repartido.bin" "fede 5001 repartido.bin" "carla 5002 nota_carla.txt"; do
+    set -- $entry
+    {
+        echo "REGISTER $1"
+        echo "CONNECT $1"
+        echo "PUBLISH $3 publicado por $1 en el $2"
+        sleep 12
+        echo "DISCONNECT $1"
+        echo "UNREGISTER $1"
+        echo "QUIT"
+    } | $CLIENT $2 > /dev/null &
+    PIDS="$PIDS $!"
+done
+sleep 4
+
+# El mismo nombre por otro servidor: ya existe (lo sabe su shard, no el de entrada)
+$CLIENT 5002 <<EOF2 | grep -v "^c> $"
+REGISTER ana
+QUIT
+EOF2
+
+# dani entra por el 5001 y ve a todos, esté cada uno en el shard que esté
+$CLIENT 5001 <<EOF2 | grep -v "^c> $"
+REGISTER dani
+CONNECT dani
+LIST_USERS
+LIST_CONTENT ana
+LIST_CONTENT carla
+LIST_CONTENT nadie
+SEARCH repartido.bin
+GET_FILE ana repartido.bin copia_ana.bin
+SWARM_GET repartido.bin copia_swarm.bin ana fede
+GET_FILE carla noexiste.txt x.txt
+DISCONNECT dani
+UNREGISTER dani
+QUIT
+EOF2
+
+[ "$(md5sum < repartido.bin)" = "$(md5sum < copia_ana.bin)" ] && echo "GET_FILE: copia idéntica" || echo "GET_FILE: copia DISTINTA"
+[ "$(md5sum < repartido.bin)" = "$(md5sum < copia_swarm.bin)" ] && echo "SWARM_GET: copia idéntica" || echo "SWARM_GET: copia DISTINTA"
+
+wait $PIDS
+rm -f repartido.bin copia_ana.bin* copia_swarm.bin*
+echo "== Test22: Finalizado =="
@@ -0,0 +1,92 @@
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_SLOTS - 1)
+
+void timer_wheel_init(TimerWheel* w, uint64_t now) {
+    w->now = now;
+    for (int l = 0; l < TIMER_LEVELS; l++) {
+        for (int s = 0; s < TIMER_SLOTS; s++) {
+            w->slots[l][s].prev = w->slots[l][s].next = &w->slots[l][s];
+        }
+    }
+}
+
+static void list_add(TimerNode* head, TimerNode* n) {
+    n->next = head;
+    n->prev = head->prev;
+    head->prev->next = n;
+    head->prev = n;
+}
+
+void timer_wheel_del(TimerNode* n) {
+    if (!n->prev) return;
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+    n->prev = n->next = NULL;
+}
+
+// Hueco según la distancia a w->now: nivel l si vence dentro de
+// TIMER_SLOTS^(l+1) ticks. Lo que va más allá de la vista se queda en el
+// último nivel y se recoloca al bajar.
+static TimerNode* slot_for(TimerWheel* w, uint64_t expires) {
+    if (expires < w->now) expires = w->now;
+    uint64_t delta = expires - w->now;
+    for (int l = 0; l < TIMER_LEVELS - 1; l++) {
+        if (delta < (1ULL << (TIMER_SLOT_BITS * (l + 1)))) {
+            return &w->slots[l][(expires >> (TIMER_SLOT_BITS * l)) & SLOT_MASK];
+        }
+    }
+    uint64_t max = (1ULL << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1;
+    if (delta > max) expires = w->now + max;
+    int l = TIMER_LEVELS - 1;
+    return &w->slots[l][(expires >> (TIMER_SLOT_BITS * l)) & SLOT_MASK];
+}
+
+void timer_wheel_add(TimerWheel* w, TimerNode* n, uint64_t expires) {
+    timer_wheel_del(n);
+    n->expires = expires;
+    list_add(slot_for(w, expires), n);
+}
+
+// Reparte el hueco index del nivel l entre los niveles de abajo
+static void cascade(TimerWheel* w, int l, int index) {
+    TimerNode* head = &w->slots[l][index];
+    TimerNode* n = head->next;
+    head->prev = head->next = head;
+    while (n != head) {
+        TimerNode* next = n->next;
+        list_add(slot_for(w, n->expires), n);
+        n = next;
+    }
+}
+
+int timer_wheel_advance(TimerWheel* w, uint64_t now, void (*fire)(TimerNode* n, void* ctx), void* ctx) {
+    int fired = 0;
+    while (w->now <= now) {
+        // Al dar la vuelta un nivel, baja lo del hueco que toca del siguiente
+        for (int l = 1; l < TIMER_LEVELS; l++) {
+            if ((w->now & ((1ULL << (TIMER_SLOT_BITS * l)) - 1)) != 0) break;
+            cascade(w, l, (w->now >> (TIMER_SLOT_BITS * l)) & SLOT_MASK);
+        }
+
+        // Se saca la lista entera antes de disparar: fire puede volver a añadir
+        TimerNode* head = &w->slots[0][w->now & SLOT_MASK];
+        TimerNode pending = { head->prev, head->next, 0 };
+        if (head->next == head) {
+            w->now++;
+            continue;
+        }
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        head->prev = head->next = head;
+        w->now++;
+
+        while (pending.next != &pending) {
+            TimerNode* n = pending.next;
+            timer_wheel_del(n);
+            fire(n, ctx);
+            fired++;
+        }
+    }
+    return fired;
+}
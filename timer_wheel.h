@@ -0,0 +1,57 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ----------------------------
+// Rueda de temporizadores jerárquica
+// ----------------------------
+//
+// TIMER_LEVELS ruedas de TIMER_SLOTS huecos: la primera tiene un hueco por
+// tick, la segunda uno por cada TIMER_SLOTS ticks, y así. Un temporizador
+// entra en la rueda que le toca según lo lejos que vence; cuando la primera
+// da la vuelta, el hueco actual de la siguiente se reparte entre las de
+// abajo. Añadir y quitar son O(1) (listas doblemente enlazadas con el nodo
+// metido en la estructura de quien lo usa) y cada tick sólo mira un hueco.
+//
+// Sin lock propio: quien la usa la protege (el registro, con user_mutex).
+
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS     (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS    4           // Hasta 2^24 ticks vista (19 días con ticks de 100 ms)
+
+typedef struct TimerNode {
+    struct TimerNode* prev;         // NULL = no está en la rueda
+    struct TimerNode* next;
+    uint64_t expires;               // Tick en que vence
+} TimerNode;
+
+typedef struct {
+    uint64_t now;                   // Siguiente tick por procesar
+    TimerNode slots[TIMER_LEVELS][TIMER_SLOTS];    // Cabeceras de lista circular
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel* w, uint64_t now);
+
+static inline void timer_node_init(TimerNode* n) {
+    n->prev = n->next = NULL;
+}
+
+static inline int timer_pending(const TimerNode* n) {
+    return n->prev != NULL;
+}
+
+// Programa n para el tick expires (si ya ha pasado, vence en el siguiente
+// timer_wheel_advance). Si ya estaba programado se mueve.
+void timer_wheel_add(TimerWheel* w, TimerNode* n, uint64_t expires);
+
+// Lo quita si está programado
+void timer_wheel_del(TimerNode* n);
+
+// Procesa los ticks hasta now (incluido) y llama a fire con cada
+// temporizador vencido, ya fuera de la rueda (fire puede volver a
+// añadirlo). Devuelve cuántos han vencido.
+int timer_wheel_advance(TimerWheel* w, uint64_t now, void (*fire)(TimerNode* n, void* ctx), void* ctx);
+
+#endif
@@ -0,0 +1,411 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "wal.h"
+#include "crc32.h"
+
+#define RECORD_HEADER  16        // len + crc + lsn
+#define MAX_FIELD      4096      // Los campos del registro nunca son tan largos
+
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t data_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t durable_cv = PTHREAD_COND_INITIALIZER;
+
+static char wal_dir[512];
+static WalSync sync_policy = WAL_SYNC_GROUP;
+static int wal_fd = -1;
+static int running = 0;
+static int stopping = 0;
+static _Atomic int broken = 0;          // Falló una escritura o un fdatasync: ya no se vuelca nada
+static pthread_t flusher;
+
+// Buffer que se está llenando y el que se acaba de volcar (se intercambian)
+static char* buf = NULL;
+static size_t buf_len = 0, buf_cap = 0;
+static char* spare = NULL;
+static size_t spare_cap = 0;
+
+static uint64_t next_lsn = 1;
+static uint64_t durable_lsn = 0;
+
+// Rotación pendiente: desde rotate_offset de buf los registros van al segmento rotate_lsn
+static uint64_t rotate_lsn = 0;
+static size_t rotate_offset = 0;
+
+static WalStats stats;
+
+// Aviso tras cada tanda volcada (o al romperse el WAL), fuera de wal_mutex
+static void (*notify_fn)(void* ctx) = NULL;
+static void* notify_ctx = NULL;
+
+static __thread uint64_t my_lsn = 0;   // Último LSN añadido por este hilo
+
+int wal_parse_sync(const char* name, WalSync* out) {
+    if (strcmp(name, "group") == 0) *out = WAL_SYNC_GROUP;
+    else if (strcmp(name, "async") == 0) *out = WAL_SYNC_ASYNC;
+    else return -1;
+    return 0;
+}
+
+static void segment_path(char* out, size_t size, const char* dir, uint64_t first_lsn) {
+    snprintf(out, size, "%s/wal-%016llx.log", dir, (unsigned long long)first_lsn);
+}
+
+// Un segmento nuevo nunca tiene registros válidos con LSN >= first_lsn: si
+// existe es que quedó vacío o con basura de una caída, y se trunca.
+static int open_segment(uint64_t first_lsn) {
+    char path[600];
+    segment_path(path, sizeof(path), wal_dir, first_lsn);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) return -1;
+
+    // Que la entrada del directorio también sobreviva a una caída
+    int dfd = open(wal_dir, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    return fd;
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Tras un error no se sabe qué ha llegado al disco (y un fdatasync que falla
+// puede haber descartado páginas sucias): no se reintenta, el WAL queda roto.
+static int flush_part(const char* data, size_t len) {
+    if (len == 0) return 0;
+    if (write_all(wal_fd, data, len) < 0 || fdatasync(wal_fd) < 0) {
+        perror("WAL: fallo al escribir, no se aceptan más cambios");
+        return -1;
+    }
+    return 0;
+}
+
+static void* flusher_thread(void* arg) {
+    pthread_mutex_lock(&wal_mutex);
+    while (1) {
+        while (buf_len == 0 && rotate_lsn == 0 && !stopping) {
+            pthread_cond_wait(&data_ready, &wal_mutex);
+        }
+        if (buf_len == 0 && rotate_lsn == 0 && stopping) break;
+
+        // Quedarse con la tanda y dejar un buffer vacío a los escritores
+        char* batch = buf;
+        size_t batch_len = buf_len;
+        size_t batch_cap = buf_cap;
+        uint64_t batch_last = next_lsn - 1;
+        uint64_t new_segment = rotate_lsn;
+        size_t split = new_segment ? rotate_offset : batch_len;
+        rotate_lsn = 0;
+
+        buf = spare;
+        buf_cap = spare_cap;
+        buf_len = 0;
+        int failed = broken;
+        pthread_mutex_unlock(&wal_mutex);
+
+        if (!failed) failed = flush_part(batch, split) < 0;
+        if (new_segment && !failed) {
+            int fd = open_segment(new_segment);
+            if (fd < 0) {
+                perror("WAL: no se puede abrir el segmento nuevo");
+                failed = 1;
+            } else {
+                close(wal_fd);
+                wal_fd = fd;
+                failed = flush_part(batch + split, batch_len - split) < 0;
+            }
+        }
+
+        // Con el WAL roto durable_lsn ya no avanza: quien espera recibe el error
+        pthread_mutex_lock(&wal_mutex);
+        spare = batch;
+        spare_cap = batch_cap;
+        if (failed) {
+            broken = 1;
+        } else {
+            stats.bytes += batch_len;
+            if (batch_len > 0) stats.fsyncs++;
+            durable_lsn = batch_last;
+        }
+        pthread_cond_broadcast(&durable_cv);
+
+        void (*notify)(void*) = notify_fn;
+        void* ctx = notify_ctx;
+        if (notify) {
+            pthread_mutex_unlock(&wal_mutex);
+            notify(ctx);
+            pthread_mutex_lock(&wal_mutex);
+        }
+    }
+    pthread_mutex_unlock(&wal_mutex);
+    return NULL;
+}
+
+int wal_open(const char* dir, WalSync policy, uint64_t first_lsn) {
+    snprintf(wal_dir, sizeof(wal_dir), "%s", dir);
+    sync_policy = policy;
+    next_lsn = first_lsn;
+    durable_lsn = first_lsn - 1;
+
+    wal_fd = open_segment(first_lsn);
+    if (wal_fd < 0) return -1;
+
+    stopping = 0;
+    if (pthread_create(&flusher, NULL, flusher_thread, NULL) != 0) {
+        close(wal_fd);
+        wal_fd = -1;
+        return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+void wal_close(void) {
+    if (!running) return;
+    pthread_mutex_lock(&wal_mutex);
+    stopping = 1;
+    running = 0;
+    pthread_cond_signal(&data_ready);
+    pthread_mutex_unlock(&wal_mutex);
+
+    pthread_join(flusher, NULL);
+    close(wal_fd);
+    wal_fd = -1;
+}
+
+uint64_t wal_append(char type, const char* f1, const char* f2, const char* f3) {
+    if (!running) return 0;
+
+    const char* fields[3] = { f1, f2, f3 };
+    size_t lens[3] = { 0, 0, 0 };
+    size_t payload = 1;
+    for (int i = 0; i < 3 && fields[i]; i++) {
+        lens[i] = strlen(fields[i]) + 1;
+        payload += lens[i];
+    }
+
+    pthread_mutex_lock(&wal_mutex);
+
+    if (!broken && buf_len + RECORD_HEADER + payload > buf_cap) {
+        size_t new_cap = buf_cap ? buf_cap : 64 * 1024;
+        while (buf_len + RECORD_HEADER + payload > new_cap) new_cap *= 2;
+        char* bigger = realloc(buf, new_cap);
+        if (bigger) {
+            buf = bigger;
+            buf_cap = new_cap;
+        } else {
+            // Sin memoria: el cambio no queda en el log y los siguientes
+            // dejarían un hueco, así que el WAL se rompe como si fallara el disco
+            fprintf(stderr, "WAL: sin memoria para el buffer, no se aceptan más cambios\n");
+            broken = 1;
+        }
+    }
+
+    // Roto: el LSN nunca llegará a durable_lsn, así que wal_sync fallará
+    if (broken) {
+        uint64_t lsn = next_lsn++;
+        pthread_mutex_unlock(&wal_mutex);
+        my_lsn = lsn;
+        return lsn;
+    }
+
+    uint64_t lsn = next_lsn++;
+    char* rec = buf + buf_len;
+    char* p = rec + RECORD_HEADER;
+    *p++ = type;
+    for (int i = 0; i < 3 && fields[i]; i++) {
+        memcpy(p, fields[i], lens[i]);
+        p += lens[i];
+    }
+
+    uint32_t len32 = (uint32_t)payload;
+    uint32_t crc = crc32_update(0, &lsn, sizeof(lsn));
+    crc = crc32_update(crc, rec + RECORD_HEADER, payload);
+    memcpy(rec, &len32, 4);
+    memcpy(rec + 4, &crc, 4);
+    memcpy(rec + 8, &lsn, 8);
+    buf_len += RECORD_HEADER + payload;
+    stats.records++;
+
+    pthread_cond_signal(&data_ready);
+    pthread_mutex_unlock(&wal_mutex);
+
+    my_lsn = lsn;
+    return lsn;
+}
+
+uint64_t wal_thread_lsn(void) {
+    uint64_t lsn = my_lsn;
+    my_lsn = 0;
+    return running ? lsn : 0;
+}
+
+int wal_durable(uint64_t lsn) {
+    if (lsn == 0) return 1;
+    if (sync_policy == WAL_SYNC_ASYNC) return atomic_load(&broken) ? -1 : 1;
+
+    pthread_mutex_lock(&wal_mutex);
+    int state = durable_lsn >= lsn ? 1 : broken ? -1 : 0;
+    pthread_mutex_unlock(&wal_mutex);
+    return state;
+}
+
+int wal_wait(uint64_t lsn) {
+    if (lsn == 0) return 0;
+    if (sync_policy == WAL_SYNC_ASYNC) return atomic_load(&broken) ? -1 : 0;
+
+    pthread_mutex_lock(&wal_mutex);
+    while (durable_lsn < lsn && !broken) pthread_cond_wait(&durable_cv, &wal_mutex);
+    int result = durable_lsn >= lsn ? 0 : -1;
+    pthread_mutex_unlock(&wal_mutex);
+    return result;
+}
+
+int wal_sync(void) {
+    return wal_wait(wal_thread_lsn());
+}
+
+void wal_set_notify(void (*fn)(void* ctx), void* ctx) {
+    pthread_mutex_lock(&wal_mutex);
+    notify_fn = fn;
+    notify_ctx = ctx;
+    pthread_mutex_unlock(&wal_mutex);
+}
+
+int wal_failed(void) {
+    return atomic_load(&broken);
+}
+
+uint64_t wal_last_lsn(void) {
+    pthread_mutex_lock(&wal_mutex);
+    uint64_t lsn = next_lsn - 1;
+    pthread_mutex_unlock(&wal_mutex);
+    return lsn;
+}
+
+uint64_t wal_rotate(void) {
+    pthread_mutex_lock(&wal_mutex);
+    if (!running || rotate_lsn != 0 || broken) {
+        pthread_mutex_unlock(&wal_mutex);
+        return 0;
+    }
+    rotate_lsn = next_lsn;
+    rotate_offset = buf_len;
+    uint64_t first = rotate_lsn;
+    pthread_cond_signal(&data_ready);
+    pthread_mutex_unlock(&wal_mutex);
+    return first;
+}
+
+// ----------------------------
+// Recuperación
+// ----------------------------
+
+static int is_segment(const struct dirent* d) {
+    return strncmp(d->d_name, "wal-", 4) == 0 && strstr(d->d_name, ".log") != NULL;
+}
+
+// Aplica los registros válidos de un segmento; para en el primero roto
+static uint64_t replay_segment(const char* path, uint64_t after_lsn, uint64_t last,
+                               void (*apply)(char type, const char* fields[3])) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return last;
+
+    struct stat st;
+    char* data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) data = malloc(st.st_size);
+    if (!data || read(fd, data, st.st_size) != st.st_size) {
+        free(data);
+        close(fd);
+        return last;
+    }
+    close(fd);
+
+    size_t off = 0, size = st.st_size;
+    while (off + RECORD_HEADER <= size) {
+        uint32_t len, crc;
+        uint64_t lsn;
+        memcpy(&len, data + off, 4);
+        memcpy(&crc, data + off + 4, 4);
+        memcpy(&lsn, data + off + 8, 8);
+        if (len == 0 || len > 3 * MAX_FIELD || off + RECORD_HEADER + len > size) break;
+
+        char* payload = data + off + RECORD_HEADER;
+        uint32_t check = crc32_update(crc32_update(0, &lsn, sizeof(lsn)), payload, len);
+        if (check != crc || (len > 1 && payload[len - 1] != '\0')) break;
+        off += RECORD_HEADER + len;
+
+        if (lsn <= after_lsn || lsn <= last) continue;
+
+        const char* fields[3] = { NULL, NULL, NULL };
+        char* p = payload + 1;
+        for (int i = 0; i < 3 && p < payload + len; i++) {
+            fields[i] = p;
+            p = strchr(p, '\0') + 1;
+        }
+        apply(payload[0], fields);
+        last = lsn;
+    }
+
+    if (off < size) fprintf(stderr, "WAL: %s termina en un registro incompleto (%zu bytes ignorados)\n", path, size - off);
+    free(data);
+    return last;
+}
+
+uint64_t wal_replay(const char* dir, uint64_t after_lsn,
+                    void (*apply)(char type, const char* fields[3])) {
+    struct dirent** names;
+    int n = scandir(dir, &names, is_segment, alphasort);
+    if (n < 0) return after_lsn;
+
+    uint64_t last = after_lsn;
+    for (int i = 0; i < n; i++) {
+        char path[600];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+        last = replay_segment(path, after_lsn, last, apply);
+        free(names[i]);
+    }
+    free(names);
+    return last;
+}
+
+void wal_remove_before(const char* dir, uint64_t first_lsn) {
+    struct dirent** names;
+    int n = scandir(dir, &names, is_segment, alphasort);
+    if (n < 0) return;
+
+    for (int i = 0; i < n; i++) {
+        unsigned long long start = strtoull(names[i]->d_name + 4, NULL, 16);
+        if (start < first_lsn) {
+            char path[600];
+            snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+            unlink(path);
+        }
+        free(names[i]);
+    }
+    free(names);
+}
+
+void wal_stats(WalStats* out) {
+    pthread_mutex_lock(&wal_mutex);
+    *out = stats;
+    out->durable_lsn = durable_lsn;
+    pthread_mutex_unlock(&wal_mutex);
+}
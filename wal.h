@@ -0,0 +1,97 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdint.h>
+
+// ----------------------------
+// Write-ahead log del registro
+// ----------------------------
+//
+// Cada cambio del registro (REGISTER, UNREGISTER, PUBLISH, DELETE) se añade
+// como un registro con número de secuencia (LSN) a un buffer en memoria.
+// Un hilo lo vuelca al segmento actual y hace un único fdatasync por tanda
+// (group commit): mientras dura un fsync se van juntando los siguientes.
+//
+// Formato de cada registro en disco:
+//   [u32 len][u32 crc][u64 lsn][u8 tipo][campo\0]...   (len = tipo + campos)
+// El crc cubre lsn, tipo y campos; un registro roto marca el final del
+// segmento (escritura a medias antes de una caída).
+//
+// Los segmentos se llaman wal-<primer lsn en hex>.log y se rotan al hacer
+// un snapshot (persist.h); los anteriores al snapshot se pueden borrar.
+
+#define WAL_REGISTER    'R'   // nombre
+#define WAL_UNREGISTER  'U'   // nombre
+#define WAL_PUBLISH     'P'   // nombre, archivo, descripción
+#define WAL_DELETE      'D'   // nombre, archivo
+#define WAL_CONTENT     'H'   // nombre, archivo, "hash:tamaño" (sigue al 'P' de un PUBLISH_CONTENT)
+
+// Cuándo se responde al cliente
+typedef enum {
+    WAL_SYNC_GROUP,   // Tras el fsync de la tanda que lleva su cambio
+    WAL_SYNC_ASYNC    // En seguida; el volcado va por detrás (se pierden los últimos ms)
+} WalSync;
+
+typedef struct {
+    uint64_t records;        // Registros añadidos
+    uint64_t bytes;          // Bytes escritos
+    uint64_t fsyncs;         // Tandas volcadas con fdatasync
+    uint64_t durable_lsn;    // Último LSN en disco
+} WalStats;
+
+int wal_parse_sync(const char* name, WalSync* out);
+
+// Abre un segmento nuevo en dir que empieza en first_lsn y lanza el hilo de volcado
+int wal_open(const char* dir, WalSync policy, uint64_t first_lsn);
+
+// Vuelca lo pendiente y para el hilo
+void wal_close(void);
+
+// Añade un registro (los campos que sobran van a NULL). Lo llaman los
+// escritores del registro con user_mutex cogido, así el orden del log es
+// el mismo en que se aplican los cambios. Devuelve el LSN (0 si no hay WAL).
+uint64_t wal_append(char type, const char* f1, const char* f2, const char* f3);
+
+// LSN del último registro que ha añadido este hilo desde la llamada
+// anterior (o desde wal_sync), 0 si ninguno
+uint64_t wal_thread_lsn(void);
+
+// ¿Está lsn en disco? 1 sí (o modo async), 0 todavía no, -1 no lo estará
+// nunca (WAL roto). No bloquea: los hilos de eventos aparcan la respuesta
+// y esperan al aviso de wal_set_notify.
+int wal_durable(uint64_t lsn);
+
+// Espera a que lsn esté en disco (en modo async no espera). 0 OK, -1 si el
+// WAL ha fallado y el cambio no está ni estará en disco.
+int wal_wait(uint64_t lsn);
+
+// wal_wait de lo último que ha añadido este hilo
+int wal_sync(void);
+
+// fn(ctx) se llama desde el hilo de volcado tras cada tanda en disco y al
+// romperse el WAL, sin locks cogidos
+void wal_set_notify(void (*fn)(void* ctx), void* ctx);
+
+// Tras un error de escritura o de fdatasync el WAL queda roto: durable_lsn
+// no avanza más y el servidor deja de aceptar cambios
+int wal_failed(void);
+
+// LSN del último registro añadido
+uint64_t wal_last_lsn(void);
+
+// Lo que se añada a partir de ahora va a un segmento nuevo. Requiere
+// user_mutex. Devuelve el primer LSN del segmento nuevo o 0 si ya había
+// una rotación pendiente (o el WAL está roto).
+uint64_t wal_rotate(void);
+
+// Aplica en orden los registros de dir con LSN > after_lsn. Devuelve el
+// último LSN visto (after_lsn si no hay ninguno).
+uint64_t wal_replay(const char* dir, uint64_t after_lsn,
+                    void (*apply)(char type, const char* fields[3]));
+
+// Borra los segmentos que sólo tienen registros anteriores a first_lsn
+void wal_remove_before(const char* dir, uint64_t first_lsn);
+
+void wal_stats(WalStats* out);
+
+#endif